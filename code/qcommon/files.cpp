@@ -1531,7 +1531,7 @@ FS_Write
 Properly handles partial writes
 =================
 */
-int FS_Write( const void *buffer, int len, fileHandle_t h ) {
+int FS_WriteQuiet( const void *buffer, int len, fileHandle_t h, const char **error ) {
 	int		block, remaining;
 	int		written;
 	byte	*buf;
@@ -1556,13 +1556,13 @@ int FS_Write( const void *buffer, int len, fileHandle_t h ) {
 			if (!tries) {
 				tries = 1;
 			} else {
-				Com_Printf( "FS_Write: 0 bytes written\n" );
+				*error = "FS_Write: 0 bytes written";
 				return 0;
 			}
 		}
 
 		if (written == -1) {
-			Com_Printf( "FS_Write: -1 bytes written\n" );
+			*error = "FS_Write: -1 bytes written";
 			return 0;
 		}
 
@@ -1575,6 +1575,16 @@ int FS_Write( const void *buffer, int len, fileHandle_t h ) {
 	return len;
 }
 
+int FS_Write( const void *buffer, int len, fileHandle_t h ) {
+	const char	*error = NULL;
+	const int	written = FS_WriteQuiet( buffer, len, h, &error );
+
+	if ( error ) {
+		Com_Printf( "%s\n", error );
+	}
+	return written;
+}
+
 #define	MAXPRINTMSG	4096
 void QDECL FS_Printf( fileHandle_t h, const char *fmt, ... ) {
 	va_list		argptr;
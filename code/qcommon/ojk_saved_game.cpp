@@ -5,7 +5,10 @@
 
 #include "ojk_saved_game.h"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
+#include <zlib.h>
 #include "ojk_saved_game_helper.h"
 #include "qcommon/qcommon.h"
 #include "server/server.h"
@@ -15,6 +18,110 @@ namespace ojk
 {
 
 
+namespace
+{
+
+
+// Streamed chunk header: chunk id, data size, packed size (zero for
+// uncompressed data) and a CRC-32 of the uncompressed data.
+const int streamed_header_size = 4 * static_cast<int>(sizeof(uint32_t));
+
+// Size of the file window the streamed chunks are inflated through.
+const int streamed_window_size = 64 * 1024;
+
+// Uncompressed size of the queued chunks after which write_chunk waits for
+// the writer thread to catch up.
+const std::size_t max_pending_size = 32 * 1024 * 1024;
+
+// Number of buffers kept around for reuse between chunks.
+const std::size_t max_spare_buffers = 4;
+
+// Largest uncompressed chunk written as a streamed chunk, and so the largest
+// one a load will allocate a buffer for.
+const uint32_t max_chunk_size = 64 * 1024 * 1024;
+
+
+int64_t get_time_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Builds a streamed chunk with a deflated copy of the data, or with the
+// data itself if there is no stream or the data does not compress.
+void pack_chunk(
+	const uint32_t chunk_id,
+	const std::vector<uint8_t>& src_buffer,
+	z_stream* stream,
+	std::vector<uint8_t>& dst_buffer)
+{
+	const uint32_t data_size = static_cast<uint32_t>(src_buffer.size());
+
+	uint32_t packed_size = 0;
+
+	if (stream && data_size > 0)
+	{
+		const uLong bound_size = ::deflateBound(
+			stream,
+			data_size);
+
+		dst_buffer.resize(
+			streamed_header_size + bound_size);
+
+		::deflateReset(
+			stream);
+
+		stream->next_in = const_cast<Bytef*>(src_buffer.data());
+		stream->avail_in = data_size;
+		stream->next_out = &dst_buffer[streamed_header_size];
+		stream->avail_out = static_cast<uInt>(bound_size);
+
+		if (::deflate(stream, Z_FINISH) == Z_STREAM_END &&
+			stream->total_out < data_size)
+		{
+			packed_size = static_cast<uint32_t>(stream->total_out);
+		}
+	}
+
+	if (packed_size > 0)
+	{
+		dst_buffer.resize(
+			streamed_header_size + packed_size);
+	}
+	else
+	{
+		dst_buffer.resize(
+			streamed_header_size + data_size);
+
+		std::uninitialized_copy_n(
+			src_buffer.data(),
+			data_size,
+			&dst_buffer[streamed_header_size]);
+	}
+
+	const uint32_t checksum = static_cast<uint32_t>(::crc32(
+		::crc32(0L, Z_NULL, 0),
+		src_buffer.data(),
+		data_size));
+
+	const uint32_t header[4] =
+	{
+		chunk_id,
+		data_size,
+		packed_size,
+		checksum,
+	};
+
+	std::memcpy(
+		dst_buffer.data(),
+		header,
+		streamed_header_size);
+}
+
+
+} // namespace
+
+
 SavedGame::SavedGame() :
 		error_message_(),
 		file_handle_(),
@@ -23,6 +130,22 @@ SavedGame::SavedGame() :
 		io_buffer_offset_(),
 		saved_io_buffer_offset_(),
 		rle_buffer_(),
+		is_streamed_(),
+		writer_thread_(),
+		writer_mutex_(),
+		writer_wake_(),
+		writer_done_(),
+		pending_chunks_(),
+		spare_buffers_(),
+		pending_size_(),
+		is_writer_busy_(),
+		is_writer_quit_(),
+		is_writer_failed_(),
+		writer_error_message_(),
+		writer_write_error_(),
+		written_raw_size_(),
+		written_packed_size_(),
+		writer_time_us_(),
 		is_readable_(),
 		is_writable_(),
 		is_failed_()
@@ -80,7 +203,11 @@ bool SavedGame::open(
 			INT_ID('_', 'V', 'E', 'R'),
 			sg_version))
 		{
-			if (sg_version != iSAVEGAME_VERSION)
+			if (sg_version == iSAVEGAME_VERSION_STREAMED)
+			{
+				is_streamed_ = true;
+			}
+			else if (sg_version != iSAVEGAME_VERSION)
 			{
 				is_succeed = false;
 
@@ -88,7 +215,7 @@ bool SavedGame::open(
 					S_COLOR_RED "File \"%s\" has version # %d (expecting %d)\n",
 					base_file_name.c_str(),
 					sg_version,
-					iSAVEGAME_VERSION);
+					iSAVEGAME_VERSION_STREAMED);
 			}
 		}
 		else
@@ -139,7 +266,10 @@ bool SavedGame::create(
 
 	is_writable_ = true;
 
-	const int sg_version = iSAVEGAME_VERSION;
+	// The version chunk is always in the RLE format so older builds can
+	// tell they can't load the rest.
+	//
+	const int sg_version = iSAVEGAME_VERSION_STREAMED;
 
 	SavedGameHelper sgsh(this);
 
@@ -153,11 +283,29 @@ bool SavedGame::create(
 		return false;
 	}
 
+	is_streamed_ = true;
+
+	written_raw_size_ = 0;
+	written_packed_size_ = 0;
+	writer_time_us_ = 0;
+
+	start_writer();
+
 	return true;
 }
 
 void SavedGame::close()
 {
+	if (writer_thread_.joinable())
+	{
+		if (!is_failed_)
+		{
+			static_cast<void>(flush());
+		}
+
+		stop_writer();
+	}
+
 	if (file_handle_ != 0)
 	{
 		::FS_FCloseFile(file_handle_);
@@ -171,11 +319,250 @@ void SavedGame::close()
 	saved_io_buffer_offset_ = 0;
 
 	rle_buffer_.clear();
+	spare_buffers_.clear();
 
+	is_streamed_ = false;
 	is_readable_ = false;
 	is_writable_ = false;
 }
 
+bool SavedGame::flush()
+{
+	if (!writer_thread_.joinable())
+	{
+		return !is_failed_;
+	}
+
+	const int64_t wait_begin_us = get_time_us();
+
+	{
+		std::unique_lock<std::mutex> lock(
+			writer_mutex_);
+
+		writer_done_.wait(
+			lock,
+			[this]
+			{
+				return pending_chunks_.empty() && !is_writer_busy_;
+			}
+		);
+	}
+
+	take_writer_error();
+
+	const int64_t wait_us = get_time_us() - wait_begin_us;
+
+	if (written_raw_size_ > 0)
+	{
+		::Com_DPrintf(
+			"Saved game: %d KB of chunks in %d KB, %d msec writing in the background, %d msec waiting for it\n",
+			static_cast<int>(written_raw_size_ / 1024),
+			static_cast<int>(written_packed_size_ / 1024),
+			static_cast<int>(writer_time_us_ / 1000),
+			static_cast<int>(wait_us / 1000));
+
+		written_raw_size_ = 0;
+		written_packed_size_ = 0;
+		writer_time_us_ = 0;
+	}
+
+	return !is_failed_;
+}
+
+bool SavedGame::is_flushed()
+{
+	if (!writer_thread_.joinable())
+	{
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(
+		writer_mutex_);
+
+	return pending_chunks_.empty() && !is_writer_busy_;
+}
+
+void SavedGame::take_writer_error()
+{
+	std::lock_guard<std::mutex> lock(
+		writer_mutex_);
+
+	if (is_writer_failed_ && !is_failed_)
+	{
+		if (writer_write_error_)
+		{
+			::Com_Printf(
+				"%s\n",
+				writer_write_error_);
+		}
+
+		is_failed_ = true;
+		error_message_ = writer_error_message_;
+	}
+}
+
+void SavedGame::start_writer()
+{
+	is_writer_quit_ = false;
+	is_writer_busy_ = false;
+	is_writer_failed_ = false;
+	writer_error_message_.clear();
+	writer_write_error_ = nullptr;
+	pending_size_ = 0;
+
+	writer_thread_ = std::thread(
+		&SavedGame::writer_loop,
+		this);
+}
+
+void SavedGame::stop_writer()
+{
+	{
+		std::lock_guard<std::mutex> lock(
+			writer_mutex_);
+
+		is_writer_quit_ = true;
+	}
+
+	writer_wake_.notify_one();
+	writer_thread_.join();
+
+	pending_chunks_.clear();
+	pending_size_ = 0;
+	is_writer_busy_ = false;
+}
+
+// Nothing else touches the file handle until the save is flushed, and
+// FS_WriteQuiet only uses the handle's own FILE, so the chunks are written
+// from here rather than handed back to the main thread.  Anything it has to
+// say waits for take_writer_error, the console is the main thread's.
+//
+void SavedGame::writer_loop()
+{
+	z_stream stream = {};
+	int stream_level = 0;
+
+	Buffer packed_buffer;
+
+	for (;;)
+	{
+		PendingChunk chunk;
+
+		{
+			std::unique_lock<std::mutex> lock(
+				writer_mutex_);
+
+			writer_wake_.wait(
+				lock,
+				[this]
+				{
+					return is_writer_quit_ || !pending_chunks_.empty();
+				}
+			);
+
+			if (is_writer_quit_)
+			{
+				break;
+			}
+
+			chunk = std::move(pending_chunks_.front());
+			pending_chunks_.pop_front();
+
+			is_writer_busy_ = true;
+		}
+
+		const int64_t pack_begin_us = get_time_us();
+
+		if (chunk.level != stream_level)
+		{
+			if (stream_level > 0)
+			{
+				::deflateEnd(
+					&stream);
+			}
+
+			stream_level = 0;
+
+			if (chunk.level > 0 &&
+				::deflateInit(&stream, chunk.level) == Z_OK)
+			{
+				stream_level = chunk.level;
+			}
+		}
+
+		pack_chunk(
+			chunk.chunk_id,
+			chunk.data,
+			stream_level > 0 ? &stream : nullptr,
+			packed_buffer);
+
+		const int packed_size = static_cast<int>(packed_buffer.size());
+
+		const char* write_error = nullptr;
+
+		const bool is_written = !is_writer_failed_ && ::FS_WriteQuiet(
+			packed_buffer.data(),
+			packed_size,
+			file_handle_,
+			&write_error) == packed_size;
+
+		const int64_t pack_us = get_time_us() - pack_begin_us;
+
+		{
+			std::lock_guard<std::mutex> lock(
+				writer_mutex_);
+
+			if (!is_written && !is_writer_failed_)
+			{
+				is_writer_failed_ = true;
+				writer_write_error_ = write_error;
+
+				writer_error_message_ =
+					"Failed to write " + get_chunk_id_string(chunk.chunk_id) + " chunk.";
+			}
+
+			pending_size_ -= chunk.data.size();
+			written_raw_size_ += chunk.data.size();
+			written_packed_size_ += packed_size;
+			writer_time_us_ += pack_us;
+
+			if (spare_buffers_.size() < max_spare_buffers)
+			{
+				chunk.data.clear();
+
+				spare_buffers_.push_back(
+					std::move(chunk.data));
+			}
+
+			is_writer_busy_ = false;
+		}
+
+		writer_done_.notify_all();
+	}
+
+	if (stream_level > 0)
+	{
+		::deflateEnd(
+			&stream);
+	}
+}
+
+SavedGame::Buffer SavedGame::take_spare_buffer()
+{
+	std::lock_guard<std::mutex> lock(
+		writer_mutex_);
+
+	if (spare_buffers_.empty())
+	{
+		return Buffer();
+	}
+
+	Buffer buffer = std::move(spare_buffers_.back());
+	spare_buffers_.pop_back();
+
+	return buffer;
+}
+
 bool SavedGame::read_chunk(
 	const uint32_t chunk_id)
 {
@@ -193,6 +580,177 @@ bool SavedGame::read_chunk(
 
 	io_buffer_offset_ = 0;
 
+	if (is_streamed_)
+	{
+		return read_streamed_chunk(
+			chunk_id);
+	}
+
+	return read_legacy_chunk(
+		chunk_id);
+}
+
+bool SavedGame::read_streamed_chunk(
+	const uint32_t chunk_id)
+{
+	const std::string chunk_id_string = get_chunk_id_string(
+		chunk_id);
+
+	::Com_DPrintf(
+		"Attempting read of chunk %s\n",
+		chunk_id_string.c_str());
+
+	uint32_t header[4] = {};
+
+	const int header_size = ::FS_Read(
+		header,
+		streamed_header_size,
+		file_handle_);
+
+	const uint32_t loaded_chunk_id = header[0];
+	const uint32_t data_size = header[1];
+	const uint32_t packed_size = header[2];
+	const uint32_t loaded_checksum = header[3];
+
+	if (header_size != streamed_header_size)
+	{
+		is_failed_ = true;
+
+		error_message_ =
+			"Error during loading chunk " + chunk_id_string + ".";
+
+		return false;
+	}
+
+	// Make sure we are loading the correct chunk...
+	//
+	if (loaded_chunk_id != chunk_id)
+	{
+		is_failed_ = true;
+
+		const std::string loaded_chunk_id_string = get_chunk_id_string(
+			loaded_chunk_id);
+
+		error_message_ =
+			"Loaded chunk ID (" +
+				loaded_chunk_id_string +
+				") does not match requested chunk ID (" +
+				chunk_id_string +
+				").";
+
+		return false;
+	}
+
+	// ...and that a broken header can't make us allocate any amount.
+	//
+	if (data_size > max_chunk_size)
+	{
+		is_failed_ = true;
+
+		error_message_ =
+			"Chunk " + chunk_id_string + " is larger than any saved one.";
+
+		return false;
+	}
+
+	io_buffer_.resize(
+		data_size);
+
+	bool is_loaded = false;
+
+	if (packed_size == 0)
+	{
+		is_loaded = ::FS_Read(
+			io_buffer_.data(),
+			data_size,
+			file_handle_) == static_cast<int>(data_size);
+	}
+	else
+	{
+		// Inflate straight from the file through a small window...
+		//
+		z_stream stream = {};
+
+		if (::inflateInit(&stream) == Z_OK)
+		{
+			rle_buffer_.resize(
+				streamed_window_size);
+
+			stream.next_out = io_buffer_.data();
+			stream.avail_out = data_size;
+
+			uint32_t remain_size = packed_size;
+			int z_result = Z_OK;
+
+			while (z_result == Z_OK)
+			{
+				if (stream.avail_in == 0)
+				{
+					const int window_size = static_cast<int>(std::min(
+						remain_size,
+						static_cast<uint32_t>(streamed_window_size)));
+
+					if (window_size == 0 ||
+						::FS_Read(rle_buffer_.data(), window_size, file_handle_) != window_size)
+					{
+						break;
+					}
+
+					remain_size -= window_size;
+
+					stream.next_in = rle_buffer_.data();
+					stream.avail_in = window_size;
+				}
+
+				z_result = ::inflate(
+					&stream,
+					Z_NO_FLUSH);
+			}
+
+			is_loaded =
+				z_result == Z_STREAM_END &&
+				stream.total_out == data_size &&
+				stream.avail_in == 0 &&
+				remain_size == 0;
+
+			::inflateEnd(
+				&stream);
+		}
+	}
+
+	if (!is_loaded)
+	{
+		is_failed_ = true;
+
+		error_message_ =
+			"Error during loading chunk " + chunk_id_string + ".";
+
+		return false;
+	}
+
+	// Make sure the checksums match...
+	//
+	const uint32_t checksum = static_cast<uint32_t>(::crc32(
+		::crc32(0L, Z_NULL, 0),
+		io_buffer_.data(),
+		data_size));
+
+	if (loaded_checksum != checksum)
+	{
+		is_failed_ = true;
+
+		error_message_ =
+			"Failed checksum check for chunk " + chunk_id_string + ".";
+
+		return false;
+	}
+
+	return true;
+}
+
+bool SavedGame::read_legacy_chunk(
+	const uint32_t chunk_id)
+{
 	const std::string chunk_id_string = get_chunk_id_string(
 		chunk_id);
 
@@ -272,9 +830,17 @@ bool SavedGame::read_chunk(
 		io_buffer_.resize(
 			loaded_data_size);
 
-		decompress(
+		if (!decompress(
 			rle_buffer_,
-			io_buffer_);
+			io_buffer_))
+		{
+			is_failed_ = true;
+
+			error_message_ =
+				"Error during loading chunk " + chunk_id_string + ".";
+
+			return false;
+		}
 	}
 	else
 	{
@@ -407,154 +973,134 @@ bool SavedGame::write_chunk(
 		return true;
 	}
 
-	const int src_size = static_cast<int>(io_buffer_.size());
-
-	const uint32_t checksum = Com_BlockChecksum(
-		io_buffer_.data(),
-		src_size);
+	if (!is_streamed_)
+	{
+		return write_legacy_chunk(
+			chunk_id);
+	}
 
-	uint32_t saved_chunk_size = ::FS_Write(
-		&chunk_id,
-		static_cast<int>(sizeof(chunk_id)),
-		file_handle_);
+	if (io_buffer_.size() > max_chunk_size)
+	{
+		is_failed_ = true;
 
-	int compressed_size = -1;
+		error_message_ = "Chunk " + chunk_id_string + " is too large to save.";
 
-	if (::sv_compress_saved_games->integer != 0)
-	{
-		compress(
-			io_buffer_,
-			rle_buffer_);
+		::Com_Printf(
+			"%s%s\n",
+			S_COLOR_RED,
+			error_message_.c_str());
 
-		if (rle_buffer_.size() < io_buffer_.size())
-		{
-			compressed_size = static_cast<int>(rle_buffer_.size());
-		}
+		return false;
 	}
 
-#ifdef JK2_MODE
-	const uint32_t magic_value = get_jo_magic_value();
-#endif // JK2_MODE
+	// Hand the data over to the writer thread and carry on with a fresh
+	// buffer...
+	//
+	PendingChunk chunk;
+	chunk.chunk_id = chunk_id;
+	chunk.level = (::sv_compress_saved_games->integer != 0 ? Z_BEST_SPEED : 0);
+	chunk.data = std::move(io_buffer_);
+
+	io_buffer_ = take_spare_buffer();
+	io_buffer_offset_ = 0;
 
-	if (compressed_size > 0)
 	{
-		const int size = -static_cast<int>(io_buffer_.size());
+		std::unique_lock<std::mutex> lock(
+			writer_mutex_);
 
-		saved_chunk_size += ::FS_Write(
-			&size,
-			static_cast<int>(sizeof(size)),
-			file_handle_);
+		writer_done_.wait(
+			lock,
+			[this]
+			{
+				return pending_size_ < max_pending_size;
+			}
+		);
 
-#ifdef JK2_MODE
-		saved_chunk_size += ::FS_Write(
-			&checksum,
-			static_cast<int>(sizeof(checksum)),
-			file_handle_);
-#endif // JK2_MODE
+		pending_size_ += chunk.data.size();
 
-		saved_chunk_size += ::FS_Write(
-			&compressed_size,
-			static_cast<int>(sizeof(compressed_size)),
-			file_handle_);
+		pending_chunks_.push_back(
+			std::move(chunk));
+	}
 
-		saved_chunk_size += ::FS_Write(
-			rle_buffer_.data(),
-			compressed_size,
-			file_handle_);
+	writer_wake_.notify_one();
 
-#ifdef JK2_MODE
-		saved_chunk_size += ::FS_Write(
-			&magic_value,
-			static_cast<int>(sizeof(magic_value)),
-			file_handle_);
-#else
-		saved_chunk_size += ::FS_Write(
-			&checksum,
-			static_cast<int>(sizeof(checksum)),
-			file_handle_);
-#endif // JK2_MODE
-
-		std::size_t ref_chunk_size =
-			sizeof(chunk_id) +
-			sizeof(size) +
-			sizeof(checksum) +
-			sizeof(compressed_size) +
-			compressed_size;
+	take_writer_error();
 
-#ifdef JK2_MODE
-		ref_chunk_size += sizeof(magic_value);
-#endif // JK2_MODE
+	return !is_failed_;
+}
 
-		if (saved_chunk_size != ref_chunk_size)
-		{
-			is_failed_ = true;
+bool SavedGame::write_legacy_chunk(
+	const uint32_t chunk_id)
+{
+	const uint32_t checksum = Com_BlockChecksum(
+		io_buffer_.data(),
+		static_cast<int>(io_buffer_.size()));
 
-			error_message_ = "Failed to write " + chunk_id_string + " chunk.";
+	uint32_t saved_chunk_size = ::FS_Write(
+		&chunk_id,
+		static_cast<int>(sizeof(chunk_id)),
+		file_handle_);
 
-			::Com_Printf(
-				"%s%s\n",
-				S_COLOR_RED,
-				error_message_.c_str());
+#ifdef JK2_MODE
+	const uint32_t magic_value = get_jo_magic_value();
+#endif // JK2_MODE
 
-			return false;
-		}
-	}
-	else
-	{
-		const uint32_t size = static_cast<uint32_t>(io_buffer_.size());
+	const uint32_t size = static_cast<uint32_t>(io_buffer_.size());
 
-		saved_chunk_size += ::FS_Write(
-			&size,
-			static_cast<int>(sizeof(size)),
-			file_handle_);
+	saved_chunk_size += ::FS_Write(
+		&size,
+		static_cast<int>(sizeof(size)),
+		file_handle_);
 
 #ifdef JK2_MODE
-		saved_chunk_size += ::FS_Write(
-			&checksum,
-			static_cast<int>(sizeof(checksum)),
-			file_handle_);
+	saved_chunk_size += ::FS_Write(
+		&checksum,
+		static_cast<int>(sizeof(checksum)),
+		file_handle_);
 #endif // JK2_MODE
 
-		saved_chunk_size += ::FS_Write(
-			io_buffer_.data(),
-			size,
-			file_handle_);
+	saved_chunk_size += ::FS_Write(
+		io_buffer_.data(),
+		size,
+		file_handle_);
 
 #ifdef JK2_MODE
-		saved_chunk_size += ::FS_Write(
-			&magic_value,
-			static_cast<int>(sizeof(magic_value)),
-			file_handle_);
+	saved_chunk_size += ::FS_Write(
+		&magic_value,
+		static_cast<int>(sizeof(magic_value)),
+		file_handle_);
 #else
-		saved_chunk_size += ::FS_Write(
-			&checksum,
-			static_cast<int>(sizeof(checksum)),
-			file_handle_);
+	saved_chunk_size += ::FS_Write(
+		&checksum,
+		static_cast<int>(sizeof(checksum)),
+		file_handle_);
 #endif // JK2_MODE
 
-		std::size_t ref_chunk_size =
-			sizeof(chunk_id) +
-			sizeof(size) +
-			sizeof(checksum) +
-			size;
+	std::size_t ref_chunk_size =
+		sizeof(chunk_id) +
+		sizeof(size) +
+		sizeof(checksum) +
+		size;
 
 #ifdef JK2_MODE
-		ref_chunk_size += sizeof(magic_value);
+	ref_chunk_size += sizeof(magic_value);
 #endif // JK2_MODE
 
-		if (saved_chunk_size != ref_chunk_size)
-		{
-			is_failed_ = true;
+	if (saved_chunk_size != ref_chunk_size)
+	{
+		const std::string chunk_id_string = get_chunk_id_string(
+			chunk_id);
 
-			error_message_ = "Failed to write " + chunk_id_string + " chunk.";
+		is_failed_ = true;
 
-			::Com_Printf(
-				"%s%s\n",
-				S_COLOR_RED,
-				error_message_.c_str());
+		error_message_ = "Failed to write " + chunk_id_string + " chunk.";
 
-			return false;
-		}
+		::Com_Printf(
+			"%s%s\n",
+			S_COLOR_RED,
+			error_message_.c_str());
+
+		return false;
 	}
 
 	return true;
@@ -823,73 +1369,12 @@ void SavedGame::throw_error()
 		error_message_.c_str());
 }
 
-void SavedGame::compress(
+bool SavedGame::decompress(
 	const Buffer& src_buffer,
 	Buffer& dst_buffer)
 {
 	const int src_size = static_cast<int>(src_buffer.size());
 
-	dst_buffer.resize(2 * src_size);
-
-	int src_count = 0;
-	int dst_index = 0;
-
-	while (src_count < src_size)
-	{
-		int src_index = src_count;
-		uint8_t b = src_buffer[src_index++];
-
-		while (src_index < src_size &&
-			(src_index - src_count) < 127 &&
-			src_buffer[src_index] == b)
-		{
-			src_index += 1;
-		}
-
-		if ((src_index - src_count) == 1)
-		{
-			while (src_index < src_size &&
-				(src_index - src_count) < 127 && (
-					src_buffer[src_index] != src_buffer[src_index - 1] || (
-						src_index > 1 &&
-						src_buffer[src_index] != src_buffer[src_index - 2])))
-			{
-				src_index += 1;
-			}
-
-			while (src_index < src_size &&
-				src_buffer[src_index] == src_buffer[src_index - 1])
-			{
-				src_index -= 1;
-			}
-
-			dst_buffer[dst_index++] =
-				static_cast<uint8_t>(src_count - src_index);
-
-			for (int i = src_count; i < src_index; ++i)
-			{
-				dst_buffer[dst_index++] = src_buffer[i];
-			}
-		}
-		else
-		{
-			dst_buffer[dst_index++] =
-				static_cast<uint8_t>(src_index - src_count);
-
-			dst_buffer[dst_index++] = b;
-		}
-
-		src_count = src_index;
-	}
-
-	dst_buffer.resize(
-		dst_index);
-}
-
-void SavedGame::decompress(
-	const Buffer& src_buffer,
-	Buffer& dst_buffer)
-{
 	int src_index = 0;
 	int dst_index = 0;
 
@@ -897,10 +1382,20 @@ void SavedGame::decompress(
 
 	while (remain_size > 0)
 	{
+		if (src_index >= src_size)
+		{
+			return false;
+		}
+
 		int8_t count = static_cast<int8_t>(src_buffer[src_index++]);
 
 		if (count > 0)
 		{
+			if (count > remain_size || src_index >= src_size)
+			{
+				return false;
+			}
+
 			std::uninitialized_fill_n(
 				&dst_buffer[dst_index],
 				count,
@@ -912,6 +1407,11 @@ void SavedGame::decompress(
 			{
 				count = -count;
 
+				if (count > remain_size || (src_index + count) > src_size)
+				{
+					return false;
+				}
+
 				std::uninitialized_copy_n(
 					&src_buffer[src_index],
 					count,
@@ -924,6 +1424,8 @@ void SavedGame::decompress(
 		dst_index += count;
 		remain_size -= count;
 	}
+
+	return true;
 }
 
 std::string SavedGame::generate_path(
@@ -7,8 +7,12 @@
 #define OJK_SAVED_GAME_INCLUDED
 
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "ojk_i_saved_game.h"
 
@@ -43,6 +47,14 @@ public:
 	// Closes the current saved game file.
 	void close();
 
+	// Waits until all chunks passed to write_chunk are in the file.
+	// Returns true on success or false otherwise.
+	bool flush();
+
+	// Returns true if all chunks passed to write_chunk are in the file,
+	// without waiting for the writer thread.
+	bool is_flushed();
+
 
 	// Reads a chunk from the file into the internal buffer.
 	bool read_chunk(
@@ -132,6 +144,16 @@ private:
 	using BufferOffset = Buffer::size_type;
 	using Paths = std::vector<std::string>;
 
+	// A chunk waiting for the writer thread.
+	struct PendingChunk
+	{
+		uint32_t chunk_id;
+		int level;
+		Buffer data;
+	}; // PendingChunk
+
+	using PendingChunks = std::deque<PendingChunk>;
+
 
 	// Last error message.
 	std::string error_message_;
@@ -151,9 +173,58 @@ private:
 	// Saved I/O buffer offset.
 	BufferOffset saved_io_buffer_offset_;
 
-	// RLE codec buffer.
+	// RLE codec buffer, or the inflate input window for streamed chunks.
 	Buffer rle_buffer_;
 
+	// True if the chunks after the version one are deflated and streamed.
+	bool is_streamed_;
+
+	// Compresses the written chunks and writes them into the file.
+	std::thread writer_thread_;
+
+	// Guards everything shared with the writer thread below.
+	std::mutex writer_mutex_;
+
+	// Signaled when a chunk was queued or the writer has to quit.
+	std::condition_variable writer_wake_;
+
+	// Signaled when the writer finished a chunk.
+	std::condition_variable writer_done_;
+
+	// Chunks waiting for the writer.
+	PendingChunks pending_chunks_;
+
+	// Buffers handed back by the writer thread for reuse.
+	std::vector<Buffer> spare_buffers_;
+
+	// Uncompressed size of the queued chunks.
+	std::size_t pending_size_;
+
+	// True while the writer is busy with a chunk.
+	bool is_writer_busy_;
+
+	// True if the writer thread has to quit.
+	bool is_writer_quit_;
+
+	// True if the writer failed to write a chunk.
+	bool is_writer_failed_;
+
+	// The writer's error message.
+	std::string writer_error_message_;
+
+	// What FS_Write would have printed for the writer, the main thread
+	// prints it instead.
+	const char* writer_write_error_;
+
+	// Uncompressed size of the chunks written since create.
+	std::size_t written_raw_size_;
+
+	// Size of the chunks in the file since create.
+	std::size_t written_packed_size_;
+
+	// Time the writer thread spent on the chunks, in microseconds.
+	int64_t writer_time_us_;
+
 	// True if saved game opened for reading.
 	bool is_readable_;
 
@@ -164,13 +235,36 @@ private:
 	bool is_failed_;
 
 
-	// Compresses data.
-	static void compress(
-		const Buffer& src_buffer,
-		Buffer& dst_buffer);
+	// Reads a chunk in the RLE format.
+	bool read_legacy_chunk(
+		const uint32_t chunk_id);
+
+	// Reads a chunk in the streamed format.
+	bool read_streamed_chunk(
+		const uint32_t chunk_id);
 
-	// Decompresses data.
-	static void decompress(
+	// Writes an uncompressed chunk in the RLE format.
+	bool write_legacy_chunk(
+		const uint32_t chunk_id);
+
+	// Starts the writer thread.
+	void start_writer();
+
+	// Stops the writer thread and drops any queued chunks.
+	void stop_writer();
+
+	// The writer thread.
+	void writer_loop();
+
+	// Copies the writer's error into the error flag and message.
+	void take_writer_error();
+
+	// Returns an empty buffer, reusing one from the writer if possible.
+	Buffer take_spare_buffer();
+
+	// Decompresses RLE data.
+	// Returns true on success or false otherwise.
+	static bool decompress(
 		const Buffer& src_buffer,
 		Buffer& dst_buffer);
 
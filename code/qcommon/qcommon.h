@@ -494,6 +494,9 @@ static inline int FS_FileIsInPAK( const char *filename, int *checksum )
 }
 
 int	FS_Write( const void *buffer, int len, fileHandle_t f );
+int	FS_WriteQuiet( const void *buffer, int len, fileHandle_t f, const char **error );
+// FS_Write that leaves the console alone and points error at what it would
+// have printed, for a thread writing a handle nothing else uses meanwhile
 
 int	FS_Read( void *buffer, int len, fileHandle_t f );
 // properly handles partial reads and reads from other dlls
@@ -250,6 +250,7 @@ extern	cvar_t	*sv_mapChecksum;
 extern	cvar_t	*sv_serverid;
 extern  cvar_t	*sv_testsave;
 extern  cvar_t	*sv_compress_saved_games;
+extern  cvar_t	*sv_background_saves;
 
 //===========================================================
 
@@ -388,6 +389,8 @@ qboolean SG_Append(unsigned int chid, const void *data, int length);
 int SG_Read			(unsigned int chid, void *pvAddress, int iLength, void **ppvAddressPtr = NULL);
 int SG_ReadOptional	(unsigned int chid, void *pvAddress, int iLength, void **ppvAddressPtr = NULL);
 void SG_Shutdown();
+void SG_FinishBackgroundSave(void);	// waits for a background save and puts it in place
+void SG_CheckBackgroundSave(void);	// same, but only if it's already done
 void SG_TestSave(void);
 //
 // note that this version number does not mean that a savegame with the same version can necessarily be loaded,
@@ -396,6 +399,7 @@ void SG_TestSave(void);
 //	any new enhanced ones that need to ask for new chunks during loading.
 //
 #define iSAVEGAME_VERSION 1
+#define iSAVEGAME_VERSION_STREAMED 2	// same chunks as iSAVEGAME_VERSION, deflated and written from a background thread
 int SG_Version(void);	// call this to know what version number a successfully-opened savegame file was
 //
 extern SavedGameJustLoaded_e eSavedGameJustLoaded;
@@ -578,6 +578,7 @@ void SV_Init (void) {
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_testsave = Cvar_Get ("sv_testsave", "0", 0);
 	sv_compress_saved_games = Cvar_Get ("sv_compress_saved_games", "1", 0);
+	sv_background_saves = Cvar_Get ("sv_background_saves", "1", 0);
 
 	// Only allocated once, no point in moving it around and fragmenting
 	// create a heap for Ghoul2 to use for game side model vertex transforms used in collision detection
@@ -629,6 +630,8 @@ void SV_Shutdown( const char *finalmsg ) {
 
 	Com_Printf( "^3[SV shutdown] finalmsg='%s'\n", finalmsg ? finalmsg : "(null)" );
 
+	SG_FinishBackgroundSave();
+
 	//Com_Printf( "----- Server Shutdown -----\n" );
 
 	if ( svs.clients && !com_errorEntered ) {
@@ -54,6 +54,7 @@ cvar_t	*sv_mapChecksum;
 cvar_t	*sv_serverid;
 cvar_t	*sv_testsave;			// Run the savegame enumeration every game frame
 cvar_t	*sv_compress_saved_games;	// compress the saved games on the way out (only affect saver, loader can read both)
+cvar_t	*sv_background_saves;		// finish writing saved games on a worker thread while the game carries on
 
 static int SV_RunFrameExceptionFilter( EXCEPTION_POINTERS *ep, int svTime ) {
 	static int s_runFrameCrashDetailCount = 0;
@@ -527,6 +528,8 @@ void SV_Frame( int msec,float fractionMsec ) {
 		return;
 	}
 
+	SG_CheckBackgroundSave();	// renames a finished background save into place
+
  	extern void SE_CheckForLanguageUpdates(void);
 	SE_CheckForLanguageUpdates();	// will fast-return else load different language if menu changed it
 
@@ -52,6 +52,13 @@ SavedGameJustLoaded_e eSavedGameJustLoaded = eNO;
 
 char sLastSaveFileLoaded[MAX_QPATH]={0};
 
+// A save whose chunks are still being written by the saved game's writer
+//	thread, it gets renamed from "current" once they're all in the file...
+//
+static char sBackgroundSaveName[MAX_QPATH]={0};	// empty if there isn't one
+static int	iBackgroundSaveStartTime;
+static int	iBackgroundSaveMainTime;
+
 #ifdef JK2_MODE
 #define iSG_MAPCMD_SIZE (MAX_TOKEN_CHARS)
 #else
@@ -116,11 +123,56 @@ void SG_WipeSavegame(
 		psPathlessBaseName);
 }
 
+// the writer thread is done with "current", report how it went and give it
+// the name it was saved under
+static void SG_CompleteBackgroundSave(void)
+{
+	ojk::SavedGame& saved_game = ojk::SavedGame::get_instance();
+
+	bool is_write_failed = !saved_game.flush();
+
+	saved_game.close();
+
+	if (is_write_failed)
+	{
+		Com_Printf (GetString_FailedToOpenSaveGame("current",qfalse));//S_COLOR_RED "Failed to write savegame!\n");
+		SG_WipeSavegame( "current" );
+	}
+	else
+	{
+		ojk::SavedGame::rename(
+			"current",
+			sBackgroundSaveName);
+
+		Com_DPrintf("Background save \"%s\" took %d msec on the main thread, done %d msec after it started\n", sBackgroundSaveName, iBackgroundSaveMainTime, Sys_Milliseconds() - iBackgroundSaveStartTime);
+	}
+
+	sBackgroundSaveName[0] = '\0';
+}
+
+void SG_FinishBackgroundSave(void)
+{
+	if (sBackgroundSaveName[0])
+	{
+		SG_CompleteBackgroundSave();
+	}
+}
+
+void SG_CheckBackgroundSave(void)
+{
+	if (sBackgroundSaveName[0] && ojk::SavedGame::get_instance().is_flushed())
+	{
+		SG_CompleteBackgroundSave();
+	}
+}
+
 // called from the ERR_DROP stuff just in case the error occured during loading of a saved game, because if
 //	we didn't do this then we'd run out of quake file handles after the 8th load fail...
 //
 void SG_Shutdown()
 {
+	SG_FinishBackgroundSave();
+
 	ojk::SavedGame& saved_game = ojk::SavedGame::get_instance();
 
 	saved_game.close();
@@ -147,6 +199,7 @@ void SV_WipeGame_f(void)
 		Com_Printf (S_COLOR_RED "Can't wipe 'auto'\n");
 		return;
 	}
+	SG_FinishBackgroundSave();
 	SG_WipeSavegame(Cmd_Argv(1));
 //	Com_Printf("%s has been wiped\n", Cmd_Argv(1));	// wurde gel�scht in german, but we've only got one string
 //	Com_Printf("Ok\n"); // no localization of this
@@ -753,6 +806,8 @@ int SG_GetSaveGameComment(
 {
 	int ret = 0;
 
+	SG_FinishBackgroundSave();
+
 	ojk::SavedGame& saved_game = ojk::SavedGame::get_instance();
 
 	ojk::SavedGameHelper sgh(
@@ -989,6 +1044,8 @@ qboolean SG_GetSaveImage(
 		return qfalse;
 	}
 
+	SG_FinishBackgroundSave();
+
 	ojk::SavedGame& saved_game = ojk::SavedGame::get_instance();
 
 	if (!saved_game.open(base_name))
@@ -1153,6 +1210,10 @@ qboolean SG_WriteSavegame(const char *psPathlessBaseName, qboolean qbAutosave)
 	if (!qbAutosave && !SG_GameAllowedToSaveHere(qfalse))	//full check
 		return qfalse;	// this prevents people saving via quick-save now during cinematics
 
+	const int iStartTime = Sys_Milliseconds();
+
+	SG_FinishBackgroundSave();	// only one save file can be open at a time
+
 	int iPrevTestSave = sv_testsave->integer;
 	sv_testsave->integer = 0;
 
@@ -1217,7 +1278,22 @@ qboolean SG_WriteSavegame(const char *psPathlessBaseName, qboolean qbAutosave)
 	}
 	ge->WriteLevel();	// SOF2: WriteLevel(void) — no args; ent saver always writes all
 
-	bool is_write_failed = saved_game.is_failed();
+	// everything's serialized now, so let the writer thread finish the file while the game
+	//	carries on, SG_CheckBackgroundSave() renames it into place once it's done...
+	//
+	if (sv_background_saves->integer && !saved_game.is_failed())
+	{
+		Q_strncpyz(sBackgroundSaveName, psPathlessBaseName, sizeof(sBackgroundSaveName));
+		iBackgroundSaveStartTime = iStartTime;
+		iBackgroundSaveMainTime = Sys_Milliseconds() - iStartTime;
+
+		sv_testsave->integer = iPrevTestSave;
+		return qtrue;
+	}
+
+	// wait for the chunks still being written...
+	//
+	bool is_write_failed = !saved_game.flush();
 
 	saved_game.close();
 
@@ -1233,6 +1309,8 @@ qboolean SG_WriteSavegame(const char *psPathlessBaseName, qboolean qbAutosave)
 		"current",
 		psPathlessBaseName);
 
+	Com_DPrintf("%s \"%s\" took %d msec\n", qbAutosave ? "Autosave" : "Save", psPathlessBaseName, Sys_Milliseconds() - iStartTime);
+
 	sv_testsave->integer = iPrevTestSave;
 	return qtrue;
 }
@@ -1249,6 +1327,8 @@ qboolean SG_ReadSavegame(
 		"0");
 #endif
 
+	SG_FinishBackgroundSave();
+
 	ojk::SavedGame& saved_game = ojk::SavedGame::get_instance();
 
 	ojk::SavedGameHelper sgh(
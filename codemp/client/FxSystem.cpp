@@ -31,6 +31,7 @@ cvar_t	*fx_freeze;
 #endif
 cvar_t	*fx_countScale;
 cvar_t	*fx_nearCull;
+cvar_t	*fx_poolParticles;
 
 #define DEFAULT_EXPLOSION_RADIUS	512
 
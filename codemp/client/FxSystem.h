@@ -33,6 +33,7 @@ extern cvar_t	*fx_freeze;
 
 extern cvar_t	*fx_countScale;
 extern cvar_t	*fx_nearCull;
+extern cvar_t	*fx_poolParticles;
 
 class SFxHelper
 {
@@ -30,6 +30,9 @@ struct SEffectList
 	CEffect *mEffect;
 	int		mKillTime;
 	bool	mPortal;
+	bool	mPooled;		// held by a pooled particle, mEffect stays NULL
+	short	mPoolIndex;		// where that particle sits in its pool
+	short	mPoolRefEnt;	// its entry in poolRefEnts this frame, see FX_POOL_CULLED
 };
 
 #define PI		3.14159f
@@ -42,6 +45,467 @@ int				activeFx = 0;
 int				drawnFx;
 qboolean		fxInitialized = qfalse;
 
+//-------------------------
+// Pooled particles
+//
+// Plain sprite particles (no bolt, no physics, no random modulation, not
+// player view) are by far the most common thing the fx system spawns, so they
+// skip the CParticle objects and live in these arrays instead.  FX_Add runs
+// each stage over the whole pool at once.  The math is CParticle's, step for
+// step.
+//
+// Each pooled particle still holds an effectList slot, and its refEntity is
+// submitted when FX_Add's walk reaches that slot.  Sprites sharing a shader
+// are drawn in submission order, so blended particles keep overlapping the
+// way they would as CParticles.
+//-------------------------
+#define MAX_POOLED_PARTICLES	2048
+
+// SEffectList::mPoolRefEnt values that aren't poolRefEnts indices
+#define FX_POOL_CULLED			-1	// not drawn this frame
+#define FX_POOL_UNBUILT			-2	// spawned after the pool stages ran
+
+#define FX_POOL_EXCLUDED_FLAGS	( FX_RELATIVE | FX_PLAYER_VIEW | FX_APPLY_PHYSICS | FX_SIZE_RAND | FX_RGB_RAND | FX_ALPHA_RAND )
+
+struct SParticlePool
+{
+	int		mCount;
+
+	// [axis][particle] so every axis is a contiguous run of floats
+	float	mOrg[3][MAX_POOLED_PARTICLES];
+	float	mVel[3][MAX_POOLED_PARTICLES];
+	float	mAccel[3][MAX_POOLED_PARTICLES];
+
+	float	mSizeStart[MAX_POOLED_PARTICLES];
+	float	mSizeEnd[MAX_POOLED_PARTICLES];
+	float	mSizeParm[MAX_POOLED_PARTICLES];
+
+	float	mRGBStart[3][MAX_POOLED_PARTICLES];
+	float	mRGBEnd[3][MAX_POOLED_PARTICLES];
+	float	mRGBParm[MAX_POOLED_PARTICLES];
+
+	float	mAlphaStart[MAX_POOLED_PARTICLES];
+	float	mAlphaEnd[MAX_POOLED_PARTICLES];
+	float	mAlphaParm[MAX_POOLED_PARTICLES];
+
+	float	mRotation[MAX_POOLED_PARTICLES];
+	float	mRotationDelta[MAX_POOLED_PARTICLES];
+
+	int		mTimeStart[MAX_POOLED_PARTICLES];
+	int		mTimeEnd[MAX_POOLED_PARTICLES];		// also the kill time
+	unsigned int	mFlags[MAX_POOLED_PARTICLES];
+	qhandle_t		mShader[MAX_POOLED_PARTICLES];
+	int		mDeathFxID[MAX_POOLED_PARTICLES];
+	short	mSlot[MAX_POOLED_PARTICLES];		// effectList slot, -1 once FX_FreeMember took it back
+
+	void Move( int to, int from )
+	{
+		for ( int j = 0; j < 3; j++ )
+		{
+			mOrg[j][to] = mOrg[j][from];
+			mVel[j][to] = mVel[j][from];
+			mAccel[j][to] = mAccel[j][from];
+			mRGBStart[j][to] = mRGBStart[j][from];
+			mRGBEnd[j][to] = mRGBEnd[j][from];
+		}
+		mSizeStart[to] = mSizeStart[from];
+		mSizeEnd[to] = mSizeEnd[from];
+		mSizeParm[to] = mSizeParm[from];
+		mRGBParm[to] = mRGBParm[from];
+		mAlphaStart[to] = mAlphaStart[from];
+		mAlphaEnd[to] = mAlphaEnd[from];
+		mAlphaParm[to] = mAlphaParm[from];
+		mRotation[to] = mRotation[from];
+		mRotationDelta[to] = mRotationDelta[from];
+		mTimeStart[to] = mTimeStart[from];
+		mTimeEnd[to] = mTimeEnd[from];
+		mFlags[to] = mFlags[from];
+		mShader[to] = mShader[from];
+		mDeathFxID[to] = mDeathFxID[from];
+		mSlot[to] = mSlot[from];
+	}
+};
+
+struct SPooledDeath
+{
+	int		mFxID;
+	vec3_t	mOrigin;
+};
+
+// one pool per scene so FX_Add never has to look at the portal flag
+static SParticlePool	particlePools[2];
+static int				pooledFx = 0;		// effectList slots held by pooled particles
+static bool				particlePoolBypassed = false;	// fx_bench uses this to time the CParticle path
+
+// scratch space for the pool stages
+static int				poolStep[MAX_POOLED_PARTICLES];
+static int				poolVisible[MAX_POOLED_PARTICLES];
+static float			poolPerc[MAX_POOLED_PARTICLES];
+static miniRefEntity_t	poolRefEnts[MAX_POOLED_PARTICLES];
+static int				numPoolRefEnts;
+static SPooledDeath		poolDeaths[MAX_POOLED_PARTICLES];
+
+extern void ClampRGB( const vec3_t in, byte *out );
+
+static inline bool FX_SlotFree( const SEffectList *ef )
+{
+	return ef->mEffect == 0 && !ef->mPooled;
+}
+
+static void FX_ClearParticlePools( void )
+{
+	particlePools[0].mCount = 0;
+	particlePools[1].mCount = 0;
+	pooledFx = 0;
+
+	for ( int i = 0; i < MAX_EFFECTS; i++ )
+	{
+		effectList[i].mPooled = false;
+	}
+}
+
+//-------------------------
+// FX_PoolPerc
+//
+// The LINEAR / NONLINEAR / WAVE / CLAMP biasing shared by CParticle's
+// UpdateSize, UpdateRGB and UpdateAlpha, flags already shifted down to
+// the FX_GENERIC_MASK bits.
+//-------------------------
+static inline float FX_PoolPerc( unsigned int flags, int timeStart, int timeEnd, float parm )
+{
+	const int time = theFxHelper.mTime;
+
+	// completely biased towards start if it doesn't get overridden
+	float	perc1 = 1.0f, perc2 = 1.0f;
+
+	if ( flags & FX_LINEAR )
+	{
+		// calculate element biasing
+		perc1 = 1.0f - (float)(time - timeStart) / (float)(timeEnd - timeStart);
+	}
+
+	switch ( flags & FX_PARM_MASK )
+	{
+	case FX_NONLINEAR:
+		if ( time > parm )
+		{
+			// get percent done, using parm as the start of the non-linear fade
+			perc2 = 1.0f - (float)(time - parm) / (float)(timeEnd - parm);
+		}
+		perc1 = ( flags & FX_LINEAR ) ? perc1 * 0.5f + perc2 * 0.5f : perc2;
+		break;
+
+	case FX_WAVE:
+		// wave gen, with parm being the frequency multiplier
+		perc1 = perc1 * cosf( (time - timeStart) * parm );
+		break;
+
+	case FX_CLAMP:
+		if ( time < parm )
+		{
+			perc2 = (float)(parm - time) / (float)(parm - timeStart);
+		}
+		else
+		{
+			perc2 = 0.0f;
+		}
+		perc1 = ( flags & FX_LINEAR ) ? perc1 * 0.5f + perc2 * 0.5f : perc2;
+		break;
+	}
+
+	return perc1;
+}
+
+//-------------------------
+// FX_RetirePooledParticles
+//
+// The kill checks FX_Add does for effect list entries, for every particle in
+// one scene's pool.  The survivors keep their order.
+//-------------------------
+static void FX_RetirePooledParticles( SParticlePool &pool )
+{
+	const int	time = theFxHelper.mTime;
+	const int	n = pool.mCount;
+	int			i, j, w;
+	int			numDeaths = 0;
+
+	for ( i = 0, w = 0; i < n; i++ )
+	{
+		const int	slot = pool.mSlot[i];
+		const bool	expired = time > pool.mTimeEnd[i];
+
+		// Game pausing can cause dumb time things to happen, so kill the effect in this instance
+		if ( slot >= 0 && !expired && pool.mTimeStart[i] <= time )
+		{
+			if ( w != i )
+			{
+				pool.Move( w, i );
+				effectList[slot].mPoolIndex = w;
+			}
+			w++;
+			continue;
+		}
+
+		// an expired particle has FX_KILL_ON_IMPACT cleared before it dies
+		if ( ( pool.mFlags[i] & FX_DEATH_RUNS_FX ) && ( expired || !( pool.mFlags[i] & FX_KILL_ON_IMPACT ) ) )
+		{
+			poolDeaths[numDeaths].mFxID = pool.mDeathFxID[i];
+			for ( j = 0; j < 3; j++ )
+			{
+				poolDeaths[numDeaths].mOrigin[j] = pool.mOrg[j][i];
+			}
+			numDeaths++;
+		}
+
+		if ( slot >= 0 )
+		{
+			effectList[slot].mPooled = false;
+			nextValidEffect = &effectList[slot];
+			pooledFx--;
+		}
+	}
+	pool.mCount = w;
+
+	// They may well spawn more pooled particles, which the later stages pick up
+	for ( i = 0; i < numDeaths; i++ )
+	{
+		vec3_t	norm;
+
+		VectorSet( norm, flrand(-1.0f, 1.0f), flrand(-1.0f, 1.0f), flrand(-1.0f, 1.0f));
+		VectorNormalize( norm );
+
+		theFxScheduler.PlayEffect( poolDeaths[i].mFxID, poolDeaths[i].mOrigin, norm );
+	}
+}
+
+//-------------------------
+// FX_CullPooledParticle
+//
+// CParticle::Cull for a pooled particle.
+//-------------------------
+static inline bool FX_CullPooledParticle( const SParticlePool &pool, int p )
+{
+	const float	*vieworg = theFxHelper.refdef->vieworg;
+	const float	*forward = theFxHelper.refdef->viewaxis[0];
+	const float	dx = pool.mOrg[0][p] - vieworg[0];
+	const float	dy = pool.mOrg[1][p] - vieworg[1];
+	const float	dz = pool.mOrg[2][p] - vieworg[2];
+
+	// Check if it's behind the viewer
+	if ( forward[0] * dx + forward[1] * dy + forward[2] * dz < 0 )
+	{
+		return true;
+	}
+
+	// Can't be too close, unless it's hacked to show up close to the inview wpn
+	if ( !( pool.mFlags[p] & FX_DEPTH_HACK ) && dx * dx + dy * dy + dz * dz < fx_nearCull->value )
+	{
+		return true;
+	}
+
+	return false;
+}
+
+//-------------------------
+// FX_PoolPercs
+//
+// FX_PoolPerc for every particle in parts, into poolPerc.  One stage's bias
+// at a time, so runs of particles from the same effect take the same way
+// through its switch.
+//-------------------------
+static void FX_PoolPercs( const SParticlePool &pool, const int *parts, int count, int shift, const float *parm )
+{
+	for ( int k = 0; k < count; k++ )
+	{
+		const int p = parts[k];
+
+		poolPerc[k] = FX_PoolPerc( pool.mFlags[p] >> shift, pool.mTimeStart[p], pool.mTimeEnd[p], parm[p] );
+	}
+}
+
+//-------------------------
+// FX_BuildPooledRefEnts
+//
+// The size, colour and rotation updates and the refEntity Draw would submit,
+// for every particle in parts, a stage at a time.  The refEntities go to
+// poolRefEnts from numPoolRefEnts on, in the order of parts.
+//-------------------------
+static void FX_BuildPooledRefEnts( SParticlePool &pool, const int *parts, int count )
+{
+	miniRefEntity_t	*ents = &poolRefEnts[numPoolRefEnts];
+	const float		rotate = theFxHelper.mFrameTime * 0.01f;
+	const float		damp = 1.0f - ( theFxHelper.mFrameTime * 0.0007f );
+	int				j, k;
+
+	numPoolRefEnts += count;
+	memset( ents, 0, sizeof( *ents ) * count );
+
+	for ( k = 0; k < count; k++ )
+	{
+		const int			p = parts[k];
+		const unsigned int	flags = pool.mFlags[p];
+		miniRefEntity_t		*ent = &ents[k];
+
+		ent->reType = RT_SPRITE;
+		ent->customShader = pool.mShader[p];
+		if ( flags & FX_SET_SHADER_TIME )
+		{
+			ent->shaderTime = pool.mTimeStart[p] * 0.001f;
+		}
+		if ( flags & FX_DEPTH_HACK )
+		{
+			ent->renderfx |= RF_DEPTHHACK;
+		}
+		for ( j = 0; j < 3; j++ )
+		{
+			ent->origin[j] = pool.mOrg[j][p];
+		}
+	}
+
+	// Size
+	FX_PoolPercs( pool, parts, count, FX_SIZE_SHIFT, pool.mSizeParm );
+	for ( k = 0; k < count; k++ )
+	{
+		const int p = parts[k];
+
+		ents[k].radius = (pool.mSizeStart[p] * poolPerc[k]) + (pool.mSizeEnd[p] * (1.0f - poolPerc[k]));
+	}
+
+	// RGB, a channel at a time and clamped the way ClampRGB does it
+	FX_PoolPercs( pool, parts, count, FX_RGB_SHIFT, pool.mRGBParm );
+	for ( j = 0; j < 3; j++ )
+	{
+		const float	*rgbStart = pool.mRGBStart[j];
+		const float	*rgbEnd = pool.mRGBEnd[j];
+
+		for ( k = 0; k < count; k++ )
+		{
+			const int	p = parts[k];
+			float		res = rgbStart[p] * poolPerc[k];
+			int			r;
+
+			res = res + rgbEnd[p] * (1.0f - poolPerc[k]);
+			r = Q_ftol( res * 255.0f );
+			r = r < 0 ? 0 : r;
+			ents[k].shaderRGBA[j] = (byte)( r > 255 ? 255 : r );
+		}
+	}
+
+	// Alpha, which scales the colour unless the shader takes it directly
+	FX_PoolPercs( pool, parts, count, FX_ALPHA_SHIFT, pool.mAlphaParm );
+	for ( k = 0; k < count; k++ )
+	{
+		const int	p = parts[k];
+		const bool	useAlpha = ( pool.mFlags[p] & FX_USE_ALPHA ) != 0;
+		byte		*rgba = ents[k].shaderRGBA;
+		float		perc;
+		int			alpha, scale;
+
+		perc = (pool.mAlphaStart[p] * poolPerc[k]) + (pool.mAlphaEnd[p] * (1.0f - poolPerc[k]));
+		perc = Com_Clamp( 0.0f, 1.0f, perc );
+		alpha = Com_Clamp( 0, 255, perc * 255.0f );
+
+		// ( c * 256 ) >> 8 leaves the colour as it is
+		scale = useAlpha ? 256 : alpha;
+		rgba[0] = ((int)rgba[0] * scale) >> 8;
+		rgba[1] = ((int)rgba[1] * scale) >> 8;
+		rgba[2] = ((int)rgba[2] * scale) >> 8;
+		rgba[3] = useAlpha ? (byte)alpha : 0;
+	}
+
+	// Rotation
+	for ( k = 0; k < count; k++ )
+	{
+		const int p = parts[k];
+
+		pool.mRotation[p] += rotate * pool.mRotationDelta[p];
+		pool.mRotationDelta[p] *= damp;
+		ents[k].rotation = pool.mRotation[p];
+	}
+}
+
+//-------------------------
+// FX_BuildPooledRefEnt
+//
+// FX_BuildPooledRefEnts for a single particle that may not be drawn at all.
+// Returns the poolRefEnts index, or FX_POOL_CULLED.
+//-------------------------
+static int FX_BuildPooledRefEnt( SParticlePool &pool, int p )
+{
+	const int v = numPoolRefEnts;
+
+	if ( FX_CullPooledParticle( pool, p ) )
+	{
+		return FX_POOL_CULLED;
+	}
+
+	FX_BuildPooledRefEnts( pool, &p, 1 );
+	return v;
+}
+
+//-------------------------
+// FX_UpdatePooledParticles
+//
+// The pooled equivalent of the CParticle::Update calls for one scene, minus
+// the submission.  FX_Add submits poolRefEnts as its walk reaches each slot.
+//-------------------------
+static void FX_UpdatePooledParticles( bool portal )
+{
+	SParticlePool	&pool = particlePools[portal ? 1 : 0];
+	const int		time = theFxHelper.mTime;
+	int				i, j, n, numVisible;
+
+	numPoolRefEnts = 0;
+
+	FX_RetirePooledParticles( pool );
+	n = pool.mCount;
+
+	// Move everything that wasn't spawned this frame
+	for ( i = 0; i < n; i++ )
+	{
+		poolStep[i] = pool.mTimeStart[i] < time;
+	}
+
+	const float realTime = theFxHelper.mRealTime;
+	for ( j = 0; j < 3; j++ )
+	{
+		float		*org = pool.mOrg[j];
+		float		*vel = pool.mVel[j];
+		const float	*accel = pool.mAccel[j];
+
+		for ( i = 0; i < n; i++ )
+		{
+			const float step = poolStep[i] ? realTime : 0.0f;
+
+			vel[i] = vel[i] + step * accel[i];
+			org[i] = org[i] + step * vel[i];
+		}
+	}
+
+	// Cull, the survivors get refEntities in pool order
+	numVisible = 0;
+	for ( i = 0; i < n; i++ )
+	{
+		const int slot = pool.mSlot[i];
+
+		// a death effect above may have needed the slot back
+		if ( slot < 0 )
+		{
+			continue;
+		}
+
+		if ( FX_CullPooledParticle( pool, i ) )
+		{
+			effectList[slot].mPoolRefEnt = FX_POOL_CULLED;
+			continue;
+		}
+		effectList[slot].mPoolRefEnt = numVisible;
+		poolVisible[numVisible++] = i;
+	}
+
+	FX_BuildPooledRefEnts( pool, poolVisible, numVisible );
+}
+
 //-------------------------
 // FX_Free
 //
@@ -60,6 +524,7 @@ bool FX_Free( bool templates )
 	}
 
 	activeFx = 0;
+	FX_ClearParticlePools();
 
 	theFxScheduler.Clean( templates );
 	return true;
@@ -83,6 +548,7 @@ void FX_Stop( void )
 	}
 
 	activeFx = 0;
+	FX_ClearParticlePools();
 
 	theFxScheduler.Clean(false);
 }
@@ -102,6 +568,7 @@ int	FX_Init( refdef_t* refdef )
 		for ( int i = 0; i < MAX_EFFECTS; i++ )
 		{
 			effectList[i].mEffect = 0;
+			effectList[i].mPooled = false;
 		}
 	}
 	nextValidEffect = &effectList[0];
@@ -112,6 +579,7 @@ int	FX_Init( refdef_t* refdef )
 	fx_debug = Cvar_Get("fx_debug", "0", CVAR_TEMP);
 	fx_countScale = Cvar_Get("fx_countScale", "1", CVAR_ARCHIVE_ND);
 	fx_nearCull = Cvar_Get("fx_nearCull", "16", CVAR_ARCHIVE_ND);
+	fx_poolParticles = Cvar_Get("fx_poolParticles", "1", CVAR_ARCHIVE_ND, "Keep plain particles in pooled arrays instead of one object each");
 
 	theFxHelper.ReInit(refdef);
 
@@ -128,14 +596,24 @@ void FX_SetRefDef(refdef_t *refdef)
 //-------------------------
 static void FX_FreeMember( SEffectList *obj )
 {
-	obj->mEffect->Die();
-	delete obj->mEffect;
-	obj->mEffect = 0;
+	if ( obj->mPooled )
+	{
+		// The particle dies when its pool next retires, as if it had been killed
+		particlePools[obj->mPortal ? 1 : 0].mSlot[obj->mPoolIndex] = -1;
+		obj->mPooled = false;
+		pooledFx--;
+	}
+	else
+	{
+		obj->mEffect->Die();
+		delete obj->mEffect;
+		obj->mEffect = 0;
+
+		activeFx--;
+	}
 
 	// May as well mark this to be used next
 	nextValidEffect = obj;
-
-	activeFx--;
 }
 
 
@@ -149,7 +627,7 @@ static void FX_FreeMember( SEffectList *obj )
 //-------------------------
 static SEffectList *FX_GetValidEffect()
 {
-	if ( nextValidEffect->mEffect == 0 )
+	if ( FX_SlotFree( nextValidEffect ) )
 	{
 		return nextValidEffect;
 	}
@@ -160,7 +638,7 @@ static SEffectList *FX_GetValidEffect()
 	// Blah..plow through the list till we find something that is currently untainted
 	for ( i = 0, ef = effectList; i < MAX_EFFECTS; i++, ef++ )
 	{
-		if ( ef->mEffect == 0 )
+		if ( FX_SlotFree( ef ) )
 		{
 			return ef;
 		}
@@ -190,10 +668,31 @@ void FX_Add( bool portal )
 
 	drawnFx = 0;
 
-	int numFx = activeFx;	//but stop when there can't be any more left!
+	FX_UpdatePooledParticles( portal );
+
+	int numFx = activeFx + pooledFx;	//but stop when there can't be any more left!
 	for ( i = 0, ef = effectList; i < MAX_EFFECTS && numFx; i++, ef++ )
 	{
-		if ( ef->mEffect != 0)
+		if ( ef->mPooled )
+		{
+			--numFx;
+			if ( portal != ef->mPortal )
+			{
+				continue;
+			}
+
+			if ( ef->mPoolRefEnt == FX_POOL_UNBUILT )
+			{
+				// spawned by an effect earlier in the walk, a CParticle would get its first Update now
+				ef->mPoolRefEnt = FX_BuildPooledRefEnt( particlePools[portal ? 1 : 0], ef->mPoolIndex );
+			}
+			if ( ef->mPoolRefEnt != FX_POOL_CULLED )
+			{
+				theFxHelper.AddFxToScene( &poolRefEnts[ef->mPoolRefEnt] );
+				drawnFx++;
+			}
+		}
+		else if ( ef->mEffect != 0)
 		{
 			--numFx;
 			if (portal != ef->mPortal)
@@ -220,10 +719,10 @@ void FX_Add( bool portal )
 		}
 	}
 
-
 	if ( fx_debug->integer && !portal)
 	{
 		theFxHelper.Print( "Active    FX: %i\n", activeFx );
+		theFxHelper.Print( "Pooled    FX: %i\n", pooledFx );
 		theFxHelper.Print( "Drawn     FX: %i\n", drawnFx );
 		theFxHelper.Print( "Scheduled FX: %i High: %i\n", theFxScheduler.NumScheduledFx(), theFxScheduler.GetHighWatermark() );
 	}
@@ -253,6 +752,85 @@ void FX_AddPrimitive( CEffect *pEffect, int killTime )
 	pEffect->SetTimeEnd( theFxHelper.mTime + killTime );
 }
 
+//-------------------------
+//  FX_AddPooledParticle
+//
+// Fills in a pool slot the way FX_AddParticle and FX_AddPrimitive set up a
+// CParticle, and takes the effectList slot the CParticle would have.
+//-------------------------
+static void FX_AddPooledParticle( SParticlePool &pool, SEffectList *item, vec3_t org, vec3_t vel, vec3_t accel,
+								float size1, float size2, float sizeParm,
+								float alpha1, float alpha2, float alphaParm,
+								vec3_t sRGB, vec3_t eRGB, float rgbParm,
+								float rotation, float rotationDelta,
+								int deathID, int killTime, qhandle_t shader, int flags )
+{
+	const int p = pool.mCount++;
+
+	for ( int j = 0; j < 3; j++ )
+	{
+		pool.mOrg[j][p] = org ? org[j] : 0.0f;
+		pool.mVel[j][p] = vel ? vel[j] : 0.0f;
+		pool.mAccel[j][p] = accel ? accel[j] : 0.0f;
+		pool.mRGBStart[j][p] = sRGB ? sRGB[j] : 0.0f;
+		pool.mRGBEnd[j][p] = eRGB ? eRGB[j] : 0.0f;
+	}
+
+	// RGB----------------
+	pool.mRGBParm[p] = 0.0f;
+	if (( flags & FX_RGB_PARM_MASK ) == FX_RGB_WAVE )
+	{
+		pool.mRGBParm[p] = rgbParm * PI * 0.001f;
+	}
+	else if ( flags & FX_RGB_PARM_MASK )
+	{
+		// rgbParm should be a value from 0-100..
+		pool.mRGBParm[p] = rgbParm * 0.01f * killTime + theFxHelper.mTime;
+	}
+
+	// Alpha----------------
+	pool.mAlphaStart[p] = alpha1;
+	pool.mAlphaEnd[p] = alpha2;
+	pool.mAlphaParm[p] = 0.0f;
+	if (( flags & FX_ALPHA_PARM_MASK ) == FX_ALPHA_WAVE )
+	{
+		pool.mAlphaParm[p] = alphaParm * PI * 0.001f;
+	}
+	else if ( flags & FX_ALPHA_PARM_MASK )
+	{
+		pool.mAlphaParm[p] = alphaParm * 0.01f * killTime + theFxHelper.mTime;
+	}
+
+	// Size----------------
+	pool.mSizeStart[p] = size1;
+	pool.mSizeEnd[p] = size2;
+	pool.mSizeParm[p] = 0.0f;
+	if (( flags & FX_SIZE_PARM_MASK ) == FX_SIZE_WAVE )
+	{
+		pool.mSizeParm[p] = sizeParm * PI * 0.001f;
+	}
+	else if ( flags & FX_SIZE_PARM_MASK )
+	{
+		pool.mSizeParm[p] = sizeParm * 0.01f * killTime + theFxHelper.mTime;
+	}
+
+	pool.mRotation[p] = rotation;
+	pool.mRotationDelta[p] = rotationDelta;
+	pool.mTimeStart[p] = theFxHelper.mTime;
+	pool.mTimeEnd[p] = theFxHelper.mTime + killTime;
+	pool.mFlags[p] = flags;
+	pool.mShader[p] = shader;
+	pool.mDeathFxID[p] = deathID;
+	pool.mSlot[p] = item - effectList;
+
+	item->mPooled = true;
+	item->mPortal = gEffectsInPortal;
+	item->mPoolIndex = p;
+	item->mPoolRefEnt = FX_POOL_UNBUILT;
+
+	pooledFx++;
+}
+
 //-------------------------
 //  FX_AddParticle
 //-------------------------
@@ -271,6 +849,21 @@ CParticle *FX_AddParticle( vec3_t org, vec3_t vel, vec3_t accel, float size1, fl
 		return 0;
 	}
 
+	if ( !( flags & FX_POOL_EXCLUDED_FLAGS ) && fx_poolParticles->integer && !particlePoolBypassed )
+	{
+		SParticlePool	&pool = particlePools[gEffectsInPortal ? 1 : 0];
+		SEffectList		*item = FX_GetValidEffect();
+
+		// making room may have run a death effect, so check the pool afterwards
+		if ( pool.mCount < MAX_POOLED_PARTICLES )
+		{
+			// Pooled particles have no object to hand back
+			FX_AddPooledParticle( pool, item, org, vel, accel, size1, size2, sizeParm, alpha1, alpha2, alphaParm,
+								sRGB, eRGB, rgbParm, rotation, rotationDelta, deathID, killTime, shader, flags );
+			return 0;
+		}
+	}
+
 	CParticle *fx = new CParticle;
 
 	if ( fx )
@@ -1245,3 +1838,123 @@ CBezier *FX_AddBezier( vec3_t start, vec3_t end,
 
 	return fx;
 }
+
+//-------------------------
+// FX_Bench_f
+//
+// Keeps a few thousand particles alive for a while, once through the pools
+// and once as CParticle objects, and times spawning, updating and submitting
+// them.  Any effects playing at the time are stopped.
+//-------------------------
+#define FXBENCH_LIVE		1500
+#define FXBENCH_FRAMES		1000
+#define FXBENCH_FRAMEMSEC	16
+#define FXBENCH_LIFE		1000
+
+static float FX_BenchRand( int *seed, float min, float max )
+{
+	return min + ( max - min ) * Q_random( seed );
+}
+
+static int FX_BenchRun( int live, bool pooled, int *spawned )
+{
+	static const int benchFlags[] =
+	{
+		FX_ALPHA_LINEAR | FX_SIZE_LINEAR,
+		FX_ALPHA_LINEAR | FX_RGB_LINEAR,
+		FX_ALPHA_NONLINEAR | FX_SIZE_LINEAR,
+		FX_ALPHA_CLAMP | FX_SIZE_WAVE | FX_USE_ALPHA,
+	};
+	const int	perFrame = Q_max( 1, live * FXBENCH_FRAMEMSEC / FXBENCH_LIFE );
+	vec3_t		org, vel, accel, sRGB, eRGB;
+	int			seed = 0x5eed;
+
+	FX_Stop();
+	particlePoolBypassed = !pooled;
+	theFxHelper.mTime = 0;
+	*spawned = 0;
+
+	VectorSet( accel, 0, 0, -400 );
+	VectorSet( sRGB, 1, 1, 1 );
+	VectorSet( eRGB, 0.5f, 0.5f, 0.5f );
+
+	const int iStart = Sys_Milliseconds();
+
+	for ( int frame = 1; frame <= FXBENCH_FRAMES; frame++ )
+	{
+		theFxHelper.AdjustTime( frame * FXBENCH_FRAMEMSEC );
+
+		for ( int i = 0; i < perFrame; i++ )
+		{
+			// about half of them end up behind the viewer
+			for ( int j = 0; j < 3; j++ )
+			{
+				org[j] = FX_BenchRand( &seed, -512, 512 );
+				vel[j] = FX_BenchRand( &seed, -100, 100 );
+			}
+
+			FX_AddParticle( org, vel, accel,
+							FX_BenchRand( &seed, 2, 8 ), 16, 50,
+							1, 0, 50,
+							sRGB, eRGB, 0,
+							FX_BenchRand( &seed, 0, 360 ), FX_BenchRand( &seed, -90, 90 ),
+							NULL, NULL, 0,
+							0, 0,
+							FXBENCH_LIFE, 0, benchFlags[Q_rand( &seed ) & 3] );
+			(*spawned)++;
+		}
+
+		FX_Add( false );
+
+		if ( cls.rendererStarted )
+		{
+			re->ClearScene();
+		}
+	}
+
+	const int iMsec = Sys_Milliseconds() - iStart;
+
+	FX_Stop();
+	particlePoolBypassed = false;
+
+	return iMsec;
+}
+
+void FX_Bench_f( void )
+{
+	if ( !fxInitialized )
+	{
+		Com_Printf( "The fx system isn't running\n" );
+		return;
+	}
+
+	int live = FXBENCH_LIVE;
+	if ( Cmd_Argc() > 1 )
+	{
+		// the CParticle path can't hold more than MAX_EFFECTS at once
+		live = Com_Clampi( 1, MAX_EFFECTS * 7 / 8, atoi( Cmd_Argv( 1 ) ) );
+	}
+
+	if ( !fx_poolParticles->integer )
+	{
+		Com_Printf( "fx_poolParticles is 0, both runs use CParticle\n" );
+	}
+
+	const SFxHelper	savedHelper = theFxHelper;
+	refdef_t		refdef;
+
+	// looking down +x from the origin
+	memset( &refdef, 0, sizeof( refdef ) );
+	AxisClear( refdef.viewaxis );
+	theFxHelper.refdef = &refdef;
+
+	int spawned;
+	const int iPooledMsec = FX_BenchRun( live, true, &spawned );
+	const int iObjectMsec = FX_BenchRun( live, false, &spawned );
+
+	theFxHelper = savedHelper;
+
+	Com_Printf( "%d particles spawned over %d frames, about %d alive at a time\n", spawned, FXBENCH_FRAMES, live );
+	Com_Printf( "pooled    %6d msec (%6.1f usec per frame)\n", iPooledMsec, 1000.0f * iPooledMsec / FXBENCH_FRAMES );
+	Com_Printf( "CParticle %6d msec (%6.1f usec per frame)\n", iObjectMsec, 1000.0f * iObjectMsec / FXBENCH_FRAMES );
+}
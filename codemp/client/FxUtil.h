@@ -29,6 +29,7 @@ int		FX_Init( refdef_t* refdef );	// called in CG_Init to purge the fx system.
 void	FX_SetRefDef(refdef_t *refdef);
 void	FX_Add( bool portal );		// called every cgame frame to add all fx into the scene.
 void	FX_Stop( void );	// ditches all active effects without touching the templates.
+void	FX_Bench_f( void );	// fx_bench console command, times pooled particles against CParticle.
 
 
 CParticle *FX_AddParticle( vec3_t org, vec3_t vel, vec3_t accel,
@@ -502,6 +502,46 @@ void CL_ShutdownCGame( void ) {
 	CL_UnbindCGame();
 }
 
+/*
+====================
+CL_PrefetchLevel
+
+Starts loading the map and the models and sounds of the gamestate in the
+background, cgame asks for most of them while it initializes
+====================
+*/
+static void CL_PrefetchLevel( void ) {
+	static char	names[1 + MAX_MODELS + MAX_SOUNDS * 2][MAX_QPATH];
+	const char	*qpaths[ARRAY_LEN( names )];
+	const char	*s;
+	char		sound[MAX_QPATH];
+	int			i, count;
+
+	count = 0;
+	Q_strncpyz( names[count++], cl.mapname, MAX_QPATH );
+	for ( i = 1 ; i < MAX_MODELS ; i++ ) {
+		s = cl.gameState.stringData + cl.gameState.stringOffsets[CS_MODELS + i];
+		// inline brush models are in the map
+		if ( s[0] && s[0] != '*' ) {
+			Q_strncpyz( names[count++], s, MAX_QPATH );
+		}
+	}
+	for ( i = 1 ; i < MAX_SOUNDS ; i++ ) {
+		s = cl.gameState.stringData + cl.gameState.stringOffsets[CS_SOUNDS + i];
+		// '*' sounds depend on the player model, the sound code tries a wav before an mp3
+		if ( s[0] && s[0] != '*' ) {
+			COM_StripExtension( s, sound, sizeof( sound ) );
+			Com_sprintf( names[count++], MAX_QPATH, "%s.wav", sound );
+			Com_sprintf( names[count++], MAX_QPATH, "%s.mp3", sound );
+		}
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		qpaths[i] = names[i];
+	}
+	FS_PrefetchFiles( qpaths, count );
+}
+
 /*
 ====================
 CL_InitCGame
@@ -525,6 +565,11 @@ void CL_InitCGame( void ) {
 	mapname = Info_ValueForKey( info, "mapname" );
 	Com_sprintf( cl.mapname, sizeof( cl.mapname ), "maps/%s.bsp", mapname );
 
+	// look for loose files added since the last level again
+	FS_FlushDirMisses();
+
+	CL_PrefetchLevel();
+
 	// load the dll
 	CL_BindCGame();
 
@@ -535,6 +580,9 @@ void CL_InitCGame( void ) {
 	// otherwise server commands sent just before a gamestate are dropped
 	CGVM_Init( clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
 
+	// whatever cgame didn't ask for
+	FS_CancelPrefetch();
+
 	int clRate = Cvar_VariableIntegerValue( "rate" );
 	if ( clRate == 4000 ) {
 		Com_Printf( S_COLOR_YELLOW "WARNING: Old default /rate value detected (4000). Suggest typing /rate 25000 into console for a smoother connection!\n" );
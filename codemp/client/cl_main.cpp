@@ -33,6 +33,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "qcommon/stringed_ingame.h"
 #include "qcommon/game_version.h"
 #include "cl_cgameapi.h"
+#include "FxUtil.h"
 #include "cl_uiapi.h"
 #include "cl_lan.h"
 #include "snd_local.h"
@@ -2529,6 +2530,9 @@ void CL_InitRef( void ) {
 	ri.PD_Store = PD_Store;
 	ri.PD_Load = PD_Load;
 
+	ri.Sys_ParallelFor = Sys_ParallelFor;
+	ri.Sys_CPUCount = Sys_CPUCount;
+
 	ret = GetRefAPI( REF_API_VERSION, &ri );
 
 //	Com_Printf( "-------------------------------\n");
@@ -2890,6 +2894,7 @@ void CL_Init( void ) {
 	Cmd_AddCommand ("forcepowers", CL_SetForcePowers_f );
 	Cmd_AddCommand ("video", CL_Video_f, "Record demo to avi" );
 	Cmd_AddCommand ("stopvideo", CL_StopVideo_f, "Stop avi recording" );
+	Cmd_AddCommand ("fx_bench", FX_Bench_f, "Times pooled particles against particle objects" );
 
 	CL_InitRef();
 
@@ -2964,6 +2969,7 @@ void CL_Shutdown( void ) {
 	Cmd_RemoveCommand ("forcepowers");
 	Cmd_RemoveCommand ("video");
 	Cmd_RemoveCommand ("stopvideo");
+	Cmd_RemoveCommand ("fx_bench");
 
 	CL_ShutdownInput();
 	Con_Shutdown();
@@ -2164,6 +2164,12 @@ int ScanForEnemies(bot_state_t *bs)
 	int i;
 	float hasEnemyDist = 0;
 	qboolean noAttackNonJM = qfalse;
+	int candidates[MAX_CLIENTS+1];
+	float candidateDist[MAX_CLIENTS+1];
+	traceRequest_t visCheck[MAX_CLIENTS+1];
+	trace_t visTrace[MAX_CLIENTS+1];
+	int numCandidates = 0;
+	int c;
 
 	closest = 999999;
 	i = 0;
@@ -2195,6 +2201,7 @@ int ScanForEnemies(bot_state_t *bs)
 		}
 	}
 
+	//gather everyone we could see or hear first so the visibility checks go out as one batch
 	while (i <= MAX_CLIENTS)
 	{
 		if (i != bs->client && g_entities[i].client && !OnSameTeam(&g_entities[bs->client], &g_entities[i]) && PassStandardEnemyChecks(bs, &g_entities[i]) && BotPVSCheck(g_entities[i].client->ps.origin, bs->eye) && PassLovedOneCheck(bs, &g_entities[i]))
@@ -2208,23 +2215,42 @@ int ScanForEnemies(bot_state_t *bs)
 				distcheck = 1;
 			}
 
-			if (distcheck < closest && ((InFieldOfVision(bs->viewangles, 90, a) && !BotMindTricked(bs->client, i)) || BotCanHear(bs, &g_entities[i], distcheck)) && OrgVisible(bs->eye, g_entities[i].client->ps.origin, -1))
+			if (distcheck < closest && ((InFieldOfVision(bs->viewangles, 90, a) && !BotMindTricked(bs->client, i)) || BotCanHear(bs, &g_entities[i], distcheck)))
 			{
-				if (BotMindTricked(bs->client, i))
-				{
-					if (distcheck < 256 || (level.time - g_entities[i].client->dangerTime) < 100)
-					{
-						if (!hasEnemyDist || distcheck < (hasEnemyDist - 128))
-						{ //if we have an enemy, only switch to closer if he is 128+ closer to avoid flipping out
-							if (!noAttackNonJM || g_entities[i].client->ps.isJediMaster)
-							{
-								closest = distcheck;
-								bestindex = i;
-							}
-						}
-					}
-				}
-				else
+				traceRequest_t *vis = &visCheck[numCandidates];
+
+				//same trace as OrgVisible
+				memset(vis, 0, sizeof(*vis));
+				VectorCopy(bs->eye, vis->start);
+				VectorCopy(g_entities[i].client->ps.origin, vis->end);
+				vis->passEntityNum = -1;
+				vis->contentmask = MASK_SOLID;
+
+				candidates[numCandidates] = i;
+				candidateDist[numCandidates] = distcheck;
+				numCandidates++;
+			}
+		}
+		i++;
+	}
+
+	if (!numCandidates)
+	{
+		return -1;
+	}
+
+	trap->TraceBatch(visTrace, visCheck, numCandidates);
+
+	for (c = 0; c < numCandidates; c++)
+	{
+		i = candidates[c];
+		distcheck = candidateDist[c];
+
+		if (distcheck < closest && visTrace[c].fraction == 1)
+		{
+			if (BotMindTricked(bs->client, i))
+			{
+				if (distcheck < 256 || (level.time - g_entities[i].client->dangerTime) < 100)
 				{
 					if (!hasEnemyDist || distcheck < (hasEnemyDist - 128))
 					{ //if we have an enemy, only switch to closer if he is 128+ closer to avoid flipping out
@@ -2236,8 +2262,18 @@ int ScanForEnemies(bot_state_t *bs)
 					}
 				}
 			}
+			else
+			{
+				if (!hasEnemyDist || distcheck < (hasEnemyDist - 128))
+				{ //if we have an enemy, only switch to closer if he is 128+ closer to avoid flipping out
+					if (!noAttackNonJM || g_entities[i].client->ps.isJediMaster)
+					{
+						closest = distcheck;
+						bestindex = i;
+					}
+				}
+			}
 		}
-		i++;
 	}
 
 	return bestindex;
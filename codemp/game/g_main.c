@@ -3566,6 +3566,15 @@ GetModuleAPI
 
 gameImport_t *trap = NULL;
 
+// a version 1 engine's import table ends before TraceBatch
+static gameImport_t trapVersion1;
+
+static void G_TraceBatchSerial( trace_t *results, const traceRequest_t *requests, int count ) {
+	int i;
+	for ( i=0; i<count; i++, results++, requests++ )
+		trap->Trace( results, requests->start, requests->mins, requests->maxs, requests->end, requests->passEntityNum, requests->contentmask, requests->capsule, requests->traceFlags, requests->useLod );
+}
+
 Q_EXPORT gameExport_t* QDECL GetModuleAPI( int apiVersion, gameImport_t *import )
 {
 	static gameExport_t ge = {0};
@@ -3577,7 +3586,13 @@ Q_EXPORT gameExport_t* QDECL GetModuleAPI( int apiVersion, gameImport_t *import
 
 	memset( &ge, 0, sizeof( ge ) );
 
-	if ( apiVersion != GAME_API_VERSION ) {
+	if ( apiVersion == 1 ) {
+		// copy what the engine has and run batches as single traces
+		memcpy( &trapVersion1, import, offsetof( gameImport_t, TraceBatch ) );
+		trapVersion1.TraceBatch = G_TraceBatchSerial;
+		trap = &trapVersion1;
+	}
+	else if ( apiVersion != GAME_API_VERSION ) {
 		trap->Print( "Mismatched GAME_API_VERSION: expected %i, got %i\n", GAME_API_VERSION, apiVersion );
 		return NULL;
 	}
@@ -29,7 +29,9 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #define Q3_INFINITE			16777216
 
-#define	GAME_API_VERSION	1
+// version 2 appended TraceBatch to gameImport_t, everything before it is
+// laid out as in version 1, so either side still takes a version 1 partner
+#define	GAME_API_VERSION	2
 
 // entity->svFlags
 // the server does not know how to interpret most of the values
@@ -254,6 +256,20 @@ typedef struct sharedEntity_s {
 	int				next_roff_time; //rww - npc's need to know when they're getting roff'd
 } sharedEntity_t;
 
+// one entry of a TraceBatch call, the fields match the arguments of Trace
+// except that point traces leave mins/maxs zeroed instead of passing NULL
+typedef struct traceRequest_s {
+	vec3_t			start;
+	vec3_t			mins;
+	vec3_t			maxs;
+	vec3_t			end;
+	int				passEntityNum;
+	int				contentmask;
+	int				capsule;
+	int				traceFlags;
+	int				useLod;
+} traceRequest_t;
+
 #if !defined(_GAME) && defined(__cplusplus)
 class CSequencer;
 class CTaskManager;
@@ -1093,6 +1109,9 @@ typedef struct gameImport_s {
 	void		(*G2API_CleanEntAttachments)			( void );
 	qboolean	(*G2API_OverrideServer)					( void *serverInstance );
 	void		(*G2API_GetSurfaceName)					( void *ghoul2, int surfNumber, int modelIndex, char *fillBuf );
+
+	// results[i] is what Trace would return for requests[i]
+	void		(*TraceBatch)							( trace_t *results, const traceRequest_t *requests, int count );
 } gameImport_t;
 
 typedef struct gameExport_s {
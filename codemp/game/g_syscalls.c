@@ -1009,6 +1009,11 @@ void SVSyscall_Trace( trace_t *results, const vec3_t start, const vec3_t mins, c
 	else
 		trap_Trace( results, start, mins, maxs, end, passEntityNum, contentmask );
 }
+void SVSyscall_TraceBatch( trace_t *results, const traceRequest_t *requests, int count ) {
+	int i;
+	for ( i=0; i<count; i++, results++, requests++ )
+		SVSyscall_Trace( results, requests->start, requests->mins, requests->maxs, requests->end, requests->passEntityNum, requests->contentmask, requests->capsule, requests->traceFlags, requests->useLod );
+}
 
 NORETURN void QDECL G_Error( int errorLevel, const char *error, ... ) {
 	va_list argptr;
@@ -1354,4 +1359,6 @@ static void TranslateSyscalls( void ) {
 	trap->G2API_CleanEntAttachments			= trap_G2API_CleanEntAttachments;
 	trap->G2API_OverrideServer				= trap_G2API_OverrideServer;
 	trap->G2API_GetSurfaceName				= trap_G2API_GetSurfaceName;
+
+	trap->TraceBatch						= SVSyscall_TraceBatch;
 }
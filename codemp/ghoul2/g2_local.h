@@ -310,6 +310,8 @@ int			G2API_GetGhoul2ModelFlags(CGhoul2Info *ghlInfo);
 qboolean	G2API_GetAnimFileName(CGhoul2Info *ghlInfo, char **filename);
 void		G2API_CollisionDetect(CollisionRecord_t *collRecMap, CGhoul2Info_v &ghoul2, const vec3_t angles, const vec3_t position, int frameNumber, int entNum, vec3_t rayStart, vec3_t rayEnd, vec3_t scale, IHeapAllocator *G2VertSpace, int traceFlags, int useLod, float fRadius);
 void		G2API_CollisionDetectCache(CollisionRecord_t *collRecMap, CGhoul2Info_v &ghoul2, const vec3_t angles, const vec3_t position, int frameNumber, int entNum, vec3_t rayStart, vec3_t rayEnd, vec3_t scale, IHeapAllocator *G2VertSpace, int traceFlags, int useLod, float fRadius);
+void		G2API_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, int frameNumber, int numThreads);
+void		G2API_ReleaseSkeletons(void);
 
 void		G2API_GiveMeVectorFromMatrix(mdxaBone_t *boltMatrix, Eorientations flags, vec3_t vec);
 int			G2API_CopyGhoul2Instance(CGhoul2Info_v &g2From, CGhoul2Info_v &g2To, int modelIndex);
@@ -365,6 +367,8 @@ extern qboolean gG2_GBMNoReconstruct;
 extern qboolean gG2_GBMUseSPMethod;
 // From tr_ghoul2.cpp
 void		G2_ConstructGhoulSkeleton( CGhoul2Info_v &ghoul2,const int frameNum,bool checkForNewOrigin,const vec3_t scale);
+void		G2_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, const int frameNum, int numThreads);
+void		G2_ReleaseSkeletons(void);
 
 qboolean	G2API_SkinlessModel(CGhoul2Info_v& ghoul2, int modelIndex);
 
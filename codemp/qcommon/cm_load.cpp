@@ -25,6 +25,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "cm_local.h"
 #include "qcommon/qfiles.h"
 
+#include <chrono>
+
 #ifdef BSPC
 
 #include "../bspc/l_qfiles.h"
@@ -44,18 +46,18 @@ void SetPlaneSignbits (cplane_t *out) {
 #endif //BSPC
 
 // to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
-#define	BOX_BRUSHES		1
-#define	BOX_SIDES		6
+// some extra indexes along with those needed by the map,
+// one box for each job thread
+#define	BOX_BRUSHES		MAX_JOB_THREADS
+#define	BOX_SIDES		(6*MAX_JOB_THREADS)
 #define	BOX_LEAFS		2
-#define	BOX_PLANES		12
+#define	BOX_PLANES		(12*MAX_JOB_THREADS)
 
 #define	LL(x) x=LittleLong(x)
 
 
 clipMap_t	cmg; //rwwRMG - changed from cm
-int			c_pointcontents;
-int			c_traces, c_brush_traces, c_patch_traces;
+cmStats_t	cm_stats[MAX_JOB_THREADS];
 
 
 byte		*cmod_base;
@@ -65,11 +67,14 @@ cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
 cvar_t		*cm_extraVerbose;
+cvar_t		*cm_debugSurfaceUpdate;
+cvar_t		*cm_mmap;
+cvar_t		*cm_loadTimes;
 #endif
 
-cmodel_t	box_model;
-cplane_t	*box_planes;
-cbrush_t	*box_brush;
+cmodel_t	box_model[MAX_JOB_THREADS];
+cplane_t	*box_planes;		// 12 per thread
+cbrush_t	*box_brush;			// 1 per thread
 
 
 
@@ -240,6 +245,49 @@ void CM_BoundBrush( cbrush_t *b ) {
 }
 
 
+/*
+=================
+CMod_PackBrushSides
+
+Copies each brush's side planes into blocks of BRUSH_PLANE_LANES so the
+trace kernels can test several planes at once.  Brushes index their sides
+by range, so this has to wait for the brushes lump after the sides are in.
+=================
+*/
+static void CMod_PackBrushSides( clipMap_t &cm ) {
+	cbrush_t		*brush;
+	cbrushplanes_t	*out;
+	cplane_t		*plane;
+	int				i, j, lane, count;
+
+	count = 0;
+	for ( i = 0, brush = cm.brushes ; i < cm.numBrushes ; i++, brush++ ) {
+		count += ( brush->numsides + BRUSH_PLANE_LANES - 1 ) / BRUSH_PLANE_LANES;
+	}
+
+	cm.brushplanes = (cbrushplanes_t *)Hunk_Alloc( count * sizeof( *cm.brushplanes ), h_high );
+	cm.numBrushPlanes = count;
+
+	out = cm.brushplanes;
+	for ( i = 0, brush = cm.brushes ; i < cm.numBrushes ; i++, brush++ ) {
+		brush->planes = out;
+		for ( j = 0 ; j < brush->numsides ; j += BRUSH_PLANE_LANES, out++ ) {
+			for ( lane = 0 ; lane < BRUSH_PLANE_LANES ; lane++ ) {
+				if ( j + lane < brush->numsides ) {
+					plane = brush->sides[j + lane].plane;
+					out->normal[0][lane] = plane->normal[0];
+					out->normal[1][lane] = plane->normal[1];
+					out->normal[2][lane] = plane->normal[2];
+					out->dist[lane] = plane->dist;
+				} else {
+					out->normal[0][lane] = out->normal[1][lane] = out->normal[2][lane] = 0.0f;
+					out->dist[lane] = 1.0f;
+				}
+			}
+		}
+	}
+}
+
 /*
 =================
 CMod_LoadBrushes
@@ -275,6 +323,7 @@ void CMod_LoadBrushes( const lump_t *l, clipMap_t &cm ) {
 		CM_BoundBrush( out );
 	}
 
+	CMod_PackBrushSides( cm );
 }
 
 /*
@@ -405,6 +454,15 @@ static void CMod_LoadLeafSurfaces( const lump_t *l, clipMap_t &cm )
 		Com_Error (ERR_DROP, "CMod_LoadLeafSurfaces: funny lump size");
 	count = l->filelen / sizeof(*in);
 
+#ifdef Q3_LITTLE_ENDIAN
+	if ( cm.mapping.base && !( (intptr_t)in & 3 ) ) {
+		// the mapped file lives as long as the clip map, use the lump where it is
+		cm.leafsurfaces = in;
+		cm.numLeafSurfaces = count;
+		return;
+	}
+#endif
+
 	cm.leafsurfaces = (int *)Hunk_Alloc( count * sizeof( *cm.leafsurfaces ), h_high );
 	cm.numLeafSurfaces = count;
 
@@ -502,9 +560,14 @@ static void CMod_LoadVisibility( const lump_t *l, clipMap_t &cm ) {
 	buf = cmod_base + l->fileofs;
 
 	cm.vised = qtrue;
-	cm.visibility = (unsigned char *)Hunk_Alloc( len, h_high );
 	cm.numClusters = LittleLong( ((int *)buf)[0] );
 	cm.clusterBytes = LittleLong( ((int *)buf)[1] );
+	if ( cm.mapping.base ) {
+		// the cluster bits are plain bytes, no need to copy them out of the mapped file
+		cm.visibility = buf + VIS_HEADER;
+		return;
+	}
+	cm.visibility = (unsigned char *)Hunk_Alloc( len, h_high );
 	Com_Memcpy (cm.visibility, buf + VIS_HEADER, len - VIS_HEADER );
 }
 
@@ -618,6 +681,151 @@ qboolean CM_DeleteCachedMap(qboolean bGuaranteedOkToDelete)
 
 
 
+/*
+==================
+CM_AllocChecks
+
+Gives the first numThreads job threads their multi-check marks
+==================
+*/
+static void CM_AllocChecks( clipMap_t &cm, int numThreads )
+{
+	cmCheck_t	*check;
+	int			i;
+
+	for ( i = 0, check = cm.checks ; i < numThreads ; i++, check++ ) {
+		if ( check->brushes ) {
+			continue;
+		}
+		check->count = 0;
+		check->brushes = (int *)Z_Malloc( ( cm.numBrushes + BOX_BRUSHES ) * sizeof( *check->brushes ), TAG_BSP, qtrue );
+		check->surfaces = (int *)Z_Malloc( ( cm.numSurfaces + 1 ) * sizeof( *check->surfaces ), TAG_BSP, qtrue );
+	}
+}
+
+static void CM_FreeChecks( clipMap_t &cm )
+{
+	cmCheck_t	*check;
+	int			i;
+
+	for ( i = 0, check = cm.checks ; i < MAX_JOB_THREADS ; i++, check++ ) {
+		if ( check->brushes ) {
+			Z_Free( check->brushes );
+			Z_Free( check->surfaces );
+		}
+	}
+}
+
+/*
+==================
+CM_SetupThreads
+
+Must be called on the main thread before handing collision queries to the
+first numThreads job threads
+==================
+*/
+void CM_SetupThreads( int numThreads )
+{
+	int		i;
+
+	if ( numThreads > MAX_JOB_THREADS ) {
+		numThreads = MAX_JOB_THREADS;
+	}
+
+	if ( cmg.numNodes ) {
+		CM_AllocChecks( cmg, numThreads );
+	}
+	for ( i = 0 ; i < NumSubBSP ; i++ ) {
+		CM_AllocChecks( SubBSP[i], numThreads );
+	}
+}
+
+/*
+==================
+CM_TraceStats
+==================
+*/
+void CM_TraceStats( int *traces, int *brushTraces, int *patchTraces, int *pointContents )
+{
+	int		i;
+
+	*traces = *brushTraces = *patchTraces = *pointContents = 0;
+	for ( i = 0 ; i < MAX_JOB_THREADS ; i++ ) {
+		*traces += cm_stats[i].traces;
+		*brushTraces += cm_stats[i].brushTraces;
+		*patchTraces += cm_stats[i].patchTraces;
+		*pointContents += cm_stats[i].pointContents;
+	}
+	Com_Memset( cm_stats, 0, sizeof( cm_stats ) );
+}
+
+/*
+==================
+CMod_ValidateLumps
+
+Every lump has to lie inside the file before anything reads it, the loaders
+trust fileofs/filelen from here on
+==================
+*/
+static void CMod_ValidateLumps( const dheader_t *header, int fileLength, const char *name )
+{
+	for ( int i = 0 ; i < HEADER_LUMPS ; i++ ) {
+		const lump_t *l = &header->lumps[i];
+
+		if ( l->fileofs < 0 || l->filelen < 0 || l->fileofs > fileLength - l->filelen ) {
+			Com_Error( ERR_DROP, "CM_LoadMap: %s has a bad lump %i (offset %i, length %i, file length %i)",
+				name, i, l->fileofs, l->filelen, fileLength );
+		}
+	}
+}
+
+/*
+==================
+CM_LoadTimes
+
+Per lump timing breakdown for cm_loadTimes
+==================
+*/
+#define MAX_LOAD_TIMES	16
+
+typedef struct cmLoadTimes_s {
+	int			count;
+	const char	*names[MAX_LOAD_TIMES];
+	int			bytes[MAX_LOAD_TIMES];
+	double		msec[MAX_LOAD_TIMES];
+	double		last;
+} cmLoadTimes_t;
+
+static double CM_LoadClock( void )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static void CM_LoadTime( cmLoadTimes_t *times, const char *name, int bytes )
+{
+	const double now = CM_LoadClock();
+
+	if ( times->count < MAX_LOAD_TIMES ) {
+		times->names[times->count] = name;
+		times->bytes[times->count] = bytes;
+		times->msec[times->count] = now - times->last;
+		times->count++;
+	}
+	times->last = now;
+}
+
+static void CM_PrintLoadTimes( const cmLoadTimes_t *times, const char *name, int fileLength, qboolean mapped )
+{
+	double	total = 0;
+
+	Com_Printf( "%s: %i KB, %s\n", name, fileLength >> 10, mapped ? "mapped" : "read" );
+	for ( int i = 0 ; i < times->count ; i++ ) {
+		Com_Printf( "  %-14s %8i KB %9.3f msec\n", times->names[i], times->bytes[i] >> 10, times->msec[i] );
+		total += times->msec[i];
+	}
+	Com_Printf( "  %-14s %11s %9.3f msec\n", "total", "", total );
+}
+
 static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *checksum, clipMap_t &cm )
 { //rwwRMG - function needs heavy modification
 	int				*buf;
@@ -625,6 +833,7 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 	static unsigned	last_checksum;
 	char			origName[MAX_OSPATH];
 	void			*newBuff = 0;
+	cmLoadTimes_t	times;
 
 	if ( !name || !name[0] ) {
 		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
@@ -635,6 +844,9 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE_ND|CVAR_CHEAT );
 	cm_extraVerbose = Cvar_Get ("cm_extraVerbose", "0", CVAR_TEMP );
+	cm_debugSurfaceUpdate = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
+	cm_mmap = Cvar_Get( "cm_mmap", "1", CVAR_ARCHIVE_ND, "Map the BSP file read-only instead of reading it when the renderer doesn't need a copy" );
+	cm_loadTimes = Cvar_Get( "cm_loadTimes", "0", CVAR_TEMP, "Print how long each BSP lump takes to load" );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -684,20 +896,32 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 	//	then discard it after that...
 	//
 	buf = NULL;
+	Com_Memset( &times, 0, sizeof( times ) );
+	times.last = CM_LoadClock();
 	fileHandle_t h;
 	const int iBSPLen = FS_FOpenFileRead( name, &h, qfalse );
 	if (h)
 	{
-		newBuff = Z_Malloc( iBSPLen, TAG_BSP_DISKIMAGE );
-		FS_Read( newBuff, iBSPLen, h);
-		FS_FCloseFile( h );
+		// a dedicated server never hands the image to a renderer, so the main map can be
+		//	mapped and its lumps used in place for as long as the clip map lives
+		if ( cm_mmap->integer && &cm == &cmg && ( com_dedicated->integer || Sys_LowPhysicalMemory() ) )
+		{
+			buf = (int *)FS_MapFile( h, &cm.mapping );
+		}
 
-		buf = (int*) newBuff;	// so the rest of the code works as normal
-		if (&cm == &cmg)
+		if ( !buf )
 		{
-			gpvCachedMapDiskImage = newBuff;
-			newBuff = 0;
+			newBuff = Z_Malloc( iBSPLen, TAG_BSP_DISKIMAGE );
+			FS_Read( newBuff, iBSPLen, h);
+
+			buf = (int*) newBuff;	// so the rest of the code works as normal
+			if (&cm == &cmg)
+			{
+				gpvCachedMapDiskImage = newBuff;
+				newBuff = 0;
+			}
 		}
+		FS_FCloseFile( h );
 
 		// carry on as before...
 		//
@@ -710,6 +934,14 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 		Com_Error (ERR_DROP, "Couldn't load %s", name);
 	}
 
+	if ( iBSPLen < (int)sizeof( dheader_t ) ) {
+		Com_Error (ERR_DROP, "CM_LoadMap: %s is too short", name);
+	}
+
+#ifndef BSPC
+	CM_LoadTime( &times, "file", iBSPLen );
+#endif
+
 	last_checksum = LittleLong (Com_BlockChecksum (buf, iBSPLen));
 	if ( checksum )
 		*checksum = last_checksum;
@@ -727,21 +959,44 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 		, name, header.version, BSP_VERSION );
 	}
 
+	CMod_ValidateLumps( &header, iBSPLen, name );
+
 	cmod_base = (byte *)buf;
 
+#ifndef BSPC
+	CM_LoadTime( &times, "checksum", iBSPLen );
+#define CM_LUMP_TIME( label, lump )	CM_LoadTime( &times, label, header.lumps[lump].filelen )
+#else
+#define CM_LUMP_TIME( label, lump )
+#endif
+
 	// load into heap
 	CMod_LoadShaders( &header.lumps[LUMP_SHADERS], cm );
+	CM_LUMP_TIME( "shaders", LUMP_SHADERS );
 	CMod_LoadLeafs (&header.lumps[LUMP_LEAFS], cm);
+	CM_LUMP_TIME( "leafs", LUMP_LEAFS );
 	CMod_LoadLeafBrushes (&header.lumps[LUMP_LEAFBRUSHES], cm);
+	CM_LUMP_TIME( "leafbrushes", LUMP_LEAFBRUSHES );
 	CMod_LoadLeafSurfaces (&header.lumps[LUMP_LEAFSURFACES], cm);
+	CM_LUMP_TIME( "leafsurfaces", LUMP_LEAFSURFACES );
 	CMod_LoadPlanes (&header.lumps[LUMP_PLANES], cm);
+	CM_LUMP_TIME( "planes", LUMP_PLANES );
 	CMod_LoadBrushSides (&header.lumps[LUMP_BRUSHSIDES], cm);
+	CM_LUMP_TIME( "brushsides", LUMP_BRUSHSIDES );
 	CMod_LoadBrushes (&header.lumps[LUMP_BRUSHES], cm);
+	CM_LUMP_TIME( "brushes", LUMP_BRUSHES );
 	CMod_LoadSubmodels (&header.lumps[LUMP_MODELS], cm);
+	CM_LUMP_TIME( "models", LUMP_MODELS );
 	CMod_LoadNodes (&header.lumps[LUMP_NODES], cm);
+	CM_LUMP_TIME( "nodes", LUMP_NODES );
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES], cm, name);
+	CM_LUMP_TIME( "entities", LUMP_ENTITIES );
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY], cm );
+	CM_LUMP_TIME( "visibility", LUMP_VISIBILITY );
 	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS], cm );
+	CM_LUMP_TIME( "patches", LUMP_SURFACES );
+
+#undef CM_LUMP_TIME
 
 	TotalSubModels += cm.numSubModels;
 
@@ -781,6 +1036,15 @@ static void CM_LoadMap_Actual( const char *name, qboolean clientload, int *check
 
 	CM_FloodAreaConnections (cm);
 
+	CM_AllocChecks( cm, 1 );
+
+#ifndef BSPC
+	CM_LoadTime( &times, "areas", 0 );
+	if ( cm_loadTimes->integer ) {
+		CM_PrintLoadTimes( &times, name, iBSPLen, cm.mapping.base ? qtrue : qfalse );
+	}
+#endif
+
 	// allow this to be cached if it is loaded by the server
 	if ( !clientload ) {
 		Q_strncpyz( cm.name, origName, sizeof( cm.name ) );
@@ -810,11 +1074,14 @@ void CM_ClearMap( void )
 {
 	int		i;
 
+	CM_FreeChecks( cmg );
+	Sys_UnmapFile( &cmg.mapping );
 	Com_Memset( &cmg, 0, sizeof( cmg ) );
 	CM_ClearLevelPatches();
 
 	for(i = 0; i < NumSubBSP; i++)
 	{
+		CM_FreeChecks( SubBSP[i] );
 		memset(&SubBSP[i], 0, sizeof(SubBSP[0]));
 	}
 	NumSubBSP = 0;
@@ -848,7 +1115,7 @@ cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle, clipMap_t **clipMap ) {
 		{
 			*clipMap = &cmg;
 		}
-		return &box_model;
+		return &box_model[Sys_JobThreadIndex()];
 	}
 
 	count = cmg.numSubModels;
@@ -927,47 +1194,56 @@ can just be stored out and get a proper clipping hull structure.
 */
 void CM_InitBoxHull (void)
 {
-	int			i;
+	int			i, t;
 	int			side;
 	cplane_t	*p;
 	cbrushside_t	*s;
+	cbrush_t	*brush;
+	cmodel_t	*model;
 
 	box_planes = &cmg.planes[cmg.numPlanes];
-
 	box_brush = &cmg.brushes[cmg.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cmg.brushsides + cmg.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
-
-	box_model.firstNode = -1;
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cmg.numBrushes;
-	box_model.leaf.firstLeafBrush = cmg.numLeafBrushes;
-	cmg.leafbrushes[cmg.numLeafBrushes] = cmg.numBrushes;
 
-	for (i=0 ; i<6 ; i++)
+	// every job thread gets its own box so CM_TempBoxModel can be used from any of them
+	for (t=0 ; t<MAX_JOB_THREADS ; t++)
 	{
-		side = i&1;
-
-		// brush sides
-		s = &cmg.brushsides[cmg.numBrushSides+i];
-		s->plane = 	cmg.planes + (cmg.numPlanes+i*2+side);
-		s->shaderNum = cmg.numShaders;
-
-		// planes
-		p = &box_planes[i*2];
-		p->type = i>>1;
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = 1;
-
-		p = &box_planes[i*2+1];
-		p->type = 3 + (i>>1);
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = -1;
-
-		SetPlaneSignbits( p );
+		brush = &box_brush[t];
+		brush->numsides = 6;
+		brush->sides = cmg.brushsides + cmg.numBrushSides + t*6;
+		brush->planes = NULL;		// the planes move with every CM_TempBoxModel
+		brush->contents = CONTENTS_BODY;
+
+		model = &box_model[t];
+		model->firstNode = -1;
+		model->leaf.numLeafBrushes = 1;
+//		model->leaf.firstLeafBrush = cmg.numBrushes;
+		model->leaf.firstLeafBrush = cmg.numLeafBrushes + t;
+		cmg.leafbrushes[cmg.numLeafBrushes + t] = cmg.numBrushes + t;
+
+		for (i=0 ; i<6 ; i++)
+		{
+			side = i&1;
+
+			// brush sides
+			s = &brush->sides[i];
+			s->plane = 	box_planes + (t*12+i*2+side);
+			s->shaderNum = cmg.numShaders;
+
+			// planes
+			p = &box_planes[t*12+i*2];
+			p->type = i>>1;
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = 1;
+
+			p = &box_planes[t*12+i*2+1];
+			p->type = 3 + (i>>1);
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = -1;
+
+			SetPlaneSignbits( p );
+		}
 	}
 }
 
@@ -981,29 +1257,32 @@ Capsules are handled differently though.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	const int	thread = Sys_JobThreadIndex();
+	cplane_t	*planes = &box_planes[thread*12];
+	cbrush_t	*brush = &box_brush[thread];
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, box_model[thread].mins );
+	VectorCopy( maxs, box_model[thread].maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
 	}
 
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
-
-	VectorCopy( mins, box_brush->bounds[0] );
-	VectorCopy( maxs, box_brush->bounds[1] );
+	planes[0].dist = maxs[0];
+	planes[1].dist = -maxs[0];
+	planes[2].dist = mins[0];
+	planes[3].dist = -mins[0];
+	planes[4].dist = maxs[1];
+	planes[5].dist = -maxs[1];
+	planes[6].dist = mins[1];
+	planes[7].dist = -mins[1];
+	planes[8].dist = maxs[2];
+	planes[9].dist = -maxs[2];
+	planes[10].dist = mins[2];
+	planes[11].dist = -mins[2];
+
+	VectorCopy( mins, brush->bounds[0] );
+	VectorCopy( maxs, brush->bounds[1] );
 
 	return BOX_MODEL_HANDLE;
 }
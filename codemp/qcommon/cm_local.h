@@ -63,13 +63,22 @@ typedef struct cbrushside_s {
 	int			shaderNum;
 } cbrushside_t;
 
+// brush side planes packed four at a time for the SIMD trace kernels,
+// unused lanes have a zero normal and a positive dist so they never clip
+#define	BRUSH_PLANE_LANES	4
+
+typedef struct cbrushplanes_s {
+	float		normal[3][BRUSH_PLANE_LANES];	// one row per axis
+	float		dist[BRUSH_PLANE_LANES];
+} cbrushplanes_t;
+
 typedef struct cbrush_s {
 	int					shaderNum;		// the shader that determined the contents
 	int					contents;
 	vec3_t				bounds[2];
 	cbrushside_t		*sides;
+	cbrushplanes_t		*planes;		// sides in blocks of BRUSH_PLANE_LANES, NULL for the box brush
 	unsigned short		numsides;
-	unsigned short		checkcount;		// to avoid repeated testings
 } cbrush_t;
 
 class CCMShader
@@ -87,7 +96,6 @@ public:
 };
 
 typedef struct cPatch_s {
-	int			checkcount;				// to avoid repeated testings
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -99,6 +107,14 @@ typedef struct cArea_s {
 	int			floodvalid;
 } cArea_t;
 
+// the multi-check avoidance marks live outside the brushes and patches, one
+// set per job thread, so collision queries never write to shared map data
+typedef struct cmCheck_s {
+	int			count;				// incremented on each trace
+	int			*brushes;			// [numBrushes + box brushes] count when each brush was last tested
+	int			*surfaces;			// [numSurfaces] same for the patches
+} cmCheck_t;
+
 typedef struct clipMap_s {
 	char		name[MAX_QPATH];
 
@@ -129,6 +145,9 @@ typedef struct clipMap_s {
 	int			numBrushes;
 	cbrush_t	*brushes;
 
+	int			numBrushPlanes;
+	cbrushplanes_t *brushplanes;
+
 	int			numClusters;
 	int			clusterBytes;
 	byte		*visibility;
@@ -145,7 +164,8 @@ typedef struct clipMap_s {
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
+	cmCheck_t	checks[MAX_JOB_THREADS];	// allocated up to CM_SetupThreads
+	sysFileMapping_t	mapping;	// the BSP file when lumps are used in place (cm_mmap)
 } clipMap_t;
 
 
@@ -154,12 +174,25 @@ typedef struct clipMap_s {
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
 extern	clipMap_t	cmg; //rwwRMG - changed from cm
-extern	int			c_pointcontents;
-extern	int			c_traces, c_brush_traces, c_patch_traces;
+
+// com_showtrace statistics, one set per job thread so traces running in
+// parallel never bump the same counter, CM_TraceStats adds them up
+typedef struct cmStats_s {
+	int			traces;
+	int			brushTraces;
+	int			patchTraces;
+	int			pointContents;
+	int			pad[12];		// one cache line per thread
+} cmStats_t;
+
+extern	cmStats_t	cm_stats[MAX_JOB_THREADS];
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
 extern	cvar_t		*cm_extraVerbose;
+extern	cvar_t		*cm_debugSurfaceUpdate;
+extern	cvar_t		*cm_mmap;
+extern	cvar_t		*cm_loadTimes;
 
 // cm_test.c
 
@@ -180,6 +213,7 @@ typedef struct traceWork_s { //rwwRMG - modified
 	vec3_t		extents;	// greatest of abs(size[0]) and abs(size[1])
 	vec3_t		modelOrigin;// origin of the model tracing through
 	int			contents;	// ored contents of the model tracing through
+	int			thread;		// job thread index, picks the checks and box hull to use
 	qboolean	isPoint;	// optimized case
 //	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
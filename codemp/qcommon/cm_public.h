@@ -29,6 +29,14 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 void		CM_LoadMap( const char *name, qboolean clientload, int *checksum);
 
 void		CM_ClearMap( void );
+
+// traces, point contents and the box/leaf queries are safe to run from the
+// job threads once CM_SetupThreads has been called on the main thread with at
+// least as many threads, the map itself is never written to while tracing
+void		CM_SetupThreads( int numThreads );
+// adds up the com_showtrace counts of every job thread and zeroes them, call
+// it on the main thread while no batch is running
+void		CM_TraceStats( int *traces, int *brushTraces, int *patchTraces, int *pointContents );
 clipHandle_t CM_InlineModel( int index );		// 0 = world, 1 + are bmodels
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule );
 
@@ -43,6 +51,8 @@ int			CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec
 
 void		CM_BoxTrace ( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, clipHandle_t model, int brushmask, int capsule );
 void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, clipHandle_t model, int brushmask, const vec3_t origin, const vec3_t angles, int capsule );
+void		CM_TraceFuzz_f( void );
+void		CM_TraceStress_f( void );
 
 byte		*CM_ClusterPVS (int cluster);
 
@@ -49,7 +49,7 @@ int CM_PointLeafnum_r( const vec3_t p, int num, clipMap_t *local ) {
 			num = node->children[0];
 	}
 
-	c_pointcontents++;		// optimize counter
+	cm_stats[Sys_JobThreadIndex()].pointContents++;		// optimize counter
 
 	return -1 - num;
 }
@@ -89,6 +89,7 @@ void CM_StoreLeafs( leafList_t *ll, int nodenum ) {
 }
 
 void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
+	cmCheck_t	*check = &cmg.checks[Sys_JobThreadIndex()];
 	int			i, k;
 	int			leafnum;
 	int			brushnum;
@@ -102,10 +103,10 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cmg.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cmg.brushes[brushnum];
-		if ( b->checkcount == cmg.checkcount ) {
+		if ( check->brushes[brushnum] == check->count ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cmg.checkcount;
+		check->brushes[brushnum] = check->count;
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -175,7 +176,7 @@ int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *boxList, int list
 	//rwwRMG - changed to boxList to not conflict with list type
 	leafList_t	ll;
 
-	cmg.checkcount++;
+	cmg.checks[Sys_JobThreadIndex()].count++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
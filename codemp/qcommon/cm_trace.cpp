@@ -23,6 +23,16 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "cm_local.h"
 
+// The packed brush kernels have to match the scalar plane tests bit for bit,
+// so they are only built where the scalar float math is plain SSE that the
+// compiler won't contract into fused multiply-adds.
+#if ( defined(__x86_64__) || defined(_M_X64) ) && !defined(__FMA__)
+	#define CM_SIMD_SSE
+	#include <xmmintrin.h>
+#endif
+
+static qboolean cm_packedBrushes = qtrue;	// tracefuzz turns it off to compare
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -116,6 +126,111 @@ float CM_DistanceFromLineSquared(vec3_t p, vec3_t lp1, vec3_t lp2, vec3_t dir) {
 }
 
 
+/*
+===============================================================================
+
+PACKED BRUSH SIDES
+
+The side planes of every map brush are also stored BRUSH_PLANE_LANES at a
+time by CMod_PackBrushSides.  The kernels below compute the plane distances
+for a whole block at once, in the same order of operations as DotProduct,
+and fall back to the scalar code only for the few planes a trace crosses.
+
+===============================================================================
+*/
+
+#ifdef CM_SIMD_SSE
+static QINLINE __m128 CM_SelectPS( __m128 mask, __m128 a, __m128 b ) {
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+static QINLINE __m128 CM_DotPS( __m128 x, __m128 y, __m128 z, __m128 nx, __m128 ny, __m128 nz ) {
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, nx ), _mm_mul_ps( y, ny ) ), _mm_mul_ps( z, nz ) );
+}
+
+/*
+================
+CM_BoxOutsideBrush_SSE
+
+Returns true if the position test box or capsule is completely in front of
+one of the non-axial sides of the brush
+================
+*/
+static bool CM_BoxOutsideBrush_SSE( const traceWork_t *tw, const cbrush_t *brush ) {
+	const cbrushplanes_t	*p;
+	const __m128	zero = _mm_setzero_ps();
+	const __m128	sx = _mm_set1_ps( tw->start[0] );
+	const __m128	sy = _mm_set1_ps( tw->start[1] );
+	const __m128	sz = _mm_set1_ps( tw->start[2] );
+	__m128			nx, ny, nz, dist, d1;
+	int				block, numBlocks, skip;
+
+	numBlocks = ( brush->numsides + BRUSH_PLANE_LANES - 1 ) / BRUSH_PLANE_LANES;
+
+	// the first six planes are the axial planes, so we only
+	// need to test the remainder
+	block = 6 / BRUSH_PLANE_LANES;
+	skip = ( 1 << ( 6 % BRUSH_PLANE_LANES ) ) - 1;
+
+	if ( tw->sphere.use ) {
+		const __m128	radius = _mm_set1_ps( tw->sphere.radius );
+		const __m128	ox = _mm_set1_ps( tw->sphere.offset[0] );
+		const __m128	oy = _mm_set1_ps( tw->sphere.offset[1] );
+		const __m128	oz = _mm_set1_ps( tw->sphere.offset[2] );
+		__m128			above, px, py, pz;
+
+		for ( p = brush->planes + block ; block < numBlocks ; block++, p++, skip = 0 ) {
+			nx = _mm_loadu_ps( p->normal[0] );
+			ny = _mm_loadu_ps( p->normal[1] );
+			nz = _mm_loadu_ps( p->normal[2] );
+
+			// adjust the plane distance appropriately for radius
+			dist = _mm_add_ps( _mm_loadu_ps( p->dist ), radius );
+
+			// find the closest point on the capsule to the plane
+			above = _mm_cmpgt_ps( CM_DotPS( nx, ny, nz, ox, oy, oz ), zero );
+			px = CM_SelectPS( above, _mm_sub_ps( sx, ox ), _mm_add_ps( sx, ox ) );
+			py = CM_SelectPS( above, _mm_sub_ps( sy, oy ), _mm_add_ps( sy, oy ) );
+			pz = CM_SelectPS( above, _mm_sub_ps( sz, oz ), _mm_add_ps( sz, oz ) );
+
+			d1 = _mm_sub_ps( CM_DotPS( px, py, pz, nx, ny, nz ), dist );
+			if ( _mm_movemask_ps( _mm_cmpgt_ps( d1, zero ) ) & ~skip ) {
+				return true;
+			}
+		}
+	} else {
+		const __m128	minx = _mm_set1_ps( tw->size[0][0] );
+		const __m128	miny = _mm_set1_ps( tw->size[0][1] );
+		const __m128	minz = _mm_set1_ps( tw->size[0][2] );
+		const __m128	maxx = _mm_set1_ps( tw->size[1][0] );
+		const __m128	maxy = _mm_set1_ps( tw->size[1][1] );
+		const __m128	maxz = _mm_set1_ps( tw->size[1][2] );
+		__m128			ox, oy, oz;
+
+		for ( p = brush->planes + block ; block < numBlocks ; block++, p++, skip = 0 ) {
+			nx = _mm_loadu_ps( p->normal[0] );
+			ny = _mm_loadu_ps( p->normal[1] );
+			nz = _mm_loadu_ps( p->normal[2] );
+
+			// tw->offsets[signbits], the corner furthest behind the plane
+			ox = CM_SelectPS( _mm_cmplt_ps( nx, zero ), maxx, minx );
+			oy = CM_SelectPS( _mm_cmplt_ps( ny, zero ), maxy, miny );
+			oz = CM_SelectPS( _mm_cmplt_ps( nz, zero ), maxz, minz );
+
+			// adjust the plane distance appropriately for mins/maxs
+			dist = _mm_sub_ps( _mm_loadu_ps( p->dist ), CM_DotPS( ox, oy, oz, nx, ny, nz ) );
+
+			d1 = _mm_sub_ps( CM_DotPS( sx, sy, sz, nx, ny, nz ), dist );
+			if ( _mm_movemask_ps( _mm_cmpgt_ps( d1, zero ) ) & ~skip ) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+#endif
+
 /*
 ===============================================================================
 
@@ -153,6 +268,13 @@ void CM_TestBoxInBrush( traceWork_t *tw, trace_t &trace, cbrush_t *brush ) {
 		return;
 	}
 
+#ifdef CM_SIMD_SSE
+	if ( brush->planes && cm_packedBrushes ) {
+		if ( CM_BoxOutsideBrush_SSE( tw, brush ) ) {
+			return;
+		}
+	} else
+#endif
    if ( tw->sphere.use ) {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
@@ -211,6 +333,8 @@ CM_TestInLeaf
 */
 void CM_TestInLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *local )
 {
+	cmCheck_t	*check = &local->checks[tw->thread];
+	int			surfnum;
 	int			k;
 	int			brushnum;
 	cbrush_t	*b;
@@ -220,10 +344,10 @@ void CM_TestInLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *l
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = local->leafbrushes[leaf->firstLeafBrush+k];
 		b = &local->brushes[brushnum];
-		if (b->checkcount == local->checkcount) {
+		if ( check->brushes[brushnum] == check->count ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = local->checkcount;
+		check->brushes[brushnum] = check->count;
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -242,14 +366,15 @@ void CM_TestInLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *l
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = local->surfaces[ local->leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = local->leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = local->surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == local->checkcount ) {
+			if ( check->surfaces[surfnum] == check->count ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = local->checkcount;
+			check->surfaces[surfnum] = check->count;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -399,12 +524,12 @@ void CM_PositionTest( traceWork_t *tw, trace_t &trace ) {
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
 
-	cmg.checkcount++;
+	cmg.checks[tw->thread].count++;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
 
-	cmg.checkcount++;
+	cmg.checks[tw->thread].count++;
 
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
@@ -433,7 +558,7 @@ CM_TraceThroughPatch
 void CM_TraceThroughPatch( traceWork_t *tw, trace_t &trace, cPatch_t *patch ) {
 	float		oldFrac;
 
-	c_patch_traces++;
+	cm_stats[tw->thread].patchTraces++;
 
 	oldFrac = trace.fraction;
 
@@ -445,6 +570,57 @@ void CM_TraceThroughPatch( traceWork_t *tw, trace_t &trace, cPatch_t *patch ) {
 	}
 }
 
+/*
+================
+CM_CrossPlane
+
+Moves the enter or leave fraction for a plane the trace crosses
+================
+*/
+static QINLINE void CM_CrossPlane(traceWork_t *tw, cbrushside_t *side, float d1, float d2)
+{
+	float			f;
+	cplane_t		*plane = side->plane;
+
+	// crosses face
+	if (d1 > d2)
+	{	// enter
+		f = (d1 - SURFACE_CLIP_EPSILON);
+		if ( f < 0.0f )
+		{
+			f = 0.0f;
+			if (f > tw->enterFrac)
+			{
+				tw->enterFrac = f;
+				tw->clipplane = plane;
+				tw->leadside = side;
+			}
+		}
+		else if (f > tw->enterFrac * (d1 - d2) )
+		{
+			tw->enterFrac = f / (d1 - d2);
+			tw->clipplane = plane;
+			tw->leadside = side;
+		}
+	}
+	else
+	{	// leave
+		f = (d1 + SURFACE_CLIP_EPSILON);
+		if ( f < (d1 - d2) )
+		{
+			f = 1.0f;
+			if (f < tw->leaveFrac)
+			{
+				tw->leaveFrac = f;
+			}
+		}
+		else if (f > tw->leaveFrac * (d1 - d2) )
+		{
+			tw->leaveFrac = f / (d1 - d2);
+		}
+	}
+}
+
 /*
 ================
 CM_PlaneCollision
@@ -455,7 +631,7 @@ CM_PlaneCollision
 
 bool CM_PlaneCollision(traceWork_t *tw, cbrushside_t *side)
 {
-	float			dist, f;
+	float			dist;
 	float			d1, d2;
 
 	cplane_t		*plane = side->plane;
@@ -488,45 +664,108 @@ bool CM_PlaneCollision(traceWork_t *tw, cbrushside_t *side)
 	{
 		return(true);
 	}
-	// crosses face
-	if (d1 > d2)
-	{	// enter
-		f = (d1 - SURFACE_CLIP_EPSILON);
-		if ( f < 0.0f )
+
+	CM_CrossPlane(tw, side, d1, d2);
+	return(true);
+}
+
+#ifdef CM_SIMD_SSE
+/*
+================
+CM_TraceThroughBrushSides_SSE
+
+CM_PlaneCollision for all the packed sides of a brush
+  Returns false for a quick getout
+================
+*/
+static bool CM_TraceThroughBrushSides_SSE( traceWork_t *tw, const cbrush_t *brush )
+{
+	const cbrushplanes_t	*p = brush->planes;
+	const __m128	zero = _mm_setzero_ps();
+	const __m128	epsilon = _mm_set1_ps( SURFACE_CLIP_EPSILON );
+	const __m128	sx = _mm_set1_ps( tw->start[0] );
+	const __m128	sy = _mm_set1_ps( tw->start[1] );
+	const __m128	sz = _mm_set1_ps( tw->start[2] );
+	const __m128	ex = _mm_set1_ps( tw->end[0] );
+	const __m128	ey = _mm_set1_ps( tw->end[1] );
+	const __m128	ez = _mm_set1_ps( tw->end[2] );
+	const __m128	minx = _mm_set1_ps( tw->size[0][0] );
+	const __m128	miny = _mm_set1_ps( tw->size[0][1] );
+	const __m128	minz = _mm_set1_ps( tw->size[0][2] );
+	const __m128	maxx = _mm_set1_ps( tw->size[1][0] );
+	const __m128	maxy = _mm_set1_ps( tw->size[1][1] );
+	const __m128	maxz = _mm_set1_ps( tw->size[1][2] );
+	__m128			nx, ny, nz, ox, oy, oz, dist, d1, d2, out1, out2;
+	float			d1s[BRUSH_PLANE_LANES], d2s[BRUSH_PLANE_LANES];
+	int				i, lane, cross, startout, getout;
+
+	startout = getout = 0;
+	for ( i = 0 ; i < brush->numsides ; i += BRUSH_PLANE_LANES, p++ )
+	{
+		nx = _mm_loadu_ps( p->normal[0] );
+		ny = _mm_loadu_ps( p->normal[1] );
+		nz = _mm_loadu_ps( p->normal[2] );
+
+		// tw->offsets[signbits], the corner furthest behind the plane
+		ox = CM_SelectPS( _mm_cmplt_ps( nx, zero ), maxx, minx );
+		oy = CM_SelectPS( _mm_cmplt_ps( ny, zero ), maxy, miny );
+		oz = CM_SelectPS( _mm_cmplt_ps( nz, zero ), maxz, minz );
+
+		// adjust the plane distance appropriately for mins/maxs
+		dist = _mm_sub_ps( _mm_loadu_ps( p->dist ), CM_DotPS( ox, oy, oz, nx, ny, nz ) );
+
+		d1 = _mm_sub_ps( CM_DotPS( sx, sy, sz, nx, ny, nz ), dist );
+		d2 = _mm_sub_ps( CM_DotPS( ex, ey, ez, nx, ny, nz ), dist );
+
+		out1 = _mm_cmpgt_ps( d1, zero );
+		out2 = _mm_cmpgt_ps( d2, zero );
+
+		// if completely in front of face, no intersection with the entire brush
+		if ( _mm_movemask_ps( _mm_and_ps( out1, _mm_or_ps( _mm_cmpge_ps( d2, epsilon ), _mm_cmpge_ps( d2, d1 ) ) ) ) )
 		{
-			f = 0.0f;
-			if (f > tw->enterFrac)
-			{
-				tw->enterFrac = f;
-				tw->clipplane = plane;
-				tw->leadside = side;
-			}
+			return(false);
 		}
-		else if (f > tw->enterFrac * (d1 - d2) )
+
+		startout |= _mm_movemask_ps( out1 );
+		getout |= _mm_movemask_ps( out2 );
+
+		// only the planes that are crossed can move the enter and leave fractions,
+		// padding lanes past numsides never are
+		cross = ~_mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( d1, zero ), _mm_cmple_ps( d2, zero ) ) );
+		if ( brush->numsides - i < BRUSH_PLANE_LANES )
 		{
-			tw->enterFrac = f / (d1 - d2);
-			tw->clipplane = plane;
-			tw->leadside = side;
+			cross &= ( 1 << ( brush->numsides - i ) ) - 1;
 		}
-	}
-	else
-	{	// leave
-		f = (d1 + SURFACE_CLIP_EPSILON);
-		if ( f < (d1 - d2) )
+		cross &= ( 1 << BRUSH_PLANE_LANES ) - 1;
+		if ( !cross )
 		{
-			f = 1.0f;
-			if (f < tw->leaveFrac)
-			{
-				tw->leaveFrac = f;
-			}
+			continue;
 		}
-		else if (f > tw->leaveFrac * (d1 - d2) )
+
+		_mm_storeu_ps( d1s, d1 );
+		_mm_storeu_ps( d2s, d2 );
+		for ( lane = 0 ; lane < BRUSH_PLANE_LANES ; lane++ )
 		{
-			tw->leaveFrac = f / (d1 - d2);
+			if ( cross & ( 1 << lane ) )
+			{
+				CM_CrossPlane( tw, brush->sides + i + lane, d1s[lane], d2s[lane] );
+			}
 		}
 	}
+
+	if ( startout )
+	{
+		// startpoint is not in solid
+		tw->startout = true;
+	}
+	if ( getout )
+	{
+		// endpoint is not in solid
+		tw->getout = true;
+	}
 	return(true);
 }
+#endif
 
 /*
 ================
@@ -569,6 +808,16 @@ void CM_TraceThroughBrush( traceWork_t *tw, trace_t &trace, cbrush_t *brush, boo
 	// find the latest time the trace crosses a plane towards the interior
 	// and the earliest time the trace crosses a plane towards the exterior
 	//
+#ifdef CM_SIMD_SSE
+	if (brush->planes && cm_packedBrushes)
+	{
+		if(!CM_TraceThroughBrushSides_SSE(tw, brush))
+		{
+			return;
+		}
+	}
+	else
+#endif
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = brush->sides + i;
@@ -649,6 +898,8 @@ CM_TraceThroughLeaf
 ================
 */
 void CM_TraceThroughLeaf( traceWork_t *tw, trace_t &trace, clipMap_t *local, cLeaf_t *leaf ) {
+	cmCheck_t	*check = &local->checks[tw->thread];
+	int			surfnum;
 	int			k;
 	int			brushnum;
 	cbrush_t	*b;
@@ -659,10 +910,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, trace_t &trace, clipMap_t *local, cLe
 		brushnum = local->leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &local->brushes[brushnum];
-		if ( b->checkcount == local->checkcount ) {
+		if ( check->brushes[brushnum] == check->count ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = local->checkcount;
+		check->brushes[brushnum] = check->count;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -682,14 +933,15 @@ void CM_TraceThroughLeaf( traceWork_t *tw, trace_t &trace, clipMap_t *local, cLe
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = local->surfaces[ local->leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = local->leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = local->surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == local->checkcount ) {
+			if ( check->surfaces[surfnum] == check->count ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = local->checkcount;
+			check->surfaces[surfnum] = check->count;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1005,6 +1257,8 @@ CM_TraceToLeaf
 */
 void CM_TraceToLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *local )
 {
+	cmCheck_t	*check = &local->checks[tw->thread];
+	int			surfnum;
 	int			k;
 	int			brushnum;
 	cbrush_t	*b;
@@ -1016,11 +1270,11 @@ void CM_TraceToLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *
 		brushnum = local->leafbrushes[leaf->firstLeafBrush + k];
 
 		b = &local->brushes[brushnum];
-		if ( b->checkcount == local->checkcount )
+		if ( check->brushes[brushnum] == check->count )
 		{
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = local->checkcount;
+		check->brushes[brushnum] = check->count;
 
 		if ( !(b->contents & tw->contents) )
 		{
@@ -1041,14 +1295,15 @@ void CM_TraceToLeaf( traceWork_t *tw, trace_t &trace, cLeaf_t *leaf, clipMap_t *
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = local->surfaces[ local->leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = local->leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = local->surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == local->checkcount ) {
+			if ( check->surfaces[surfnum] == check->count ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = local->checkcount;
+			check->surfaces[surfnum] = check->count;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1225,12 +1480,11 @@ void CM_Trace( trace_t *trace, const vec3_t start, const vec3_t end,
 
 	cmod = CM_ClipHandleToModel( model, &local );
 
-	local->checkcount++;		// for multi-check avoidance
-
-	c_traces++;				// for statistics, may be zeroed
-
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof(tw) );
+	tw.thread = Sys_JobThreadIndex();
+	cm_stats[tw.thread].traces++;		// for statistics, may be zeroed
+	local->checks[tw.thread].count++;		// for multi-check avoidance
 	memset(trace, 0, sizeof(*trace));
 	trace->fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
@@ -1618,3 +1872,263 @@ bool CM_CullWorldBox (const cplane_t *frustum, const vec3pair_t bounds)
 
 	return(CM_CullBox(frustum, transformed));
 }
+
+/*
+===============================================================================
+
+TRACE FUZZING
+
+===============================================================================
+*/
+
+typedef struct traceFuzz_s {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		angles;
+	int			model;
+	int			capsule;
+	qboolean	box;			// against a CM_TempBoxModel made by the tracing thread
+	vec3_t		boxMins, boxMaxs;
+	trace_t		result[2];		// scalar, packed or serial, threaded
+} traceFuzz_t;
+
+typedef struct traceFuzzJob_s {
+	traceFuzz_t	*traces;
+	int			pass;
+} traceFuzzJob_t;
+
+#define	TRACEFUZZ_TRACES	50000
+#define	TRACESTRESS_ROUNDS	4
+
+static bool CM_TracesMatch( const trace_t *a, const trace_t *b ) {
+	return a->allsolid == b->allsolid
+		&& a->startsolid == b->startsolid
+		&& a->fraction == b->fraction
+		&& VectorCompare( a->endpos, b->endpos )
+		&& VectorCompare( a->plane.normal, b->plane.normal )
+		&& a->plane.dist == b->plane.dist
+		&& a->plane.type == b->plane.type
+		&& a->plane.signbits == b->plane.signbits
+		&& a->surfaceFlags == b->surfaceFlags
+		&& a->contents == b->contents;
+}
+
+/*
+==================
+CM_GenerateFuzzTraces
+
+Random traces aimed through the middle of random brushes of the loaded map
+==================
+*/
+static traceFuzz_t *CM_GenerateFuzzTraces( int count, int seed ) {
+	traceFuzz_t	*traces, *t;
+	cbrush_t	*brush;
+	vec3_t		center;
+	int			i, j, numModels;
+
+	numModels = CM_NumInlineModels();
+
+	traces = (traceFuzz_t *)Z_Malloc( sizeof( traceFuzz_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+		// aim through the middle of a random brush from somewhere nearby
+		brush = &cmg.brushes[( Q_rand( &seed ) & 0x7fffffff ) % cmg.numBrushes];
+		VectorAdd( brush->bounds[0], brush->bounds[1], center );
+		VectorScale( center, 0.5f, center );
+		for ( j = 0 ; j < 3 ; j++ ) {
+			t->start[j] = center[j] + Q_crandom( &seed ) * 256.0f;
+			t->end[j] = center[j] + Q_crandom( &seed ) * 32.0f;
+		}
+
+		switch ( i & 7 ) {
+		case 0:		// position test
+			VectorCopy( t->start, t->end );
+			// fall through
+		case 1:
+		case 2:
+			for ( j = 0 ; j < 3 ; j++ ) {
+				t->mins[j] = -Q_random( &seed ) * 48.0f;
+				t->maxs[j] = Q_random( &seed ) * 48.0f;
+			}
+			break;
+		case 3:		// capsule
+			t->capsule = 1;
+			// fall through
+		case 4:
+			VectorSet( t->mins, -15, -15, -24 );
+			VectorSet( t->maxs, 15, 15, 40 );
+			break;
+		default:	// line
+			break;
+		}
+
+		// some go through rotated brush models or an entity sized box instead of the world
+		if ( numModels > 1 && ( i % 5 ) == 4 ) {
+			t->model = 1 + ( Q_rand( &seed ) & 0x7fffffff ) % ( numModels - 1 );
+			t->angles[YAW] = Q_random( &seed ) * 360.0f;
+		} else if ( ( i % 5 ) == 3 ) {
+			t->box = qtrue;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				t->boxMins[j] = center[j] - 8.0f - Q_random( &seed ) * 56.0f;
+				t->boxMaxs[j] = center[j] + 8.0f + Q_random( &seed ) * 56.0f;
+			}
+		}
+	}
+
+	return traces;
+}
+
+static void CM_RunFuzzTrace( traceFuzz_t *t, trace_t *result ) {
+	if ( t->box ) {
+		CM_TransformedBoxTrace( result, t->start, t->end, t->mins, t->maxs,
+			CM_TempBoxModel( t->boxMins, t->boxMaxs, qfalse ), -1, vec3_origin, vec3_origin, t->capsule );
+	} else if ( t->model ) {
+		CM_TransformedBoxTrace( result, t->start, t->end, t->mins, t->maxs,
+			CM_InlineModel( t->model ), -1, vec3_origin, t->angles, t->capsule );
+	} else {
+		CM_BoxTrace( result, t->start, t->end, t->mins, t->maxs, 0, -1, t->capsule );
+	}
+}
+
+static void CM_TraceFuzzJob( void *data, int index ) {
+	traceFuzzJob_t	*job = (traceFuzzJob_t *)data;
+	traceFuzz_t		*t = &job->traces[index];
+
+	CM_RunFuzzTrace( t, &t->result[job->pass] );
+}
+
+static int CM_CompareFuzzTraces( const traceFuzz_t *traces, int count ) {
+	const traceFuzz_t	*t;
+	int					i, differ;
+
+	differ = 0;
+	for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+		if ( CM_TracesMatch( &t->result[0], &t->result[1] ) ) {
+			continue;
+		}
+		if ( differ++ < 8 ) {
+			Com_Printf( S_COLOR_RED "trace %i (%.3f %.3f %.3f) to (%.3f %.3f %.3f): fraction %f / %f\n", i,
+				t->start[0], t->start[1], t->start[2], t->end[0], t->end[1], t->end[2],
+				t->result[0].fraction, t->result[1].fraction );
+		}
+	}
+
+	return differ;
+}
+
+/*
+==================
+CM_TraceFuzz_f
+
+tracefuzz [count]
+
+Runs random traces aimed at the brushes of the loaded map through the scalar
+plane tests and the packed kernels and reports any trace that comes out
+differently, along with the time each took.
+==================
+*/
+void CM_TraceFuzz_f( void ) {
+#ifdef CM_SIMD_SSE
+	traceFuzz_t	*traces, *t;
+	int			count, i, pass, start, msec[2], differ;
+
+	if ( !cmg.numNodes || !cmg.numBrushes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	count = TRACEFUZZ_TRACES;
+	if ( Cmd_Argc() > 1 ) {
+		count = Com_Clampi( 1, 10000000, atoi( Cmd_Argv( 1 ) ) );
+	}
+
+	traces = CM_GenerateFuzzTraces( count, 0x7ace );
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		cm_packedBrushes = (qboolean)pass;
+		start = Sys_Milliseconds();
+		for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+			CM_RunFuzzTrace( t, &t->result[pass] );
+		}
+		msec[pass] = Sys_Milliseconds() - start;
+	}
+	cm_packedBrushes = qtrue;
+
+	differ = CM_CompareFuzzTraces( traces, count );
+
+	Com_Printf( "%i traces, scalar %i msec, packed %i msec\n", count, msec[0], msec[1] );
+	if ( differ ) {
+		Com_Printf( S_COLOR_RED "%i traces differ\n", differ );
+	} else {
+		Com_Printf( "all traces match\n" );
+	}
+
+	Z_Free( traces );
+#else
+	Com_Printf( "The packed brush kernels aren't built for this platform.\n" );
+#endif
+}
+
+/*
+==================
+CM_TraceStress_f
+
+tracestress [threads] [count]
+
+Runs the same random traces serially on the main thread and then spread over
+the job threads a few times over, and reports any trace whose threaded
+result differs from the serial one.
+==================
+*/
+void CM_TraceStress_f( void ) {
+	traceFuzzJob_t	job;
+	traceFuzz_t		*t;
+	int				numThreads, count, i, round, start, serialMsec, threadMsec, differ;
+
+	if ( !cmg.numNodes || !cmg.numBrushes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	numThreads = Sys_CPUCount();
+	if ( Cmd_Argc() > 1 ) {
+		numThreads = Com_Clampi( 1, MAX_JOB_THREADS, atoi( Cmd_Argv( 1 ) ) );
+	}
+	count = TRACEFUZZ_TRACES;
+	if ( Cmd_Argc() > 2 ) {
+		count = Com_Clampi( 1, 10000000, atoi( Cmd_Argv( 2 ) ) );
+	}
+
+	CM_SetupThreads( numThreads );
+
+	job.traces = CM_GenerateFuzzTraces( count, 0x57e5 );
+
+	start = Sys_Milliseconds();
+	for ( i = 0, t = job.traces ; i < count ; i++, t++ ) {
+		CM_RunFuzzTrace( t, &t->result[0] );
+	}
+	serialMsec = Sys_Milliseconds() - start;
+
+	// every round hands the traces to the threads in a different interleaving
+	differ = 0;
+	threadMsec = 0;
+	job.pass = 1;
+	for ( round = 0 ; round < TRACESTRESS_ROUNDS ; round++ ) {
+		for ( i = 0, t = job.traces ; i < count ; i++, t++ ) {
+			Com_Memset( &t->result[1], 0, sizeof( t->result[1] ) );
+		}
+		start = Sys_Milliseconds();
+		Sys_ParallelFor( numThreads, count, CM_TraceFuzzJob, &job );
+		threadMsec += Sys_Milliseconds() - start;
+		differ += CM_CompareFuzzTraces( job.traces, count );
+	}
+
+	Com_Printf( "%i traces, serial %i msec, %i threads %i msec\n", count, serialMsec,
+		numThreads, threadMsec / TRACESTRESS_ROUNDS );
+	if ( differ ) {
+		Com_Printf( S_COLOR_RED "%i threaded traces differ\n", differ );
+	} else {
+		Com_Printf( "all traces match\n" );
+	}
+
+	Z_Free( job.traces );
+}
@@ -1211,6 +1211,10 @@ void Com_Init( char *commandLine ) {
 #ifndef FINAL_BUILD
 		Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
 #endif
+		Cmd_AddCommand ("huffbench", MSG_HuffmanBenchmark_f, "Times the message Huffman coders" );
+		Cmd_AddCommand ("msgbench", MSG_Benchmark_f, "Times delta entity and playerstate encoding" );
+		Cmd_AddCommand ("tracefuzz", CM_TraceFuzz_f, "Compares packed brush traces against the scalar plane tests on the loaded map" );
+		Cmd_AddCommand ("tracestress", CM_TraceStress_f, "Compares traces run on the job threads against serial traces on the loaded map" );
 		Cmd_AddCommand ("writeconfig", Com_WriteConfig_f, "Write the configuration to file" );
 		Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 
@@ -1651,15 +1655,11 @@ void Com_Frame( void ) {
 		//
 		if ( com_showtrace->integer ) {
 
-			extern	int c_traces, c_brush_traces, c_patch_traces;
-			extern	int	c_pointcontents;
+			int traces, brushTraces, patchTraces, pointContents;
 
-			Com_Printf ("%4i traces  (%ib %ip) %4i points\n", c_traces,
-				c_brush_traces, c_patch_traces, c_pointcontents);
-			c_traces = 0;
-			c_brush_traces = 0;
-			c_patch_traces = 0;
-			c_pointcontents = 0;
+			CM_TraceStats( &traces, &brushTraces, &patchTraces, &pointContents );
+			Com_Printf ("%4i traces  (%ib %ip) %4i points\n", traces,
+				brushTraces, patchTraces, pointContents);
 		}
 
 		if ( com_affinity->modified )
@@ -1710,6 +1710,8 @@ void Com_Shutdown (void)
 	}
 
 	MSG_shutdownHuffman();
+
+	Sys_ShutdownJobs();
 /*
 	// Only used for testing changes to huffman frequency table when tuning.
 	{
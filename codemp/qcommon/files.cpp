@@ -39,6 +39,17 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #endif
 #include <minizip/unzip.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #if defined(_WIN32)
 #include <windows.h>
 #endif
@@ -229,6 +240,13 @@ typedef struct searchpath_s {
 	directory_t	*dir;
 } searchpath_t;
 
+// every file of every pak in one hash, see FS_BuildFileIndex
+typedef struct fileIndexEntry_s {
+	fileInPack_t				*file;
+	searchpath_t				*search;	// the pak holding it
+	struct fileIndexEntry_s		*next;		// in search path order
+} fileIndexEntry_t;
+
 static char		fs_gamedir[MAX_OSPATH];	// this will be a single file name with no separators
 static cvar_t		*fs_debug;
 static cvar_t		*fs_homepath;
@@ -246,9 +264,21 @@ static cvar_t		*fs_gamedirvar;
 static cvar_t		*fs_dirbeforepak; //rww - when building search path, keep directories at top and insert pk3's under them
 static cvar_t		*fs_forcegame;
 static searchpath_t	*fs_searchpaths;
+static fileIndexEntry_t	**fs_fileIndex;
+static int			fs_fileIndexSize;		// power of 2
+static fileIndexEntry_t	*fs_fileIndexEntries;
+
+// full OS paths of loose files that weren't there when we last looked
+#define	MAX_DIR_MISSES		16384
+static std::unordered_set<std::string>	fs_dirMisses;
 static int			fs_readCount;			// total bytes read
 static int			fs_loadCount;			// total files read
 static int			fs_packFiles = 0;		// total number of files in packs
+static int			fs_lookupCount;			// FS_FOpenFileRead calls
+static int			fs_lookupMisses;		// ... that found nothing
+static int			fs_dirProbes;			// fopen attempts on loose directories
+static int			fs_dirProbesSkipped;	// ... answered by the miss cache instead
+static cvar_t		*fs_dirMissCache;
 
 static int			fs_fakeChkSum;
 static int			fs_checksumFeed;
@@ -270,6 +300,8 @@ typedef struct fileHandleData_s {
 	int			zipFilePos;
 	int			zipFileLen;
 	qboolean	zipFile;
+	const pack_t	*zipPack;		// the pk3 a zipFile is read from
+	const searchpath_t	*search;	// where FS_FOpenFileRead found it
 	char		name[MAX_ZPATH];
 } fileHandleData_t;
 
@@ -646,6 +678,7 @@ void FS_CopyFile( char *fromOSPath, char *toOSPath ) {
 		return;
 	}
 
+	FS_FlushDirMisses();
 	f = fopen( toOSPath, "wb" );
 	if ( !f ) {
 		free ( buf );
@@ -819,6 +852,7 @@ fileHandle_t FS_SV_FOpenFileWrite( const char *filename ) {
 	}
 
 	Com_DPrintf( "writing to: %s\n", ospath );
+	FS_FlushDirMisses();
 	fsh[f].handleFiles.file.o = fopen( ospath, "wb" );
 
 	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
@@ -860,6 +894,7 @@ fileHandle_t FS_SV_FOpenFileAppend( const char *filename ) {
 		return 0;
 	}
 
+	FS_FlushDirMisses();
 	fsh[f].handleFiles.file.o = fopen( ospath, "ab" );
 	fsh[f].handleSync = qfalse;
 
@@ -980,6 +1015,7 @@ void FS_SV_Rename( const char *from, const char *to, qboolean safe ) {
 		FS_CheckFilenameIsMutable( to_ospath, __func__ );
 	}
 
+	FS_FlushDirMisses();
 	if (rename( from_ospath, to_ospath )) {
 		// Failed, try copying it and deleting the original
 		FS_CopyFile ( from_ospath, to_ospath );
@@ -1010,6 +1046,7 @@ void FS_Rename( const char *from, const char *to ) {
 
 	FS_CheckFilenameIsMutable( to_ospath, __func__ );
 
+	FS_FlushDirMisses();
 	if (rename( from_ospath, to_ospath )) {
 		// Failed, try copying it and deleting the original
 		FS_CopyFile ( from_ospath, to_ospath );
@@ -1087,6 +1124,7 @@ fileHandle_t FS_FOpenFileWrite( const char *filename, qboolean safe ) {
 	// enabling the following line causes a recursive function call loop
 	// when running with +set logfile 1 +set developer 1
 	//Com_DPrintf( "writing to: %s\n", ospath );
+	FS_FlushDirMisses();
 	fsh[f].handleFiles.file.o = fopen( ospath, "wb" );
 
 	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
@@ -1130,6 +1168,7 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 		return 0;
 	}
 
+	FS_FlushDirMisses();
 	fsh[f].handleFiles.file.o = fopen( ospath, "ab" );
 	fsh[f].handleSync = qfalse;
 	if (!fsh[f].handleFiles.file.o) {
@@ -1299,6 +1338,193 @@ bool FS_FileCacheable(const char* const filename)
 	return( strchr(filename, '/') != 0 );
 }
 
+/*
+=============================================================================
+
+GLOBAL FILE INDEX
+
+Looking a name up used to hash it again for every pak in the search path and
+try an fopen in every directory.  All pak contents now go into one table,
+in search path order, and directory misses are remembered until something is
+written through the file system or it restarts.
+
+=============================================================================
+*/
+
+/*
+================
+FS_HashIndexName
+
+Same case and separator folding as FS_FilenameCompare, extension included
+================
+*/
+static unsigned int FS_HashIndexName( const char *fname, int hashSize ) {
+	unsigned int	hash = 2166136261U;
+	int				c;
+
+	while ( ( c = (unsigned char)*fname++ ) != 0 ) {
+		if ( c >= 'A' && c <= 'Z' ) {
+			c += 'a' - 'A';
+		}
+		if ( c == '\\' || c == ':' ) {
+			c = '/';
+		}
+		hash = ( hash ^ c ) * 16777619U;
+	}
+
+	return hash & ( hashSize - 1 );
+}
+
+/*
+================
+FS_FreeFileIndex
+================
+*/
+static void FS_FreeFileIndex( void ) {
+	if ( fs_fileIndex ) {
+		Z_Free( fs_fileIndex );
+	}
+	if ( fs_fileIndexEntries ) {
+		Z_Free( fs_fileIndexEntries );
+	}
+	fs_fileIndex = NULL;
+	fs_fileIndexEntries = NULL;
+	fs_fileIndexSize = 0;
+}
+
+/*
+================
+FS_BuildFileIndex
+
+Called once the search path is final.  The entries for a name end up in the
+order FS_FOpenFileRead used to find them: earlier search paths first and,
+within a pak, the order of its own hash chains
+================
+*/
+static void FS_BuildFileIndex( void ) {
+	searchpath_t		*search;
+	searchpath_t		**paks;
+	fileIndexEntry_t	*entry;
+	fileInPack_t		*file;
+	unsigned int		hash;
+	int					numPaks, numEntries, i, j;
+
+	FS_FreeFileIndex();
+
+	numPaks = 0;
+	numEntries = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			numPaks++;
+			numEntries += search->pack->numfiles;
+		}
+	}
+	if ( !numEntries ) {
+		return;
+	}
+
+	for ( fs_fileIndexSize = 1 ; fs_fileIndexSize < numEntries ; fs_fileIndexSize <<= 1 ) {
+	}
+	fs_fileIndex = (fileIndexEntry_t **)Z_Malloc( fs_fileIndexSize * sizeof( *fs_fileIndex ), TAG_FILESYS, qtrue );
+	fs_fileIndexEntries = (fileIndexEntry_t *)Z_Malloc( numEntries * sizeof( *fs_fileIndexEntries ), TAG_FILESYS, qtrue );
+
+	paks = (searchpath_t **)Z_Malloc( numPaks * sizeof( *paks ), TAG_TEMP_WORKSPACE, qfalse );
+	numPaks = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			paks[numPaks++] = search;
+		}
+	}
+
+	// link from the back so every chain comes out front to back
+	entry = fs_fileIndexEntries;
+	for ( i = numPaks - 1 ; i >= 0 ; i-- ) {
+		for ( j = 0 ; j < paks[i]->pack->numfiles ; j++ ) {
+			file = &paks[i]->pack->buildBuffer[j];
+			if ( !file->name ) {
+				continue;	// the zip directory was cut short
+			}
+			hash = FS_HashIndexName( file->name, fs_fileIndexSize );
+			entry->file = file;
+			entry->search = paks[i];
+			entry->next = fs_fileIndex[hash];
+			fs_fileIndex[hash] = entry;
+			entry++;
+		}
+	}
+
+	Z_Free( paks );
+}
+
+/*
+================
+FS_IndexLookup
+
+Returns the first pak in the search path that has the file and may be used
+on the current (pure) server, or NULL
+================
+*/
+static const fileIndexEntry_t *FS_IndexLookup( const char *filename ) {
+	const fileIndexEntry_t	*entry;
+
+	if ( !fs_fileIndex ) {
+		return NULL;
+	}
+
+	for ( entry = fs_fileIndex[FS_HashIndexName( filename, fs_fileIndexSize )] ; entry ; entry = entry->next ) {
+		if ( FS_FilenameCompare( entry->file->name, filename ) ) {
+			continue;
+		}
+		// disregard if it doesn't match one of the allowed pure pak files
+		if ( !FS_PakIsPure( entry->search->pack ) ) {
+			continue;
+		}
+		return entry;
+	}
+
+	return NULL;
+}
+
+/*
+================
+FS_FlushDirMisses
+
+Anything written through the file system may be a file an earlier lookup
+missed, and anything copied into the game directories while playing shows
+up on the next level load
+================
+*/
+void FS_FlushDirMisses( void ) {
+	fs_dirMisses.clear();
+}
+
+/*
+================
+FS_DirMissCached
+================
+*/
+static qboolean FS_DirMissCached( const char *ospath ) {
+	if ( !fs_dirMissCache || !fs_dirMissCache->integer ) {
+		return qfalse;
+	}
+	return fs_dirMisses.count( ospath ) ? qtrue : qfalse;
+}
+
+/*
+================
+FS_CacheDirMiss
+================
+*/
+static void FS_CacheDirMiss( const char *ospath ) {
+	if ( !fs_dirMissCache || !fs_dirMissCache->integer ) {
+		return;
+	}
+	if ( fs_dirMisses.size() >= MAX_DIR_MISSES ) {
+		fs_dirMisses.clear();
+	}
+	fs_dirMisses.insert( ospath );
+}
+
 /*
 ===========
 FS_FOpenFileRead
@@ -1317,14 +1543,12 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 	pack_t			*pak;
 	fileInPack_t	*pakFile;
 	directory_t		*dir;
-	long			hash;
+	const fileIndexEntry_t	*indexed;
 	//unz_s			*zfi;
 	//void			*temp;
 	int				l;
 	bool			isUserConfig = false;
 
-	hash = 0;
-
 	FS_AssertInitialised();
 
 	if ( file == NULL ) {
@@ -1357,6 +1581,8 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 
 	isUserConfig = !Q_stricmp( filename, "autoexec.cfg" ) || !Q_stricmp( filename, Q3CONFIG_CFG );
 
+	fs_lookupCount++;
+
 	//
 	// search through the path, one element at a time
 	//
@@ -1375,133 +1601,124 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 	{
 		bFasterToReOpenUsingNewLocalFile = qfalse;
 
+		// the first pure pak that has it, directories before it in the
+		// search path still get to override it
+		// autoexec.cfg and openjk.cfg can only be loaded outside of pk3 files.
+		indexed = isUserConfig ? NULL : FS_IndexLookup( filename );
+
 		for ( search = fs_searchpaths ; search ; search = search->next ) {
-			//
-			if ( search->pack ) {
-				hash = FS_HashFileName(filename, search->pack->hashSize);
-			}
 			// is the element a pak file?
-			if ( search->pack && search->pack->hashTable[hash] ) {
-				// disregard if it doesn't match one of the allowed pure pak files
-				if ( !FS_PakIsPure(search->pack) ) {
-					continue;
-				}
-
-				// autoexec.cfg and openjk.cfg can only be loaded outside of pk3 files.
-				if ( isUserConfig ) {
+			if ( search->pack ) {
+				if ( !indexed || search != indexed->search ) {
 					continue;
 				}
 
-				// look through all the pak file elements
 				pak = search->pack;
-				pakFile = pak->hashTable[hash];
-				do {
-					// case and separator insensitive comparisons
-					if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-						// found it!
+				pakFile = indexed->file;
 
-						// mark the pak as having been referenced and mark specifics on cgame and ui
-						// shaders, txt, arena files  by themselves do not count as a reference as
-						// these are loaded from all pk3s
-						// from every pk3 file..
+				// found it!
 
-						// The x86.dll suffixes are needed in order for sv_pure to continue to
-						// work on non-x86/windows systems...
+				// mark the pak as having been referenced and mark specifics on cgame and ui
+				// shaders, txt, arena files  by themselves do not count as a reference as
+				// these are loaded from all pk3s
+				// from every pk3 file..
 
-						// reference lists
-						if ( !pak->noref ) {
-							// JK2MV automatically references pk3's in three cases:
-							// 1. A .bsp file is loaded from it (and thus it is expected to be a map)
-							// 2. cgame.qvm or ui.qvm is loaded from it (expected to be a clientside)
-							// 3. pk3 is located in fs_game != base (standard jk2 behavior)
-							// All others need to be referenced manually by the use of reflists.
+				// The x86.dll suffixes are needed in order for sv_pure to continue to
+				// work on non-x86/windows systems...
 
-							if (!Q_stricmp(get_filename_ext(filename), "bsp")) {
-								pak->referenced |= FS_GENERAL_REF;
-							}
+				// reference lists
+				if ( !pak->noref ) {
+					// JK2MV automatically references pk3's in three cases:
+					// 1. A .bsp file is loaded from it (and thus it is expected to be a map)
+					// 2. cgame.qvm or ui.qvm is loaded from it (expected to be a clientside)
+					// 3. pk3 is located in fs_game != base (standard jk2 behavior)
+					// All others need to be referenced manually by the use of reflists.
 
-							if (!Q_stricmp(filename, "vm/cgame.qvm") || !Q_stricmp( filename, "cgamex86.dll" )) {
-								pak->referenced |= FS_CGAME_REF;
-							}
+					if (!Q_stricmp(get_filename_ext(filename), "bsp")) {
+						pak->referenced |= FS_GENERAL_REF;
+					}
 
-							if (!Q_stricmp(filename, "vm/ui.qvm") || !Q_stricmp( filename, "uix86.dll" )) {
-								pak->referenced |= FS_UI_REF;
-							}
+					if (!Q_stricmp(filename, "vm/cgame.qvm") || !Q_stricmp( filename, "cgamex86.dll" )) {
+						pak->referenced |= FS_CGAME_REF;
+					}
 
-							// OLD Ref:
-							/*
-							l = strlen( filename );
-							if ( !(pak->referenced & FS_GENERAL_REF)) {
-								if( !FS_IsExt(filename, ".shader", l) &&
-								    !FS_IsExt(filename, ".txt", l) &&
-								    !FS_IsExt(filename, ".str", l) &&
-								    !FS_IsExt(filename, ".cfg", l) &&
-								    !FS_IsExt(filename, ".config", l) &&
-								    !FS_IsExt(filename, ".bot", l) &&
-								    !FS_IsExt(filename, ".arena", l) &&
-								    !FS_IsExt(filename, ".menu", l) &&
-								    !FS_IsExt(filename, ".fcf", l) &&
-								    Q_stricmp(filename, "jampgamex86.dll") != 0 &&
-								    //Q_stricmp(filename, "vm/qagame.qvm") != 0 &&
-								    !strstr(filename, "levelshots"))
-								{
-									pak->referenced |= FS_GENERAL_REF;
-								}
-							}
-							*/
-						}
+					if (!Q_stricmp(filename, "vm/ui.qvm") || !Q_stricmp( filename, "uix86.dll" )) {
+						pak->referenced |= FS_UI_REF;
+					}
 
-						if ( uniqueFILE ) {
-							// open a new file on the pakfile
-							fsh[*file].handleFiles.file.z = unzOpen (pak->pakFilename);
-							if (fsh[*file].handleFiles.file.z == NULL) {
-								Com_Error (ERR_FATAL, "Couldn't open %s", pak->pakFilename);
-							}
-						} else {
-							fsh[*file].handleFiles.file.z = pak->handle;
+					// OLD Ref:
+					/*
+					l = strlen( filename );
+					if ( !(pak->referenced & FS_GENERAL_REF)) {
+						if( !FS_IsExt(filename, ".shader", l) &&
+						    !FS_IsExt(filename, ".txt", l) &&
+						    !FS_IsExt(filename, ".str", l) &&
+						    !FS_IsExt(filename, ".cfg", l) &&
+						    !FS_IsExt(filename, ".config", l) &&
+						    !FS_IsExt(filename, ".bot", l) &&
+						    !FS_IsExt(filename, ".arena", l) &&
+						    !FS_IsExt(filename, ".menu", l) &&
+						    !FS_IsExt(filename, ".fcf", l) &&
+						    Q_stricmp(filename, "jampgamex86.dll") != 0 &&
+						    //Q_stricmp(filename, "vm/qagame.qvm") != 0 &&
+						    !strstr(filename, "levelshots"))
+						{
+							pak->referenced |= FS_GENERAL_REF;
 						}
-						Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-						fsh[*file].zipFile = qtrue;
+					}
+					*/
+				}
+
+				if ( uniqueFILE ) {
+					// open a new file on the pakfile
+					fsh[*file].handleFiles.file.z = unzOpen (pak->pakFilename);
+					if (fsh[*file].handleFiles.file.z == NULL) {
+						Com_Error (ERR_FATAL, "Couldn't open %s", pak->pakFilename);
+					}
+				} else {
+					fsh[*file].handleFiles.file.z = pak->handle;
+				}
+				Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
+				fsh[*file].zipFile = qtrue;
 
-						// set the file position in the zip file (also sets the current file info)
-						unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
+				// set the file position in the zip file (also sets the current file info)
+				unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
 
-						// open the file in the zip
-						unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
+				// open the file in the zip
+				unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
 
 #if 0
-						zfi = (unz_s *)fsh[*file].handleFiles.file.z;
-						// in case the file was new
-						temp = zfi->filestream;
-						// set the file position in the zip file (also sets the current file info)
-						unzSetOffset(pak->handle, pakFile->pos);
-						// copy the file info into the unzip structure
-						Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
-						// we copy this back into the structure
-						zfi->filestream = temp;
-						// open the file in the zip
-						unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
+				zfi = (unz_s *)fsh[*file].handleFiles.file.z;
+				// in case the file was new
+				temp = zfi->filestream;
+				// set the file position in the zip file (also sets the current file info)
+				unzSetOffset(pak->handle, pakFile->pos);
+				// copy the file info into the unzip structure
+				Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
+				// we copy this back into the structure
+				zfi->filestream = temp;
+				// open the file in the zip
+				unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
 #endif
-						fsh[*file].zipFilePos = pakFile->pos;
-						fsh[*file].zipFileLen = pakFile->len;
+				fsh[*file].zipFilePos = pakFile->pos;
+				fsh[*file].zipFileLen = pakFile->len;
+				fsh[*file].zipPack = pak;
+				fsh[*file].search = search;
 
-						if ( fs_debug->integer ) {
-							Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n",
-								filename, pak->pakFilename );
-						}
+				if ( fs_debug->integer ) {
+					Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n",
+						filename, pak->pakFilename );
+				}
 	#ifndef DEDICATED
 	#ifndef FINAL_BUILD
-						// Check for unprecached files when in game but not in the menus
-						if((cls.state == CA_ACTIVE) && !(Key_GetCatcher( ) & KEYCATCH_UI))
-						{
-							Com_Printf(S_COLOR_YELLOW "WARNING: File %s not precached\n", filename);
-						}
+				// Check for unprecached files when in game but not in the menus
+				if((cls.state == CA_ACTIVE) && !(Key_GetCatcher( ) & KEYCATCH_UI))
+				{
+					Com_Printf(S_COLOR_YELLOW "WARNING: File %s not precached\n", filename);
+				}
 	#endif
 	#endif // DEDICATED
-						return pakFile->len;
-					}
-					pakFile = pakFile->next;
-				} while(pakFile != NULL);
+				return pakFile->len;
 			} else if ( search->dir ) {
 				// check a file in the directory tree
 
@@ -1527,8 +1744,14 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 				dir = search->dir;
 
 				netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
+				if ( FS_DirMissCached( netpath ) ) {
+					fs_dirProbesSkipped++;
+					continue;
+				}
+				fs_dirProbes++;
 				fsh[*file].handleFiles.file.o = fopen (netpath, "rb");
 				if ( !fsh[*file].handleFiles.file.o ) {
+					FS_CacheDirMiss( netpath );
 					continue;
 				}
 
@@ -1558,6 +1781,7 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 #endif
 				Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
 				fsh[*file].zipFile = qfalse;
+				fsh[*file].search = search;
 				if ( fs_debug->integer ) {
 					Com_Printf( "FS_FOpenFileRead: %s (found in '%s%c%s')\n", filename,
 						dir->path, PATH_SEP, dir->gamedir );
@@ -1598,6 +1822,7 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 									bOk = !!CopyFile( netpath, copypath, FALSE );
 								}
 
+								FS_FlushDirMisses();
 								if (bOk)
 								{
 									// clear this handle and setup for re-opening of the new local copy...
@@ -1632,6 +1857,7 @@ long FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean unique
 	}
 	while ( bFasterToReOpenUsingNewLocalFile );
 
+	fs_lookupMisses++;
 	Com_DPrintf ("Can't find %s\n", filename);
 #ifdef FS_MISSING
 	if (missingFiles) {
@@ -1665,6 +1891,55 @@ qboolean FS_FindPureDLL(const char *name)
 	return qfalse;
 }
 
+/*
+=================
+FS_MapFile
+
+Maps a file opened with FS_FOpenFileRead read-only into memory when it is a
+plain file or stored uncompressed in a pk3, so big files can be used in place.
+Returns NULL if it can't be mapped, FS_Read still works on the handle then.
+The mapping outlives the handle and is released with Sys_UnmapFile.
+=================
+*/
+const void *FS_MapFile( fileHandle_t f, sysFileMapping_t *mapping ) {
+	unz_file_info	info;
+	const void		*data;
+	FILE			*pak;
+	long			offset;
+
+	FS_AssertInitialised();
+
+	mapping->base = NULL;
+	mapping->size = 0;
+
+	if ( !f ) {
+		return NULL;
+	}
+
+	if ( !fsh[f].zipFile ) {
+		return Sys_MapFile( fsh[f].handleFiles.file.o, 0, FS_filelength( f ), mapping );
+	}
+
+	// only stored, unencrypted files sit in the pk3 as they are
+	if ( unzGetCurrentFileInfo( fsh[f].handleFiles.file.z, &info, NULL, 0, NULL, 0, NULL, 0 ) != UNZ_OK
+		|| info.compression_method != 0 || ( info.flag & 1 ) || !fsh[f].zipPack ) {
+		return NULL;
+	}
+	offset = (long)unzGetCurrentFileZStreamPos64( fsh[f].handleFiles.file.z );
+	if ( offset <= 0 ) {
+		return NULL;
+	}
+
+	pak = fopen( fsh[f].zipPack->pakFilename, "rb" );
+	if ( !pak ) {
+		return NULL;
+	}
+	data = Sys_MapFile( pak, offset, (long)info.uncompressed_size, mapping );
+	fclose( pak );
+
+	return data;
+}
+
 /*
 =================
 FS_Read
@@ -1939,72 +2214,492 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 }
 
 /*
-============
-FS_ReadFile
+=================================================================================
 
-Filename are relative to the quake search path
-a null buffer will just return the file length without loading
-============
+ASYNC FILE LOADING
+
+FS_PrefetchFiles hands a list of files to a few loader threads that find,
+read and inflate them ahead of time.  FS_ReadFile still does its own lookup
+on the main thread, so references, pure checks and search order are exactly
+what they would be without prefetching, and only takes the prefetched data
+when it came from the same place.  The loaders only read search path and
+pak state, anything that changes it cancels the prefetch first
+
+=================================================================================
 */
-long FS_ReadFile( const char *qpath, void **buffer ) {
-	fileHandle_t	h;
-	byte*			buf;
-	qboolean		isConfig;
-	long				len;
 
-	FS_AssertInitialised();
+#define	MAX_PREFETCH_THREADS	4
+#define	PREFETCH_PAK_HANDLES	4		// open paks each loader keeps around
+
+typedef enum {
+	PREFETCH_QUEUED,
+	PREFETCH_LOADING,
+	PREFETCH_DONE,
+	PREFETCH_FAILED
+} prefetchState_t;
+
+typedef struct prefetchFile_s {
+	std::string			qpath;
+	prefetchState_t		state;
+	const searchpath_t	*search;		// where the loader found it
+	unsigned long		zipFilePos;
+	long				len;
+	time_t				mtime;			// loose files only
+	char				ospath[MAX_OSPATH];
+	byte				*data;			// malloc'd, not zone memory
+} prefetchFile_t;
+
+typedef struct prefetchPak_s {
+	const pack_t		*pak;
+	unzFile				handle;
+} prefetchPak_t;
+
+static cvar_t		*fs_prefetch;
+static cvar_t		*fs_prefetchThreads;
+static cvar_t		*fs_prefetchMemory;
+static std::mutex	fs_prefetchMutex;
+static std::condition_variable	fs_prefetchWake;	// loaders wait for work
+static std::condition_variable	fs_prefetchDone;	// the main thread waits for a file
+static std::vector<std::thread>	fs_prefetchThreadPool;
+static std::deque<prefetchFile_t *>	fs_prefetchQueue;
+static std::unordered_map<std::string, prefetchFile_t *>	fs_prefetchFiles;
+static int			fs_prefetchLoading;
+static size_t		fs_prefetchBytes;	// held by finished files
+static size_t		fs_prefetchBudget;
+static bool			fs_prefetchQuit;
+static int			fs_prefetchHits;
+static int			fs_prefetchWaits;	// hits that still had to wait for a loader
+static int			fs_prefetchMisses;
 
-	if ( !qpath || !qpath[0] ) {
-		Com_Error( ERR_FATAL, "FS_ReadFile with empty name\n" );
-	}
+/*
+=================
+FS_PrefetchLookup
 
-	buf = NULL;	// quiet compiler warning
+FS_FOpenFileRead's search, minus everything with side effects.  Runs on a
+loader thread and opens the file it finds
+=================
+*/
+static qboolean FS_PrefetchLookup( prefetchFile_t *file, FILE **loose ) {
+	const fileIndexEntry_t	*indexed;
+	const searchpath_t		*search;
+	const char				*filename;
+	int						l;
 
-	// if this is a .cfg file and we are playing back a journal, read
-	// it from the journal file
-	if ( strstr( qpath, ".cfg" ) ) {
-		isConfig = qtrue;
-		if ( com_journal && com_journal->integer == 2 ) {
-			int		r;
+	filename = file->qpath.c_str();
+	l = (int)file->qpath.size();
+	indexed = ( !Q_stricmp( filename, "autoexec.cfg" ) || !Q_stricmp( filename, Q3CONFIG_CFG ) ) ? NULL : FS_IndexLookup( filename );
 
-			Com_DPrintf( "Loading %s from journal file.\n", qpath );
-			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
-			if ( r != sizeof( len ) ) {
-				if (buffer != NULL) *buffer = NULL;
-				return -1;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			if ( indexed && search == indexed->search ) {
+				file->search = search;
+				file->zipFilePos = indexed->file->pos;
+				file->len = indexed->file->len;
+				return qtrue;
 			}
-			// if the file didn't exist when the journal was created
-			if (!len) {
-				if (buffer == NULL) {
-					return 1;			// hack for old journal files
+		} else if ( search->dir ) {
+			if ( fs_numServerPaks ) {
+				if ( !FS_IsExt( filename, ".cfg", l ) &&
+					!FS_IsExt( filename, ".fcf", l ) &&
+					!FS_IsExt( filename, ".menu", l ) &&
+					!FS_IsExt( filename, ".game", l ) &&
+					!FS_IsExt( filename, ".dat", l ) &&
+					!FS_IsDemoExt( filename, l ) ) {
+					continue;
 				}
-				*buffer = NULL;
-				return -1;
 			}
-			if (buffer == NULL) {
-				return len;
+
+			// FS_BuildOSPath hands out shared buffers
+			Com_sprintf( file->ospath, sizeof( file->ospath ), "%s/%s/%s", search->dir->path, search->dir->gamedir, filename );
+			FS_ReplaceSeparators( file->ospath );
+			*loose = fopen( file->ospath, "rb" );
+			if ( *loose ) {
+				file->search = search;
+				file->len = FS_fplength( *loose );
+				return qtrue;
 			}
+		}
+	}
 
-			buf = (unsigned char *)Hunk_AllocateTempMemory(len+1);
-			*buffer = buf;
+	return qfalse;
+}
 
-			r = FS_Read( buf, len, com_journalDataFile );
-			if ( r != len ) {
-				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
-			}
+/*
+=================
+FS_PrefetchPakHandle
 
-			fs_loadCount++;
+A loader's own handle on a pak, minizip handles can't be shared
+=================
+*/
+static unzFile FS_PrefetchPakHandle( prefetchPak_t *paks, const pack_t *pak ) {
+	int		i;
 
-			// guarantee that it will have a trailing 0 for string operations
-			buf[len] = 0;
+	for ( i = 0 ; i < PREFETCH_PAK_HANDLES ; i++ ) {
+		if ( paks[i].pak == pak ) {
+			return paks[i].handle;
+		}
+	}
 
-			return len;
+	// replace the oldest one
+	if ( paks[PREFETCH_PAK_HANDLES - 1].handle ) {
+		unzClose( paks[PREFETCH_PAK_HANDLES - 1].handle );
+	}
+	memmove( paks + 1, paks, ( PREFETCH_PAK_HANDLES - 1 ) * sizeof( *paks ) );
+	paks[0].pak = pak;
+	paks[0].handle = unzOpen( pak->pakFilename );
+	return paks[0].handle;
+}
+
+/*
+=================
+FS_PrefetchLoad
+=================
+*/
+static void FS_PrefetchLoad( prefetchFile_t *file, prefetchPak_t *paks ) {
+	FILE		*loose;
+	unzFile		uf;
+	long long	size;
+	qboolean	ok;
+
+	loose = NULL;
+	if ( !FS_PrefetchLookup( file, &loose ) || file->len < 0 ) {
+		if ( loose ) {
+			fclose( loose );
 		}
-	} else {
-		isConfig = qfalse;
+		return;
 	}
 
-	// look for it in the filesystem or pack files
+	file->data = (byte *)malloc( file->len + 1 );
+	if ( !file->data ) {
+		if ( loose ) {
+			fclose( loose );
+		}
+		return;
+	}
+
+	if ( loose ) {
+		ok = (qboolean)( fread( file->data, 1, file->len, loose ) == (size_t)file->len );
+		fclose( loose );
+		ok = (qboolean)( ok && Sys_FileInfo( file->ospath, &size, &file->mtime ) && size == file->len );
+	} else {
+		uf = FS_PrefetchPakHandle( paks, file->search->pack );
+		ok = qfalse;
+		if ( uf && unzSetOffset( uf, file->zipFilePos ) == UNZ_OK && unzOpenCurrentFile( uf ) == UNZ_OK ) {
+			ok = (qboolean)( unzReadCurrentFile( uf, file->data, file->len ) == file->len );
+			if ( unzCloseCurrentFile( uf ) != UNZ_OK ) {
+				ok = qfalse;	// crc mismatch
+			}
+		}
+	}
+
+	if ( !ok ) {
+		free( file->data );
+		file->data = NULL;
+	}
+}
+
+/*
+=================
+FS_PrefetchThread
+=================
+*/
+static void FS_PrefetchThread( void ) {
+	prefetchPak_t	paks[PREFETCH_PAK_HANDLES];
+	prefetchFile_t	*file;
+	int				i;
+
+	memset( paks, 0, sizeof( paks ) );
+
+	std::unique_lock<std::mutex> lock( fs_prefetchMutex );
+	for ( ;; ) {
+		// stop taking work while the main thread hasn't picked up enough
+		fs_prefetchWake.wait( lock, [] { return fs_prefetchQuit || ( !fs_prefetchQueue.empty() && fs_prefetchBytes < fs_prefetchBudget ); } );
+		if ( fs_prefetchQuit ) {
+			break;
+		}
+
+		file = fs_prefetchQueue.front();
+		fs_prefetchQueue.pop_front();
+		file->state = PREFETCH_LOADING;
+		fs_prefetchLoading++;
+		lock.unlock();
+
+		FS_PrefetchLoad( file, paks );
+
+		lock.lock();
+		file->state = file->data ? PREFETCH_DONE : PREFETCH_FAILED;
+		if ( file->data ) {
+			fs_prefetchBytes += file->len;
+		}
+		fs_prefetchLoading--;
+		fs_prefetchDone.notify_all();
+	}
+	lock.unlock();
+
+	for ( i = 0 ; i < PREFETCH_PAK_HANDLES ; i++ ) {
+		if ( paks[i].handle ) {
+			unzClose( paks[i].handle );
+		}
+	}
+}
+
+/*
+=================
+FS_FreePrefetchFile
+
+Call with fs_prefetchMutex held
+=================
+*/
+static void FS_FreePrefetchFile( prefetchFile_t *file ) {
+	if ( file->data ) {
+		fs_prefetchBytes -= file->len;
+		free( file->data );
+	}
+	delete file;
+}
+
+/*
+=================
+FS_CancelPrefetch
+
+Drops everything that was prefetched or still waits to be.  Must be called
+before anything the loaders look at changes
+=================
+*/
+void FS_CancelPrefetch( void ) {
+	std::unique_lock<std::mutex> lock( fs_prefetchMutex );
+
+	fs_prefetchQueue.clear();
+	fs_prefetchDone.wait( lock, [] { return fs_prefetchLoading == 0; } );
+
+	for ( auto &it : fs_prefetchFiles ) {
+		FS_FreePrefetchFile( it.second );
+	}
+	fs_prefetchFiles.clear();
+}
+
+/*
+=================
+FS_ShutdownPrefetch
+
+Also stops the loaders, their pak handles are only good until the pak is freed
+=================
+*/
+static void FS_ShutdownPrefetch( void ) {
+	FS_CancelPrefetch();
+
+	{
+		std::lock_guard<std::mutex> lock( fs_prefetchMutex );
+		fs_prefetchQuit = true;
+	}
+	fs_prefetchWake.notify_all();
+	for ( std::thread &thread : fs_prefetchThreadPool ) {
+		thread.join();
+	}
+	fs_prefetchThreadPool.clear();
+	fs_prefetchQuit = false;
+}
+
+// joins the loaders when the process exits without an FS_Shutdown
+static struct prefetchGuard_s {
+	~prefetchGuard_s() { FS_ShutdownPrefetch(); }
+} fs_prefetchGuard;
+
+/*
+=================
+FS_PrefetchFiles
+
+Starts loading qpaths in the background so a later FS_ReadFile of the same
+names finds them in memory.  Anything left from an earlier list is dropped
+=================
+*/
+void FS_PrefetchFiles( const char **qpaths, int count ) {
+	prefetchFile_t	*file;
+	const char		*qpath;
+	int				i, numThreads;
+
+	FS_AssertInitialised();
+	FS_CancelPrefetch();
+
+	if ( !fs_prefetch->integer || count <= 0 ) {
+		return;
+	}
+
+	numThreads = fs_prefetchThreads->integer;
+	if ( numThreads <= 0 ) {
+		numThreads = Sys_CPUCount() - 1;
+	}
+	numThreads = Com_Clampi( 1, MAX_PREFETCH_THREADS, numThreads );
+	while ( (int)fs_prefetchThreadPool.size() < numThreads ) {
+		fs_prefetchThreadPool.emplace_back( FS_PrefetchThread );
+	}
+
+	std::lock_guard<std::mutex> lock( fs_prefetchMutex );
+	fs_prefetchBudget = (size_t)Com_Clampi( 1, 1024, fs_prefetchMemory->integer ) << 20;
+	for ( i = 0 ; i < count ; i++ ) {
+		qpath = qpaths[i];
+		if ( !qpath || !qpath[0] ) {
+			continue;
+		}
+		if ( qpath[0] == '/' || qpath[0] == '\\' ) {
+			qpath++;
+		}
+		if ( strstr( qpath, ".." ) || strstr( qpath, "::" ) || fs_prefetchFiles.count( qpath ) ) {
+			continue;
+		}
+
+		file = new prefetchFile_t();
+		file->qpath = qpath;
+		file->state = PREFETCH_QUEUED;
+		fs_prefetchFiles[file->qpath] = file;
+		fs_prefetchQueue.push_back( file );
+	}
+	fs_prefetchWake.notify_all();
+}
+
+/*
+=================
+FS_TakePrefetched
+
+The prefetched contents of qpath if there are any and they came from where
+FS_FOpenFileRead just found it as h.  The caller frees them
+=================
+*/
+static byte *FS_TakePrefetched( const char *qpath, fileHandle_t h, long len ) {
+	prefetchFile_t	*file;
+	byte			*data;
+	long long		size;
+	time_t			mtime;
+
+	if ( qpath[0] == '/' || qpath[0] == '\\' ) {
+		qpath++;
+	}
+
+	std::unique_lock<std::mutex> lock( fs_prefetchMutex );
+	if ( fs_prefetchFiles.empty() ) {
+		return NULL;
+	}
+	auto it = fs_prefetchFiles.find( qpath );
+	if ( it == fs_prefetchFiles.end() ) {
+		return NULL;
+	}
+	file = it->second;
+	fs_prefetchFiles.erase( it );
+
+	if ( file->state == PREFETCH_QUEUED ) {
+		// quicker to read it right here
+		fs_prefetchQueue.erase( std::find( fs_prefetchQueue.begin(), fs_prefetchQueue.end(), file ) );
+		fs_prefetchMisses++;
+		delete file;
+		return NULL;
+	}
+	if ( file->state == PREFETCH_LOADING ) {
+		fs_prefetchWaits++;
+		fs_prefetchDone.wait( lock, [file] { return file->state != PREFETCH_LOADING; } );
+	}
+
+	data = file->data;
+	if ( data ) {
+		fs_prefetchBytes -= file->len;
+		file->data = NULL;
+	}
+	lock.unlock();
+	fs_prefetchWake.notify_all();
+
+	if ( data && ( fsh[h].search != file->search || file->len != len ) ) {
+		free( data );
+		data = NULL;
+	}
+	if ( data ) {
+		if ( fsh[h].zipFile ) {
+			if ( (unsigned int)fsh[h].zipFilePos != (unsigned int)file->zipFilePos ) {
+				free( data );
+				data = NULL;
+			}
+		} else if ( !Sys_FileInfo( file->ospath, &size, &mtime ) || size != len || mtime != file->mtime ) {
+			// rewritten since the loader read it
+			free( data );
+			data = NULL;
+		}
+	}
+	delete file;
+
+	if ( data ) {
+		fs_prefetchHits++;
+	} else {
+		fs_prefetchMisses++;
+	}
+	return data;
+}
+
+/*
+============
+FS_ReadFile
+
+Filename are relative to the quake search path
+a null buffer will just return the file length without loading
+============
+*/
+long FS_ReadFile( const char *qpath, void **buffer ) {
+	fileHandle_t	h;
+	byte*			buf;
+	byte*			prefetched;
+	qboolean		isConfig;
+	long				len;
+
+	FS_AssertInitialised();
+
+	if ( !qpath || !qpath[0] ) {
+		Com_Error( ERR_FATAL, "FS_ReadFile with empty name\n" );
+	}
+
+	buf = NULL;	// quiet compiler warning
+
+	// if this is a .cfg file and we are playing back a journal, read
+	// it from the journal file
+	if ( strstr( qpath, ".cfg" ) ) {
+		isConfig = qtrue;
+		if ( com_journal && com_journal->integer == 2 ) {
+			int		r;
+
+			Com_DPrintf( "Loading %s from journal file.\n", qpath );
+			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
+			if ( r != sizeof( len ) ) {
+				if (buffer != NULL) *buffer = NULL;
+				return -1;
+			}
+			// if the file didn't exist when the journal was created
+			if (!len) {
+				if (buffer == NULL) {
+					return 1;			// hack for old journal files
+				}
+				*buffer = NULL;
+				return -1;
+			}
+			if (buffer == NULL) {
+				return len;
+			}
+
+			buf = (unsigned char *)Hunk_AllocateTempMemory(len+1);
+			*buffer = buf;
+
+			r = FS_Read( buf, len, com_journalDataFile );
+			if ( r != len ) {
+				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
+			}
+
+			fs_loadCount++;
+
+			// guarantee that it will have a trailing 0 for string operations
+			buf[len] = 0;
+
+			return len;
+		}
+	} else {
+		isConfig = qfalse;
+	}
+
+	// look for it in the filesystem or pack files
 	len = FS_FOpenFileRead( qpath, &h, qfalse );
 	if ( h == 0 ) {
 		if ( buffer ) {
@@ -2038,7 +2733,13 @@ long FS_ReadFile( const char *qpath, void **buffer ) {
 
 //	Z_Label(buf, qpath);
 
-	FS_Read (buf, len, h);
+	prefetched = FS_TakePrefetched( qpath, h, len );
+	if ( prefetched ) {
+		memcpy( buf, prefetched, len );
+		free( prefetched );
+	} else {
+		FS_Read (buf, len, h);
+	}
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
@@ -2096,66 +2797,288 @@ void FS_WriteFile( const char *qpath, const void *buffer, int size ) {
 }
 
 /*
-==========================================================================
+=================================================================================
 
-ZIP FILE LOADING
+PK3 CENTRAL DIRECTORY CACHE
 
-==========================================================================
+Everything FS_LoadZipFile takes out of a pk3's central directory is kept in
+pk3cache.dat under fs_homepath, keyed by the full path of the pk3 and checked
+against its size, modification time and the crc of its raw central directory
+and end record, since the file crcs in there end up in the pure checksums.
+Unchanged paks are rebuilt from it without walking their central directory.  The file is read at the start of
+FS_Startup and written back at the end if anything changed, in the byte order
+of the machine that wrote it
+
+=================================================================================
 */
 
+#define	PAKCACHE_IDENT		(('C'<<24)+('K'<<16)+('A'<<8)+'P')
+#define	PAKCACHE_VERSION	2
+#define	PAKCACHE_FILENAME	"pk3cache.dat"
+
+typedef struct pakCacheEntry_s {
+	long long					size = -1;
+	long long					mtime = -1;
+	unsigned int				dirCrc = 0;		// see FS_PakDirectoryCRC
+	int							parseUsec = 0;	// what walking the central directory cost
+	int							numfiles = -1;
+	std::vector<unsigned int>	pos;
+	std::vector<unsigned int>	len;
+	std::vector<int>			crcs;			// little endian, non-empty files only
+	std::string					names;			// lower case, each one NUL terminated
+	bool						used = false;	// loaded during this startup
+} pakCacheEntry_t;
+
+static cvar_t		*fs_pakCacheVar;
+static std::unordered_map<std::string, pakCacheEntry_t>	fs_pakCache;
+static bool			fs_pakCacheActive;
+static bool			fs_pakCacheDirty;
+static int			fs_pakCacheHits;
+static int			fs_pakParsed;
+static long long	fs_pakLoadUsec;			// spent in FS_LoadZipFile
+static long long	fs_pakParseUsec;		// what it would have cost without the cache
+
+static long long FS_PakClock( void ) {
+	return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static const char *FS_PakCachePath( void ) {
+	return va( "%s%c%s", fs_homepath->string, PATH_SEP, PAKCACHE_FILENAME );
+}
+
+// a bounds checked cursor over the cache file
+typedef struct pakCacheReader_s {
+	const byte	*cur;
+	const byte	*end;
+} pakCacheReader_t;
+
+static bool FS_PakCacheRead( pakCacheReader_t *reader, void *out, size_t size ) {
+	if ( (size_t)( reader->end - reader->cur ) < size ) {
+		return false;
+	}
+	if ( size ) {
+		memcpy( out, reader->cur, size );
+	}
+	reader->cur += size;
+	return true;
+}
+
 /*
 =================
-FS_LoadZipFile
-
-Creates a new pak_t in the search chain for the contents
-of a zip file.
+FS_ReadPakCacheEntry
 =================
 */
-static pack_t *FS_LoadZipFile( const char *zipfile, const char *basename )
-{
-	fileInPack_t	*buildBuffer;
-	pack_t			*pack;
-	unzFile			uf;
-	int				err;
-	unz_global_info gi;
-	char			filename_inzip[MAX_ZPATH];
-	unz_file_info	file_info;
-	int				len;
-	size_t			i;
-	long			hash;
-	int				fs_numHeaderLongs;
-	int				*fs_headerLongs;
-	char			*namePtr;
+static bool FS_ReadPakCacheEntry( pakCacheReader_t *reader, std::string &path, pakCacheEntry_t &entry ) {
+	int		pathLen, numCrcs, namesLen, numNames;
 
-	fs_numHeaderLongs = 0;
+	if ( !FS_PakCacheRead( reader, &pathLen, sizeof( pathLen ) ) || pathLen <= 0 || pathLen >= MAX_OSPATH ) {
+		return false;
+	}
+	path.resize( pathLen );
+	if ( !FS_PakCacheRead( reader, &path[0], pathLen ) ) {
+		return false;
+	}
 
-	uf = unzOpen(zipfile);
-	err = unzGetGlobalInfo (uf,&gi);
+	if ( !FS_PakCacheRead( reader, &entry.size, sizeof( entry.size ) )
+		|| !FS_PakCacheRead( reader, &entry.mtime, sizeof( entry.mtime ) )
+		|| !FS_PakCacheRead( reader, &entry.dirCrc, sizeof( entry.dirCrc ) )
+		|| !FS_PakCacheRead( reader, &entry.parseUsec, sizeof( entry.parseUsec ) )
+		|| !FS_PakCacheRead( reader, &entry.numfiles, sizeof( entry.numfiles ) )
+		|| !FS_PakCacheRead( reader, &numCrcs, sizeof( numCrcs ) )
+		|| !FS_PakCacheRead( reader, &namesLen, sizeof( namesLen ) ) ) {
+		return false;
+	}
+	if ( entry.numfiles < 0 || numCrcs < 0 || numCrcs > entry.numfiles || namesLen < entry.numfiles ) {
+		return false;
+	}
 
-	if (err != UNZ_OK)
-		return NULL;
+	entry.pos.resize( entry.numfiles );
+	entry.len.resize( entry.numfiles );
+	entry.crcs.resize( numCrcs );
+	entry.names.resize( namesLen );
+	if ( !FS_PakCacheRead( reader, entry.pos.data(), entry.numfiles * sizeof( unsigned int ) )
+		|| !FS_PakCacheRead( reader, entry.len.data(), entry.numfiles * sizeof( unsigned int ) )
+		|| !FS_PakCacheRead( reader, entry.crcs.data(), numCrcs * sizeof( int ) )
+		|| !FS_PakCacheRead( reader, &entry.names[0], namesLen ) ) {
+		return false;
+	}
 
-	len = 0;
-	unzGoToFirstFile(uf);
-	for (i = 0; i < gi.number_entry; i++)
-	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
+	// FS_PakFromCache walks the names by their terminators
+	numNames = 0;
+	for ( char c : entry.names ) {
+		if ( !c ) {
+			numNames++;
+		}
+	}
+	if ( numNames != entry.numfiles || ( namesLen && entry.names[namesLen - 1] ) ) {
+		return false;
+	}
+
+	return true;
+}
+
+/*
+=================
+FS_LoadPakCache
+=================
+*/
+static void FS_LoadPakCache( void ) {
+	FILE				*f;
+	long				len;
+	int					header[3], i;
+	std::vector<byte>	data;
+	std::string			path;
+	pakCacheReader_t	reader;
+
+	fs_pakCache.clear();
+	fs_pakCacheActive = false;
+	fs_pakCacheDirty = false;
+	fs_pakCacheHits = 0;
+	fs_pakParsed = 0;
+	fs_pakLoadUsec = 0;
+	fs_pakParseUsec = 0;
+
+	if ( !fs_pakCacheVar->integer || !fs_homepath->string[0] ) {
+		return;
+	}
+	fs_pakCacheActive = true;
+
+	f = fopen( FS_PakCachePath(), "rb" );
+	if ( !f ) {
+		fs_pakCacheDirty = true;
+		return;
+	}
+	len = FS_fplength( f );
+	if ( len > 0 ) {
+		data.resize( len );
+		if ( fread( data.data(), 1, len, f ) != (size_t)len ) {
+			data.clear();
+		}
+	}
+	fclose( f );
+
+	reader.cur = data.data();
+	reader.end = data.data() + data.size();
+	if ( !FS_PakCacheRead( &reader, header, sizeof( header ) ) || header[0] != PAKCACHE_IDENT || header[1] != PAKCACHE_VERSION || header[2] < 0 ) {
+		Com_DPrintf( "%s is from another version, rebuilding it\n", PAKCACHE_FILENAME );
+		fs_pakCacheDirty = true;
+		return;
+	}
+
+	for ( i = 0; i < header[2]; i++ ) {
+		pakCacheEntry_t entry;
+		if ( !FS_ReadPakCacheEntry( &reader, path, entry ) ) {
 			break;
 		}
-		len += strlen(filename_inzip) + 1;
-		unzGoToNextFile(uf);
+		fs_pakCache[path] = std::move( entry );
+	}
+	if ( i < header[2] || reader.cur != reader.end ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: %s is damaged, rebuilding it\n", PAKCACHE_FILENAME );
+		fs_pakCache.clear();
+		fs_pakCacheDirty = true;
+	}
+}
+
+/*
+=================
+FS_SavePakCache
+
+Entries for paks that weren't loaded this time are kept as long as the pk3
+is still there unchanged, so switching between mods doesn't thrash the cache
+=================
+*/
+static void FS_SavePakCache( void ) {
+	std::string		out;
+	int				header[3], numCrcs, namesLen, pathLen;
+	long long		size;
+	time_t			mtime;
+	const char		*ospath;
+	char			tmppath[MAX_OSPATH];
+	FILE			*f;
+
+	if ( !fs_pakCacheActive ) {
+		return;
+	}
+	fs_pakCacheActive = false;
+
+	for ( auto it = fs_pakCache.begin(); it != fs_pakCache.end(); ) {
+		if ( !it->second.used && ( !Sys_FileInfo( it->first.c_str(), &size, &mtime ) || size != it->second.size || (long long)mtime != it->second.mtime ) ) {
+			it = fs_pakCache.erase( it );
+			fs_pakCacheDirty = true;
+		} else {
+			++it;
+		}
+	}
+
+	if ( fs_pakCacheDirty ) {
+		header[0] = PAKCACHE_IDENT;
+		header[1] = PAKCACHE_VERSION;
+		header[2] = (int)fs_pakCache.size();
+		out.append( (const char *)header, sizeof( header ) );
+		for ( const auto &it : fs_pakCache ) {
+			const pakCacheEntry_t &entry = it.second;
+
+			pathLen = (int)it.first.size();
+			numCrcs = (int)entry.crcs.size();
+			namesLen = (int)entry.names.size();
+			out.append( (const char *)&pathLen, sizeof( pathLen ) );
+			out.append( it.first );
+			out.append( (const char *)&entry.size, sizeof( entry.size ) );
+			out.append( (const char *)&entry.mtime, sizeof( entry.mtime ) );
+			out.append( (const char *)&entry.dirCrc, sizeof( entry.dirCrc ) );
+			out.append( (const char *)&entry.parseUsec, sizeof( entry.parseUsec ) );
+			out.append( (const char *)&entry.numfiles, sizeof( entry.numfiles ) );
+			out.append( (const char *)&numCrcs, sizeof( numCrcs ) );
+			out.append( (const char *)&namesLen, sizeof( namesLen ) );
+			out.append( (const char *)entry.pos.data(), entry.pos.size() * sizeof( unsigned int ) );
+			out.append( (const char *)entry.len.data(), entry.len.size() * sizeof( unsigned int ) );
+			out.append( (const char *)entry.crcs.data(), entry.crcs.size() * sizeof( int ) );
+			out.append( entry.names );
+		}
+
+		// write to the side so a crash never leaves half a cache behind
+		ospath = FS_PakCachePath();
+		Com_sprintf( tmppath, sizeof( tmppath ), "%s.tmp", ospath );
+		f = fopen( tmppath, "wb" );
+		if ( f ) {
+			const bool written = fwrite( out.data(), 1, out.size(), f ) == out.size();
+			fclose( f );
+			remove( ospath );
+			if ( !written || rename( tmppath, ospath ) ) {
+				remove( tmppath );
+				Com_DPrintf( "Couldn't write %s\n", ospath );
+			}
+		} else {
+			Com_DPrintf( "Couldn't write %s\n", ospath );
+		}
 	}
 
-	buildBuffer = (struct fileInPack_s *)Z_Malloc( (gi.number_entry * sizeof( fileInPack_t )) + len, TAG_FILESYS, qtrue );
-	namePtr = ((char *) buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
-	fs_headerLongs = (int *)Z_Malloc( ( gi.number_entry + 1 ) * sizeof(int), TAG_FILESYS, qtrue );
-	fs_headerLongs[ fs_numHeaderLongs++ ] = LittleLong( fs_checksumFeed );
+	fs_pakCache.clear();
+}
+
+/*
+==========================================================================
+
+ZIP FILE LOADING
+
+==========================================================================
+*/
+
+/*
+=================
+FS_AllocPak
+
+A pack_t with an empty hash table sized for numfiles entries
+=================
+*/
+static pack_t *FS_AllocPak( const char *zipfile, const char *basename, unzFile uf, int numfiles ) {
+	pack_t	*pack;
+	int		i;
 
 	// get the hash table size from the number of files in the zip
 	// because lots of custom pk3 files have less than 32 or 64 files
 	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
+		if (i > numfiles) {
 			break;
 		}
 	}
@@ -2176,10 +3099,79 @@ static pack_t *FS_LoadZipFile( const char *zipfile, const char *basename )
 	}
 
 	pack->handle = uf;
-	pack->numfiles = gi.number_entry;
+	pack->numfiles = numfiles;
+	return pack;
+}
+
+/*
+=================
+FS_SetPakChecksums
+
+crcs are the little endian crcs of every non-empty file in the pak, the
+pure checksum also covers the current checksum feed
+=================
+*/
+static void FS_SetPakChecksums( pack_t *pack, const int *crcs, int numCrcs ) {
+	int		*headerLongs;
+
+	headerLongs = (int *)Z_Malloc( ( numCrcs + 1 ) * sizeof(int), TAG_FILESYS, qtrue );
+	headerLongs[0] = LittleLong( fs_checksumFeed );
+	if ( numCrcs ) {
+		memcpy( headerLongs + 1, crcs, numCrcs * sizeof(int) );
+	}
+
+	pack->checksum = Com_BlockChecksum( &headerLongs[ 1 ], sizeof(*headerLongs) * numCrcs );
+	pack->pure_checksum = Com_BlockChecksum( headerLongs, sizeof(*headerLongs) * ( numCrcs + 1 ) );
+	pack->checksum = LittleLong( pack->checksum );
+	pack->pure_checksum = LittleLong( pack->pure_checksum );
+
+	Z_Free(headerLongs);
+}
+
+/*
+=================
+FS_ParseZipFile
+
+Walks the whole central directory of an open zip.  When cache isn't NULL
+it gets everything needed to rebuild the pak without the zip
+=================
+*/
+static pack_t *FS_ParseZipFile( const char *zipfile, const char *basename, unzFile uf, const unz_global_info *gi, pakCacheEntry_t *cache )
+{
+	fileInPack_t	*buildBuffer;
+	pack_t			*pack;
+	int				err;
+	char			filename_inzip[MAX_ZPATH];
+	unz_file_info	file_info;
+	int				len;
+	size_t			i;
+	long			hash;
+	int				fs_numHeaderLongs;
+	int				*fs_headerLongs;
+	char			*namePtr;
+
+	fs_numHeaderLongs = 0;
+
+	len = 0;
+	unzGoToFirstFile(uf);
+	for (i = 0; i < gi->number_entry; i++)
+	{
+		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
+		if (err != UNZ_OK) {
+			break;
+		}
+		len += strlen(filename_inzip) + 1;
+		unzGoToNextFile(uf);
+	}
+
+	buildBuffer = (struct fileInPack_s *)Z_Malloc( (gi->number_entry * sizeof( fileInPack_t )) + len, TAG_FILESYS, qtrue );
+	namePtr = ((char *) buildBuffer) + gi->number_entry * sizeof( fileInPack_t );
+	fs_headerLongs = (int *)Z_Malloc( ( gi->number_entry + 1 ) * sizeof(int), TAG_FILESYS, qtrue );
+
+	pack = FS_AllocPak( zipfile, basename, uf, gi->number_entry );
 	unzGoToFirstFile(uf);
 
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0; i < gi->number_entry; i++)
 	{
 		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
 		if (err != UNZ_OK) {
@@ -2201,10 +3193,20 @@ static pack_t *FS_LoadZipFile( const char *zipfile, const char *basename )
 		unzGoToNextFile(uf);
 	}
 
-	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * ( fs_numHeaderLongs - 1 ) );
-	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * fs_numHeaderLongs );
-	pack->checksum = LittleLong( pack->checksum );
-	pack->pure_checksum = LittleLong( pack->pure_checksum );
+	FS_SetPakChecksums( pack, fs_headerLongs, fs_numHeaderLongs );
+
+	// a directory that stopped parsing half way isn't worth remembering
+	if ( cache && i == gi->number_entry ) {
+		cache->numfiles = gi->number_entry;
+		cache->pos.resize( i );
+		cache->len.resize( i );
+		for ( i = 0; i < gi->number_entry; i++ ) {
+			cache->pos[i] = (unsigned int)buildBuffer[i].pos;
+			cache->len[i] = (unsigned int)buildBuffer[i].len;
+		}
+		cache->crcs.assign( fs_headerLongs, fs_headerLongs + fs_numHeaderLongs );
+		cache->names.assign( ((char *) buildBuffer) + gi->number_entry * sizeof( fileInPack_t ), len );
+	}
 
 	Z_Free(fs_headerLongs);
 
@@ -2212,6 +3214,174 @@ static pack_t *FS_LoadZipFile( const char *zipfile, const char *basename )
 	return pack;
 }
 
+/*
+=================
+FS_PakDirectoryCRC
+
+crc32 of a zip's central directory and the end record pointing at it, read
+straight from the file in one go rather than an entry at a time.  Fails for
+zips it can't make sense of, which are then never cached
+=================
+*/
+#define	ZIP_END_RECORD_SIZE		22
+#define	ZIP_END_RECORD_IDENT	0x06054b50
+
+static bool FS_PakDirectoryCRC( const char *zipfile, long long size, const unz_global_info *gi, unsigned int *crc ) {
+	byte				end[ZIP_END_RECORD_SIZE];
+	std::vector<byte>	dir;
+	long long			endPos, dirPos, dirSize;
+	bool				read;
+	FILE				*f;
+
+	endPos = size - ZIP_END_RECORD_SIZE - gi->size_comment;
+	if ( endPos < 0 ) {
+		return false;
+	}
+
+	f = fopen( zipfile, "rb" );
+	if ( !f ) {
+		return false;
+	}
+	read = fseek( f, (long)endPos, SEEK_SET ) == 0 && fread( end, 1, sizeof( end ), f ) == sizeof( end );
+	if ( read ) {
+		dirSize = end[12] | ( end[13] << 8 ) | ( end[14] << 16 ) | ( (unsigned int)end[15] << 24 );
+		dirPos = end[16] | ( end[17] << 8 ) | ( end[18] << 16 ) | ( (unsigned int)end[19] << 24 );
+
+		// zip64 and anything else that doesn't add up is left to minizip
+		read = ( end[0] | ( end[1] << 8 ) | ( end[2] << 16 ) | ( (unsigned int)end[3] << 24 ) ) == ZIP_END_RECORD_IDENT
+			&& dirPos + dirSize <= endPos;
+	}
+	if ( read ) {
+		dir.resize( (size_t)dirSize );
+		read = fseek( f, (long)dirPos, SEEK_SET ) == 0 && fread( dir.data(), 1, dir.size(), f ) == dir.size();
+	}
+	fclose( f );
+
+	if ( !read ) {
+		return false;
+	}
+
+	*crc = crc32( 0L, Z_NULL, 0 );
+	*crc = crc32( *crc, dir.data(), (uInt)dir.size() );
+	*crc = crc32( *crc, end, sizeof( end ) );
+	return true;
+}
+
+/*
+=================
+FS_PakFromCache
+
+Rebuilds a pak from what FS_ParseZipFile remembered about it
+=================
+*/
+static pack_t *FS_PakFromCache( const char *zipfile, const char *basename, unzFile uf, const pakCacheEntry_t *cache )
+{
+	fileInPack_t	*buildBuffer;
+	pack_t			*pack;
+	char			*namePtr;
+	long			hash;
+	int				i;
+
+	buildBuffer = (struct fileInPack_s *)Z_Malloc( (cache->numfiles * sizeof( fileInPack_t )) + cache->names.size(), TAG_FILESYS, qtrue );
+	namePtr = ((char *) buildBuffer) + cache->numfiles * sizeof( fileInPack_t );
+	memcpy( namePtr, cache->names.data(), cache->names.size() );
+
+	pack = FS_AllocPak( zipfile, basename, uf, cache->numfiles );
+
+	for ( i = 0; i < cache->numfiles; i++ ) {
+		hash = FS_HashFileName( namePtr, pack->hashSize );
+		buildBuffer[i].name = namePtr;
+		namePtr += strlen( namePtr ) + 1;
+		buildBuffer[i].pos = cache->pos[i];
+		buildBuffer[i].len = cache->len[i];
+		buildBuffer[i].next = pack->hashTable[hash];
+		pack->hashTable[hash] = &buildBuffer[i];
+	}
+
+	FS_SetPakChecksums( pack, cache->crcs.data(), (int)cache->crcs.size() );
+
+	pack->buildBuffer = buildBuffer;
+	return pack;
+}
+
+/*
+=================
+FS_LoadZipFile
+
+Creates a new pak_t in the search chain for the contents
+of a zip file.
+=================
+*/
+static pack_t *FS_LoadZipFile( const char *zipfile, const char *basename )
+{
+	pack_t			*pack;
+	unzFile			uf;
+	int				err;
+	unz_global_info gi;
+	pakCacheEntry_t	*cached, parsed;
+	qboolean		known;
+	long long		size, start;
+	time_t			mtime;
+	unsigned int	dirCrc;
+	int				usec;
+
+	start = FS_PakClock();
+
+	cached = NULL;
+	known = qfalse;
+	if ( fs_pakCacheActive && Sys_FileInfo( zipfile, &size, &mtime ) ) {
+		known = qtrue;
+		auto it = fs_pakCache.find( zipfile );
+		if ( it != fs_pakCache.end() && it->second.size == size && it->second.mtime == (long long)mtime ) {
+			cached = &it->second;
+		}
+	}
+
+	uf = unzOpen(zipfile);
+	err = unzGetGlobalInfo (uf,&gi);
+
+	if (err != UNZ_OK)
+		return NULL;
+
+	if ( known && !FS_PakDirectoryCRC( zipfile, size, &gi, &dirCrc ) ) {
+		known = qfalse;
+		cached = NULL;
+	}
+
+	// the same size and time don't prove the directory is the one cached
+	if ( cached && ( cached->numfiles != (int)gi.number_entry || cached->dirCrc != dirCrc ) ) {
+		cached = NULL;
+	}
+
+	if ( cached ) {
+		pack = FS_PakFromCache( zipfile, basename, uf, cached );
+		cached->used = true;
+		fs_pakCacheHits++;
+		fs_pakLoadUsec += FS_PakClock() - start;
+		fs_pakParseUsec += cached->parseUsec;
+		return pack;
+	}
+
+	pack = FS_ParseZipFile( zipfile, basename, uf, &gi, known ? &parsed : NULL );
+
+	usec = (int)( FS_PakClock() - start );
+	fs_pakParsed++;
+	fs_pakLoadUsec += usec;
+	fs_pakParseUsec += usec;
+
+	if ( known && parsed.numfiles >= 0 ) {
+		parsed.size = size;
+		parsed.mtime = (long long)mtime;
+		parsed.dirCrc = dirCrc;
+		parsed.parseUsec = usec;
+		parsed.used = true;
+		fs_pakCache[zipfile] = std::move( parsed );
+		fs_pakCacheDirty = true;
+	}
+
+	return pack;
+}
+
 /*
 =================
 FS_FreePak
@@ -2902,6 +4072,11 @@ void FS_Path_f( void ) {
 			Com_Printf( "handle %i: %s\n", i, fsh[i].name );
 		}
 	}
+
+	Com_Printf( "%i lookups, %i not found, %i directory probes, %i skipped by the miss cache (%i misses cached)\n",
+		fs_lookupCount, fs_lookupMisses, fs_dirProbes, fs_dirProbesSkipped, (int)fs_dirMisses.size() );
+	Com_Printf( "%i prefetched files read, %i of them waited for a loader, %i read without prefetching\n",
+		fs_prefetchHits, fs_prefetchWaits, fs_prefetchMisses );
 }
 
 /*
@@ -3337,6 +4512,8 @@ void FS_Shutdown( qboolean closemfp, qboolean keepModuleFiles ) {
 	searchpath_t	*p, *next;
 	int	i;
 
+	FS_ShutdownPrefetch();
+
 #if defined(_WIN32)
 	// Delete temporary files
 	fs_temporaryFileWriteIdx = 0;
@@ -3381,6 +4558,9 @@ void FS_Shutdown( qboolean closemfp, qboolean keepModuleFiles ) {
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
 
+	FS_FreeFileIndex();
+	FS_FlushDirMisses();
+
 	Cmd_RemoveCommand( "path" );
 	Cmd_RemoveCommand( "dir" );
 	Cmd_RemoveCommand( "fdir" );
@@ -3584,6 +4764,15 @@ void FS_Startup( const char *gameName ) {
 
 	fs_forcegame = Cvar_Get ("fs_forcegame", "", CVAR_INIT, "Folder to use for overriding of fs_game (can not be set by the server)." );
 
+	fs_dirMissCache = Cvar_Get( "fs_dirMissCache", "1", CVAR_ARCHIVE_ND, "Remember files that aren't in the game directories until something is written, the next level load or fs_restart" );
+	fs_pakCacheVar = Cvar_Get( "fs_pakCache", "1", CVAR_ARCHIVE_ND, "Keep the directories of unchanged pk3 files in " PAKCACHE_FILENAME " instead of parsing them on every startup" );
+
+	fs_prefetch = Cvar_Get( "fs_prefetch", "1", CVAR_ARCHIVE_ND, "Load the files of a level in the background while it starts" );
+	fs_prefetchThreads = Cvar_Get( "fs_prefetchThreads", "0", CVAR_ARCHIVE_ND, "Threads loading files in the background, 0 picks one less than the number of cores" );
+	fs_prefetchMemory = Cvar_Get( "fs_prefetchMemory", "64", CVAR_ARCHIVE_ND, "Megabytes of loaded files the background loaders may hold before they're read" );
+
+	FS_LoadPakCache();
+
 	// add search path elements in reverse priority order (lowest priority first)
 	if (fs_cdpath->string[0]) {
 		FS_AddGameDirectory( fs_cdpath->string, gameName );
@@ -3661,6 +4850,10 @@ void FS_Startup( const char *gameName ) {
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
 
+	FS_BuildFileIndex();
+
+	FS_SavePakCache();
+
 	// print the current search paths
 	FS_Path_f();
 
@@ -3676,6 +4869,12 @@ void FS_Startup( const char *gameName ) {
 	}
 #endif
 	Com_Printf( "%d files in pk3 files\n", fs_packFiles );
+	if ( fs_pakCacheVar->integer ) {
+		Com_Printf( "%d pk3 files loaded in %.1f msec, %d from the pak cache, %d parsed (%.1f msec parsing them all)\n",
+			fs_pakCacheHits + fs_pakParsed, fs_pakLoadUsec / 1000.0f, fs_pakCacheHits, fs_pakParsed, fs_pakParseUsec / 1000.0f );
+	} else {
+		Com_Printf( "%d pk3 files parsed in %.1f msec, pak cache off\n", fs_pakParsed, fs_pakLoadUsec / 1000.0f );
+	}
 }
 
 /*
@@ -3904,6 +5103,9 @@ exception of .cfg and .dat files.
 void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames ) {
 	int		i, c, d;
 
+	// the loaders look at the pure list
+	FS_CancelPrefetch();
+
 	Cmd_TokenizeString( pakSums );
 
 	c = Cmd_Argc();
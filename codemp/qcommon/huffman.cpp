@@ -27,25 +27,24 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "qcommon/qcommon.h"
 
+// bit cursor for the adaptive Huff_Compress/Huff_Decompress coders only, the
+// offset based functions used by the msg_t bitstream keep their cursor local
+// so message encoding can run on several threads at once
 static int			bloc = 0;
 
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int loc = *offset;
+	if ((loc&7) == 0) {
+		fout[(loc>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(loc>>3)] |= bit << (loc&7);
+	*offset = loc + 1;
 }
 
 int		Huff_getBit( byte *fin, int *offset) {
-	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
-	return t;
+	int loc = *offset;
+	*offset = loc + 1;
+	return (fin[(loc>>3)] >> (loc&7)) & 0x1;
 }
 
 /* Add a bit to the output file (buffered) */
@@ -270,18 +269,19 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
-	bloc = *offset;
+	int loc = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (bloc >= maxoffset) {
+		if (loc >= maxoffset) {
 			*ch = 0;
 			*offset = maxoffset + 1;
 			return;
 		}
-		if (get_bit(fin)) {
+		if ((fin[(loc>>3)] >> (loc&7)) & 0x1) {
 			node = node->right;
 		} else {
 			node = node->left;
 		}
+		loc++;
 	}
 	if (!node) {
 		*ch = 0;
@@ -289,24 +289,20 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 //		Com_Error(ERR_DROP, "Illegal tree!\n");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = loc;
 }
 
 /* Send the prefix code for this node */
-static void send(node_t *node, node_t *child, byte *fout, int maxoffset) {
+static void send(node_t *node, node_t *child, byte *fout, int *offset, int maxoffset) {
 	if (node->parent) {
-		send(node->parent, node, fout, maxoffset);
+		send(node->parent, node, fout, offset, maxoffset);
 	}
 	if (child) {
-		if (bloc >= maxoffset) {
-			bloc = maxoffset + 1;
+		if (*offset >= maxoffset) {
+			*offset = maxoffset + 1;
 			return;
 		}
-		if (node->right == child) {
-			add_bit(1, fout);
-		} else {
-			add_bit(0, fout);
-		}
+		Huff_putBit(node->right == child, fout, offset);
 	}
 }
 
@@ -320,14 +316,121 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout, int maxoffset) {
 			add_bit((char)((ch >> i) & 0x1), fout);
 		}
 	} else {
-		send(huff->loc[ch], NULL, fout, maxoffset);
+		send(huff->loc[ch], NULL, fout, &bloc, maxoffset);
 	}
 }
 
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout, maxoffset);
-	*offset = bloc;
+	send(huff->loc[ch], NULL, fout, offset, maxoffset);
+}
+
+/*
+=============================================================================
+
+Table driven coding
+
+Once MSG_initHuffman has fed the frequency table the msg_t trees never change
+again, so every code can be looked up instead of walking the tree one bit at a
+time.  The results, including the overflow behaviour at maxoffset, match
+Huff_offsetTransmit and Huff_offsetReceive bit for bit.
+
+=============================================================================
+*/
+
+/* Flatten a tree into per symbol codes and a decode lookup table, fails if a code doesn't fit in 32 bits */
+qboolean Huff_BuildTable( const huff_t *huff, huffTable_t *table ) {
+	const node_t	*node;
+	uint32_t		code, fill;
+	int				ch, length;
+
+	Com_Memset( table, 0, sizeof( *table ) );
+	table->tree = huff->tree;
+
+	for ( ch = 0; ch <= HMAX; ch++ ) {
+		if ( !huff->loc[ch] ) {
+			continue;
+		}
+
+		// collect the path from the leaf up, the root's bit goes out first
+		code = 0;
+		length = 0;
+		for ( node = huff->loc[ch]; node->parent; node = node->parent ) {
+			if ( length == HUFF_MAX_CODE_BITS ) {
+				return qfalse;
+			}
+			code = (code << 1) | (node->parent->right == node);
+			length++;
+		}
+		table->code[ch] = code;
+		table->length[ch] = length;
+
+		if ( length == 0 || length > HUFF_LOOKUP_BITS ) {
+			continue;
+		}
+		for ( fill = 0; fill < (1u << (HUFF_LOOKUP_BITS - length)); fill++ ) {
+			table->lookup[code | (fill << length)] = (uint16_t)(ch | (length << 9));
+		}
+	}
+
+	return qtrue;
+}
+
+/* Send a symbol, same result as Huff_offsetTransmit */
+void Huff_tableTransmit( const huffTable_t *table, int ch, byte *fout, int *offset, int maxoffset ) {
+	uint32_t	code = table->code[ch];
+	int			length = table->length[ch];
+	int			loc = *offset;
+	int			shift, n;
+	qboolean	overflow = qfalse;
+
+	// the tree coder stops at maxoffset and flags the overflow one past it
+	if ( length > 0 && loc + length > maxoffset ) {
+		length = maxoffset - loc;
+		if ( length < 0 ) {
+			length = 0;
+		}
+		overflow = qtrue;
+	}
+
+	while ( length > 0 ) {
+		shift = loc & 7;
+		n = 8 - shift;
+		if ( n > length ) {
+			n = length;
+		}
+		if ( shift == 0 ) {
+			fout[loc >> 3] = (byte)(code & ((1 << n) - 1));
+		} else {
+			fout[loc >> 3] |= (byte)((code & ((1 << n) - 1)) << shift);
+		}
+		code >>= n;
+		loc += n;
+		length -= n;
+	}
+
+	*offset = overflow ? maxoffset + 1 : loc;
+}
+
+/* Get a symbol, same result as Huff_offsetReceive */
+void Huff_tableReceive( const huffTable_t *table, int *ch, const byte *fin, int *offset, int maxoffset ) {
+	const byte	*p;
+	uint32_t	bits;
+	int			loc = *offset;
+	int			entry;
+
+	// the lookup reads three bytes, leave the last few bits of the message to the tree
+	if ( loc + 24 <= maxoffset ) {
+		p = fin + (loc >> 3);
+		bits = ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)) >> (loc & 7);
+		entry = table->lookup[bits & ((1 << HUFF_LOOKUP_BITS) - 1)];
+		if ( entry ) {
+			*ch = entry & 511;
+			*offset = loc + (entry >> 9);
+			return;
+		}
+	}
+
+	Huff_offsetReceive( table->tree, ch, (byte *)fin, offset, maxoffset );
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -382,7 +485,7 @@ void Huff_Decompress(msg_t *mbuf, int offset) {
 	Com_Memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern 	int oldsize;
+extern thread_local int oldsize;
 
 void Huff_Compress(msg_t *mbuf, int offset) {
 	int			i, ch, size;
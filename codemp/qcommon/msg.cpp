@@ -30,6 +30,9 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 //#define _USINGNEWHUFFTABLE_		// Build a new frequency table to cut and paste.
 
 static huffman_t		msgHuff;
+static huffTable_t		msgHuffEncode;
+static huffTable_t		msgHuffDecode;
+static qboolean			msgHuffTables = qfalse;	// codes fit the tables
 
 static qboolean			msgInit = qfalse;
 #ifdef _NEWHUFFTABLE_
@@ -45,11 +48,12 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
+// statistics only, thread_local because snapshot jobs write messages in parallel
 #ifndef FINAL_BUILD
-	int gLastBitIndex = 0;
+	thread_local int gLastBitIndex = 0;
 #endif
 
-int oldsize = 0;
+thread_local int oldsize = 0;
 
 bool g_nOverrideChecked = false;
 void MSG_CheckNETFPSFOverrides(qboolean psfOverrides);
@@ -131,23 +135,51 @@ bit functions
 =============================================================================
 */
 
-int	overflows;
+thread_local int	overflows;
 
-// negative bit values include signs
-void MSG_WriteBits( msg_t *msg, int value, int bits ) {
-	int	i;
+/*
+Word at a time paths for the Huffman bitstream.
 
-	oldsize += bits;
+msgWriter_t gathers the bits of consecutive writes in a 64 bit accumulator and
+stores them a word at a time, the delta encoders use it for their field loops.
+The msg_t itself is only brought up to date by MSG_EndWriter, so nothing else
+may touch the message in between.  Reads that stay clear of the end of the
+message decode from a 64 bit window with a single bounds check per call.
 
-	if ( msg->overflowed ) {
-		return;
-	}
+Near the end of the buffer both fall back to the bit by bit path, which
+defines the overflow behaviour, and the bits on the wire are identical.
+*/
+static qboolean		msgFastBits = qtrue;	// msgbench and the unit tests turn it off to compare
 
-	if ( bits == 0 || bits < -31 || bits > 32 ) {
-		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
-	}
+void MSG_SetFastBits( qboolean fast ) {
+	msgFastBits = fast;
+}
 
-	// check for overflows
+// room for whatever is pending in the accumulator plus one 32 bit write
+#define MSG_WRITER_SLACK	32
+
+typedef struct msgWriter_s {
+	msg_t		*msg;
+	qboolean	direct;		// write through MSG_WriteBits
+	byte		*out;		// byte holding the first bit of acc
+	byte		*end;
+	uint64_t	acc;
+	int			accBits;
+} msgWriter_t;
+
+static QINLINE uint64_t MSG_LoadBits64( const byte *p ) {
+#ifdef Q3_LITTLE_ENDIAN
+	uint64_t	v;
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+#else
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24)
+		| ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+#endif
+}
+
+// statistics only, the value is masked to the width either way
+static QINLINE void MSG_CountOverflow( int value, int bits ) {
 	if ( bits != 32 ) {
 		if ( bits > 0 ) {
 			if ( value > ( ( 1 << bits ) - 1 ) || value < 0 ) {
@@ -169,6 +201,160 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 			}
 		}
 	}
+}
+
+static void MSG_BeginWriter( msg_t *msg, msgWriter_t *w ) {
+	w->msg = msg;
+	w->out = w->end = NULL;
+	w->acc = 0;
+	w->accBits = 0;
+	w->direct = (qboolean)(!msgFastBits || !msgHuffTables || msg->oob || msg->overflowed);
+	if ( w->direct ) {
+		return;
+	}
+
+	// a partially written byte keeps its bits, a new one starts out cleared
+	w->out = msg->data + (msg->bit >> 3);
+	w->end = msg->data + msg->maxsize;
+	w->accBits = msg->bit & 7;
+	w->acc = w->accBits ? *w->out : 0;
+}
+
+static void MSG_EndWriter( msgWriter_t *w ) {
+	msg_t	*msg = w->msg;
+	int		bit;
+
+	if ( w->direct ) {
+		return;
+	}
+
+	bit = (int)(w->out - msg->data) * 8 + w->accBits;
+	for ( ; w->accBits > 0; w->accBits -= 8, w->acc >>= 8 ) {
+		*w->out++ = (byte)w->acc;
+	}
+
+	if ( bit != msg->bit ) {
+		msg->bit = bit;
+		msg->cursize = (msg->bit>>3)+1;
+	}
+	w->direct = qtrue;
+}
+
+static QINLINE void MSG_FlushWriter( msgWriter_t *w ) {
+	w->out[0] = (byte)w->acc;
+	w->out[1] = (byte)(w->acc >> 8);
+	w->out[2] = (byte)(w->acc >> 16);
+	w->out[3] = (byte)(w->acc >> 24);
+	w->out += 4;
+	w->acc >>= 32;
+	w->accBits -= 32;
+}
+
+// same as MSG_WriteBits( w->msg, value, bits )
+static QINLINE void MSG_WriterBits( msgWriter_t *w, int value, int bits ) {
+	uint32_t	v;
+	int			nbits, ch;
+
+	if ( !w->direct && w->out + MSG_WRITER_SLACK > w->end ) {
+		MSG_EndWriter( w );
+	}
+	if ( w->direct ) {
+		MSG_WriteBits( w->msg, value, bits );
+		return;
+	}
+
+	oldsize += bits;
+
+	if ( bits == 0 || bits < -31 || bits > 32 ) {
+		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
+	}
+	MSG_CountOverflow( value, bits );
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+
+	if ( w->accBits >= 32 ) {
+		MSG_FlushWriter( w );
+	}
+
+	v = (uint32_t)value & (0xffffffff>>(32-bits));
+	nbits = bits & 7;
+	w->acc |= (uint64_t)(v & ((1 << nbits) - 1)) << w->accBits;
+	w->accBits += nbits;
+
+	for ( v >>= nbits, bits -= nbits ; bits > 0 ; bits -= 8, v >>= 8 ) {
+		if ( w->accBits > 32 ) {
+			MSG_FlushWriter( w );
+		}
+		ch = v & 0xff;
+		w->acc |= (uint64_t)msgHuffEncode.code[ch] << w->accBits;
+		w->accBits += msgHuffEncode.length[ch];
+	}
+}
+
+// bits is positive and the message has at least 8 bytes left to read,
+// returns qfalse if a long code ran off the end of the message
+static QINLINE qboolean MSG_ReadBitsFast( msg_t *msg, int bits, int *value ) {
+	uint64_t	window;
+	int			loc, avail, nbits, numSymbols, entry, get, i;
+
+	loc = msg->bit;
+	window = MSG_LoadBits64( msg->data + (loc >> 3) ) >> (loc & 7);
+	avail = 64 - (loc & 7);
+
+	nbits = bits & 7;
+	numSymbols = bits >> 3;
+
+	*value = (int)(window & ((1 << nbits) - 1));
+	window >>= nbits;
+	avail -= nbits;
+	loc += nbits;
+
+	for ( i = 0; i < numSymbols; i++ ) {
+		entry = avail >= HUFF_LOOKUP_BITS ? msgHuffDecode.lookup[window & ((1 << HUFF_LOOKUP_BITS) - 1)] : 0;
+		if ( entry ) {
+			get = entry & 511;
+			window >>= entry >> 9;
+			avail -= entry >> 9;
+			loc += entry >> 9;
+		} else {
+			// long code or out of window, let the bounds checked decoder have it
+			Huff_tableReceive( &msgHuffDecode, &get, msg->data, &loc, msg->cursize<<3 );
+			if ( loc > msg->cursize<<3 ) {
+				msg->bit = loc;
+				return qfalse;
+			}
+			if ( (loc >> 3) + 8 <= msg->cursize ) {
+				window = MSG_LoadBits64( msg->data + (loc >> 3) ) >> (loc & 7);
+				avail = 64 - (loc & 7);
+			} else {
+				avail = 0;
+			}
+		}
+		*value |= get << (i * 8 + nbits);
+	}
+
+	msg->bit = loc;
+	msg->readcount = (msg->bit>>3)+1;
+	return qtrue;
+}
+
+// negative bit values include signs
+void MSG_WriteBits( msg_t *msg, int value, int bits ) {
+	int	i;
+
+	oldsize += bits;
+
+	if ( msg->overflowed ) {
+		return;
+	}
+
+	if ( bits == 0 || bits < -31 || bits > 32 ) {
+		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
+	}
+
+	// check for overflows
+	MSG_CountOverflow( value, bits );
 	if ( bits < 0 ) {
 		bits = -bits;
 	}
@@ -215,7 +401,11 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 #ifdef _NEWHUFFTABLE_
 				fwrite(&value, 1, 1, fp);
 #endif // _NEWHUFFTABLE_
-				Huff_offsetTransmit (&msgHuff.compressor, (value&0xff), msg->data, &msg->bit, msg->maxsize << 3);
+				if ( msgHuffTables ) {
+					Huff_tableTransmit (&msgHuffEncode, (value&0xff), msg->data, &msg->bit, msg->maxsize << 3);
+				} else {
+					Huff_offsetTransmit (&msgHuff.compressor, (value&0xff), msg->data, &msg->bit, msg->maxsize << 3);
+				}
 				value = (value>>8);
 
 				if ( msg->bit > msg->maxsize << 3 ) {
@@ -228,6 +418,48 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	}
 }
 
+/*
+=================
+MSG_WriteBitString
+
+Appends the first numBits bits of a message that was written from bit 0.
+Huffman codes don't depend on where they start, so this produces the same
+bits as repeating the original writes.  Returns qfalse without writing
+anything if they don't fit, the caller has to repeat the writes to get
+the usual overflow behaviour.
+=================
+*/
+qboolean MSG_WriteBitString( msg_t *msg, const byte *bits, int numBits ) {
+	byte	*out;
+	int		shift, i, remaining;
+
+	if ( msg->overflowed || numBits <= 0 ) {
+		return qtrue;
+	}
+	if ( msg->oob || msg->bit + numBits > msg->maxsize << 3 ) {
+		return qfalse;
+	}
+
+	out = msg->data + (msg->bit >> 3);
+	shift = msg->bit & 7;
+
+	if ( !shift ) {
+		Com_Memcpy( out, bits, (numBits + 7) >> 3 );
+	} else {
+		// the unused bits of the last source byte are clear
+		for ( i = 0, remaining = numBits ; remaining > 0 ; i++, remaining -= 8 ) {
+			out[i] |= bits[i] << shift;
+			if ( shift + (remaining < 8 ? remaining : 8) > 8 ) {
+				out[i+1] = bits[i] >> (8 - shift);
+			}
+		}
+	}
+
+	msg->bit += numBits;
+	msg->cursize = (msg->bit>>3)+1;
+	return qtrue;
+}
+
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int			value;
 	int			get;
@@ -271,6 +503,13 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		} else {
 			Com_Error(ERR_DROP, "can't read %d bits\n", bits);
 		}
+	} else if ( msgFastBits && msgHuffTables && (msg->bit >> 3) + 8 <= msg->cursize ) {
+		if ( !MSG_ReadBitsFast( msg, bits, &value ) ) {
+			msg->readcount = msg->cursize + 1;
+			return 0;
+		}
+		// the bit by bit path sign extends from the whole bytes only
+		bits -= bits & 7;
 	} else {
 		nbits = 0;
 		if (bits&7) {
@@ -286,7 +525,11 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		}
 		if (bits) {
 			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
+				if ( msgHuffTables ) {
+					Huff_tableReceive (&msgHuffDecode, &get, msg->data, &msg->bit, msg->cursize<<3);
+				} else {
+					Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
+				}
 #ifdef _NEWHUFFTABLE_
 				fwrite(&get, 1, 1, fp);
 #endif // _NEWHUFFTABLE_
@@ -309,6 +552,29 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 	return value;
 }
 
+// same as MSG_ReadBits, inlined into the field loops of the delta decoders
+static QINLINE int MSG_ReadFieldBits( msg_t *msg, int bits ) {
+	int		value, n;
+
+	if ( !msgFastBits || !msgHuffTables || msg->oob || msg->readcount > msg->cursize
+		|| (msg->bit >> 3) + 8 > msg->cursize ) {
+		return MSG_ReadBits( msg, bits );
+	}
+
+	n = bits < 0 ? -bits : bits;
+	if ( !MSG_ReadBitsFast( msg, n, &value ) ) {
+		msg->readcount = msg->cursize + 1;
+		return 0;
+	}
+
+	// like MSG_ReadBits, sign extend from the whole bytes only
+	n -= n & 7;
+	if ( bits < 0 && n > 0 && n < 32 && ( value & ( 1 << ( n - 1 ) ) ) ) {
+		value |= -1 ^ ( ( 1 << n ) - 1 );
+	}
+	return value;
+}
+
 
 
 //================================================================================
@@ -1045,6 +1311,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 	int			trunc;
 	float		fullFloat;
 	int			*fromF, *toF;
+	msgWriter_t	w;
 
 	numFields = (int)ARRAY_LEN( entityStateFields );
 
@@ -1093,11 +1360,12 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 		return;
 	}
 
-	MSG_WriteBits( msg, to->number, GENTITYNUM_BITS );
-	MSG_WriteBits( msg, 0, 1 );			// not removed
-	MSG_WriteBits( msg, 1, 1 );			// we have a delta
+	MSG_BeginWriter( msg, &w );
+	MSG_WriterBits( &w, to->number, GENTITYNUM_BITS );
+	MSG_WriterBits( &w, 0, 1 );			// not removed
+	MSG_WriterBits( &w, 1, 1 );			// we have a delta
 
-	MSG_WriteByte( msg, lc );	// # of changes
+	MSG_WriterBits( &w, lc, 8 );	// # of changes
 
 	oldsize += numFields;
 
@@ -1106,11 +1374,11 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 		toF = (int *)( (byte *)to + field->offset );
 
 		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 );	// no change
+			MSG_WriterBits( &w, 0, 1 );	// no change
 			continue;
 		}
 
-		MSG_WriteBits( msg, 1, 1 );	// changed
+		MSG_WriterBits( &w, 1, 1 );	// changed
 
 		if ( field->bits == 0 ) {
 			// float
@@ -1118,31 +1386,33 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 			trunc = (int)fullFloat;
 
 			if (fullFloat == 0.0f) {
-					MSG_WriteBits( msg, 0, 1 );
+					MSG_WriterBits( &w, 0, 1 );
 					oldsize += FLOAT_INT_BITS;
 			} else {
-				MSG_WriteBits( msg, 1, 1 );
+				MSG_WriterBits( &w, 1, 1 );
 				if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
 					trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
 					// send as small integer
-					MSG_WriteBits( msg, 0, 1 );
-					MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+					MSG_WriterBits( &w, 0, 1 );
+					MSG_WriterBits( &w, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
 				} else {
 					// send as full floating point value
-					MSG_WriteBits( msg, 1, 1 );
-					MSG_WriteBits( msg, *toF, 32 );
+					MSG_WriterBits( &w, 1, 1 );
+					MSG_WriterBits( &w, *toF, 32 );
 				}
 			}
 		} else {
 			if (*toF == 0) {
-				MSG_WriteBits( msg, 0, 1 );
+				MSG_WriterBits( &w, 0, 1 );
 			} else {
-				MSG_WriteBits( msg, 1, 1 );
+				MSG_WriterBits( &w, 1, 1 );
 				// integer
-				MSG_WriteBits( msg, *toF, field->bits );
+				MSG_WriterBits( &w, *toF, field->bits );
 			}
 		}
 	}
+
+	MSG_EndWriter( &w );
 }
 
 /*
@@ -1179,7 +1449,7 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 	}
 
 	// check for a remove
-	if ( MSG_ReadBits( msg, 1 ) == 1 ) {
+	if ( MSG_ReadFieldBits( msg, 1 ) == 1 ) {
 		Com_Memset( to, 0, sizeof( *to ) );
 		to->number = MAX_GENTITIES - 1;
 		if ( cl_shownet && ( cl_shownet->integer >= 2 || cl_shownet->integer == -1 ) ) {
@@ -1189,7 +1459,7 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 	}
 
 	// check for no delta
-	if ( MSG_ReadBits( msg, 1 ) == 0 ) {
+	if ( MSG_ReadFieldBits( msg, 1 ) == 0 ) {
 		*to = *from;
 		to->number = number;
 		return;
@@ -1223,18 +1493,18 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
 
-		if ( ! MSG_ReadBits( msg, 1 ) ) {
+		if ( ! MSG_ReadFieldBits( msg, 1 ) ) {
 			// no change
 			*toF = *fromF;
 		} else {
 			if ( field->bits == 0 ) {
 				// float
-				if ( MSG_ReadBits( msg, 1 ) == 0 ) {
+				if ( MSG_ReadFieldBits( msg, 1 ) == 0 ) {
 						*(float *)toF = 0.0f;
 				} else {
-					if ( MSG_ReadBits( msg, 1 ) == 0 ) {
+					if ( MSG_ReadFieldBits( msg, 1 ) == 0 ) {
 						// integral float
-						trunc = MSG_ReadBits( msg, FLOAT_INT_BITS );
+						trunc = MSG_ReadFieldBits( msg, FLOAT_INT_BITS );
 						// bias to allow equal parts positive and negative
 						trunc -= FLOAT_INT_BIAS;
 						*(float *)toF = trunc;
@@ -1243,18 +1513,18 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 						}
 					} else {
 						// full floating point value
-						*toF = MSG_ReadBits( msg, 32 );
+						*toF = MSG_ReadFieldBits( msg, 32 );
 						if ( print ) {
 							Com_Printf( "%s:%f ", field->name, *(float *)toF );
 						}
 					}
 				}
 			} else {
-				if ( MSG_ReadBits( msg, 1 ) == 0 ) {
+				if ( MSG_ReadFieldBits( msg, 1 ) == 0 ) {
 					*toF = 0;
 				} else {
 					// integer
-					*toF = MSG_ReadBits( msg, field->bits );
+					*toF = MSG_ReadFieldBits( msg, field->bits );
 					if ( print ) {
 						Com_Printf( "%s:%i ", field->name, *toF );
 					}
@@ -2107,6 +2377,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	int				*fromF, *toF;
 	float			fullFloat;
 	int				trunc, lc;
+	msgWriter_t		w;
 #ifdef _ONEBIT_COMBO
 	int				bitComboMask = 0;
 	int				numBitsInMask = 0;
@@ -2117,6 +2388,8 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		Com_Memset (&dummy, 0, sizeof(dummy));
 	}
 
+	MSG_BeginWriter( msg, &w );
+
 //=====_OPTIMIZED_VEHICLE_NETWORKING=======================================================================
 #ifdef _OPTIMIZED_VEHICLE_NETWORKING
 	if ( isVehiclePS )
@@ -2129,13 +2402,13 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		if ( to->m_iVehicleNum
 			&& (to->eFlags&EF_NODRAW) )
 		{//pilot riding *inside* a vehicle!
-			MSG_WriteBits( msg, 1, 1 );	// Pilot player state
+			MSG_WriterBits( &w, 1, 1 );	// Pilot player state
 			numFields = (int)ARRAY_LEN( pilotPlayerStateFields );
 			PSFields = pilotPlayerStateFields;
 		}
 		else
 		{//normal client
-			MSG_WriteBits( msg, 0, 1 );	// Normal player state
+			MSG_WriterBits( &w, 0, 1 );	// Normal player state
 			numFields = (int)ARRAY_LEN( playerStateFields );
 		}
 	}
@@ -2156,7 +2429,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		}
 	}
 
-	MSG_WriteByte( msg, lc );	// # of changes
+	MSG_WriterBits( &w, lc, 8 );	// # of changes
 
 #ifndef FINAL_BUILD
 	gLastBitIndex = lc;
@@ -2179,11 +2452,11 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 #endif
 
 		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 );	// no change
+			MSG_WriterBits( &w, 0, 1 );	// no change
 			continue;
 		}
 
-		MSG_WriteBits( msg, 1, 1 );	// changed
+		MSG_WriterBits( &w, 1, 1 );	// changed
 
 		if ( field->bits == 0 ) {
 			// float
@@ -2193,16 +2466,16 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 			if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
 				trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
 				// send as small integer
-				MSG_WriteBits( msg, 0, 1 );
-				MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+				MSG_WriterBits( &w, 0, 1 );
+				MSG_WriterBits( &w, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
 			} else {
 				// send as full floating point value
-				MSG_WriteBits( msg, 1, 1 );
-				MSG_WriteBits( msg, *toF, 32 );
+				MSG_WriterBits( &w, 1, 1 );
+				MSG_WriterBits( &w, *toF, 32 );
 			}
 		} else {
 			// integer
-			MSG_WriteBits( msg, *toF, field->bits );
+			MSG_WriterBits( &w, *toF, field->bits );
 		}
 	}
 
@@ -2236,19 +2509,20 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	}
 
 	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_WriterBits( &w, 0, 1 );	// no change
 		oldsize += 4;
 #ifdef _ONEBIT_COMBO
 		goto sendBitMask;
 #else
+		MSG_EndWriter( &w );
 		return;
 #endif
 	}
-	MSG_WriteBits( msg, 1, 1 );	// changed
+	MSG_WriterBits( &w, 1, 1 );	// changed
 
 	if ( statsbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, statsbits, MAX_STATS );
+		MSG_WriterBits( &w, 1, 1 );	// changed
+		MSG_WriterBits( &w, statsbits, MAX_STATS );
 		for (i=0 ; i<MAX_STATS ; i++)
 		{
 			if (statsbits & (1<<i) )
@@ -2256,49 +2530,49 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 				if (i == STAT_WEAPONS)
 				{ //ugly.. but we're gonna need it anyway -rww
 					//(just send this one in MAX_WEAPONS bits, so that we can add up to MAX_WEAPONS weaps without hassle)
-					MSG_WriteBits(msg, to->stats[i], MAX_WEAPONS);
+					MSG_WriterBits( &w, to->stats[i], MAX_WEAPONS );
 				}
 				else
 				{
-					MSG_WriteShort (msg, to->stats[i]);
+					MSG_WriterBits( &w, to->stats[i], 16 );
 				}
 			}
 		}
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_WriterBits( &w, 0, 1 );	// no change
 	}
 
 
 	if ( persistantbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, persistantbits, MAX_PERSISTANT );
+		MSG_WriterBits( &w, 1, 1 );	// changed
+		MSG_WriterBits( &w, persistantbits, MAX_PERSISTANT );
 		for (i=0 ; i<MAX_PERSISTANT ; i++)
 			if (persistantbits & (1<<i) )
-				MSG_WriteShort (msg, to->persistant[i]);
+				MSG_WriterBits( &w, to->persistant[i], 16 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_WriterBits( &w, 0, 1 );	// no change
 	}
 
 
 	if ( ammobits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, ammobits, MAX_AMMO_TRANSMIT );
+		MSG_WriterBits( &w, 1, 1 );	// changed
+		MSG_WriterBits( &w, ammobits, MAX_AMMO_TRANSMIT );
 		for (i=0 ; i<MAX_AMMO_TRANSMIT ; i++)
 			if (ammobits & (1<<i) )
-				MSG_WriteShort (msg, to->ammo[i]);
+				MSG_WriterBits( &w, to->ammo[i], 16 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_WriterBits( &w, 0, 1 );	// no change
 	}
 
 
 	if ( powerupbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, powerupbits, MAX_POWERUPS );
+		MSG_WriterBits( &w, 1, 1 );	// changed
+		MSG_WriterBits( &w, powerupbits, MAX_POWERUPS );
 		for (i=0 ; i<MAX_POWERUPS ; i++)
 			if (powerupbits & (1<<i) )
-				MSG_WriteLong( msg, to->powerups[i] );
+				MSG_WriterBits( &w, to->powerups[i], 32 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_WriterBits( &w, 0, 1 );	// no change
 	}
 
 #ifdef _ONEBIT_COMBO
@@ -2309,8 +2583,8 @@ sendBitMask:
 			bitComboMask != *bitComboDelta ||
 			numBitsInMask != *bitNumDelta)
 		{ //send the mask, it changed
-			MSG_WriteBits(msg, 1, 1);
-			MSG_WriteBits(msg, bitComboMask, numBitsInMask);
+			MSG_WriterBits( &w, 1, 1 );
+			MSG_WriterBits( &w, bitComboMask, numBitsInMask );
 			if (bitComboDelta)
 			{
 				*bitComboDelta = bitComboMask;
@@ -2319,10 +2593,12 @@ sendBitMask:
 		}
 		else
 		{ //send 1 bit 0 to indicate no change
-			MSG_WriteBits(msg, 0, 1);
+			MSG_WriterBits( &w, 0, 1 );
 		}
 	}
 #endif
+
+	MSG_EndWriter( &w );
 }
 
 
@@ -2376,7 +2652,7 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 	}
 	else
 	{
-		int isPilot = MSG_ReadBits( msg, 1 );
+		int isPilot = MSG_ReadFieldBits( msg, 1 );
 		if ( isPilot )
 		{//pilot riding *inside* a vehicle!
 			numFields = (int)ARRAY_LEN( pilotPlayerStateFields );
@@ -2411,15 +2687,15 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 		}
 #endif
 
-		if ( ! MSG_ReadBits( msg, 1 ) ) {
+		if ( ! MSG_ReadFieldBits( msg, 1 ) ) {
 			// no change
 			*toF = *fromF;
 		} else {
 			if ( field->bits == 0 ) {
 				// float
-				if ( MSG_ReadBits( msg, 1 ) == 0 ) {
+				if ( MSG_ReadFieldBits( msg, 1 ) == 0 ) {
 					// integral float
-					trunc = MSG_ReadBits( msg, FLOAT_INT_BITS );
+					trunc = MSG_ReadFieldBits( msg, FLOAT_INT_BITS );
 					// bias to allow equal parts positive and negative
 					trunc -= FLOAT_INT_BIAS;
 					*(float *)toF = trunc;
@@ -2428,14 +2704,14 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 					}
 				} else {
 					// full floating point value
-					*toF = MSG_ReadBits( msg, 32 );
+					*toF = MSG_ReadFieldBits( msg, 32 );
 					if ( print ) {
 						Com_Printf( "%s:%f ", field->name, *(float *)toF );
 					}
 				}
 			} else {
 				// integer
-				*toF = MSG_ReadBits( msg, field->bits );
+				*toF = MSG_ReadFieldBits( msg, field->bits );
 				if ( print ) {
 					Com_Printf( "%s:%i ", field->name, *toF );
 				}
@@ -2450,9 +2726,9 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 	}
 
 	// read the arrays
-	if (MSG_ReadBits( msg, 1 ) ) {
+	if (MSG_ReadFieldBits( msg, 1 ) ) {
 		// parse stats
-		if ( MSG_ReadBits( msg, 1 ) ) {
+		if ( MSG_ReadFieldBits( msg, 1 ) ) {
 			LOG("PS_STATS");
 			bits = MSG_ReadBits (msg, MAX_STATS);
 			for (i=0 ; i<MAX_STATS ; i++) {
@@ -2460,7 +2736,7 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 				{
 					if (i == STAT_WEAPONS)
 					{ //ugly.. but we're gonna need it anyway -rww
-						to->stats[i] = MSG_ReadBits(msg, MAX_WEAPONS);
+						to->stats[i] = MSG_ReadFieldBits( msg, MAX_WEAPONS );
 					}
 					else
 					{
@@ -2471,7 +2747,7 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 		}
 
 		// parse persistant stats
-		if ( MSG_ReadBits( msg, 1 ) ) {
+		if ( MSG_ReadFieldBits( msg, 1 ) ) {
 			LOG("PS_PERSISTANT");
 			bits = MSG_ReadBits (msg, MAX_PERSISTANT);
 			for (i=0 ; i<MAX_PERSISTANT ; i++) {
@@ -2482,7 +2758,7 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 		}
 
 		// parse ammo
-		if ( MSG_ReadBits( msg, 1 ) ) {
+		if ( MSG_ReadFieldBits( msg, 1 ) ) {
 			LOG("PS_AMMO");
 			bits = MSG_ReadBits (msg, MAX_AMMO_TRANSMIT);
 			for (i=0 ; i<MAX_AMMO_TRANSMIT ; i++) {
@@ -2493,7 +2769,7 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 		}
 
 		// parse powerups
-		if ( MSG_ReadBits( msg, 1 ) ) {
+		if ( MSG_ReadFieldBits( msg, 1 ) ) {
 			LOG("PS_POWERUPS");
 			bits = MSG_ReadBits (msg, MAX_POWERUPS);
 			for (i=0 ; i<MAX_POWERUPS ; i++) {
@@ -2515,9 +2791,9 @@ void MSG_ReadDeltaPlayerstate (msg_t *msg, playerState_t *from, playerState_t *t
 
 #ifdef _ONEBIT_COMBO
 	if (numBitsInMask &&
-		MSG_ReadBits( msg, 1 ))
+		MSG_ReadFieldBits( msg, 1 ))
 	{ //mask changed...
-		int newBitMask = MSG_ReadBits(msg, numBitsInMask);
+		int newBitMask = MSG_ReadFieldBits( msg, numBitsInMask );
 		int nOneBit = 0;
 
 		//we have to go through all the fields again now to match the values
@@ -3057,6 +3333,19 @@ int msg_hData[256] = {
 13504,			// 255
 };
 
+/*
+=================
+MSG_BuildHuffTables
+
+The trees are final once the frequency table has been fed in, flatten them
+so MSG_WriteBits and MSG_ReadBits don't have to walk them bit by bit.
+=================
+*/
+static void MSG_BuildHuffTables( void ) {
+	msgHuffTables = (qboolean)(Huff_BuildTable( &msgHuff.compressor, &msgHuffEncode )
+		&& Huff_BuildTable( &msgHuff.decompressor, &msgHuffDecode ));
+}
+
 #ifndef _USINGNEWHUFFTABLE_
 
 void MSG_initHuffman() {
@@ -3074,6 +3363,7 @@ void MSG_initHuffman() {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+	MSG_BuildHuffTables();
 }
 
 #else
@@ -3109,6 +3399,7 @@ void MSG_initHuffman() {
 	}
 	Com_Printf("};\n");
 	FS_FreeFile( data );
+	MSG_BuildHuffTables();
 	Cbuf_AddText( "condump dump.txt\n" );
 }
 
@@ -3124,6 +3415,356 @@ void MSG_shutdownHuffman()
 #endif // _NEWHUFFTABLE_
 }
 
+/*
+=================
+MSG_HuffmanBenchmark_f
+
+huffbench [file]
+
+Times the tree walking and the table driven msg_t Huffman coders against
+each other and checks that they agree bit for bit.  The file is a raw dump
+of the bytes snapshots push through the coder, like the netchan.bin written
+by a _NEWHUFFTABLE_ build.  Without one a stream following msg_hData is used.
+=================
+*/
+#define HUFFBENCH_SYMBOLS	(1<<20)
+#define HUFFBENCH_PASSES	8
+
+void MSG_HuffmanBenchmark_f( void ) {
+	byte		*symbols, *fileData = NULL;
+	byte		*treeBits, *tableBits;
+	int			numSymbols, maxOffset;
+	int			treeOffset, tableOffset;
+	int			treeEncode = 0, tableEncode = 0, treeDecode = 0, tableDecode = 0;
+	int			i, pass, start, ch, mismatches;
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+	if ( !msgHuffTables ) {
+		Com_Printf( "Huffman codes too long for the lookup tables, using the trees\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 ) {
+		numSymbols = FS_ReadFile( Cmd_Argv( 1 ), (void **)&fileData );
+		if ( numSymbols <= 0 ) {
+			Com_Printf( "Couldn't load %s\n", Cmd_Argv( 1 ) );
+			return;
+		}
+		symbols = fileData;
+		if ( numSymbols > HUFFBENCH_SYMBOLS * 16 ) {
+			numSymbols = HUFFBENCH_SYMBOLS * 16;
+		}
+	} else {
+		unsigned int	seed = 0x1234567;
+		int				total = 0, pick;
+
+		for ( i = 0; i < 256; i++ ) {
+			total += msg_hData[i];
+		}
+		numSymbols = HUFFBENCH_SYMBOLS;
+		symbols = (byte *)Z_Malloc( numSymbols, TAG_TEMP_WORKSPACE, qfalse );
+		for ( i = 0; i < numSymbols; i++ ) {
+			seed = seed * 1664525 + 1013904223;
+			pick = (int)(((uint64_t)(seed >> 8) * total) >> 24);
+			for ( ch = 0; pick >= msg_hData[ch]; ch++ ) {
+				pick -= msg_hData[ch];
+			}
+			symbols[i] = (byte)ch;
+		}
+	}
+
+	// no code is longer than HUFF_MAX_CODE_BITS
+	maxOffset = numSymbols * HUFF_MAX_CODE_BITS;
+	treeBits = (byte *)Z_Malloc( maxOffset / 8, TAG_TEMP_WORKSPACE, qtrue );
+	tableBits = (byte *)Z_Malloc( maxOffset / 8, TAG_TEMP_WORKSPACE, qtrue );
+
+	mismatches = 0;
+	for ( pass = 0; pass < HUFFBENCH_PASSES; pass++ ) {
+		start = Sys_Milliseconds();
+		treeOffset = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_offsetTransmit( &msgHuff.compressor, symbols[i], treeBits, &treeOffset, maxOffset );
+		}
+		treeEncode += Sys_Milliseconds() - start;
+
+		start = Sys_Milliseconds();
+		tableOffset = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_tableTransmit( &msgHuffEncode, symbols[i], tableBits, &tableOffset, maxOffset );
+		}
+		tableEncode += Sys_Milliseconds() - start;
+
+		if ( treeOffset != tableOffset || memcmp( treeBits, tableBits, (treeOffset + 7) >> 3 ) ) {
+			mismatches++;
+		}
+
+		start = Sys_Milliseconds();
+		treeOffset = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_offsetReceive( msgHuff.decompressor.tree, &ch, treeBits, &treeOffset, tableOffset );
+			if ( ch != symbols[i] ) {
+				mismatches++;
+			}
+		}
+		treeDecode += Sys_Milliseconds() - start;
+
+		start = Sys_Milliseconds();
+		treeOffset = 0;
+		for ( i = 0; i < numSymbols; i++ ) {
+			Huff_tableReceive( &msgHuffDecode, &ch, treeBits, &treeOffset, tableOffset );
+			if ( ch != symbols[i] ) {
+				mismatches++;
+			}
+		}
+		tableDecode += Sys_Milliseconds() - start;
+	}
+
+	Com_Printf( "%i symbols x %i passes, %.2f bits per symbol\n", numSymbols, HUFFBENCH_PASSES, (float)tableOffset / numSymbols );
+	Com_Printf( "encode: tree %5i msec, table %5i msec\n", treeEncode, tableEncode );
+	Com_Printf( "decode: tree %5i msec, table %5i msec\n", treeDecode, tableDecode );
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_RED "%i mismatches between the tree and table coders\n", mismatches );
+	}
+
+	Z_Free( tableBits );
+	Z_Free( treeBits );
+	if ( fileData ) {
+		FS_FreeFile( fileData );
+	} else {
+		Z_Free( symbols );
+	}
+}
+
+/*
+=================
+MSG_Benchmark_f
+
+msgbench
+
+Times MSG_WriteDeltaEntity and MSG_WriteDeltaPlayerstate on random deltas
+with the word at a time bitstream and with the bit by bit one, and checks
+that both produce the same bits and read back the same states, and that
+MSG_WriteBitString splices deltas in unchanged.
+=================
+*/
+#define MSGBENCH_ENTITIES		1024
+#define MSGBENCH_PLAYERS		64
+#define MSGBENCH_PASSES			64
+#define MSGBENCH_BUFFER			(1<<20)
+
+typedef struct msgBench_s {
+	entityState_t	entFrom[MSGBENCH_ENTITIES];
+	entityState_t	entTo[MSGBENCH_ENTITIES];
+	entityState_t	entRead[2][MSGBENCH_ENTITIES];
+	playerState_t	psFrom[MSGBENCH_PLAYERS];
+	playerState_t	psTo[MSGBENCH_PLAYERS];
+	playerState_t	psRead[2][MSGBENCH_PLAYERS];
+	byte			buffer[2][MSGBENCH_BUFFER];
+	int				size[2];
+} msgBench_t;
+
+static unsigned int msgBenchSeed;
+
+static int MSG_BenchRand( void ) {
+	msgBenchSeed = msgBenchSeed * 1664525 + 1013904223;
+	return (int)(msgBenchSeed >> 8);
+}
+
+// changes a few fields to values that fit them, like the game would
+static void MSG_BenchChangeFields( void *state, const netField_t *fields, int numFields, int changes ) {
+	const netField_t	*field;
+	int					*f, bits;
+
+	while ( changes-- ) {
+		field = &fields[MSG_BenchRand() % numFields];
+		f = (int *)((byte *)state + field->offset);
+		if ( field->bits == 0 ) {
+			if ( MSG_BenchRand() & 1 ) {
+				*(float *)f = (float)((MSG_BenchRand() & 8191) - 4096);
+			} else {
+				*(float *)f = (MSG_BenchRand() & 0xffff) * 0.37f;
+			}
+		} else {
+			bits = field->bits < 0 ? -field->bits - 1 : field->bits;
+			*f = MSG_BenchRand() & (bits >= 24 ? 0xffffff : (1 << bits) - 1);
+		}
+	}
+}
+
+static int MSG_BenchWrite( msgBench_t *bench, int mode, qboolean players ) {
+	msg_t	msg;
+	int		i, pass, start;
+
+	msgFastBits = (qboolean)(mode == 1);
+	start = Sys_Milliseconds();
+	for ( pass = 0; pass < MSGBENCH_PASSES; pass++ ) {
+		MSG_Init( &msg, bench->buffer[mode], MSGBENCH_BUFFER );
+		if ( players ) {
+			for ( i = 0; i < MSGBENCH_PLAYERS; i++ ) {
+#ifdef _ONEBIT_COMBO
+				MSG_WriteDeltaPlayerstate( &msg, &bench->psFrom[i], &bench->psTo[i], NULL, NULL );
+#else
+				MSG_WriteDeltaPlayerstate( &msg, &bench->psFrom[i], &bench->psTo[i] );
+#endif
+			}
+		} else {
+			for ( i = 0; i < MSGBENCH_ENTITIES; i++ ) {
+				MSG_WriteDeltaEntity( &msg, &bench->entFrom[i], &bench->entTo[i], qfalse );
+			}
+		}
+	}
+	bench->size[mode] = msg.cursize;
+	msgFastBits = qtrue;
+
+	return Sys_Milliseconds() - start;
+}
+
+// fills a small message past overflowing, which has to go the same way in both modes
+static qboolean MSG_BenchOverflow( msgBench_t *bench ) {
+	msg_t	msg[2];
+	int		i, mode;
+
+	for ( mode = 0; mode < 2; mode++ ) {
+		msgFastBits = (qboolean)(mode == 1);
+		MSG_Init( &msg[mode], bench->buffer[mode], MAX_MSGLEN / 16 );
+		msg[mode].allowoverflow = qtrue;
+		for ( i = 0; i < MSGBENCH_ENTITIES && !msg[mode].overflowed; i++ ) {
+			MSG_WriteDeltaEntity( &msg[mode], &bench->entFrom[i], &bench->entTo[i], qfalse );
+#ifdef _ONEBIT_COMBO
+			MSG_WriteDeltaPlayerstate( &msg[mode], &bench->psFrom[i % MSGBENCH_PLAYERS], &bench->psTo[i % MSGBENCH_PLAYERS], NULL, NULL );
+#else
+			MSG_WriteDeltaPlayerstate( &msg[mode], &bench->psFrom[i % MSGBENCH_PLAYERS], &bench->psTo[i % MSGBENCH_PLAYERS] );
+#endif
+		}
+	}
+	msgFastBits = qtrue;
+
+	return (qboolean)(msg[0].bit == msg[1].bit && msg[0].cursize == msg[1].cursize
+		&& msg[0].overflowed == msg[1].overflowed && !memcmp( msg[0].data, msg[1].data, msg[0].maxsize ));
+}
+
+// deltas written elsewhere and spliced in with MSG_WriteBitString have to
+// come out the same as writing them directly, at any bit alignment
+static qboolean MSG_BenchSplice( msgBench_t *bench ) {
+	msg_t	msg[2], delta;
+	byte	deltaBuf[MAX_MSGLEN / 16];
+	int		i, align;
+
+	for ( align = 0; align < 8; align++ ) {
+		MSG_Init( &msg[0], bench->buffer[0], MAX_MSGLEN );
+		MSG_Init( &msg[1], bench->buffer[1], MAX_MSGLEN );
+		if ( align ) {
+			MSG_WriteBits( &msg[0], 0x55, align );
+			MSG_WriteBits( &msg[1], 0x55, align );
+		}
+		for ( i = 0; i < 256; i++ ) {
+			MSG_WriteDeltaEntity( &msg[0], &bench->entFrom[i], &bench->entTo[i], (qboolean)(i & 1) );
+
+			MSG_Init( &delta, deltaBuf, sizeof( deltaBuf ) );
+			MSG_WriteDeltaEntity( &delta, &bench->entFrom[i], &bench->entTo[i], (qboolean)(i & 1) );
+			if ( !MSG_WriteBitString( &msg[1], delta.data, delta.bit ) ) {
+				return qfalse;
+			}
+		}
+		if ( msg[0].bit != msg[1].bit || msg[0].cursize != msg[1].cursize
+			|| memcmp( msg[0].data, msg[1].data, msg[0].cursize ) ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+static int MSG_BenchRead( msgBench_t *bench, int mode, qboolean players ) {
+	msg_t	msg;
+	int		i, pass, start;
+
+	msgFastBits = (qboolean)(mode == 1);
+	start = Sys_Milliseconds();
+	for ( pass = 0; pass < MSGBENCH_PASSES; pass++ ) {
+		MSG_Init( &msg, bench->buffer[1], MSGBENCH_BUFFER );
+		msg.cursize = bench->size[1];
+		MSG_BeginReading( &msg );
+		if ( players ) {
+			for ( i = 0; i < MSGBENCH_PLAYERS; i++ ) {
+				MSG_ReadDeltaPlayerstate( &msg, &bench->psFrom[i], &bench->psRead[mode][i] );
+			}
+		} else {
+			for ( i = 0; i < MSGBENCH_ENTITIES; i++ ) {
+				MSG_ReadDeltaEntity( &msg, &bench->entFrom[i], &bench->entRead[mode][i],
+					MSG_ReadBits( &msg, GENTITYNUM_BITS ) );
+			}
+		}
+	}
+	msgFastBits = qtrue;
+
+	return Sys_Milliseconds() - start;
+}
+
+void MSG_Benchmark_f( void ) {
+	msgBench_t	*bench;
+	int			i, mode, type;
+	int			writeMsec[2], readMsec[2];
+	qboolean	same;
+	static const char *names[2] = { "MSG_WriteDeltaEntity", "MSG_WriteDeltaPlayerstate" };
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+	if ( !msgHuffTables ) {
+		Com_Printf( "Huffman codes too long for the lookup tables, nothing to compare\n" );
+		return;
+	}
+
+	bench = (msgBench_t *)Z_Malloc( sizeof( *bench ), TAG_TEMP_WORKSPACE, qtrue );
+
+	msgBenchSeed = 0x1234567;
+	for ( i = 0; i < MSGBENCH_ENTITIES; i++ ) {
+		MSG_BenchChangeFields( &bench->entFrom[i], entityStateFields, (int)ARRAY_LEN( entityStateFields ), 12 );
+		bench->entTo[i] = bench->entFrom[i];
+		MSG_BenchChangeFields( &bench->entTo[i], entityStateFields, (int)ARRAY_LEN( entityStateFields ), 1 + (i & 7) );
+		bench->entFrom[i].number = bench->entTo[i].number = i;
+	}
+	for ( i = 0; i < MSGBENCH_PLAYERS; i++ ) {
+		MSG_BenchChangeFields( &bench->psFrom[i], playerStateFields, (int)ARRAY_LEN( playerStateFields ), 24 );
+		bench->psTo[i] = bench->psFrom[i];
+		MSG_BenchChangeFields( &bench->psTo[i], playerStateFields, (int)ARRAY_LEN( playerStateFields ), 4 + (i & 15) );
+		bench->psTo[i].stats[i % MAX_STATS] = i;
+		bench->psFrom[i].m_iVehicleNum = bench->psTo[i].m_iVehicleNum = 0;
+	}
+
+	Com_Printf( "%i passes, bit by bit / word at a time\n", MSGBENCH_PASSES );
+	for ( type = 0; type < 2; type++ ) {
+		for ( mode = 0; mode < 2; mode++ ) {
+			writeMsec[mode] = MSG_BenchWrite( bench, mode, (qboolean)type );
+		}
+		for ( mode = 0; mode < 2; mode++ ) {
+			readMsec[mode] = MSG_BenchRead( bench, mode, (qboolean)type );
+		}
+
+		same = (qboolean)(bench->size[0] == bench->size[1] && !memcmp( bench->buffer[0], bench->buffer[1], bench->size[0] ));
+		if ( type ) {
+			same = (qboolean)(same && !memcmp( bench->psRead[0], bench->psRead[1], sizeof( bench->psRead[0] ) ));
+		} else {
+			same = (qboolean)(same && !memcmp( bench->entRead[0], bench->entRead[1], sizeof( bench->entRead[0] ) ));
+		}
+
+		Com_Printf( "%-26s %6i bytes, write %5i / %5i msec, read %5i / %5i msec%s\n", names[type], bench->size[1],
+			writeMsec[0], writeMsec[1], readMsec[0], readMsec[1], same ? "" : S_COLOR_RED " MISMATCH" );
+	}
+
+	if ( !MSG_BenchOverflow( bench ) ) {
+		Com_Printf( S_COLOR_RED "overflowing messages differ\n" );
+	}
+	if ( !MSG_BenchSplice( bench ) ) {
+		Com_Printf( S_COLOR_RED "spliced deltas differ\n" );
+	}
+
+	Z_Free( bench );
+}
+
 /*
 =================
 MSG_ReportChangeVectors_f
@@ -71,6 +71,12 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include <sys/filio.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#define NET_BATCHED_IO		// recvmmsg, sendmmsg and epoll
+#endif
+
 typedef int SOCKET;
 #define INVALID_SOCKET                -1
 #define SOCKET_ERROR                        -1
@@ -96,6 +102,7 @@ static cvar_t	*net_ip;
 static cvar_t	*net_port;
 
 static cvar_t	*net_dropsim;
+static cvar_t	*net_batch;
 
 static struct sockaddr_in	socksRelayAddr;
 
@@ -106,6 +113,34 @@ static SOCKET	socks_socket = INVALID_SOCKET;
 static	int		numIP;
 static	byte	localIP[MAX_IPS][4];
 
+#ifdef NET_BATCHED_IO
+#define	NET_RECV_BATCH			16		// datagrams drained by one recvmmsg
+#define	NET_SEND_BATCH			64		// datagrams flushed by one sendmmsg
+#define	NET_SEND_QUEUE_BYTES	( NET_SEND_BATCH * 1400 )
+
+typedef struct netRecvBatch_s {
+	byte				data[NET_RECV_BATCH][MAX_MSGLEN + 1];
+	struct sockaddr_in	from[NET_RECV_BATCH];
+	struct iovec		iov[NET_RECV_BATCH];
+	struct mmsghdr		msgs[NET_RECV_BATCH];
+} netRecvBatch_t;
+
+typedef struct netSendQueue_s {
+	qboolean			active;			// between NET_BeginSendBatch and NET_FlushSendBatch
+	int					count;
+	int					bytes;
+	byte				data[NET_SEND_QUEUE_BYTES];
+	struct sockaddr_in	to[NET_SEND_BATCH];
+	netadrtype_t		type[NET_SEND_BATCH];
+	struct iovec		iov[NET_SEND_BATCH];
+	struct mmsghdr		msgs[NET_SEND_BATCH];
+} netSendQueue_t;
+
+static netRecvBatch_t	netRecv;
+static netSendQueue_t	netSend;
+static int				net_epoll = -1;
+#endif
+
 //=============================================================================
 
 /*
@@ -247,12 +282,50 @@ Receive one packet
 int	recvfromCount;
 #endif
 
+/*
+==================
+NET_ReadPacketAddress
+
+Fills in the sender and the message size of a received datagram, unwrapping
+it if it came through the SOCKS relay
+==================
+*/
+static qboolean NET_ReadPacketAddress( struct sockaddr_in *from, socklen_t fromlen, int ret, netadr_t *net_from, msg_t *net_message ) {
+	memset( from->sin_zero, 0, 8 );
+
+	if ( usingSocks && memcmp( from, &socksRelayAddr, fromlen ) == 0 ) {
+		if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
+			return qfalse;
+		}
+		net_from->type = NA_IP;
+		net_from->ip[0] = net_message->data[4];
+		net_from->ip[1] = net_message->data[5];
+		net_from->ip[2] = net_message->data[6];
+		net_from->ip[3] = net_message->data[7];
+		memcpy( &net_from->port, &net_message->data[8], 2 );
+		net_message->readcount = 10;
+	}
+	else {
+		SockadrToNetadr( from, net_from );
+		net_message->readcount = 0;
+	}
+
+	if( ret >= net_message->maxsize ) {
+		Com_Printf( "Oversize packet from %s\n", NET_AdrToString (net_from) );
+		return qfalse;
+	}
+
+	net_message->cursize = ret;
+	return qtrue;
+}
+
 qboolean NET_GetPacket( netadr_t *net_from, msg_t *net_message, fd_set *fdr ) {
 	int ret, err;
 	socklen_t fromlen;
 	struct sockaddr_in from;
 
-	if ( ip_socket == INVALID_SOCKET || !FD_ISSET(ip_socket, fdr) ) {
+	// no fdr means the caller already knows the socket is readable
+	if ( ip_socket == INVALID_SOCKET || ( fdr && !FD_ISSET(ip_socket, fdr) ) ) {
 		return qfalse;
 	}
 
@@ -272,32 +345,142 @@ qboolean NET_GetPacket( netadr_t *net_from, msg_t *net_message, fd_set *fdr ) {
 		return qfalse;
 	}
 
-	memset( from.sin_zero, 0, 8 );
+	return NET_ReadPacketAddress( &from, fromlen, ret, net_from, net_message );
+}
 
-	if ( usingSocks && memcmp( &from, &socksRelayAddr, fromlen ) == 0 ) {
-		if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
-			return qfalse;
-		}
-		net_from->type = NA_IP;
-		net_from->ip[0] = net_message->data[4];
-		net_from->ip[1] = net_message->data[5];
-		net_from->ip[2] = net_message->data[6];
-		net_from->ip[3] = net_message->data[7];
-		memcpy( &net_from->port, &net_message->data[8], 2 );
-		net_message->readcount = 10;
+#ifdef NET_BATCHED_IO
+/*
+==================
+NET_ReceiveBatch
+
+Drains up to NET_RECV_BATCH datagrams from s with one recvmmsg, returns how
+many arrived
+==================
+*/
+static int NET_ReceiveBatch( SOCKET s, netRecvBatch_t *batch ) {
+	int i, ret, err;
+
+	for ( i = 0 ; i < NET_RECV_BATCH ; i++ ) {
+		batch->iov[i].iov_base = batch->data[i];
+		batch->iov[i].iov_len = sizeof( batch->data[i] );
+		memset( &batch->msgs[i], 0, sizeof( batch->msgs[i] ) );
+		batch->msgs[i].msg_hdr.msg_name = &batch->from[i];
+		batch->msgs[i].msg_hdr.msg_namelen = sizeof( batch->from[i] );
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
 	}
-	else {
-		SockadrToNetadr( &from, net_from );
-		net_message->readcount = 0;
+
+#ifdef _DEBUG
+	recvfromCount++;		// performance check
+#endif
+	ret = recvmmsg( s, batch->msgs, NET_RECV_BATCH, MSG_DONTWAIT, NULL );
+
+	if ( ret == SOCKET_ERROR ) {
+		err = socketError;
+
+		if( err != EAGAIN && err != ECONNRESET )
+			Com_Printf( "NET_ReceiveBatch: %s\n", NET_ErrorString() );
+		return 0;
 	}
 
-	if( ret >= net_message->maxsize ) {
-		Com_Printf( "Oversize packet from %s\n", NET_AdrToString (net_from) );
-		return qfalse;
+	return ret;
+}
+
+/*
+==================
+NET_SendBatch
+
+Sends count prepared datagrams with as few sendmmsg calls as the kernel lets
+us, skipping over the ones that fail the way Sys_SendPacket would
+==================
+*/
+static void NET_SendBatch( SOCKET s, struct mmsghdr *msgs, const netadrtype_t *types, int count ) {
+	int sent = 0, ret, err;
+
+	while ( sent < count ) {
+		ret = sendmmsg( s, msgs + sent, count - sent, 0 );
+		if ( ret > 0 ) {
+			sent += ret;
+			continue;
+		}
+
+		// the datagram at msgs[sent] failed
+		err = socketError;
+		sent++;
+
+		// wouldblock is silent
+		if( err == EAGAIN ) {
+			continue;
+		}
+
+		// some PPP links do not allow broadcasts and return an error
+		if( err == EADDRNOTAVAIL && types && types[sent - 1] == NA_BROADCAST ) {
+			continue;
+		}
+
+		Com_Printf( "NET_SendPacket: %s\n", NET_ErrorString() );
 	}
+}
 
-	net_message->cursize = ret;
-	return qtrue;
+/*
+==================
+NET_QueuePacket
+
+Copies a datagram into the send queue, flushing it first if it is full
+==================
+*/
+static void NET_QueuePacket( int length, const void *data, const struct sockaddr_in *to, netadrtype_t type ) {
+	if ( netSend.count == NET_SEND_BATCH || netSend.bytes + length > NET_SEND_QUEUE_BYTES ) {
+		NET_SendBatch( ip_socket, netSend.msgs, netSend.type, netSend.count );
+		netSend.count = 0;
+		netSend.bytes = 0;
+	}
+
+	const int i = netSend.count++;
+	memcpy( netSend.data + netSend.bytes, data, length );
+	netSend.to[i] = *to;
+	netSend.type[i] = type;
+	netSend.iov[i].iov_base = netSend.data + netSend.bytes;
+	netSend.iov[i].iov_len = length;
+	memset( &netSend.msgs[i], 0, sizeof( netSend.msgs[i] ) );
+	netSend.msgs[i].msg_hdr.msg_name = &netSend.to[i];
+	netSend.msgs[i].msg_hdr.msg_namelen = sizeof( netSend.to[i] );
+	netSend.msgs[i].msg_hdr.msg_iov = &netSend.iov[i];
+	netSend.msgs[i].msg_hdr.msg_iovlen = 1;
+	netSend.bytes += length;
+}
+#endif
+
+/*
+==================
+NET_BeginSendBatch
+
+Packets sent until NET_FlushSendBatch are queued and go out together, where
+the platform can do that in a single call
+==================
+*/
+void NET_BeginSendBatch( void ) {
+#ifdef NET_BATCHED_IO
+	netSend.active = ( net_batch && net_batch->integer && ip_socket != INVALID_SOCKET ) ? qtrue : qfalse;
+	netSend.count = 0;
+	netSend.bytes = 0;
+#endif
+}
+
+/*
+==================
+NET_FlushSendBatch
+==================
+*/
+void NET_FlushSendBatch( void ) {
+#ifdef NET_BATCHED_IO
+	if ( netSend.count && ip_socket != INVALID_SOCKET ) {
+		NET_SendBatch( ip_socket, netSend.msgs, netSend.type, netSend.count );
+	}
+	netSend.active = qfalse;
+	netSend.count = 0;
+	netSend.bytes = 0;
+#endif
 }
 
 //=============================================================================
@@ -324,6 +507,13 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 
 	NetadrToSockadr( to, &addr );
 
+#ifdef NET_BATCHED_IO
+	if ( netSend.active && !usingSocks && length <= NET_SEND_QUEUE_BYTES ) {
+		NET_QueuePacket( length, data, &addr, to->type );
+		return;
+	}
+#endif
+
 	if( usingSocks && to->type == NA_IP ) {
 		socksBuf[0] = 0;	// reserved
 		socksBuf[1] = 0;
@@ -843,6 +1033,27 @@ void NET_OpenIP( void )
 		if ( ip_socket == INVALID_SOCKET )
 			Com_Printf( "WARNING: Couldn't bind to a v4 ip address.\n");
 	}
+
+#ifdef NET_BATCHED_IO
+	if ( ip_socket != INVALID_SOCKET ) {
+		struct epoll_event	event;
+
+		net_epoll = epoll_create1( EPOLL_CLOEXEC );
+		if ( net_epoll == -1 ) {
+			Com_Printf( "WARNING: NET_OpenIP: epoll_create1: %s\n", NET_ErrorString() );
+		}
+		else {
+			memset( &event, 0, sizeof( event ) );
+			event.events = EPOLLIN;
+			event.data.fd = ip_socket;
+			if ( epoll_ctl( net_epoll, EPOLL_CTL_ADD, ip_socket, &event ) == -1 ) {
+				Com_Printf( "WARNING: NET_OpenIP: epoll_ctl: %s\n", NET_ErrorString() );
+				close( net_epoll );
+				net_epoll = -1;
+			}
+		}
+	}
+#endif
 }
 
 //===================================================================
@@ -893,6 +1104,8 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get( "net_dropsim", "", CVAR_TEMP);
 
+	net_batch = Cvar_Get( "net_batch", "1", CVAR_ARCHIVE_ND, "Receive and send datagrams in batches and wait on the socket with epoll where the platform supports it" );
+
 	return modified ? qtrue : qfalse;
 }
 
@@ -939,6 +1152,17 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if ( stop ) {
+#ifdef NET_BATCHED_IO
+		netSend.active = qfalse;
+		netSend.count = 0;
+		netSend.bytes = 0;
+
+		if ( net_epoll != -1 ) {
+			close( net_epoll );
+			net_epoll = -1;
+		}
+#endif
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -956,6 +1180,115 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 }
 
+/*
+====================
+NET_Bench_f
+
+Bounces packets between two sockets on the loopback interface, first with
+one system call per datagram and then batched, and prints the throughput
+====================
+*/
+#define	NETBENCH_PACKETS	200000
+#define	NETBENCH_CHUNK		64		// datagrams in flight at once, well below the socket buffer
+
+static void NET_PrintBench( const char *name, int count, int received, int msec ) {
+	Com_Printf( "%-18s %7i msec (%9.0f packets/sec), %i of %i received\n",
+		name, msec, 1000.0f * count / Q_max( msec, 1 ), received, count );
+}
+
+static void NET_Bench_f( void ) {
+	SOCKET				sender, receiver;
+	struct sockaddr_in	to, from;
+	socklen_t			len;
+	byte				payload[1400];
+	byte				buf[MAX_MSGLEN + 1];
+	int					count, size, sent, received, i, n, start, err;
+
+	count = NETBENCH_PACKETS;
+	if ( Cmd_Argc() > 1 ) {
+		count = Com_Clampi( 1, 100000000, atoi( Cmd_Argv( 1 ) ) );
+	}
+	size = 600;		// about a busy snapshot
+	if ( Cmd_Argc() > 2 ) {
+		size = Com_Clampi( 1, sizeof( payload ), atoi( Cmd_Argv( 2 ) ) );
+	}
+	for ( i = 0 ; i < size ; i++ ) {
+		payload[i] = (byte)i;
+	}
+
+	sender = NET_IPSocket( "127.0.0.1", PORT_ANY, &err );
+	receiver = NET_IPSocket( "127.0.0.1", PORT_ANY, &err );
+	len = sizeof( to );
+	if ( sender == INVALID_SOCKET || receiver == INVALID_SOCKET
+		|| getsockname( receiver, (struct sockaddr *)&to, &len ) == SOCKET_ERROR ) {
+		Com_Printf( "Couldn't open the benchmark sockets.\n" );
+		if ( sender != INVALID_SOCKET )
+			closesocket( sender );
+		if ( receiver != INVALID_SOCKET )
+			closesocket( receiver );
+		return;
+	}
+
+	Com_Printf( "%i packets of %i bytes over loopback\n", count, size );
+
+	// one call per datagram, like Sys_SendPacket and NET_GetPacket
+	received = 0;
+	start = Sys_Milliseconds();
+	for ( sent = 0 ; sent < count ; sent += n ) {
+		n = Q_min( NETBENCH_CHUNK, count - sent );
+		for ( i = 0 ; i < n ; i++ ) {
+			sendto( sender, (const char *)payload, size, 0, (struct sockaddr *)&to, sizeof( to ) );
+		}
+		for ( ;; ) {
+			len = sizeof( from );
+			if ( recvfrom( receiver, (char *)buf, sizeof( buf ), 0, (struct sockaddr *)&from, &len ) == SOCKET_ERROR ) {
+				break;
+			}
+			received++;
+		}
+	}
+	NET_PrintBench( "sendto/recvfrom", count, received, Sys_Milliseconds() - start );
+
+#ifdef NET_BATCHED_IO
+	{
+		struct iovec	iov;
+		struct mmsghdr	msgs[NETBENCH_CHUNK];
+		// its own, netRecv may still hold packets NET_Event hasn't handed out
+		netRecvBatch_t	*batch = (netRecvBatch_t *)Z_Malloc( sizeof( *batch ), TAG_TEMP_WORKSPACE );
+
+		iov.iov_base = payload;
+		iov.iov_len = size;
+		memset( msgs, 0, sizeof( msgs ) );
+		for ( i = 0 ; i < NETBENCH_CHUNK ; i++ ) {
+			msgs[i].msg_hdr.msg_name = &to;
+			msgs[i].msg_hdr.msg_namelen = sizeof( to );
+			msgs[i].msg_hdr.msg_iov = &iov;
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		// the same way NET_FlushSendBatch and NET_Event do it
+		received = 0;
+		start = Sys_Milliseconds();
+		for ( sent = 0 ; sent < count ; sent += n ) {
+			n = Q_min( NETBENCH_CHUNK, count - sent );
+			NET_SendBatch( sender, msgs, NULL, n );
+			do {
+				i = NET_ReceiveBatch( receiver, batch );
+				received += i;
+			} while ( i == NET_RECV_BATCH );
+		}
+		NET_PrintBench( "sendmmsg/recvmmsg", count, received, Sys_Milliseconds() - start );
+
+		Z_Free( batch );
+	}
+#else
+	Com_Printf( "Batched socket calls are not available on this platform.\n" );
+#endif
+
+	closesocket( sender );
+	closesocket( receiver );
+}
+
 /*
 ====================
 NET_Init
@@ -976,6 +1309,7 @@ void NET_Init( void ) {
 	NET_Config( qtrue );
 
 	Cmd_AddCommand ("net_restart", NET_Restart_f, "Restart the networking sub-system" );
+	Cmd_AddCommand ("netbench", NET_Bench_f, "Measures loopback packets per second with single and batched socket calls" );
 }
 
 /*
@@ -1003,30 +1337,63 @@ Called from NET_Sleep which uses select() to determine which sockets have seen a
 ====================
 */
 
+static void NET_DispatchPacket( netadr_t *from, msg_t *netmsg )
+{
+	if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
+			return;          // drop this packet
+	}
+
+	if(com_sv_running->integer)
+		Com_RunAndTimeServerPacket(from, netmsg);
+	else
+		CL_PacketEvent(from, netmsg);
+}
+
+#ifdef NET_BATCHED_IO
+static void NET_EventBatched( void )
+{
+	netadr_t from;
+	msg_t netmsg;
+	int i, count;
+
+	do
+	{
+		count = NET_ReceiveBatch(ip_socket, &netRecv);
+
+		for(i = 0; i < count; i++)
+		{
+			MSG_Init(&netmsg, netRecv.data[i], sizeof(netRecv.data[i]));
+
+			if(NET_ReadPacketAddress(&netRecv.from[i], netRecv.msgs[i].msg_hdr.msg_namelen, netRecv.msgs[i].msg_len, &from, &netmsg))
+				NET_DispatchPacket(&from, &netmsg);
+		}
+	} while(count == NET_RECV_BATCH);
+}
+#endif
+
 void NET_Event(fd_set *fdr)
 {
 	byte bufData[MAX_MSGLEN + 1];
 	netadr_t from;
 	msg_t netmsg;
 
+#ifdef NET_BATCHED_IO
+	if(net_batch->integer && ip_socket != INVALID_SOCKET && (!fdr || FD_ISSET(ip_socket, fdr)))
+	{
+		NET_EventBatched();
+		return;
+	}
+#endif
+
 	while(1)
 	{
 		MSG_Init(&netmsg, bufData, sizeof(bufData));
 
 		if(NET_GetPacket(&from, &netmsg, fdr))
-		{
-			if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
-			{
-				// com_dropsim->value percent of incoming packets get dropped.
-				if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
-					continue;          // drop this packet
-			}
-
-			if(com_sv_running->integer)
-				Com_RunAndTimeServerPacket(&from, &netmsg);
-			else
-				CL_PacketEvent(&from, &netmsg);
-		}
+			NET_DispatchPacket(&from, &netmsg);
 		else
 			break;
 	}
@@ -1048,6 +1415,24 @@ void NET_Sleep( int msec ) {
 	if (msec < 0)
 		msec = 0;
 
+#ifdef NET_BATCHED_IO
+	if (net_batch->integer && net_epoll != -1)
+	{
+		struct epoll_event event;
+
+		retval = epoll_wait(net_epoll, &event, 1, msec);
+
+		if(retval == SOCKET_ERROR)
+		{
+			if(socketError != EINTR)
+				Com_Printf("Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString());
+		}
+		else if(retval > 0)
+			NET_Event(NULL);
+		return;
+	}
+#endif
+
 	FD_ZERO(&fdset);
 	if (ip_socket != INVALID_SOCKET) {
 		FD_SET(ip_socket, &fdset); // network socket
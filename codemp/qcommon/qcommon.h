@@ -56,6 +56,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+qboolean MSG_WriteBitString( msg_t *msg, const byte *bits, int numBits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -101,6 +102,11 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct pl
 #ifndef FINAL_BUILD
 void MSG_ReportChangeVectors_f( void );
 #endif
+void MSG_HuffmanBenchmark_f( void );
+void MSG_Benchmark_f( void );
+// qfalse keeps msg_t reads and writes on the bit by bit path, to compare the
+// word at a time one against
+void MSG_SetFastBits( qboolean fast );
 
 //============================================================================
 
@@ -148,6 +154,18 @@ const char	*NET_AdrToString (const netadr_t *a);
 qboolean	NET_StringToAdr ( const char *s, netadr_t *a);
 qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_message);
 void		NET_Sleep(int msec);
+// packets sent between these two are queued and go out together on platforms
+// that can send several datagrams with one system call
+void		NET_BeginSendBatch( void );
+void		NET_FlushSendBatch( void );
+
+// a send batch for the scope it lives in, flushed on the way out even when
+// an error is thrown through it
+class NetSendBatch {
+public:
+	NetSendBatch() { NET_BeginSendBatch(); };
+	~NetSendBatch() { NET_FlushSendBatch(); };
+};
 
 void		Sys_SendPacket( int length, const void *data, const netadr_t *to );
 //Does NOT parse port numbers, only base addresses.
@@ -583,6 +601,9 @@ qboolean	FS_ConditionalRestart( int checksumFeed );
 void	FS_Restart( int checksumFeed, qboolean inPlace = qfalse );
 // shutdown and restart the filesystem so changes to fs_gamedir can take effect
 
+void	FS_FlushDirMisses( void );
+// forget the loose files earlier lookups didn't find, so ones added since are seen
+
 char	**FS_ListFiles( const char *directory, const char *extension, int *numfiles );
 // directory should not have either a leading or trailing /
 // if extension is "/", only subdirectories will be returned
@@ -630,6 +651,10 @@ int		FS_Write( const void *buffer, int len, fileHandle_t f );
 int		FS_Read( void *buffer, int len, fileHandle_t f );
 // properly handles partial reads and reads from other dlls
 
+const void *FS_MapFile( fileHandle_t f, sysFileMapping_t *mapping );
+// read-only view of a plain or stored pk3 file opened with FS_FOpenFileRead,
+// NULL if it can't be mapped.  Release it with Sys_UnmapFile
+
 void	FS_FCloseFile( fileHandle_t f );
 // note: you can't just fclose from another DLL, due to MS libc issues
 
@@ -641,6 +666,13 @@ long		FS_ReadFile( const char *qpath, void **buffer );
 // the buffer should be considered read-only, because it may be cached
 // for other uses.
 
+void	FS_PrefetchFiles( const char **qpaths, int count );
+// starts loading files in the background, a later FS_ReadFile of one of
+// them takes the loaded data instead of reading it.  Replaces the previous list
+
+void	FS_CancelPrefetch( void );
+// drops whatever was prefetched and not read yet
+
 void	FS_ForceFlush( fileHandle_t f );
 // forces flush on files we're writing to.
 
@@ -1030,6 +1062,18 @@ typedef struct huffman_s {
 	huff_t		decompressor;
 } huffman_t;
 
+#define HUFF_LOOKUP_BITS	12		// codes up to this long decode with a single lookup
+#define HUFF_MAX_CODE_BITS	32
+
+// Flattened form of a tree that no longer changes, for the msg_t bitstream.
+// Produces exactly the same bits as Huff_offsetTransmit/Huff_offsetReceive.
+typedef struct huffTable_s {
+	node_t		*tree;								// walked for codes longer than HUFF_LOOKUP_BITS
+	uint32_t	code[HMAX+1];						// bits in transmission order, first bit in bit 0
+	byte		length[HMAX+1];						// 0 if the symbol isn't in the tree
+	uint16_t	lookup[1<<HUFF_LOOKUP_BITS];		// symbol | length << 9, 0 if the code is longer
+} huffTable_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1040,6 +1084,9 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+qboolean Huff_BuildTable( const huff_t *huff, huffTable_t *table );
+void	Huff_tableTransmit( const huffTable_t *table, int ch, byte *fout, int *offset, int maxoffset );
+void	Huff_tableReceive( const huffTable_t *table, int *ch, const byte *fin, int *offset, int maxoffset );
 
 extern huffman_t clientHuffTables;
 
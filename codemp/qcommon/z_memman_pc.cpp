@@ -38,6 +38,7 @@ const static char *psTagStrings[TAG_COUNT+1]=	// +1 because TAG_COUNT will itsel
 ////////////////////////////////////////////////
 
 static void Z_Details_f(void);
+static void Z_Bench_f(void);
 void CIN_CloseAllVideos();
 
 
@@ -51,6 +52,7 @@ typedef struct zoneHeader_s
 		int					iMagic;
 		memtag_t			eTag;
 		int					iSize;
+		int					iSlabClass;		// -1 for blocks from malloc
 struct	zoneHeader_s		*pNext;
 struct	zoneHeader_s		*pPrev;
 } zoneHeader_t;
@@ -85,16 +87,44 @@ typedef struct zoneStats_s
 
 } zoneStats_t;
 
+// Every tag keeps its own block list so Z_TagFree() only has to visit the
+//	blocks it's actually going to free, rather than everything in the zone...
+//
 typedef struct zone_s
 {
 	zoneStats_t				Stats;
-	zoneHeader_t			Header;
+	zoneHeader_t			Headers[TAG_COUNT];
 } zone_t;
 
 cvar_t	*com_validateZone;
 
 zone_t	TheZone = {};
 
+static inline void Zone_LinkBlock(zoneHeader_t *pMemory)
+{
+	zoneHeader_t *pHead = &TheZone.Headers[pMemory->eTag];
+
+	pMemory->pNext = pHead->pNext;
+	pHead->pNext = pMemory;
+	if (pMemory->pNext)
+	{
+		pMemory->pNext->pPrev = pMemory;
+	}
+	pMemory->pPrev = pHead;
+}
+
+static inline void Zone_UnlinkBlock(zoneHeader_t *pMemory)
+{
+	assert(pMemory->pPrev->pNext == pMemory);
+	assert(!pMemory->pNext || (pMemory->pNext->pPrev == pMemory));
+
+	pMemory->pPrev->pNext = pMemory->pNext;
+	if (pMemory->pNext)
+	{
+		pMemory->pNext->pPrev = pMemory->pPrev;
+	}
+}
+
 
 // Scans through the linked list of mallocs and makes sure no data has been overwritten
 
@@ -105,32 +135,41 @@ void Z_Validate(void)
 		return;
 	}
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	for (memtag_t iTag = 0; iTag < TAG_COUNT; iTag++)
 	{
-		#ifdef DETAILED_ZONE_DEBUG_CODE
-		// this won't happen here, but wtf?
-		int& iAllocCount = mapAllocatedZones[pMemory];
-		if (iAllocCount <= 0)
+		zoneHeader_t *pMemory = TheZone.Headers[iTag].pNext;
+		while (pMemory)
 		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Bad block allocation count!");
-			return;
-		}
-		#endif
+			#ifdef DETAILED_ZONE_DEBUG_CODE
+			// this won't happen here, but wtf?
+			int& iAllocCount = mapAllocatedZones[pMemory];
+			if (iAllocCount <= 0)
+			{
+				Com_Error(ERR_FATAL, "Z_Validate(): Bad block allocation count!");
+				return;
+			}
+			#endif
 
-		if(pMemory->iMagic != ZONE_MAGIC)
-		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone header!");
-			return;
-		}
+			if(pMemory->iMagic != ZONE_MAGIC)
+			{
+				Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone header!");
+				return;
+			}
 
-		if (ZoneTailFromHeader(pMemory)->iMagic != ZONE_MAGIC)
-		{
-			Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone tail!");
-			return;
-		}
+			if(pMemory->eTag != iTag)
+			{
+				Com_Error(ERR_FATAL, "Z_Validate(): Block on the wrong tag list!");
+				return;
+			}
+
+			if (ZoneTailFromHeader(pMemory)->iMagic != ZONE_MAGIC)
+			{
+				Com_Error(ERR_FATAL, "Z_Validate(): Corrupt zone tail!");
+				return;
+			}
 
-		pMemory = pMemory->pNext;
+			pMemory = pMemory->pNext;
+		}
 	}
 }
 
@@ -154,21 +193,242 @@ typedef struct StaticMem_s {
 #pragma pack(pop)
 
 StaticZeroMem_t gZeroMalloc  =
-	{ {ZONE_MAGIC, TAG_STATIC,0,NULL,NULL},{ZONE_MAGIC}};
+	{ {ZONE_MAGIC, TAG_STATIC,0,-1,NULL,NULL},{ZONE_MAGIC}};
 StaticMem_t gEmptyString =
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'\0','\0'},{ZONE_MAGIC}};
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'\0','\0'},{ZONE_MAGIC}};
 StaticMem_t gNumberString[] = {
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'0','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'1','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'2','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'3','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'4','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'5','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'6','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'7','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'8','\0'},{ZONE_MAGIC}},
-	{ {ZONE_MAGIC, TAG_STATIC,2,NULL,NULL},{'9','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'0','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'1','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'2','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'3','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'4','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'5','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'6','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'7','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'8','\0'},{ZONE_MAGIC}},
+	{ {ZONE_MAGIC, TAG_STATIC,2,-1,NULL,NULL},{'9','\0'},{ZONE_MAGIC}},
+};
+
+// Blocks of up to SLAB_MAX_SIZE bytes come out of slab pages instead of
+// malloc.  Every page holds blocks of one size class and sits on its class's
+// list while it has room, a page nothing lives in any more goes back to the
+// system unless it's the last one with room.  Like the rest of the zone this
+// is only for the main thread, see sys_jobs.h
+//
+#define SLAB_PAGE_SIZE		(64*1024)		// pages are aligned to their size
+#define SLAB_PAGE_HEADER	64
+#define SLAB_MAX_SIZE		4096
+#define SLAB_GRANULARITY	16
+
+static const int slabClassSizes[] = {
+	16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512,
+	640, 768, 1024, 1280, 1536, 2048, 2560, 3072, 4096
 };
+#define NUM_SLAB_CLASSES	ARRAY_LEN(slabClassSizes)
+
+typedef struct slabPage_s
+{
+struct	slabPage_s		*pNext;		// pages of the class that have room
+struct	slabPage_s		*pPrev;
+		void			*pFree;		// blocks given back
+		byte			*pUnused;	// never handed out so far
+		int				iClass;
+		int				iUsed;
+} slabPage_t;
+
+typedef struct slabClass_s
+{
+	int				iBlockSize;
+	int				iPages;
+	int				iUsed;
+	slabPage_t		*pPartial;
+} slabClass_t;
+
+static slabClass_t	slabClasses[NUM_SLAB_CLASSES];
+static byte			slabClassForSize[SLAB_MAX_SIZE / SLAB_GRANULARITY + 1];
+static qboolean		slabsInitialised = qfalse;
+static qboolean		slabsBypassed = qfalse;		// zone_bench's malloc pass
+cvar_t				*com_zoneSlabs;
+
+static void Zone_InitSlabs(void)
+{
+	int iClass = 0;
+	for (int i = 0; i <= SLAB_MAX_SIZE / SLAB_GRANULARITY; i++)
+	{
+		while (slabClassSizes[iClass] < i * SLAB_GRANULARITY)
+		{
+			iClass++;
+		}
+		slabClassForSize[i] = iClass;
+	}
+
+	for (size_t i = 0; i < NUM_SLAB_CLASSES; i++)
+	{
+		// room for the header, the tail and the next header's alignment
+		int iBlockSize = sizeof(zoneHeader_t) + slabClassSizes[i] + sizeof(zoneTail_t);
+		slabClasses[i].iBlockSize = (iBlockSize + SLAB_GRANULARITY - 1) & ~(SLAB_GRANULARITY - 1);
+	}
+
+	slabsInitialised = qtrue;
+}
+
+static slabPage_t *Zone_AllocSlabPage(void)
+{
+#ifdef _WIN32
+	return (slabPage_t *) _aligned_malloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+#else
+	void *pPage;
+	if (posix_memalign(&pPage, SLAB_PAGE_SIZE, SLAB_PAGE_SIZE))
+	{
+		return NULL;
+	}
+	return (slabPage_t *) pPage;
+#endif
+}
+
+static void Zone_FreeSlabPage(slabPage_t *pPage)
+{
+#ifdef _WIN32
+	_aligned_free(pPage);
+#else
+	free(pPage);
+#endif
+}
+
+static inline qboolean Zone_SlabPageFull(const slabPage_t *pPage)
+{
+	return (qboolean)(!pPage->pFree && pPage->pUnused + slabClasses[pPage->iClass].iBlockSize > (byte *)pPage + SLAB_PAGE_SIZE);
+}
+
+static void Zone_LinkSlabPage(slabClass_t *pClass, slabPage_t *pPage)
+{
+	pPage->pPrev = NULL;
+	pPage->pNext = pClass->pPartial;
+	if (pPage->pNext)
+	{
+		pPage->pNext->pPrev = pPage;
+	}
+	pClass->pPartial = pPage;
+}
+
+static void Zone_UnlinkSlabPage(slabClass_t *pClass, slabPage_t *pPage)
+{
+	if (pPage->pPrev)
+	{
+		pPage->pPrev->pNext = pPage->pNext;
+	}
+	else
+	{
+		pClass->pPartial = pPage->pNext;
+	}
+	if (pPage->pNext)
+	{
+		pPage->pNext->pPrev = pPage->pPrev;
+	}
+}
+
+// the slab size class for an iSize, -1 if it has to come from malloc
+//
+static inline int Zone_SlabClass(int iSize)
+{
+	if (iSize > SLAB_MAX_SIZE || slabsBypassed || (com_zoneSlabs && !com_zoneSlabs->integer))
+	{
+		return -1;
+	}
+	if (!slabsInitialised)
+	{
+		Zone_InitSlabs();
+	}
+	return slabClassForSize[(iSize + SLAB_GRANULARITY - 1) / SLAB_GRANULARITY];
+}
+
+static void *Zone_SlabAlloc(int iClass)
+{
+	slabClass_t	*pClass = &slabClasses[iClass];
+	slabPage_t	*pPage = pClass->pPartial;
+	void		*pBlock;
+
+	if (!pPage)
+	{
+		pPage = Zone_AllocSlabPage();
+		if (!pPage)
+		{
+			return NULL;	// let the malloc path try to free something up
+		}
+		memset(pPage, 0, sizeof(*pPage));
+		pPage->iClass = iClass;
+		pPage->pUnused = (byte *)pPage + SLAB_PAGE_HEADER;
+		Zone_LinkSlabPage(pClass, pPage);
+		pClass->iPages++;
+	}
+
+	if (pPage->pFree)
+	{
+		pBlock = pPage->pFree;
+		pPage->pFree = *(void **)pBlock;
+	}
+	else
+	{
+		pBlock = pPage->pUnused;
+		pPage->pUnused += pClass->iBlockSize;
+	}
+	pPage->iUsed++;
+	pClass->iUsed++;
+
+	if (Zone_SlabPageFull(pPage))
+	{
+		Zone_UnlinkSlabPage(pClass, pPage);
+	}
+
+	return pBlock;
+}
+
+static void Zone_SlabFree(void *pBlock)
+{
+	slabPage_t	*pPage = (slabPage_t *)((uintptr_t)pBlock & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+	slabClass_t	*pClass = &slabClasses[pPage->iClass];
+
+	if (Zone_SlabPageFull(pPage))
+	{
+		Zone_LinkSlabPage(pClass, pPage);
+	}
+
+	// this also wipes the block's magic, so a second free of it is caught
+	*(void **)pBlock = pPage->pFree;
+	pPage->pFree = pBlock;
+	pPage->iUsed--;
+	pClass->iUsed--;
+
+	if (!pPage->iUsed && (pPage->pPrev || pPage->pNext))
+	{
+		Zone_UnlinkSlabPage(pClass, pPage);
+		Zone_FreeSlabPage(pPage);
+		pClass->iPages--;
+	}
+}
+
+// gives back the pages that are kept around empty
+//
+static void Zone_ReleaseEmptySlabs(void)
+{
+	for (size_t i = 0; i < NUM_SLAB_CLASSES; i++)
+	{
+		slabClass_t	*pClass = &slabClasses[i];
+		slabPage_t	*pPage = pClass->pPartial;
+		while (pPage)
+		{
+			slabPage_t *pNext = pPage->pNext;
+			if (!pPage->iUsed)
+			{
+				Zone_UnlinkSlabPage(pClass, pPage);
+				Zone_FreeSlabPage(pPage);
+				pClass->iPages--;
+			}
+			pPage = pNext;
+		}
+	}
+}
+
 
 qboolean gbMemFreeupOccured = qfalse;
 void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iUnusedAlign /* = 4 */)
@@ -188,6 +448,19 @@ void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iU
 	// Allocate a chunk...
 	//
 	zoneHeader_t *pMemory = NULL;
+	int iSlabClass = Zone_SlabClass(iSize);
+	if (iSlabClass >= 0)
+	{
+		pMemory = (zoneHeader_t *) Zone_SlabAlloc(iSlabClass);
+		if (!pMemory)
+		{
+			iSlabClass = -1;
+		}
+		else if (bZeroit)
+		{
+			memset(pMemory, 0, iRealSize);
+		}
+	}
 	while (pMemory == NULL)
 	{
 		if (gbMemFreeupOccured)
@@ -286,13 +559,8 @@ void *Z_Malloc(int iSize, memtag_t eTag, qboolean bZeroit /* = qfalse */, int iU
 	pMemory->iMagic	= ZONE_MAGIC;
 	pMemory->eTag	= eTag;
 	pMemory->iSize	= iSize;
-	pMemory->pNext  = TheZone.Header.pNext;
-	TheZone.Header.pNext = pMemory;
-	if (pMemory->pNext)
-	{
-		pMemory->pNext->pPrev = pMemory;
-	}
-	pMemory->pPrev = &TheZone.Header;
+	pMemory->iSlabClass = iSlabClass;
+	Zone_LinkBlock(pMemory);
 	//
 	// add tail...
 	//
@@ -356,9 +624,11 @@ void Z_MorphMallocTag( void *pvAddress, memtag_t eDesiredTag )
 	TheZone.Stats.iSizesPerTag	[pMemory->eTag] -= pMemory->iSize;
 	TheZone.Stats.iCountsPerTag	[pMemory->eTag]--;
 
-	// morph...
+	// morph, moving it over to the new tag's list...
 	//
+	Zone_UnlinkBlock(pMemory);
 	pMemory->eTag = eDesiredTag;
+	Zone_LinkBlock(pMemory);
 
 	// INC new tag stats...
 	//
@@ -379,19 +649,17 @@ static void Zone_FreeBlock(zoneHeader_t *pMemory)
 		TheZone.Stats.iSizesPerTag	[pMemory->eTag] -= pMemory->iSize;
 		TheZone.Stats.iCountsPerTag	[pMemory->eTag]--;
 
-		// Sanity checks...
-		//
-		assert(pMemory->pPrev->pNext == pMemory);
-		assert(!pMemory->pNext || (pMemory->pNext->pPrev == pMemory));
-
 		// Unlink and free...
 		//
-		pMemory->pPrev->pNext = pMemory->pNext;
-		if(pMemory->pNext)
+		Zone_UnlinkBlock(pMemory);
+		if (pMemory->iSlabClass >= 0)
+		{
+			Zone_SlabFree(pMemory);
+		}
+		else
 		{
-			pMemory->pNext->pPrev = pMemory->pPrev;
+			free (pMemory);
 		}
-		free (pMemory);
 
 
 		#ifdef DETAILED_ZONE_DEBUG_CODE
@@ -477,6 +745,17 @@ int Z_MemSize(memtag_t eTag)
 	return TheZone.Stats.iSizesPerTag[eTag];
 }
 
+static void Zone_FreeTagList(memtag_t eTag)
+{
+	zoneHeader_t *pMemory = TheZone.Headers[eTag].pNext;
+	while (pMemory)
+	{
+		zoneHeader_t *pNext = pMemory->pNext;
+		Zone_FreeBlock(pMemory);
+		pMemory = pNext;
+	}
+}
+
 // Frees all blocks with the specified tag...
 //
 void Z_TagFree(memtag_t eTag)
@@ -485,15 +764,16 @@ void Z_TagFree(memtag_t eTag)
 //	int iZoneBlocks = TheZone.Stats.iCount;
 //#endif
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	if (eTag == TAG_ALL)
 	{
-		zoneHeader_t *pNext = pMemory->pNext;
-		if ( (eTag == TAG_ALL) || (pMemory->eTag == eTag))
+		for (int iTag = 0; iTag < TAG_COUNT; iTag++)
 		{
-			Zone_FreeBlock(pMemory);
+			Zone_FreeTagList((memtag_t)iTag);
 		}
-		pMemory = pNext;
+	}
+	else
+	{
+		Zone_FreeTagList(eTag);
 	}
 
 // these stupid pragmas don't work here???!?!?!
@@ -548,6 +828,16 @@ static void Z_Stats_f(void)
 									TheZone.Stats.iPeak,
 									         (float)TheZone.Stats.iPeak / 1024.0f / 1024.0f
 				);
+
+	int iPages = 0, iBlocks = 0;
+	for (size_t i = 0; i < NUM_SLAB_CLASSES; i++)
+	{
+		iPages	+= slabClasses[i].iPages;
+		iBlocks	+= slabClasses[i].iUsed;
+	}
+	Com_Printf("%d of the blocks are in %d slab pages (%.2fMB)\n",
+									iBlocks, iPages, (float)iPages * SLAB_PAGE_SIZE / 1024.0f / 1024.0f
+				);
 }
 
 // Gives a detailed breakdown of the memory blocks in the zone
@@ -583,6 +873,150 @@ static void Z_Details_f(void)
 	Z_Stats_f();
 }
 
+// Mixes allocations of string and small struct sizes with frees of random
+// live blocks, the way level loads and CopyString churn the zone.  The same
+// sequence runs once from the slab pages and once from malloc
+//
+#define ZONEBENCH_SLOTS		4096
+#define ZONEBENCH_OPS		2000000
+
+static int Z_BenchSize(int *piSeed)
+{
+	int r = Q_rand(piSeed) & 0x7fffffff;
+	switch (r % 20)
+	{
+	case 0:
+		return 1024 + (r >> 8) % 3073;
+	case 1: case 2: case 3: case 4: case 5:
+		return 64 + (r >> 8) % 961;
+	default:
+		return 8 + (r >> 8) % 57;
+	}
+}
+
+static int Z_BenchRun(void **ppSlots, int iOps)
+{
+	int iSeed = 0x5eed;
+	int iStart = Sys_Milliseconds();
+
+	for (int i = 0; i < iOps; i++)
+	{
+		int iSlot = (Q_rand(&iSeed) & 0x7fffffff) % ZONEBENCH_SLOTS;
+		int iSize = Z_BenchSize(&iSeed);
+		if (ppSlots[iSlot])
+		{
+			Z_Free(ppSlots[iSlot]);
+			ppSlots[iSlot] = NULL;
+		}
+		else
+		{
+			ppSlots[iSlot] = Z_Malloc(iSize, TAG_SPECIAL_MEM_TEST, qfalse);
+		}
+	}
+	for (int i = 0; i < ZONEBENCH_SLOTS; i++)
+	{
+		Z_Free(ppSlots[i]);
+		ppSlots[i] = NULL;
+	}
+
+	return Sys_Milliseconds() - iStart;
+}
+
+// Frees one tag's worth of blocks from under a pile of long-lived blocks
+//	from other tags, the way Hunk_Clear() does on every map change.  The
+//	full walk visits every block in the zone the way Z_TagFree() used to
+//
+#define ZONEBENCH_LIVE		100000
+#define ZONEBENCH_TAGFREES	2000
+#define ZONEBENCH_TAGBLOCKS	64
+
+static void Z_BenchFullWalkFree(memtag_t eTag)
+{
+	for (int iTag = 0; iTag < TAG_COUNT; iTag++)
+	{
+		zoneHeader_t *pMemory = TheZone.Headers[iTag].pNext;
+		while (pMemory)
+		{
+			zoneHeader_t *pNext = pMemory->pNext;
+			if (pMemory->eTag == eTag)
+			{
+				Zone_FreeBlock(pMemory);
+			}
+			pMemory = pNext;
+		}
+	}
+}
+
+static int Z_BenchTagFreeRun(qboolean bFullWalk)
+{
+	int iStart = Sys_Milliseconds();
+
+	for (int i = 0; i < ZONEBENCH_TAGFREES; i++)
+	{
+		for (int j = 0; j < ZONEBENCH_TAGBLOCKS; j++)
+		{
+			Z_Malloc(64, TAG_SPECIAL_MEM_TEST, qfalse);
+		}
+		if (bFullWalk)
+		{
+			Z_BenchFullWalkFree(TAG_SPECIAL_MEM_TEST);
+		}
+		else
+		{
+			Z_TagFree(TAG_SPECIAL_MEM_TEST);
+		}
+	}
+
+	return Sys_Milliseconds() - iStart;
+}
+
+static void Z_Bench_f(void)
+{
+	int iOps = ZONEBENCH_OPS;
+	if (Cmd_Argc() > 1)
+	{
+		iOps = Com_Clampi(1, 100000000, atoi(Cmd_Argv(1)));
+	}
+
+	if (com_zoneSlabs && !com_zoneSlabs->integer)
+	{
+		Com_Printf("com_zoneSlabs is 0, both runs use malloc\n");
+	}
+
+	// outside the zone so it doesn't take part
+	void **ppSlots = (void **) calloc(ZONEBENCH_SLOTS, sizeof(void *));
+
+	int iSlabMsec = Z_BenchRun(ppSlots, iOps);
+	slabsBypassed = qtrue;
+	int iMallocMsec = Z_BenchRun(ppSlots, iOps);
+	slabsBypassed = qfalse;
+
+	free(ppSlots);
+
+	Com_Printf("%d allocations and frees of up to 4KB, %d live blocks at most\n", iOps, ZONEBENCH_SLOTS);
+	Com_Printf("slab pages %6d msec (%6.1f nsec each)\n", iSlabMsec, 1000000.0f * iSlabMsec / iOps);
+	Com_Printf("malloc     %6d msec (%6.1f nsec each)\n", iMallocMsec, 1000000.0f * iMallocMsec / iOps);
+
+	void **ppLive = (void **) malloc(ZONEBENCH_LIVE * sizeof(void *));
+	for (int i = 0; i < ZONEBENCH_LIVE; i++)
+	{
+		ppLive[i] = Z_Malloc(32, TAG_SMALL, qfalse);
+	}
+
+	int iTagMsec = Z_BenchTagFreeRun(qfalse);
+	int iWalkMsec = Z_BenchTagFreeRun(qtrue);
+
+	for (int i = 0; i < ZONEBENCH_LIVE; i++)
+	{
+		Z_Free(ppLive[i]);
+	}
+	free(ppLive);
+
+	Com_Printf("%d tag frees of %d blocks with %d other blocks live\n", ZONEBENCH_TAGFREES, ZONEBENCH_TAGBLOCKS, TheZone.Stats.iCount + ZONEBENCH_LIVE);
+	Com_Printf("tag list   %6d msec (%6.1f usec each)\n", iTagMsec, 1000.0f * iTagMsec / ZONEBENCH_TAGFREES);
+	Com_Printf("full walk  %6d msec (%6.1f usec each)\n", iWalkMsec, 1000.0f * iWalkMsec / ZONEBENCH_TAGFREES);
+}
+
 // Shuts down the zone memory system and frees up all memory
 void Com_ShutdownZoneMemory(void)
 {
@@ -590,6 +1024,7 @@ void Com_ShutdownZoneMemory(void)
 
 	Cmd_RemoveCommand("zone_stats");
 	Cmd_RemoveCommand("zone_details");
+	Cmd_RemoveCommand("zone_bench");
 
 	if(TheZone.Stats.iCount)
 	{
@@ -599,6 +1034,8 @@ void Com_ShutdownZoneMemory(void)
 		assert(!TheZone.Stats.iCount);
 		assert(!TheZone.Stats.iCurrent);
 	}
+
+	Zone_ReleaseEmptySlabs();
 }
 
 // Initialises the zone memory system
@@ -606,7 +1043,11 @@ void Com_ShutdownZoneMemory(void)
 void Com_InitZoneMemory( void )
 {
 	memset(&TheZone, 0, sizeof(TheZone));
-	TheZone.Header.iMagic = ZONE_MAGIC;
+	for (int i = 0; i < TAG_COUNT; i++)
+	{
+		TheZone.Headers[i].iMagic = ZONE_MAGIC;
+		TheZone.Headers[i].eTag = (memtag_t)i;
+	}
 }
 
 void Com_InitZoneMemoryVars( void ) {
@@ -615,9 +1056,11 @@ void Com_InitZoneMemoryVars( void ) {
 //#else
 	com_validateZone = Cvar_Get("com_validateZone", "0", 0);
 //#endif
+	com_zoneSlabs = Cvar_Get("com_zoneSlabs", "1", 0, "Serve zone blocks of up to 4KB from slab pages instead of malloc");
 
 	Cmd_AddCommand("zone_stats", Z_Stats_f, "Prints out zone memory stats" );
 	Cmd_AddCommand("zone_details", Z_Details_f, "Prints out full detailed zone memory info" );
+	Cmd_AddCommand("zone_bench", Z_Bench_f, "Measures small zone allocations with and without the slab pages, and tag frees" );
 
 #ifdef _DEBUG
 	Cmd_AddCommand("zone_memrecovertest", Z_MemRecoverTest_f);
@@ -673,16 +1116,19 @@ void Com_TouchMemory( void ) {
 
 	sum = 0;
 
-	zoneHeader_t *pMemory = TheZone.Header.pNext;
-	while (pMemory)
+	for (int iTag = 0; iTag < TAG_COUNT; iTag++)
 	{
-		byte *pMem = (byte *) &pMemory[1];
-		j = pMemory->iSize >> 2;
-		for (i=0; i<j; i+=64){
-			sum += ((unsigned int*)pMem)[i];
-		}
+		zoneHeader_t *pMemory = TheZone.Headers[iTag].pNext;
+		while (pMemory)
+		{
+			byte *pMem = (byte *) &pMemory[1];
+			j = pMemory->iSize >> 2;
+			for (i=0; i<j; i+=64){
+				sum += ((unsigned int*)pMem)[i];
+			}
 
-		pMemory = pMemory->pNext;
+			pMemory = pMemory->pNext;
+		}
 	}
 
 //	end = Sys_Milliseconds();
@@ -0,0 +1,277 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+#pragma once
+
+/*
+==============================================================
+
+GHOUL2 BONE AND SKINNING KERNELS
+
+Shared by every renderer that evaluates Ghoul2 skeletons.  Each kernel has
+a scalar version with the arithmetic the renderers always used and, on
+x86-64, an SSE version that does the same operations in the same order four
+lanes at a time, so the two give bit identical results.  That only holds
+while the compiler doesn't fuse the scalar multiplies and adds, so builds
+with FMA enabled stay on the scalar kernels, like the packed brush tests in
+cm_trace.cpp.
+
+Include it after the renderer's tr_local.h, which brings in mdx_format.h
+with the bone struct the way the Ghoul2 headers want it.
+
+==============================================================
+*/
+
+#if ( defined(__x86_64__) || defined(_M_X64) ) && !defined(__FMA__)
+	#define MDX_SIMD_SSE
+	#include <emmintrin.h>
+#endif
+
+// out = in2 * in, the way Multiply_3x4Matrix has always done it
+static QINLINE void Mdx_Multiply3x4_Scalar( mdxaBone_t *out, const mdxaBone_t *in2, const mdxaBone_t *in ) {
+	int i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		const float n0 = in2->matrix[i][0], n1 = in2->matrix[i][1], n2 = in2->matrix[i][2], n3 = in2->matrix[i][3];
+
+		out->matrix[i][0] = (n0 * in->matrix[0][0]) + (n1 * in->matrix[1][0]) + (n2 * in->matrix[2][0]);
+		out->matrix[i][1] = (n0 * in->matrix[0][1]) + (n1 * in->matrix[1][1]) + (n2 * in->matrix[2][1]);
+		out->matrix[i][2] = (n0 * in->matrix[0][2]) + (n1 * in->matrix[1][2]) + (n2 * in->matrix[2][2]);
+		out->matrix[i][3] = (n0 * in->matrix[0][3]) + (n1 * in->matrix[1][3]) + (n2 * in->matrix[2][3]) + n3;
+	}
+}
+
+// out = aFrac * a + bFrac * b, element by element
+static QINLINE void Mdx_LerpBone_Scalar( mdxaBone_t *out, const mdxaBone_t *a, float aFrac, const mdxaBone_t *b, float bFrac ) {
+	int j;
+
+	for ( j = 0 ; j < 12 ; j++ ) {
+		((float *)out)[j] = (aFrac * ((const float *)a)[j]) + (bFrac * ((const float *)b)[j]);
+	}
+}
+
+// same as MC_UnCompressQuat
+static QINLINE void Mdx_UnCompressQuat_Scalar( float mat[3][4], const unsigned char *comp ) {
+	unsigned short	in[7];
+	float			q[4], t[3];
+	int				i;
+
+	memcpy( in, comp, sizeof( in ) );
+	for ( i = 0 ; i < 4 ; i++ ) {
+		q[i] = in[i];
+		q[i] /= 16383.0f;
+		q[i] -= 2.0f;
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		t[i] = in[4 + i];
+		t[i] /= 64;
+		t[i] -= 512;
+	}
+
+	const float w = q[0], x = q[1], y = q[2], z = q[3];
+	const float fTx = 2.0f*x, fTy = 2.0f*y, fTz = 2.0f*z;
+	const float fTwx = fTx*w, fTwy = fTy*w, fTwz = fTz*w;
+	const float fTxx = fTx*x, fTxy = fTy*x, fTxz = fTz*x;
+	const float fTyy = fTy*y, fTyz = fTz*y, fTzz = fTz*z;
+
+	mat[0][0] = 1.0f-(fTyy+fTzz);
+	mat[0][1] = fTxy-fTwz;
+	mat[0][2] = fTxz+fTwy;
+	mat[0][3] = t[0];
+	mat[1][0] = fTxy+fTwz;
+	mat[1][1] = 1.0f-(fTxx+fTzz);
+	mat[1][2] = fTyz-fTwx;
+	mat[1][3] = t[1];
+	mat[2][0] = fTxz-fTwy;
+	mat[2][1] = fTyz+fTwx;
+	mat[2][2] = 1.0f-(fTxx+fTyy);
+	mat[2][3] = t[2];
+}
+
+#ifdef MDX_SIMD_SSE
+static QINLINE __m128 Mdx_Splat( __m128 v, int lane ) {
+	switch ( lane ) {
+	case 0:		return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+	case 1:		return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+	case 2:		return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+	default:	return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	}
+}
+
+static QINLINE void Mdx_Multiply3x4_SSE( mdxaBone_t *out, const mdxaBone_t *in2, const mdxaBone_t *in ) {
+	// adding -0.0f leaves every float as it is, signed zeros included, so the
+	// translation can go in with one add across the whole row
+	const __m128	translation = _mm_castsi128_ps( _mm_set_epi32( -1, 0, 0, 0 ) );
+	const __m128	negZero = _mm_castsi128_ps( _mm_set_epi32( 0, (int)0x80000000, (int)0x80000000, (int)0x80000000 ) );
+	const __m128	m0 = _mm_loadu_ps( in->matrix[0] );
+	const __m128	m1 = _mm_loadu_ps( in->matrix[1] );
+	const __m128	m2 = _mm_loadu_ps( in->matrix[2] );
+	__m128			n[3], r[3];
+	int				i;
+
+	// load everything before storing anything, out may be one of the inputs
+	for ( i = 0 ; i < 3 ; i++ ) {
+		n[i] = _mm_loadu_ps( in2->matrix[i] );
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		r[i] = _mm_add_ps( _mm_mul_ps( Mdx_Splat( n[i], 0 ), m0 ), _mm_mul_ps( Mdx_Splat( n[i], 1 ), m1 ) );
+		r[i] = _mm_add_ps( r[i], _mm_mul_ps( Mdx_Splat( n[i], 2 ), m2 ) );
+		r[i] = _mm_add_ps( r[i], _mm_or_ps( _mm_and_ps( Mdx_Splat( n[i], 3 ), translation ), negZero ) );
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		_mm_storeu_ps( out->matrix[i], r[i] );
+	}
+}
+
+static QINLINE void Mdx_LerpBone_SSE( mdxaBone_t *out, const mdxaBone_t *a, float aFrac, const mdxaBone_t *b, float bFrac ) {
+	const __m128	af = _mm_set1_ps( aFrac );
+	const __m128	bf = _mm_set1_ps( bFrac );
+	int				i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		_mm_storeu_ps( out->matrix[i], _mm_add_ps( _mm_mul_ps( af, _mm_loadu_ps( a->matrix[i] ) ), _mm_mul_ps( bf, _mm_loadu_ps( b->matrix[i] ) ) ) );
+	}
+}
+
+static QINLINE void Mdx_UnCompressQuat_SSE( float mat[3][4], const unsigned char *comp ) {
+	const __m128i	zero = _mm_setzero_si128();
+	__m128			q, t;
+
+	// the four quat shorts and the three translation shorts, dequantised four
+	// at a time without reading past the 14 bytes of the bone
+	q = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)comp ), zero ) );
+	t = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_srli_si128( _mm_loadl_epi64( (const __m128i *)( comp + 6 ) ), 2 ), zero ) );
+	q = _mm_sub_ps( _mm_div_ps( q, _mm_set1_ps( 16383.0f ) ), _mm_set1_ps( 2.0f ) );
+	t = _mm_sub_ps( _mm_div_ps( t, _mm_set1_ps( 64.0f ) ), _mm_set1_ps( 512.0f ) );
+
+	const float w = _mm_cvtss_f32( q );
+	const float x = _mm_cvtss_f32( Mdx_Splat( q, 1 ) );
+	const float y = _mm_cvtss_f32( _mm_movehl_ps( q, q ) );
+	const float z = _mm_cvtss_f32( Mdx_Splat( q, 3 ) );
+	const float fTx = 2.0f*x, fTy = 2.0f*y, fTz = 2.0f*z;
+	const float fTwx = fTx*w, fTwy = fTy*w, fTwz = fTz*w;
+	const float fTxx = fTx*x, fTxy = fTy*x, fTxz = fTz*x;
+	const float fTyy = fTy*y, fTyz = fTz*y, fTzz = fTz*z;
+
+	mat[0][0] = 1.0f-(fTyy+fTzz);
+	mat[0][1] = fTxy-fTwz;
+	mat[0][2] = fTxz+fTwy;
+	mat[0][3] = _mm_cvtss_f32( t );
+	mat[1][0] = fTxy+fTwz;
+	mat[1][1] = 1.0f-(fTxx+fTzz);
+	mat[1][2] = fTyz-fTwx;
+	mat[1][3] = _mm_cvtss_f32( Mdx_Splat( t, 1 ) );
+	mat[2][0] = fTxz-fTwy;
+	mat[2][1] = fTyz+fTwx;
+	mat[2][2] = 1.0f-(fTxx+fTyy);
+	mat[2][3] = _mm_cvtss_f32( _mm_movehl_ps( t, t ) );
+}
+
+/*
+A bone laid out by column for skinning, with the fourth lane zero.  Skinning
+a point is then ((c0*x + c1*y) + c2*z) + c3 in every lane at once, which is
+exactly DotProduct( row, v ) + row[3] for each row.  Surfaces load the few
+bones they reference into a palette once instead of evaluating a bone for
+every weight of every vert.
+*/
+typedef struct mdxSkinBone_s {
+	__m128	col[4];
+} mdxSkinBone_t;
+
+static QINLINE void Mdx_LoadSkinBone( mdxSkinBone_t *out, const mdxaBone_t *bone ) {
+	__m128	r0 = _mm_loadu_ps( bone->matrix[0] );
+	__m128	r1 = _mm_loadu_ps( bone->matrix[1] );
+	__m128	r2 = _mm_loadu_ps( bone->matrix[2] );
+	__m128	r3 = _mm_setzero_ps();
+
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	out->col[0] = r0;
+	out->col[1] = r1;
+	out->col[2] = r2;
+	out->col[3] = r3;
+}
+
+static QINLINE __m128 Mdx_SkinPoint( const mdxSkinBone_t *bone, const float *v ) {
+	__m128	r;
+
+	r = _mm_add_ps( _mm_mul_ps( bone->col[0], _mm_set1_ps( v[0] ) ), _mm_mul_ps( bone->col[1], _mm_set1_ps( v[1] ) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( bone->col[2], _mm_set1_ps( v[2] ) ) );
+	return _mm_add_ps( r, bone->col[3] );
+}
+
+static QINLINE __m128 Mdx_SkinNormal( const mdxSkinBone_t *bone, const float *n ) {
+	__m128	r;
+
+	r = _mm_add_ps( _mm_mul_ps( bone->col[0], _mm_set1_ps( n[0] ) ), _mm_mul_ps( bone->col[1], _mm_set1_ps( n[1] ) ) );
+	return _mm_add_ps( r, _mm_mul_ps( bone->col[2], _mm_set1_ps( n[2] ) ) );
+}
+
+// writes the first three lanes only
+static QINLINE void Mdx_StoreVec3( float *out, __m128 v ) {
+	_mm_storel_pi( (__m64 *)out, v );
+	_mm_store_ss( out + 2, _mm_movehl_ps( v, v ) );
+}
+
+/*
+The bones a surface has loaded so far, by bone reference index.  A bone goes
+in the first time a weight asks for it, so the bones get evaluated in the
+same order as in the scalar loops.  Eval is how the renderer evaluates the
+bone a reference points at in its bone cache.
+*/
+typedef struct mdxSkinPalette_s {
+	mdxSkinBone_t	bones[iMAX_G2_BONEREFS_PER_SURFACE];
+	unsigned int	loaded;
+} mdxSkinPalette_t;
+
+template< typename BoneCache, const mdxaBone_t &(*Eval)( BoneCache *, int ) >
+static QINLINE const mdxSkinBone_t *Mdx_PaletteBone( mdxSkinPalette_t *palette, int index, const int *piBoneReferences, BoneCache *bones ) {
+	if ( !( palette->loaded & ( 1u << index ) ) ) {
+		Mdx_LoadSkinBone( &palette->bones[index], &Eval( bones, piBoneReferences[index] ) );
+		palette->loaded |= 1u << index;
+	}
+	return &palette->bones[index];
+}
+
+// sum plus each weight of the vert times its skinned point, the last weight
+// being what's left of one, added in the order the scalar loops add them.
+// Pass -0.0f for the sum to start with the first term, 0.0f to add it to zero.
+template< typename BoneCache, const mdxaBone_t &(*Eval)( BoneCache *, int ) >
+static QINLINE __m128 Mdx_SkinWeightedPoint( mdxSkinPalette_t *palette, const mdxmVertex_t *v, __m128 sum, const int *piBoneReferences, BoneCache *bones ) {
+	const int	iNumWeights = G2_GetVertWeights( v );
+	float		fTotalWeight = 0.0f;
+	int			k;
+
+	for ( k = 0 ; k < iNumWeights ; k++ ) {
+		const mdxSkinBone_t	*bone = Mdx_PaletteBone< BoneCache, Eval >( palette, G2_GetVertBoneIndex( v, k ), piBoneReferences, bones );
+		const float			fBoneWeight = G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
+
+		sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( fBoneWeight ), Mdx_SkinPoint( bone, v->vertCoords ) ) );
+	}
+	return sum;
+}
+
+#define Mdx_Multiply3x4		Mdx_Multiply3x4_SSE
+#define Mdx_LerpBone		Mdx_LerpBone_SSE
+#define Mdx_UnCompressQuat	Mdx_UnCompressQuat_SSE
+#else
+#define Mdx_Multiply3x4		Mdx_Multiply3x4_Scalar
+#define Mdx_LerpBone		Mdx_LerpBone_Scalar
+#define Mdx_UnCompressQuat	Mdx_UnCompressQuat_Scalar
+#endif
@@ -151,6 +151,10 @@ void G2_DEBUG_RemovePtrFromTracker(CGhoul2Info_v *g2)
 qboolean G2_SetupModelPointers(CGhoul2Info *ghlInfo);
 qboolean G2_SetupModelPointers(CGhoul2Info_v &ghoul2);
 qboolean G2_TestModelPointers(CGhoul2Info *ghlInfo);
+qboolean G2_UseHitIndex(CGhoul2Info_v &ghoul2, float fRadius);
+void G2_TraceModelsIndexed(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale, IHeapAllocator *G2VertSpace, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius);
+qboolean G2_TransformModelCached(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale, IHeapAllocator *G2VertSpace, int useLod);
+void G2_ConstructGhoulSkeletonCached(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale);
 
 //rww - RAGDOLL_BEGIN
 #define NUM_G2T_TIME (2)
@@ -2097,32 +2101,47 @@ void G2API_CollisionDetect(CollisionRecord_t *collRecMap, CGhoul2Info_v &ghoul2,
 	{
 		vec3_t	transRayStart, transRayEnd;
 
-		// make sure we have transformed the whole skeletons for each model
-		G2_ConstructGhoulSkeleton(ghoul2, frameNumber, true, scale);
-
 		// pre generate the world matrix - used to transform the incoming ray
 		G2_GenerateWorldMatrix(angles, position);
 
 		G2VertSpace->ResetHeap();
 
-		// now having done that, time to build the model
+		// translate the ray to model space
+		TransformAndTranslatePoint(rayStart, transRayStart, &worldMatrixInv);
+		TransformAndTranslatePoint(rayEnd, transRayEnd, &worldMatrixInv);
+
+		if (collRecMap && G2_UseHitIndex(ghoul2, fRadius))
+		{
+			// make sure we have transformed the whole skeletons for each model, an
+			// earlier trace this frame may already have built this pose
+			G2_ConstructGhoulSkeletonCached(ghoul2, frameNumber, scale);
+
+			// point trace, only the parts of the model the ray can reach get built
+			G2_TraceModelsIndexed(ghoul2, frameNumber, scale, G2VertSpace, transRayStart, transRayEnd, collRecMap, entNum, traceFlags, useLod, fRadius);
+		}
+		else
+		{
+			// an earlier trace this frame may already have built this pose
+			if (!G2_TransformModelCached(ghoul2, frameNumber, scale, G2VertSpace, useLod))
+			{
+				// make sure we have transformed the whole skeletons for each model
+				G2_ConstructGhoulSkeleton(ghoul2, frameNumber, true, scale);
+
+				// now having done that, time to build the model
 #ifdef _G2_GORE
-		G2_TransformModel(ghoul2, frameNumber, scale, G2VertSpace, useLod, false);
+				G2_TransformModel(ghoul2, frameNumber, scale, G2VertSpace, useLod, false);
 #else
-		G2_TransformModel(ghoul2, frameNumber, scale, G2VertSpace, useLod);
+				G2_TransformModel(ghoul2, frameNumber, scale, G2VertSpace, useLod);
 #endif
+			}
 
-		// model is built. Lets check to see if any triangles are actually hit.
-		// first up, translate the ray to model space
-		TransformAndTranslatePoint(rayStart, transRayStart, &worldMatrixInv);
-		TransformAndTranslatePoint(rayEnd, transRayEnd, &worldMatrixInv);
-
-		// now walk each model and check the ray against each poly - sigh, this is SO expensive. I wish there was a better way to do this.
+			// model is built. now walk each model and check the ray against each poly - sigh, this is SO expensive. I wish there was a better way to do this.
 #ifdef _G2_GORE
-		G2_TraceModels(ghoul2, transRayStart, transRayEnd, collRecMap, entNum, traceFlags, useLod, fRadius,0,0,0,0,0,qfalse);
+			G2_TraceModels(ghoul2, transRayStart, transRayEnd, collRecMap, entNum, traceFlags, useLod, fRadius,0,0,0,0,0,qfalse);
 #else
-		G2_TraceModels(ghoul2, transRayStart, transRayEnd, collRecMap, entNum, traceFlags, useLod, fRadius);
+			G2_TraceModels(ghoul2, transRayStart, transRayEnd, collRecMap, entNum, traceFlags, useLod, fRadius);
 #endif
+		}
 		int i;
 		for ( i = 0; i < MAX_G2_COLLISIONS && collRecMap[i].mEntityNum != -1; i ++ );
 
@@ -2132,6 +2151,19 @@ void G2API_CollisionDetect(CollisionRecord_t *collRecMap, CGhoul2Info_v &ghoul2,
 	}
 }
 
+// Builds the skeletons of several instances at once for a run of queries that
+// can't change them, see G2_ConstructSkeletons.  Release them before any bone
+// can move again.
+void G2API_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, int frameNumber, int numThreads)
+{
+	G2_ConstructSkeletons(ghoul2, scales, lods, count, frameNumber, numThreads);
+}
+
+void G2API_ReleaseSkeletons(void)
+{
+	G2_ReleaseSkeletons();
+}
+
 qboolean G2API_SetGhoul2ModelFlags(CGhoul2Info *ghlInfo, const int flags)
 {
 	if (G2_SetupModelPointers(ghlInfo))
@@ -27,6 +27,11 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "ghoul2/g2_local.h"
 
 #include "tr_local.h"
+#include "rd-common/mdx_simd.h"
+
+#include <algorithm>
+#include <vector>
+
 #ifdef _G2_GORE
 #include "ghoul2/G2_gore.h"
 
@@ -175,6 +180,50 @@ CGoreSet::~CGoreSet()
 #endif // _SOF2
 
 const mdxaBone_t &EvalBoneCache(int index,CBoneCache *boneCache);
+int G2_BoneCacheTouch(const CBoneCache *boneCache);
+
+// Hit index - see G2_RegisterHitIndex
+#define G2_HIT_IDENT			(('H'<<24)+('G'<<16)+('L'<<8)+'2')
+#define G2_HIT_CLUSTER_TRIS		16
+#define G2_HIT_EPSILON			0.25f		// slack for rounding in the skinning and the triangle test
+
+typedef struct g2HitBounds_s
+{
+	vec3_t		center;			// bind pose box
+	vec3_t		extents;
+	int			firstBone;		// into the bone cache indexes
+	int			numBones;		// 0 if the weights can't be trusted to stay inside the box
+} g2HitBounds_t;
+
+typedef struct g2HitCluster_s
+{
+	g2HitBounds_t	bounds;
+	int				firstTri;
+	int				numTris;
+	int				firstVert;	// into the vert numbers
+	int				numVerts;
+} g2HitCluster_t;
+
+typedef struct g2HitSurface_s
+{
+	g2HitBounds_t	bounds;		// every vert of the surface
+	int				firstCluster;
+	int				numClusters;
+} g2HitSurface_t;
+
+typedef struct g2HitIndex_s
+{
+	int			ident;
+	int			meshSize;		// mdxm->ofsEnd of the mesh it was built from
+	int			numLODs;
+	int			numSurfaces;
+	int			ofsSurfaces;	// g2HitSurface_t [numLODs][numSurfaces]
+	int			ofsClusters;	// g2HitCluster_t
+	int			ofsBones;		// int
+	int			ofsVerts;		// short
+	int			ofsEnd;
+} g2HitIndex_t;
+
 class CTraceSurface
 {
 public:
@@ -194,6 +243,12 @@ public:
 	bool				hitOne;
 	float				m_fRadius;
 
+	// set when a point trace skins through the hit index as it goes
+	const g2HitIndex_t	*hitIndex;
+	const float			*hitScale;
+	CBoneCache			*boneCache;
+	IHeapAllocator		*G2VertSpace;
+
 #ifdef _G2_GORE
 	//gore application thing
 	float				ssize;
@@ -258,6 +313,10 @@ public:
 		VectorCopy(initrayStart, rayStart);
 		VectorCopy(initrayEnd, rayEnd);
 		hitOne = false;
+		hitIndex = NULL;
+		hitScale = NULL;
+		boneCache = NULL;
+		G2VertSpace = NULL;
 	}
 
 };
@@ -385,6 +444,55 @@ int G2_DecideTraceLod(CGhoul2Info &ghoul2, int useLod)
 	return returnLod;
 }
 
+static float *G2_AllocSurfaceVerts( const mdxmSurface_t *surface, IHeapAllocator *G2VertSpace, size_t *TransformedVertsArray )
+{
+	// alloc some space for the transformed verts to get put in
+	float *TransformedVerts = (float *)G2VertSpace->MiniHeapAlloc(surface->numVerts * 5 * 4);
+	TransformedVertsArray[surface->thisSurfaceIndex] = (size_t)TransformedVerts;
+	if (!TransformedVerts)
+	{
+		Com_Error(ERR_DROP, "Ran out of transform space for Ghoul2 Models. Adjust MiniHeapSize in SV_SpawnServer.\n");
+	}
+	return TransformedVerts;
+}
+
+#ifdef MDX_SIMD_SSE
+static qboolean g2SimdSkinning = qtrue; // g2skinbench turns it off to compare
+
+static const mdxaBone_t &G2_EvalSkinBone( CBoneCache *boneCache, int index )
+{
+	return EvalBoneCache( index, boneCache );
+}
+
+// R_TransformEachSurface with each weighted bone done as one four lane sum.
+// The palette evaluates the same bones, in the same order, as the scalar loop.
+static void R_TransformEachSurface_SSE( const mdxmSurface_t *surface, const vec3_t scale, float *TransformedVerts, CBoneCache *boneCache )
+{
+	mdxSkinPalette_t	palette;
+	int					j;
+
+	const int *piBoneReferences = (const int *)((const byte *)surface + surface->ofsBoneReferences);
+	const int numVerts = surface->numVerts;
+	const mdxmVertex_t *v = (const mdxmVertex_t *)((const byte *)surface + surface->ofsVerts);
+	const mdxmVertexTexCoord_t *pTexCoords = (const mdxmVertexTexCoord_t *)&v[numVerts];
+
+	// the scalar loop skips the multiply when there's nothing to scale, times 1 is exact anyway
+	const __m128 vScale = _mm_setr_ps( scale[0], scale[1], scale[2], 0.0f );
+
+	palette.loaded = 0;
+	for ( j = 0; j < numVerts; j++, v++, TransformedVerts += 5 )
+	{
+		const __m128 tempVert = Mdx_SkinWeightedPoint< CBoneCache, G2_EvalSkinBone >( &palette, v, _mm_setzero_ps(), piBoneReferences, boneCache );
+
+		// copy tranformed verts into temp space
+		Mdx_StoreVec3( TransformedVerts, _mm_mul_ps( tempVert, vScale ) );
+		// we will need the S & T coors too for hitlocation and hitmaterial stuff
+		TransformedVerts[3] = pTexCoords[j].texCoords[0];
+		TransformedVerts[4] = pTexCoords[j].texCoords[1];
+	}
+}
+#endif
+
 void R_TransformEachSurface( const mdxmSurface_t *surface, vec3_t scale, IHeapAllocator *G2VertSpace, size_t *TransformedVertsArray,CBoneCache *boneCache)
 {
 	int				 j, k;
@@ -396,13 +504,15 @@ void R_TransformEachSurface( const mdxmSurface_t *surface, vec3_t scale, IHeapAl
 	//
 	int *piBoneReferences = (int*) ((byte*)surface + surface->ofsBoneReferences);
 
-	// alloc some space for the transformed verts to get put in
-	TransformedVerts = (float *)G2VertSpace->MiniHeapAlloc(surface->numVerts * 5 * 4);
-	TransformedVertsArray[surface->thisSurfaceIndex] = (size_t)TransformedVerts;
-	if (!TransformedVerts)
+	TransformedVerts = G2_AllocSurfaceVerts(surface, G2VertSpace, TransformedVertsArray);
+
+#ifdef MDX_SIMD_SSE
+	if (g2SimdSkinning)
 	{
-		Com_Error(ERR_DROP, "Ran out of transform space for Ghoul2 Models. Adjust MiniHeapSize in SV_SpawnServer.\n");
+		R_TransformEachSurface_SSE(surface, scale, TransformedVerts, boneCache);
+		return;
 	}
+#endif
 
 	// whip through and actually transform each vertex
 	const int numVerts = surface->numVerts;
@@ -537,6 +647,25 @@ void G2_TransformSurfaces(int surfaceNum, surfaceInfo_v &rootSList,
 	}
 }
 
+// a scale of 0 on an axis means unscaled
+static void G2_CorrectScale(const vec3_t scale, vec3_t correctScale)
+{
+	VectorCopy(scale, correctScale);
+	// check for scales of 0 - that's the default I believe
+	if (!scale[0])
+	{
+		correctScale[0] = 1.0;
+	}
+	if (!scale[1])
+	{
+		correctScale[1] = 1.0;
+	}
+	if (!scale[2])
+	{
+		correctScale[2] = 1.0;
+	}
+}
+
 // main calling point for the model transform for collision detection. At this point all of the skeleton has been transformed.
 #ifdef _G2_GORE
 void G2_TransformModel(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale, IHeapAllocator *G2VertSpace, int useLod, bool ApplyGore)
@@ -561,20 +690,7 @@ void G2_TransformModel(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale,
 	}
 #endif
 
-	VectorCopy(scale, correctScale);
-	// check for scales of 0 - that's the default I believe
-	if (!scale[0])
-	{
-		correctScale[0] = 1.0;
-	}
-	if (!scale[1])
-	{
-		correctScale[1] = 1.0;
-	}
-	if (!scale[2])
-	{
-		correctScale[2] = 1.0;
-	}
+	G2_CorrectScale(scale, correctScale);
 
 	// walk each possible model for this entity and try rendering it out
 	for (i=0; i<ghoul2.size(); i++)
@@ -644,6 +760,336 @@ void G2_TransformModel(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale,
 }
 
 
+/////////////////////////////////////////////////////////////////////
+//	Hit index
+//
+//	Built once per mesh when it is registered.  Each surface of each LOD is
+//	cut into runs of G2_HIT_CLUSTER_TRIS consecutive triangles, and each run
+//	keeps the verts its triangles use, the bones those verts are weighted to
+//	and a bind pose box around the verts.  A skinned vert is a weighted
+//	average of its bind position moved by each of its bones, so it can't leave
+//	the union of the box moved by every bone of its run.  A point trace works
+//	that union out from the current bone matrices, then skins and tests only
+//	the runs whose box the ray passes through.  Those are still tested in file
+//	order, so the collision records come out exactly as they would have from
+//	skinning the whole model.
+//
+//	Only this renderer has one.  A listen server runs the game's traces
+//	through the client's renderer, which still skins the whole model.
+/////////////////////////////////////////////////////////////////////
+
+static cvar_t *r_ghoul2HitIndex = NULL;
+
+static void G2_BuildHitBounds(const mdxmSurface_t *surface, const short *vertNums, int numVerts, std::vector<int> &bones, g2HitBounds_t &bounds)
+{
+	const int			*piBoneReferences = (int *)((byte *)surface + surface->ofsBoneReferences);
+	const mdxmVertex_t	*verts = (mdxmVertex_t *)((byte *)surface + surface->ofsVerts);
+	const int			firstBone = bones.size();
+	bool				trusted = true;
+	vec3_t				mins, maxs;
+	int					i, k;
+
+	ClearBounds(mins, maxs);
+	for (i = 0; i < numVerts; i++)
+	{
+		const mdxmVertex_t	*v = &verts[vertNums[i]];
+		const int			iNumWeights = G2_GetVertWeights( v );
+		float				fTotalWeight = 0.0f;
+
+		AddPointToBounds(v->vertCoords, mins, maxs);
+		for (k = 0; k < iNumWeights; k++)
+		{
+			const int	boneNum = piBoneReferences[G2_GetVertBoneIndex( v, k )];
+			const float	fBoneWeight = G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
+
+			// the remainder weight goes negative if the others add up past 1
+			if (fBoneWeight < 0.0f || fBoneWeight > 1.0f)
+			{
+				trusted = false;
+			}
+			if (std::find(bones.begin() + firstBone, bones.end(), boneNum) == bones.end())
+			{
+				bones.push_back(boneNum);
+			}
+		}
+	}
+
+	if (!numVerts || !trusted)
+	{
+		bones.resize(firstBone);
+		VectorClear(bounds.center);
+		VectorClear(bounds.extents);
+	}
+	else
+	{
+		VectorAdd(mins, maxs, bounds.center);
+		VectorScale(bounds.center, 0.5f, bounds.center);
+		VectorSubtract(maxs, bounds.center, bounds.extents);
+	}
+	bounds.firstBone = firstBone;
+	bounds.numBones = bones.size() - firstBone;
+}
+
+// builds the hit index for a mesh and caches it under hitsName, NULL if the mesh can't have one
+static g2HitIndex_t *G2_BuildHitIndex(const model_t *mod, const char *hitsName)
+{
+	const mdxmHeader_t		*mdxm = mod->mdxm;
+	std::vector<g2HitSurface_t>	surfaces(mdxm->numLODs * mdxm->numSurfaces);
+	std::vector<g2HitCluster_t>	clusters;
+	std::vector<int>		bones;
+	std::vector<short>		verts, allVerts;
+	std::vector<int>		vertCluster;
+	int						l, i, j, k;
+
+	for (l = 0; l < mdxm->numLODs; l++)
+	{
+		for (i = 0; i < mdxm->numSurfaces; i++)
+		{
+			const mdxmSurface_t		*surface = (mdxmSurface_t *)G2_FindSurface((void *)mod, i, l);
+			const mdxmTriangle_t	*tris = (mdxmTriangle_t *)((byte *)surface + surface->ofsTriangles);
+
+			if (surface->thisSurfaceIndex != i)
+			{
+				return NULL;
+			}
+
+			g2HitSurface_t &hitSurf = surfaces[l * mdxm->numSurfaces + i];
+
+			allVerts.resize(surface->numVerts);
+			for (j = 0; j < surface->numVerts; j++)
+			{
+				allVerts[j] = j;
+			}
+			G2_BuildHitBounds(surface, allVerts.data(), surface->numVerts, bones, hitSurf.bounds);
+
+			hitSurf.firstCluster = clusters.size();
+			vertCluster.assign(surface->numVerts, -1);
+			for (j = 0; j < surface->numTriangles; j += G2_HIT_CLUSTER_TRIS)
+			{
+				g2HitCluster_t cluster;
+
+				cluster.firstTri = j;
+				cluster.numTris = Q_min(G2_HIT_CLUSTER_TRIS, surface->numTriangles - j);
+				cluster.firstVert = verts.size();
+				for (k = 0; k < cluster.numTris * 3; k++)
+				{
+					const int vertNum = tris[j + k / 3].indexes[k % 3];
+
+					if (vertCluster[vertNum] != (int)clusters.size())
+					{
+						vertCluster[vertNum] = clusters.size();
+						verts.push_back(vertNum);
+					}
+				}
+				cluster.numVerts = verts.size() - cluster.firstVert;
+				G2_BuildHitBounds(surface, &verts[cluster.firstVert], cluster.numVerts, bones, cluster.bounds);
+				clusters.push_back(cluster);
+			}
+			hitSurf.numClusters = clusters.size() - hitSurf.firstCluster;
+		}
+	}
+
+	const int ofsSurfaces = sizeof(g2HitIndex_t);
+	const int ofsClusters = ofsSurfaces + surfaces.size() * sizeof(g2HitSurface_t);
+	const int ofsBones = ofsClusters + clusters.size() * sizeof(g2HitCluster_t);
+	const int ofsVerts = ofsBones + bones.size() * sizeof(int);
+	const int size = ofsVerts + verts.size() * sizeof(short);
+
+	qboolean bAlreadyFound = qfalse;
+	g2HitIndex_t *hits = (g2HitIndex_t *)RE_RegisterModels_Malloc(size, NULL, hitsName, &bAlreadyFound, TAG_MODEL_GLM);
+
+	if (!bAlreadyFound)
+	{
+		hits->ident = G2_HIT_IDENT;
+		hits->meshSize = mdxm->ofsEnd;
+		hits->numLODs = mdxm->numLODs;
+		hits->numSurfaces = mdxm->numSurfaces;
+		hits->ofsSurfaces = ofsSurfaces;
+		hits->ofsClusters = ofsClusters;
+		hits->ofsBones = ofsBones;
+		hits->ofsVerts = ofsVerts;
+		hits->ofsEnd = size;
+		memcpy((byte *)hits + ofsSurfaces, surfaces.data(), surfaces.size() * sizeof(g2HitSurface_t));
+		memcpy((byte *)hits + ofsClusters, clusters.data(), clusters.size() * sizeof(g2HitCluster_t));
+		memcpy((byte *)hits + ofsBones, bones.data(), bones.size() * sizeof(int));
+		memcpy((byte *)hits + ofsVerts, verts.data(), verts.size() * sizeof(short));
+	}
+	return hits;
+}
+
+// picks up the hit index cached when a mesh was first registered, or builds it if there isn't one
+void G2_RegisterHitIndex(model_t *mod, const char *mod_name)
+{
+	const mdxmHeader_t	*mdxm = mod->mdxm;
+	char				hitsName[MAX_QPATH];
+
+	mod->mdxmHits = NULL;
+
+	// it's cached alongside the mesh, under the mesh's name
+	if (strlen(mod_name) + strlen("#hits") >= MAX_QPATH)
+	{
+		return;
+	}
+	Com_sprintf(hitsName, sizeof(hitsName), "%s#hits", mod_name);
+
+	const g2HitIndex_t *hits = (const g2HitIndex_t *)RE_RegisterModels_Find(hitsName);
+
+	if (!hits)
+	{
+		hits = G2_BuildHitIndex(mod, hitsName);
+	}
+
+	if (!hits || hits->ident != G2_HIT_IDENT || hits->meshSize != mdxm->ofsEnd || hits->numLODs != mdxm->numLODs || hits->numSurfaces != mdxm->numSurfaces)
+	{
+		return;
+	}
+
+	mod->dataSize += hits->ofsEnd;
+	mod->mdxmHits = hits;
+}
+
+// true if a trace can skin through the hit index instead of transforming every surface first
+qboolean G2_UseHitIndex(CGhoul2Info_v &ghoul2, float fRadius)
+{
+	int i;
+
+	if (r_ghoul2HitIndex == NULL)
+	{
+		r_ghoul2HitIndex = ri.Cvar_Get( "r_ghoul2HitIndex", "1", CVAR_NONE, "Only skin the parts of a Ghoul2 model a point trace can reach" );
+	}
+
+	// radius traces and gore need the whole model
+	if (!r_ghoul2HitIndex->integer || !(fabs(fRadius) < 0.1))
+	{
+		return qfalse;
+	}
+
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+
+		if (!g.mValid)
+		{
+			continue;
+		}
+		// the cached trace keeps its transformed verts for later calls, so they all have to be there
+		if (!g.currentModel->mdxmHits || (g.mFlags & GHOUL2_ZONETRANSALLOC))
+		{
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+// true if the ray can touch anything inside the bounds wherever the bones have moved them
+static bool G2_HitBoundsOnRay(const g2HitBounds_t &bounds, const CTraceSurface &TS)
+{
+	const int	*boneNums = (int *)((byte *)TS.hitIndex + TS.hitIndex->ofsBones) + bounds.firstBone;
+	float		enter = 0.0f, leave = 1.0f;
+	vec3_t		mins, maxs;
+	int			i, j;
+
+	if (!bounds.numBones)
+	{
+		return true;
+	}
+
+	ClearBounds(mins, maxs);
+	for (j = 0; j < bounds.numBones; j++)
+	{
+		const mdxaBone_t &bone = EvalBoneCache(boneNums[j], TS.boneCache);
+
+		for (i = 0; i < 3; i++)
+		{
+			const float center = DotProduct(bone.matrix[i], bounds.center) + bone.matrix[i][3];
+			const float extent = fabsf(bone.matrix[i][0]) * bounds.extents[0] + fabsf(bone.matrix[i][1]) * bounds.extents[1] + fabsf(bone.matrix[i][2]) * bounds.extents[2];
+
+			mins[i] = Q_min(mins[i], center - extent);
+			maxs[i] = Q_max(maxs[i], center + extent);
+		}
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		float lo = mins[i] * TS.hitScale[i];
+		float hi = maxs[i] * TS.hitScale[i];
+
+		if (lo > hi)
+		{
+			const float swap = lo;
+			lo = hi;
+			hi = swap;
+		}
+		const float slack = G2_HIT_EPSILON + Q_max(fabsf(lo), fabsf(hi)) * 1e-4f;
+		lo -= slack;
+		hi += slack;
+
+		const float delta = TS.rayEnd[i] - TS.rayStart[i];
+		if (fabsf(delta) < 1e-6f)
+		{
+			if (TS.rayStart[i] < lo || TS.rayStart[i] > hi)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float t0 = (lo - TS.rayStart[i]) / delta;
+		float t1 = (hi - TS.rayStart[i]) / delta;
+		if (t0 > t1)
+		{
+			const float swap = t0;
+			t0 = t1;
+			t1 = swap;
+		}
+		enter = Q_max(enter, t0);
+		leave = Q_min(leave, t1);
+		if (enter > leave)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// skins the listed verts exactly the way R_TransformEachSurface does the lot
+static void G2_SkinHitVerts(const mdxmSurface_t *surface, const short *vertNums, int numVerts, const float *scale, CBoneCache *boneCache, float *TransformedVerts)
+{
+	const int					*piBoneReferences = (int *)((byte *)surface + surface->ofsBoneReferences);
+	const mdxmVertex_t			*verts = (mdxmVertex_t *)((byte *)surface + surface->ofsVerts);
+	const mdxmVertexTexCoord_t	*pTexCoords = (mdxmVertexTexCoord_t *)&verts[surface->numVerts];
+	int							j, k;
+
+	for (j = 0; j < numVerts; j++)
+	{
+		const int			vertNum = vertNums[j];
+		const mdxmVertex_t	*v = &verts[vertNum];
+		const int			iNumWeights = G2_GetVertWeights( v );
+		float				fTotalWeight = 0.0f;
+		vec3_t				tempVert;
+
+		VectorClear( tempVert );
+		for ( k = 0 ; k < iNumWeights ; k++ )
+		{
+			int		iBoneIndex	= G2_GetVertBoneIndex( v, k );
+			float	fBoneWeight	= G2_GetVertBoneWeight( v, k, fTotalWeight, iNumWeights );
+
+			const mdxaBone_t &bone=EvalBoneCache(piBoneReferences[iBoneIndex],boneCache);
+
+			tempVert[0] += fBoneWeight * ( DotProduct( bone.matrix[0], v->vertCoords ) + bone.matrix[0][3] );
+			tempVert[1] += fBoneWeight * ( DotProduct( bone.matrix[1], v->vertCoords ) + bone.matrix[1][3] );
+			tempVert[2] += fBoneWeight * ( DotProduct( bone.matrix[2], v->vertCoords ) + bone.matrix[2][3] );
+		}
+
+		float *out = &TransformedVerts[vertNum * 5];
+		out[0] = tempVert[0] * scale[0];
+		out[1] = tempVert[1] * scale[1];
+		out[2] = tempVert[2] * scale[2];
+		out[3] = pTexCoords[vertNum].texCoords[0];
+		out[4] = pTexCoords[vertNum].texCoords[1];
+	}
+}
+
 // work out how much space a triangle takes
 static float	G2_AreaOfTri(const vec3_t A, const vec3_t B, const vec3_t C)
 {
@@ -1065,15 +1511,14 @@ static SVertexTemp GoreVerts[MAX_GORE_VERTS];
 #endif
 
 // now we're at poly level, check each model space transformed poly against the model world transfomed ray
-static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_t *surfInfo, CTraceSurface &TS)
+static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_t *surfInfo, CTraceSurface &TS, int firstTri, int numTris)
 {
-	int				j, numTris;
+	int				j;
 
 	// whip through and actually transform each vertex
 	const mdxmTriangle_t *tris = (mdxmTriangle_t *) ((byte *)surface + surface->ofsTriangles);
 	const float *verts = (float *)TS.TransformedVertsArray[surface->thisSurfaceIndex];
-	numTris = surface->numTriangles;
-	for ( j = 0; j < numTris; j++ )
+	for ( j = firstTri; j < firstTri + numTris; j++ )
 	{
 		float			face;
 		vec3_t	hitPoint, normal;
@@ -1194,6 +1639,41 @@ static bool G2_TracePolys(const mdxmSurface_t *surface, const mdxmSurfHierarchy_
 	return false;
 }
 
+// point trace through the hit index, skinning and testing only the clusters the ray can reach
+static bool G2_TraceHitClusters(const mdxmSurface_t *surface, const mdxmSurfHierarchy_t *surfInfo, CTraceSurface &TS)
+{
+	const g2HitSurface_t *hitSurf = (g2HitSurface_t *)((byte *)TS.hitIndex + TS.hitIndex->ofsSurfaces) + TS.lod * TS.hitIndex->numSurfaces + surface->thisSurfaceIndex;
+	const g2HitCluster_t *cluster = (g2HitCluster_t *)((byte *)TS.hitIndex + TS.hitIndex->ofsClusters) + hitSurf->firstCluster;
+	const short *vertNums = (short *)((byte *)TS.hitIndex + TS.hitIndex->ofsVerts);
+	int i;
+
+	if (!G2_HitBoundsOnRay(hitSurf->bounds, TS))
+	{
+		return false;
+	}
+
+	float *verts = (float *)TS.TransformedVertsArray[surface->thisSurfaceIndex];
+	if (!verts)
+	{
+		verts = G2_AllocSurfaceVerts(surface, TS.G2VertSpace, TS.TransformedVertsArray);
+	}
+
+	for (i = 0; i < hitSurf->numClusters; i++, cluster++)
+	{
+		if (!G2_HitBoundsOnRay(cluster->bounds, TS))
+		{
+			continue;
+		}
+
+		G2_SkinHitVerts(surface, vertNums + cluster->firstVert, cluster->numVerts, TS.hitScale, TS.boneCache, verts);
+		if (G2_TracePolys(surface, surfInfo, TS, cluster->firstTri, cluster->numTris))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 // now we're at poly level, check each model space transformed poly against the model world transfomed ray
 static bool G2_RadiusTracePolys(
 								const mdxmSurface_t *surface,
@@ -1453,7 +1933,8 @@ static void G2_TraceSurfaces(CTraceSurface &TS)
 			else
 			{
 				// go away and trace the polys in this surface
-				if (G2_TracePolys(surface, surfInfo, TS)
+				const bool hit = TS.hitIndex ? G2_TraceHitClusters(surface, surfInfo, TS) : G2_TracePolys(surface, surfInfo, TS, 0, surface->numTriangles);
+				if (hit
 					&& (TS.traceFlags == G2_RETURNONHIT)
 					)
 				{
@@ -1486,10 +1967,11 @@ static void G2_TraceSurfaces(CTraceSurface &TS)
 	}
 }
 
+// hitScale and G2VertSpace are only set for point traces that skin through the hit index
 #ifdef _G2_GORE
-void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius, float ssize,float tsize,float theta,int shader, SSkinGoreData *gore, qboolean skipIfLODNotMatch)
+static void G2_TraceModelsEx(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius, float ssize,float tsize,float theta,int shader, SSkinGoreData *gore, qboolean skipIfLODNotMatch, const float *hitScale, IHeapAllocator *G2VertSpace)
 #else
-void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius)
+static void G2_TraceModelsEx(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius, const float *hitScale, IHeapAllocator *G2VertSpace)
 #endif
 {
 	int				i, lod;
@@ -1571,6 +2053,14 @@ void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, Colli
 #else
 		CTraceSurface TS(ghoul2[i].mSurfaceRoot, ghoul2[i].mSlist,  (model_t *)ghoul2[i].currentModel, lod, rayStart, rayEnd, collRecMap, entNum, i, skin, cust_shader, ghoul2[i].mTransformedVertsArray, eG2TraceType, fRadius);
 #endif
+		if (hitScale)
+		{
+			TS.hitIndex = ghoul2[i].currentModel->mdxmHits;
+			TS.hitScale = hitScale;
+			TS.boneCache = ghoul2[i].mBoneCache;
+			TS.G2VertSpace = G2VertSpace;
+		}
+
 		// start the surface recursion loop
 		G2_TraceSurfaces(TS);
 
@@ -1589,6 +2079,708 @@ void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, Colli
 	}
 }
 
+#ifdef _G2_GORE
+void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius, float ssize,float tsize,float theta,int shader, SSkinGoreData *gore, qboolean skipIfLODNotMatch)
+{
+	G2_TraceModelsEx(ghoul2, rayStart, rayEnd, collRecMap, entNum, eG2TraceType, useLod, fRadius, ssize, tsize, theta, shader, gore, skipIfLODNotMatch, NULL, NULL);
+}
+#else
+void G2_TraceModels(CGhoul2Info_v &ghoul2, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius)
+{
+	G2_TraceModelsEx(ghoul2, rayStart, rayEnd, collRecMap, entNum, eG2TraceType, useLod, fRadius, NULL, NULL);
+}
+#endif
+
+// G2_TransformModel and G2_TraceModels in one for a point trace that G2_UseHitIndex has
+// cleared.  Every surface gets its vert space as usual, but verts are only skinned once
+// the ray reaches their cluster.
+void G2_TraceModelsIndexed(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale, IHeapAllocator *G2VertSpace, vec3_t rayStart, vec3_t rayEnd, CollisionRecord_t *collRecMap, int entNum, int eG2TraceType, int useLod, float fRadius)
+{
+	vec3_t	correctScale;
+	int		i;
+
+	G2_CorrectScale(scale, correctScale);
+
+	for (i=0; i<ghoul2.size(); i++)
+	{
+		CGhoul2Info &g=ghoul2[i];
+		if (!g.mValid)
+		{
+			continue;
+		}
+		assert(g.mBoneCache);
+		g.mMeshFrameNum = frameNum;
+
+		g.mTransformedVertsArray = (size_t*)G2VertSpace->MiniHeapAlloc(g.currentModel->mdxm->numSurfaces * sizeof (size_t));
+		if (!g.mTransformedVertsArray)
+		{
+			Com_Error(ERR_DROP, "Ran out of transform space for Ghoul2 Models. Adjust MiniHeapSize in SV_SpawnServer.\n");
+		}
+		memset(g.mTransformedVertsArray, 0, g.currentModel->mdxm->numSurfaces * sizeof (size_t));
+	}
+
+#ifdef _G2_GORE
+	G2_TraceModelsEx(ghoul2, rayStart, rayEnd, collRecMap, entNum, eG2TraceType, useLod, fRadius, 0, 0, 0, 0, 0, qfalse, correctScale, G2VertSpace);
+#else
+	G2_TraceModelsEx(ghoul2, rayStart, rayEnd, collRecMap, entNum, eG2TraceType, useLod, fRadius, correctScale, G2VertSpace);
+#endif
+
+	// the surfaces the ray never reached weren't skinned, don't leave them for G2API_CollisionDetectCache to pick up
+	for (i=0; i<ghoul2.size(); i++)
+	{
+		if (ghoul2[i].mValid)
+		{
+			ghoul2[i].mTransformedVertsArray = 0;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+//	Skin cache
+//
+//	Within one server frame the same model tends to be traced again and
+//	again: several shooters, shotgun pellets, the saber's radius traces.
+//	Each full skin done for a trace is copied into one block of
+//	r_ghoul2SkinCache kilobytes, keyed by the instance, the frame, the LOD
+//	asked for, the scale and a fingerprint of everything that poses the
+//	skeleton, so later traces of the same pose skip building the skeleton
+//	and skinning altogether.  The block is emptied whenever a new frame
+//	number comes in, and once it is full nothing more is kept that frame.
+//
+//	Point traces through the hit index don't skin the whole model, but they
+//	do build the skeleton.  The same key remembers which touch of each bone
+//	cache the last build of a pose left behind, so later point traces of that
+//	pose find the bones they already evaluated instead of building them again.
+/////////////////////////////////////////////////////////////////////
+
+#define G2_SKIN_CACHE_ENTRIES	64
+
+typedef struct g2SkinCacheEntry_s {
+	int			item;
+	int			useLod;
+	vec3_t		scale;
+	uint64_t	pose;
+	int			numModels;
+	size_t		**surfaces;		// mTransformedVertsArray for each model, NULL where it isn't valid
+} g2SkinCacheEntry_t;
+
+typedef struct g2SkeletonCacheEntry_s {
+	int			item;
+	vec3_t		scale;
+	uint64_t	pose;
+	uint64_t	touches;		// each model's bone cache and the touch the build left it at
+} g2SkeletonCacheEntry_t;
+
+typedef struct g2SkinCache_s {
+	byte				*data;
+	int					size;
+	int					used;
+	int					frameNum;
+	int					numEntries;
+	g2SkinCacheEntry_t	entries[G2_SKIN_CACHE_ENTRIES];
+	int					numSkeletons;
+	g2SkeletonCacheEntry_t	skeletons[G2_SKIN_CACHE_ENTRIES];
+
+	// since the last g2skincacheinfo reset
+	int					frames;
+	int					lookups;
+	int					hits;
+	int					stored;
+	int					overflows;
+	int					peakUsed;
+	int					skeletonLookups;
+	int					skeletonHits;
+} g2SkinCache_t;
+
+static cvar_t			*r_ghoul2SkinCache = NULL;
+static g2SkinCache_t	g2SkinCache;
+static qboolean			g2SkinCacheCommand = qfalse;
+
+static uint64_t G2_HashBytes(uint64_t hash, const void *data, size_t size)
+{
+	const byte	*bytes = (const byte *)data;
+	size_t		i;
+
+	for (i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Fingerprint of what G2_ConstructGhoulSkeleton and G2_TransformModel read
+// besides the frame, the LOD and the scale.  Ragdoll and IK bones are driven
+// by state outside the bone list, so those models aren't cached at all.
+static bool G2_SkinCachePose(CGhoul2Info_v &ghoul2, uint64_t &pose)
+{
+	uint64_t	hash = 14695981039346656037ULL;
+	int			i;
+	size_t		j;
+
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		const CGhoul2Info &g = ghoul2[i];
+
+		hash = G2_HashBytes(hash, &g.mValid, sizeof(g.mValid));
+		if (!g.mValid)
+		{
+			continue;
+		}
+		if (g.mFlags & GHOUL2_ZONETRANSALLOC)
+		{
+			// G2API_CollisionDetectCache owns this one's vert arrays
+			return false;
+		}
+
+		hash = G2_HashBytes(hash, &g.mModel, sizeof(g.mModel));
+		hash = G2_HashBytes(hash, &g.mModelBoltLink, sizeof(g.mModelBoltLink));
+		hash = G2_HashBytes(hash, &g.mSurfaceRoot, sizeof(g.mSurfaceRoot));
+		hash = G2_HashBytes(hash, &g.mLodBias, sizeof(g.mLodBias));
+		hash = G2_HashBytes(hash, &g.mNewOrigin, sizeof(g.mNewOrigin));
+		hash = G2_HashBytes(hash, &g.mFlags, sizeof(g.mFlags));
+
+		for (j = 0; j < g.mBlist.size(); j++)
+		{
+			const boneInfo_t &bone = g.mBlist[j];
+
+			if (bone.flags & (BONE_ANGLES_RAGDOLL|BONE_ANGLES_IK))
+			{
+				return false;
+			}
+			// everything up to lastTime says how the bone is animated and overridden
+			hash = G2_HashBytes(hash, &bone, offsetof(boneInfo_t, lastTime));
+		}
+		if (g.mSlist.size())
+		{
+			hash = G2_HashBytes(hash, &g.mSlist[0], g.mSlist.size() * sizeof(surfaceInfo_t));
+		}
+	}
+
+	pose = hash;
+	return true;
+}
+
+static void G2_SkinCacheBegin(int frameNum)
+{
+	const int size = Com_Clampi(0, 256 * 1024, r_ghoul2SkinCache->integer) * 1024;
+
+	if (size != g2SkinCache.size)
+	{
+		if (g2SkinCache.data)
+		{
+			Z_Free(g2SkinCache.data);
+			g2SkinCache.data = NULL;
+		}
+		g2SkinCache.size = size;
+		if (size)
+		{
+			g2SkinCache.data = (byte *)Z_Malloc(size, TAG_GHOUL2, qfalse);
+		}
+		g2SkinCache.frameNum = frameNum - 1;
+	}
+
+	if (frameNum != g2SkinCache.frameNum)
+	{
+		g2SkinCache.frameNum = frameNum;
+		g2SkinCache.numEntries = 0;
+		g2SkinCache.numSkeletons = 0;
+		g2SkinCache.used = 0;
+		g2SkinCache.frames++;
+	}
+}
+
+// which bone caches the instance's models use and the touch each is at, it
+// changes whenever anything builds one of the skeletons again
+static uint64_t G2_SkeletonTouches(CGhoul2Info_v &ghoul2)
+{
+	uint64_t	hash = 14695981039346656037ULL;
+	int			i;
+
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		const CGhoul2Info &g = ghoul2[i];
+
+		if (g.mValid)
+		{
+			const int touch = G2_BoneCacheTouch(g.mBoneCache);
+
+			hash = G2_HashBytes(hash, &g.mBoneCache, sizeof(g.mBoneCache));
+			hash = G2_HashBytes(hash, &touch, sizeof(touch));
+		}
+	}
+	return hash;
+}
+
+// remember the skeleton G2_ConstructGhoulSkeleton just built for this pose
+static void G2_SkeletonCacheStore(CGhoul2Info_v &ghoul2, const vec3_t scale, uint64_t pose)
+{
+	g2SkeletonCacheEntry_t	*entry = NULL;
+	int						i;
+
+	for (i = 0; i < g2SkinCache.numSkeletons; i++)
+	{
+		if (g2SkinCache.skeletons[i].item == ghoul2.mItem)
+		{
+			// only the last build of an instance is still there to use
+			entry = &g2SkinCache.skeletons[i];
+			break;
+		}
+	}
+	if (!entry)
+	{
+		if (g2SkinCache.numSkeletons == G2_SKIN_CACHE_ENTRIES)
+		{
+			return;
+		}
+		entry = &g2SkinCache.skeletons[g2SkinCache.numSkeletons++];
+	}
+
+	entry->item = ghoul2.mItem;
+	VectorCopy(scale, entry->scale);
+	entry->pose = pose;
+	entry->touches = G2_SkeletonTouches(ghoul2);
+}
+
+// G2_ConstructGhoulSkeleton for a point trace through the hit index, skipped
+// when the last build of this instance this frame was of the same pose and
+// scale and nothing has built its bones since
+void G2_ConstructGhoulSkeletonCached(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale)
+{
+	uint64_t	pose;
+	int			i;
+
+	if (r_ghoul2SkinCache == NULL)
+	{
+		r_ghoul2SkinCache = ri.Cvar_Get( "r_ghoul2SkinCache", "2048", CVAR_NONE, "Kilobytes kept for Ghoul2 models already skinned for a trace this frame, 0 to turn off" );
+	}
+	if (r_ghoul2SkinCache->integer <= 0 || !G2_SkinCachePose(ghoul2, pose))
+	{
+		G2_ConstructGhoulSkeleton(ghoul2, frameNum, true, scale);
+		return;
+	}
+
+	G2_SkinCacheBegin(frameNum);
+	g2SkinCache.skeletonLookups++;
+
+	for (i = 0; i < g2SkinCache.numSkeletons; i++)
+	{
+		const g2SkeletonCacheEntry_t &entry = g2SkinCache.skeletons[i];
+
+		if (entry.item == ghoul2.mItem && entry.pose == pose && VectorCompare(entry.scale, scale)
+			&& entry.touches == G2_SkeletonTouches(ghoul2))
+		{
+			g2SkinCache.skeletonHits++;
+			return;
+		}
+	}
+
+	G2_ConstructGhoulSkeleton(ghoul2, frameNum, true, scale);
+	G2_SkeletonCacheStore(ghoul2, scale, pose);
+}
+
+// copy what G2_TransformModel just built for the cache
+static void G2_SkinCacheStore(CGhoul2Info_v &ghoul2, int useLod, const vec3_t scale, uint64_t pose)
+{
+	g2SkinCacheEntry_t	*entry;
+	byte				*out;
+	float				*verts;
+	int					size, i, s, lod;
+
+	// the model arrays go first and the verts after them, so everything stays aligned
+	size = ghoul2.size() * sizeof(size_t *);
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+		if (!g.mValid)
+		{
+			continue;
+		}
+		size += g.currentModel->mdxm->numSurfaces * sizeof(size_t);
+		lod = G2_DecideTraceLod(g, useLod);
+		for (s = 0; s < g.currentModel->mdxm->numSurfaces; s++)
+		{
+			if (g.mTransformedVertsArray[s])
+			{
+				const mdxmSurface_t *surface = (mdxmSurface_t *)G2_FindSurface((void *)g.currentModel, s, lod);
+				size += surface->numVerts * 5 * sizeof(float);
+			}
+		}
+	}
+
+	if (g2SkinCache.numEntries == G2_SKIN_CACHE_ENTRIES || g2SkinCache.used + size > g2SkinCache.size)
+	{
+		g2SkinCache.overflows++;
+		return;
+	}
+
+	entry = &g2SkinCache.entries[g2SkinCache.numEntries++];
+	entry->item = ghoul2.mItem;
+	entry->useLod = useLod;
+	VectorCopy(scale, entry->scale);
+	entry->pose = pose;
+	entry->numModels = ghoul2.size();
+
+	out = g2SkinCache.data + g2SkinCache.used;
+	entry->surfaces = (size_t **)out;
+	out += ghoul2.size() * sizeof(size_t *);
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+		if (!g.mValid)
+		{
+			entry->surfaces[i] = NULL;
+			continue;
+		}
+		entry->surfaces[i] = (size_t *)out;
+		out += g.currentModel->mdxm->numSurfaces * sizeof(size_t);
+	}
+
+	verts = (float *)out;
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+		if (!g.mValid)
+		{
+			continue;
+		}
+		lod = G2_DecideTraceLod(g, useLod);
+		for (s = 0; s < g.currentModel->mdxm->numSurfaces; s++)
+		{
+			if (!g.mTransformedVertsArray[s])
+			{
+				entry->surfaces[i][s] = 0;
+				continue;
+			}
+			const mdxmSurface_t *surface = (mdxmSurface_t *)G2_FindSurface((void *)g.currentModel, s, lod);
+			memcpy(verts, (const float *)g.mTransformedVertsArray[s], surface->numVerts * 5 * sizeof(float));
+			entry->surfaces[i][s] = (size_t)verts;
+			verts += surface->numVerts * 5;
+		}
+	}
+
+	g2SkinCache.used += size;
+	g2SkinCache.peakUsed = Q_max(g2SkinCache.peakUsed, g2SkinCache.used);
+	g2SkinCache.stored++;
+}
+
+// G2_ConstructGhoulSkeleton and G2_TransformModel for a full trace, served from
+// the skin cache when this pose has already been skinned this frame.  Returns
+// qfalse when the cache is off or can't take the model, and the caller does
+// both itself.
+qboolean G2_TransformModelCached(CGhoul2Info_v &ghoul2, const int frameNum, vec3_t scale, IHeapAllocator *G2VertSpace, int useLod)
+{
+	uint64_t	pose;
+	int			i, j;
+
+	if (r_ghoul2SkinCache == NULL)
+	{
+		r_ghoul2SkinCache = ri.Cvar_Get( "r_ghoul2SkinCache", "2048", CVAR_NONE, "Kilobytes kept for Ghoul2 models already skinned for a trace this frame, 0 to turn off" );
+	}
+	if (r_ghoul2SkinCache->integer <= 0)
+	{
+		if (g2SkinCache.data)
+		{
+			// turned off, give the memory back
+			G2_SkinCacheBegin(frameNum);
+		}
+		return qfalse;
+	}
+	if (!G2_SkinCachePose(ghoul2, pose))
+	{
+		return qfalse;
+	}
+
+	G2_SkinCacheBegin(frameNum);
+	g2SkinCache.lookups++;
+
+	for (i = 0; i < g2SkinCache.numEntries; i++)
+	{
+		const g2SkinCacheEntry_t &entry = g2SkinCache.entries[i];
+
+		if (entry.item != ghoul2.mItem || entry.pose != pose || entry.useLod != useLod
+			|| entry.numModels != ghoul2.size() || !VectorCompare(entry.scale, scale))
+		{
+			continue;
+		}
+
+		for (j = 0; j < ghoul2.size(); j++)
+		{
+			CGhoul2Info &g = ghoul2[j];
+			if (g.mValid)
+			{
+				g.mMeshFrameNum = frameNum;
+				g.mTransformedVertsArray = entry.surfaces[j];
+			}
+		}
+		g2SkinCache.hits++;
+		return qtrue;
+	}
+
+	G2_ConstructGhoulSkeleton(ghoul2, frameNum, true, scale);
+	G2_SkeletonCacheStore(ghoul2, scale, pose);
+#ifdef _G2_GORE
+	G2_TransformModel(ghoul2, frameNum, scale, G2VertSpace, useLod, false);
+#else
+	G2_TransformModel(ghoul2, frameNum, scale, G2VertSpace, useLod);
+#endif
+	G2_SkinCacheStore(ghoul2, useLod, scale, pose);
+	return qtrue;
+}
+
+static void G2_SkinCacheInfo_f(void)
+{
+	if (ri.Cmd_Argc() > 1 && !Q_stricmp(ri.Cmd_Argv(1), "reset"))
+	{
+		g2SkinCache.frames = g2SkinCache.lookups = g2SkinCache.hits = 0;
+		g2SkinCache.stored = g2SkinCache.overflows = g2SkinCache.peakUsed = 0;
+		g2SkinCache.skeletonLookups = g2SkinCache.skeletonHits = 0;
+		return;
+	}
+
+	Com_Printf("%i KB skin cache, %i KB peak use, %i of %i entries in use\n",
+		g2SkinCache.size / 1024, g2SkinCache.peakUsed / 1024, g2SkinCache.numEntries, G2_SKIN_CACHE_ENTRIES);
+	Com_Printf("%i frames, %i lookups, %i hits (%.1f%%), %i skins stored, %i didn't fit\n",
+		g2SkinCache.frames, g2SkinCache.lookups, g2SkinCache.hits,
+		g2SkinCache.lookups ? 100.0f * g2SkinCache.hits / g2SkinCache.lookups : 0.0f,
+		g2SkinCache.stored, g2SkinCache.overflows);
+	Com_Printf("%i point trace skeletons, %i already built (%.1f%%)\n",
+		g2SkinCache.skeletonLookups, g2SkinCache.skeletonHits,
+		g2SkinCache.skeletonLookups ? 100.0f * g2SkinCache.skeletonHits / g2SkinCache.skeletonLookups : 0.0f);
+}
+
+int G2API_InitGhoul2Model(CGhoul2Info_v **ghoul2Ptr, const char *fileName, int modelIndex, qhandle_t customSkin, qhandle_t customShader, int modelFlags, int lodBias);
+qboolean G2API_SetBoneAnim(CGhoul2Info_v &ghoul2, const int modelIndex, const char *boneName, const int AstartFrame, const int AendFrame, const int flags, const float animSpeed, const int currentTime, const float AsetFrame, const int blendTime);
+void G2API_CleanGhoul2Models(CGhoul2Info_v **ghoul2Ptr);
+
+#define G2SKINBENCH_FRAMES		1000
+#define G2SKINBENCH_KERNEL_OPS	4000000
+
+#ifdef MDX_SIMD_SSE
+static void G2_SkinBenchKernels(const mdxaHeader_t *header)
+{
+	static const char	*names[3] = { "decompress", "lerp", "multiply" };
+	const mdxaCompQuatBone_t *pool = (const mdxaCompQuatBone_t *)((const byte *)header + header->ofsCompBonePool);
+	const int			numBones = (header->ofsEnd - header->ofsCompBonePool) / sizeof(mdxaCompQuatBone_t);
+	mdxaBone_t			*bones, *out[2];
+	float				*fracs;
+	int					reps, seed, kernel, simd, rep, i, start, msec[2], differ;
+
+	if (numBones < 2)
+	{
+		return;
+	}
+	reps = Q_max(1, G2SKINBENCH_KERNEL_OPS / numBones);
+
+	bones = (mdxaBone_t *)Z_Malloc(sizeof(mdxaBone_t) * numBones * 3, TAG_GHOUL2, qfalse);
+	out[0] = bones + numBones;
+	out[1] = out[0] + numBones;
+	fracs = (float *)Z_Malloc(sizeof(float) * numBones, TAG_GHOUL2, qfalse);
+
+	seed = 0x5eed;
+	for (i = 0; i < numBones; i++)
+	{
+		Mdx_UnCompressQuat_Scalar(bones[i].matrix, pool[i].Comp);
+		fracs[i] = Q_random(&seed);
+	}
+
+	for (kernel = 0; kernel < 3; kernel++)
+	{
+		for (simd = 0; simd < 2; simd++)
+		{
+			mdxaBone_t *o = out[simd];
+
+			start = ri.Milliseconds();
+			for (rep = 0; rep < reps; rep++)
+			{
+				for (i = 0; i < numBones; i++)
+				{
+					// each bone against its neighbour in the pool, like a parent and child
+					const mdxaBone_t *next = &bones[(i + 1) % numBones];
+
+					switch (kernel * 2 + simd)
+					{
+					case 0:	Mdx_UnCompressQuat_Scalar(o[i].matrix, pool[i].Comp); break;
+					case 1:	Mdx_UnCompressQuat_SSE(o[i].matrix, pool[i].Comp); break;
+					case 2:	Mdx_LerpBone_Scalar(&o[i], &bones[i], fracs[i], next, 1.0f - fracs[i]); break;
+					case 3:	Mdx_LerpBone_SSE(&o[i], &bones[i], fracs[i], next, 1.0f - fracs[i]); break;
+					case 4:	Mdx_Multiply3x4_Scalar(&o[i], &bones[i], next); break;
+					default: Mdx_Multiply3x4_SSE(&o[i], &bones[i], next); break;
+					}
+				}
+			}
+			msec[simd] = ri.Milliseconds() - start;
+		}
+
+		differ = 0;
+		for (i = 0; i < numBones; i++)
+		{
+			if (memcmp(&out[0][i], &out[1][i], sizeof(mdxaBone_t)))
+			{
+				differ++;
+			}
+		}
+		Com_Printf("%-12s %9i bones  scalar %6i msec  sse %6i msec  (%.2fx)\n",
+			names[kernel], reps * numBones, msec[0], msec[1], (float)Q_max(msec[0], 1) / Q_max(msec[1], 1));
+		if (differ)
+		{
+			Com_Printf(S_COLOR_RED "%i of %i bones came out differently with SSE\n", differ, numBones);
+		}
+	}
+
+	Z_Free(fracs);
+	Z_Free(bones);
+}
+
+// skins one frame the way a trace does, into the vert space
+static void G2_SkinBenchFrame(CGhoul2Info_v &ghoul2, int time, vec3_t scale, IHeapAllocator *G2VertSpace, bool construct)
+{
+	if (construct)
+	{
+		G2VertSpace->ResetHeap();
+		G2_ConstructGhoulSkeleton(ghoul2, time, true, scale);
+	}
+#ifdef _G2_GORE
+	G2_TransformModel(ghoul2, time, scale, G2VertSpace, 0, false);
+#else
+	G2_TransformModel(ghoul2, time, scale, G2VertSpace, 0);
+#endif
+}
+#endif
+
+// g2skinbench [model] [frames]
+// Runs the Ghoul2 bone and skinning kernels with and without SSE, on the
+// server and with no renderer needed: first every compressed bone in the
+// model's GLA through the decompress, lerp and multiply kernels, then the
+// model animated and skinned for collision for the given number of frames.
+// Every result has to come out bit for bit the same as the scalar one.
+static void G2_SkinBench_f(void)
+{
+#ifndef MDX_SIMD_SSE
+	Com_Printf("This build has no SSE Ghoul2 kernels to compare.\n");
+#else
+	static vec3_t		scales[2] = { { 1.0f, 1.0f, 1.0f }, { 1.25f, 1.25f, 1.1f } };
+	CGhoul2Info_v		*ghoul2 = NULL;
+	IHeapAllocator		*G2VertSpace = ri.GetG2VertSpaceServer();
+	const char			*modelName;
+	size_t				*scalarVerts;
+	int					frames, i, m, s, lod, simd, start, msec[2], differ, verts;
+
+	modelName = "models/players/kyle/model.glm";
+	if (ri.Cmd_Argc() > 1)
+	{
+		modelName = ri.Cmd_Argv(1);
+	}
+	frames = G2SKINBENCH_FRAMES;
+	if (ri.Cmd_Argc() > 2)
+	{
+		frames = Com_Clampi(1, 100000, atoi(ri.Cmd_Argv(2)));
+	}
+
+	if (!G2VertSpace || G2API_InitGhoul2Model(&ghoul2, modelName, 0, 0, 0, 0, 0) < 0 || !ghoul2 || !(*ghoul2)[0].aHeader)
+	{
+		Com_Printf("Couldn't load %s\n", modelName);
+		if (ghoul2)
+		{
+			G2API_CleanGhoul2Models(&ghoul2);
+		}
+		return;
+	}
+	CGhoul2Info_v &models = *ghoul2;
+
+	G2_SkinBenchKernels(models[0].aHeader);
+
+	// whatever the skeleton has, run through it so the bones actually move
+	G2API_SetBoneAnim(models, 0, "model_root", 0, models[0].aHeader->numFrames, BONE_ANIM_OVERRIDE_LOOP, 1.0f, 0, -1, -1);
+
+	for (simd = 0; simd < 2; simd++)
+	{
+		g2SimdSkinning = (qboolean)simd;
+		start = ri.Milliseconds();
+		for (i = 0; i < frames; i++)
+		{
+			G2_SkinBenchFrame(models, 1 + i * 33, scales[i & 1], G2VertSpace, true);
+		}
+		msec[simd] = ri.Milliseconds() - start;
+	}
+
+	// skin every frame both ways off the same skeleton and compare
+	differ = verts = 0;
+	for (i = 0; i < frames; i++)
+	{
+		g2SimdSkinning = qfalse;
+		G2_SkinBenchFrame(models, 1 + i * 33, scales[i & 1], G2VertSpace, true);
+		scalarVerts = models[0].mTransformedVertsArray;
+		g2SimdSkinning = qtrue;
+		G2_SkinBenchFrame(models, 1 + i * 33, scales[i & 1], G2VertSpace, false);
+
+		lod = G2_DecideTraceLod(models[0], 0);
+		for (s = 0; s < models[0].currentModel->mdxm->numSurfaces; s++)
+		{
+			const float *a = (const float *)scalarVerts[s];
+			const float *b = (const float *)models[0].mTransformedVertsArray[s];
+
+			if (!a || !b)
+			{
+				continue;
+			}
+			const mdxmSurface_t *surface = (mdxmSurface_t *)G2_FindSurface((void *)models[0].currentModel, s, lod);
+			for (m = 0; m < surface->numVerts; m++, a += 5, b += 5)
+			{
+				if (memcmp(a, b, 5 * sizeof(float)))
+				{
+					differ++;
+				}
+			}
+			verts += surface->numVerts;
+		}
+	}
+	g2SimdSkinning = qtrue;
+
+	Com_Printf("%-12s %9i frames scalar %6i msec  sse %6i msec  (%.2fx)\n",
+		"skin", frames, msec[0], msec[1], (float)Q_max(msec[0], 1) / Q_max(msec[1], 1));
+	if (differ)
+	{
+		Com_Printf(S_COLOR_RED "%i of %i verts came out differently with SSE\n", differ, verts);
+	}
+
+	G2VertSpace->ResetHeap();
+	G2API_CleanGhoul2Models(&ghoul2);
+#endif
+}
+
+// called for every map the server loads
+void G2_SkinCacheInit(void)
+{
+	// the models are all being loaded again, nothing skinned so far is any use
+	g2SkinCache.numEntries = 0;
+	g2SkinCache.numSkeletons = 0;
+	g2SkinCache.used = 0;
+
+	if (!g2SkinCacheCommand)
+	{
+		ri.Cmd_AddCommand("g2skincacheinfo", G2_SkinCacheInfo_f, "Shows how often Ghoul2 traces found their pose already skinned, \"reset\" clears the counts");
+		ri.Cmd_AddCommand("g2skinbench", G2_SkinBench_f, "Times the Ghoul2 bone and skinning kernels with and without SSE and checks they agree");
+		g2SkinCacheCommand = qtrue;
+	}
+}
+
+void G2_SkinCacheShutdown(void)
+{
+	if (g2SkinCacheCommand)
+	{
+		ri.Cmd_RemoveCommand("g2skincacheinfo");
+		ri.Cmd_RemoveCommand("g2skinbench");
+	}
+	if (g2SkinCache.data)
+	{
+		Z_Free(g2SkinCache.data);
+	}
+	memset(&g2SkinCache, 0, sizeof(g2SkinCache));
+	g2SkinCacheCommand = qfalse;
+	r_ghoul2SkinCache = NULL;
+}
+
 void TransformPoint (const vec3_t in, vec3_t out, mdxaBone_t *mat) {
 	for (int i=0;i<3;i++)
 	{
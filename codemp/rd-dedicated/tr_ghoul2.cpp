@@ -23,6 +23,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "client/client.h"	//FIXME!! EVIL - just include the definitions needed
 #include "tr_local.h"
 #include "qcommon/matcomp.h"
+#include "rd-common/mdx_simd.h"
 #include "qcommon/qcommon.h"
 #include "ghoul2/G2.h"
 #include "ghoul2/g2_local.h"
@@ -174,6 +175,8 @@ public:
 	//rww - RAGDOLL_END
 	mdxaBone_t		boneMatrix; //final matrix
 	int				parent; // only set once
+	int				prepared; // touch CBoneCache::Prepare already evaluated this bone for
+	int				used; // touch this bone was last put on the prepare list for
 
 	CTransformBone()
 	{
@@ -181,6 +184,8 @@ public:
 	//rww - RAGDOLL_BEGIN
 		touchRender = 0;
 	//rww - RAGDOLL_END
+		prepared=0;
+		used=0;
 	}
 
 };
@@ -209,6 +214,16 @@ class CBoneCache
 		assert(index>=0&&index<(int)mBones.size());
 		if (mFinalBones[index].touch!=mCurrentTouch)
 		{
+			if (mFinalBones[index].prepared==mCurrentTouch)
+			{
+				// already evaluated by Prepare, just mark it and its parents as used
+				if (mFinalBones[index].parent>=0)
+				{
+					EvalLow(mFinalBones[index].parent);
+				}
+				mFinalBones[index].touch=mCurrentTouch;
+				return;
+			}
 			// need to evaluate the bone
 			assert((mFinalBones[index].parent>=0&&mFinalBones[index].parent<(int)mFinalBones.size())||(index==0&&mFinalBones[index].parent==-1));
 			if (mFinalBones[index].parent>=0)
@@ -227,6 +242,29 @@ class CBoneCache
 			mFinalBones[index].touch=mCurrentTouch;
 		}
 	}
+	// same as EvalLow, but leaves touch alone so EvalRender still sees the
+	// bone as new this touch and keeps the ragdoll render marks right
+	void PrepareLow(int index)
+	{
+		assert(index>=0&&index<(int)mBones.size());
+		if (mFinalBones[index].touch!=mCurrentTouch&&mFinalBones[index].prepared!=mCurrentTouch)
+		{
+			if (mFinalBones[index].parent>=0)
+			{
+				PrepareLow(mFinalBones[index].parent);
+				SBoneCalc &par=mBones[mFinalBones[index].parent];
+				mBones[index].newFrame=par.newFrame;
+				mBones[index].currentFrame=par.currentFrame;
+				mBones[index].backlerp=par.backlerp;
+				mBones[index].blendFrame=par.blendFrame;
+				mBones[index].blendOldFrame=par.blendOldFrame;
+				mBones[index].blendMode=par.blendMode;
+				mBones[index].blendLerp=par.blendLerp;
+			}
+			G2_TransformBone(index,*this);
+			mFinalBones[index].prepared=mCurrentTouch;
+		}
+	}
 //rww - RAGDOLL_BEGIN
 	void SmoothLow(int index)
 	{
@@ -327,6 +365,8 @@ public:
 	int				incomingTime;
 
 	int				mCurrentTouch;
+	std::vector<int> mPrepareBones; // bones MarkUsed asked Prepare for, this touch
+	int				mPrepareTouch; // touch mPrepareBones was collected for
 	//rww - RAGDOLL_BEGIN
 	int				mCurrentTouchRender;
 	int				mLastTouch;
@@ -367,6 +407,7 @@ public:
 			mFinalBones[i].parent=skel->parent;
 		}
 		mCurrentTouch=3;
+		mPrepareTouch=0;
 //rww - RAGDOLL_BEGIN
 		mLastTouch=2;
 		mLastLastTouch=1;
@@ -378,6 +419,36 @@ public:
 		assert(mBones.size());
 		return mBones[0];
 	}
+	// asks the next Prepare for a bone a surface or bolt of this touch uses
+	void MarkUsed(int index)
+	{
+		assert(index>=0&&index<(int)mBones.size());
+		if (mPrepareTouch!=mCurrentTouch)
+		{
+			mPrepareBones.clear();
+			mPrepareTouch=mCurrentTouch;
+		}
+		if (mFinalBones[index].used!=mCurrentTouch)
+		{
+			mFinalBones[index].used=mCurrentTouch;
+			mPrepareBones.push_back(index);
+		}
+	}
+	// evaluates the bones marked for the current touch, and their parents,
+	// up front so the lazy Eval calls that follow only pick the results up.
+	// Anything else is still evaluated when it's asked for.  Touches nothing
+	// outside this cache, several caches can be prepared on job threads at once.
+	void Prepare()
+	{
+		if (mPrepareTouch!=mCurrentTouch)
+		{
+			return;
+		}
+		for (size_t i=0;i<mPrepareBones.size();i++)
+		{
+			PrepareLow(mPrepareBones[i]);
+		}
+	}
 	const mdxaBone_t &EvalUnsmooth(int index)
 	{
 		EvalLow(index);
@@ -511,6 +582,12 @@ const mdxaBone_t &EvalBoneCache(int index,CBoneCache *boneCache)
 	return boneCache->Eval(index);
 }
 
+// bumped by every G2_TransformGhoulBones, the bones evaluated since are good until it moves on
+int G2_BoneCacheTouch(const CBoneCache *boneCache)
+{
+	return boneCache ? boneCache->mCurrentTouch : 0;
+}
+
 //rww - RAGDOLL_BEGIN
 const mdxaHeader_t *G2_GetModA(CGhoul2Info &ghoul2)
 {
@@ -897,21 +974,7 @@ void G2_CreateMatrixFromQuaterion(mdxaBone_t *mat, vec4_t quat)
 // nasty little matrix multiply going on here..
 void Multiply_3x4Matrix(mdxaBone_t *out, mdxaBone_t *in2, mdxaBone_t *in)
 {
-	// first row of out
-	out->matrix[0][0] = (in2->matrix[0][0] * in->matrix[0][0]) + (in2->matrix[0][1] * in->matrix[1][0]) + (in2->matrix[0][2] * in->matrix[2][0]);
-	out->matrix[0][1] = (in2->matrix[0][0] * in->matrix[0][1]) + (in2->matrix[0][1] * in->matrix[1][1]) + (in2->matrix[0][2] * in->matrix[2][1]);
-	out->matrix[0][2] = (in2->matrix[0][0] * in->matrix[0][2]) + (in2->matrix[0][1] * in->matrix[1][2]) + (in2->matrix[0][2] * in->matrix[2][2]);
-	out->matrix[0][3] = (in2->matrix[0][0] * in->matrix[0][3]) + (in2->matrix[0][1] * in->matrix[1][3]) + (in2->matrix[0][2] * in->matrix[2][3]) + in2->matrix[0][3];
-	// second row of outf out
-	out->matrix[1][0] = (in2->matrix[1][0] * in->matrix[0][0]) + (in2->matrix[1][1] * in->matrix[1][0]) + (in2->matrix[1][2] * in->matrix[2][0]);
-	out->matrix[1][1] = (in2->matrix[1][0] * in->matrix[0][1]) + (in2->matrix[1][1] * in->matrix[1][1]) + (in2->matrix[1][2] * in->matrix[2][1]);
-	out->matrix[1][2] = (in2->matrix[1][0] * in->matrix[0][2]) + (in2->matrix[1][1] * in->matrix[1][2]) + (in2->matrix[1][2] * in->matrix[2][2]);
-	out->matrix[1][3] = (in2->matrix[1][0] * in->matrix[0][3]) + (in2->matrix[1][1] * in->matrix[1][3]) + (in2->matrix[1][2] * in->matrix[2][3]) + in2->matrix[1][3];
-	// third row of out  out
-	out->matrix[2][0] = (in2->matrix[2][0] * in->matrix[0][0]) + (in2->matrix[2][1] * in->matrix[1][0]) + (in2->matrix[2][2] * in->matrix[2][0]);
-	out->matrix[2][1] = (in2->matrix[2][0] * in->matrix[0][1]) + (in2->matrix[2][1] * in->matrix[1][1]) + (in2->matrix[2][2] * in->matrix[2][1]);
-	out->matrix[2][2] = (in2->matrix[2][0] * in->matrix[0][2]) + (in2->matrix[2][1] * in->matrix[1][2]) + (in2->matrix[2][2] * in->matrix[2][2]);
-	out->matrix[2][3] = (in2->matrix[2][0] * in->matrix[0][3]) + (in2->matrix[2][1] * in->matrix[1][3]) + (in2->matrix[2][2] * in->matrix[2][3]) + in2->matrix[2][3];
+	Mdx_Multiply3x4(out, in2, in);
 }
 
 
@@ -927,7 +990,7 @@ static int G2_GetBonePoolIndex(const mdxaHeader_t *pMDXAHeader, int iFrame, int
 /*static inline*/ void UnCompressBone(float mat[3][4], int iBoneIndex, const mdxaHeader_t *pMDXAHeader, int iFrame)
 {
 	mdxaCompQuatBone_t *pCompBonePool = (mdxaCompQuatBone_t *) ((byte *)pMDXAHeader + pMDXAHeader->ofsCompBonePool);
-	MC_UnCompressQuat(mat, pCompBonePool[ G2_GetBonePoolIndex( pMDXAHeader, iFrame, iBoneIndex ) ].Comp);
+	Mdx_UnCompressQuat(mat, pCompBonePool[ G2_GetBonePoolIndex( pMDXAHeader, iFrame, iBoneIndex ) ].Comp);
 }
 
 #define DEBUG_G2_TIMING (0)
@@ -1310,15 +1373,15 @@ void G2_RagGetAnimMatrix(CGhoul2Info &ghoul2, const int boneNum, mdxaBone_t &mat
 void G2_TransformBone (int child,CBoneCache &BC)
 {
 	SBoneCalc &TB=BC.mBones[child];
-	static mdxaBone_t		tbone[6];
+	mdxaBone_t		tbone[6];
 // 	mdxaFrame_t		*aFrame=0;
 //	mdxaFrame_t		*bFrame=0;
 //	mdxaFrame_t		*aoldFrame=0;
 //	mdxaFrame_t		*boldFrame=0;
-	static mdxaSkel_t		*skel;
-	static mdxaSkelOffsets_t *offsets;
+	mdxaSkel_t		*skel;
+	mdxaSkelOffsets_t *offsets;
 	boneInfo_v		&boneList = *BC.rootBoneList;
-	static int				j, boneListIndex;
+	int				boneListIndex;
 	int				angleOverride = 0;
 
 #if DEBUG_G2_TIMING
@@ -1476,11 +1539,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		UnCompressBone(tbone[3].matrix, child, BC.header, TB.blendFrame);
 		UnCompressBone(tbone[4].matrix, child, BC.header, TB.blendOldFrame);
 
-		for ( j = 0 ; j < 12 ; j++ )
-		{
-  			((float *)&tbone[5])[j] = (backlerp * ((float *)&tbone[3])[j])
-				+ (frontlerp * ((float *)&tbone[4])[j]);
-		}
+		Mdx_LerpBone(&tbone[5], &tbone[3], backlerp, &tbone[4], frontlerp);
 	}
 
   	//
@@ -1495,11 +1554,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		if (TB.blendMode)
 		{
 			float blendFrontlerp = 1.0 - TB.blendLerp;
-	  		for ( j = 0 ; j < 12 ; j++ )
-			{
-  				((float *)&tbone[2])[j] = (TB.blendLerp * ((float *)&tbone[2])[j])
-					+ (blendFrontlerp * ((float *)&tbone[5])[j]);
-			}
+			Mdx_LerpBone(&tbone[2], &tbone[2], TB.blendLerp, &tbone[5], blendFrontlerp);
 		}
 
   		if (!child)
@@ -1516,21 +1571,13 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		UnCompressBone(tbone[0].matrix, child, BC.header, TB.newFrame);
 		UnCompressBone(tbone[1].matrix, child, BC.header, TB.currentFrame);
 
-		for ( j = 0 ; j < 12 ; j++ )
-		{
-  			((float *)&tbone[2])[j] = (TB.backlerp * ((float *)&tbone[0])[j])
-				+ (frontlerp * ((float *)&tbone[1])[j]);
-		}
+		Mdx_LerpBone(&tbone[2], &tbone[0], TB.backlerp, &tbone[1], frontlerp);
 
 		// blend in the other frame if we need to
 		if (TB.blendMode)
 		{
 			float blendFrontlerp = 1.0 - TB.blendLerp;
-	  		for ( j = 0 ; j < 12 ; j++ )
-			{
-  				((float *)&tbone[2])[j] = (TB.blendLerp * ((float *)&tbone[2])[j])
-					+ (blendFrontlerp * ((float *)&tbone[5])[j]);
-			}
+			Mdx_LerpBone(&tbone[2], &tbone[2], TB.blendLerp, &tbone[5], blendFrontlerp);
 		}
 
   		if (!child)
@@ -1566,7 +1613,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 			// this is crazy, we are gonna drive the animation to ID while we are doing post mults to compensate.
 			Multiply_3x4Matrix(&temp,&firstPass, &skel->BasePoseMat);
 			float	matrixScale = VectorLength((float*)&temp);
-			static mdxaBone_t		toMatrix =
+			mdxaBone_t		toMatrix =
 			{
 				{
 					{ 1.0f, 0.0f, 0.0f, 0.0f },
@@ -1599,11 +1646,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 //					mdxaBone_t lerp;
 					// now do the blend into the destination
 					float blendFrontlerp = 1.0 - blendLerp;
-	  				for ( j = 0 ; j < 12 ; j++ )
-					{
-  						((float *)&bone)[j] = (blendLerp * ((float *)&temp)[j])
-							+ (blendFrontlerp * ((float *)&tbone[2])[j]);
-					}
+					Mdx_LerpBone(&bone, &temp, blendLerp, &tbone[2], blendFrontlerp);
 //					Multiply_3x4Matrix(&bone, &BC.mFinalBones[parent].boneMatrix,&lerp);
 				}
 			}
@@ -1669,11 +1712,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 
 					// now do the blend into the destination
 					float blendFrontlerp = 1.0 - blendLerp;
-	  				for ( j = 0 ; j < 12 ; j++ )
-					{
-  						((float *)&bone)[j] = (blendLerp * ((float *)&temp)[j])
-							+ (blendFrontlerp * ((float *)&firstPass)[j]);
-					}
+					Mdx_LerpBone(&bone, &temp, blendLerp, &firstPass, blendFrontlerp);
 				}
 				else
 				{
@@ -2879,6 +2918,189 @@ bool G2_NeedsRecalc(CGhoul2Info *ghlInfo,int frameNum)
 	return false;
 }
 
+/*
+==============
+G2_ConstructSkeletons
+
+Skeletons built ahead of a run of queries that can't change them, for
+example the Ghoul2 traces of a server trace batch.  The skeletons are set up
+here and the bones used by their surfaces at each model's trace LOD and by
+their bolts are evaluated on the job threads, one bone cache per job.  Any
+other bone a query needs is evaluated when it's asked for.  Until
+G2_ReleaseSkeletons, G2_ConstructGhoulSkeleton leaves a held skeleton alone
+when it is asked for the same time and scale again.
+==============
+*/
+#define MAX_G2_HELD_SKELETONS	256
+#define MAX_G2_PREPARED_CACHES	1024
+
+typedef struct g2HeldSkeleton_s {
+	CGhoul2Info_v	*ghoul2;
+	vec3_t			scale;
+} g2HeldSkeleton_t;
+
+static g2HeldSkeleton_t	g2HeldSkeletons[MAX_G2_HELD_SKELETONS];
+static int				g2NumHeldSkeletons;
+static int				g2HeldFrameNum;
+
+static CBoneCache		*g2PreparedCaches[MAX_G2_PREPARED_CACHES];
+
+// asks the next Prepare of the cache for the bones a surface is skinned with
+static void G2_MarkSurfaceBones(CBoneCache *boneCache, const mdxmSurface_t *surface)
+{
+	const int	*piBoneReferences = (const int *)((const byte *)surface + surface->ofsBoneReferences);
+	int			i;
+
+	for (i = 0; i < surface->numBoneReferences; i++)
+	{
+		boneCache->MarkUsed(piBoneReferences[i]);
+	}
+}
+
+static void G2_PrepareBoneCacheJob(void *data, int index)
+{
+	((CBoneCache **)data)[index]->Prepare();
+}
+
+// evaluates the marked bones of every cache, spread over numThreads threads
+static void G2_PrepareBoneCaches(CBoneCache **caches, int count, int numThreads)
+{
+	ri.Sys_ParallelFor(numThreads, count, G2_PrepareBoneCacheJob, caches);
+}
+
+int G2_DecideTraceLod(CGhoul2Info &ghoul2, int useLod);
+
+// marks the bones of the surfaces of a LOD that aren't switched off, walking
+// the hierarchy the way G2_TransformSurfaces does.  Uses the quick override
+// lookup, so this has to stay on the main thread.
+static void G2_MarkSurfaceTreeBones(CGhoul2Info &ghoul2, int surfaceNum, int lod)
+{
+	int	i;
+	const mdxmSurface_t			*surface = (mdxmSurface_t *)G2_FindSurface((void *)ghoul2.currentModel, surfaceNum, lod);
+	const mdxmHierarchyOffsets_t	*surfIndexes = (mdxmHierarchyOffsets_t *)((byte *)ghoul2.currentModel->mdxm + sizeof(mdxmHeader_t));
+	const mdxmSurfHierarchy_t		*surfInfo = (mdxmSurfHierarchy_t *)((byte *)surfIndexes + surfIndexes->offsets[surface->thisSurfaceIndex]);
+	const surfaceInfo_t			*surfOverride = G2_FindOverrideSurface(surfaceNum, ghoul2.mSlist);
+	int	offFlags = surfInfo->flags;
+
+	if (surfOverride)
+	{
+		offFlags = surfOverride->offFlags;
+	}
+	if (!offFlags)
+	{
+		G2_MarkSurfaceBones(ghoul2.mBoneCache, surface);
+	}
+	if (offFlags & G2SURFACEFLAG_NODESCENDANTS)
+	{
+		return;
+	}
+	for (i = 0; i < surfInfo->numChildren; i++)
+	{
+		G2_MarkSurfaceTreeBones(ghoul2, surfInfo->childIndexes[i], lod);
+	}
+}
+
+// marks the bones a trace at useLod and the bolts of the models will use for
+// the next Prepare.  Bolts on generated surfaces are left to be evaluated
+// when they're asked for.
+static void G2_MarkUsedBones(CGhoul2Info_v &ghoul2, int useLod)
+{
+	int	i, j;
+
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+
+		if (!g.mValid || !g.mBoneCache)
+		{
+			continue;
+		}
+
+		G2_FindOverrideSurface(-1, g.mSlist); //reset the quick surface override lookup
+		G2_MarkSurfaceTreeBones(g, g.mSurfaceRoot, G2_DecideTraceLod(g, useLod));
+
+		for (j = 0; j < (int)g.mBltlist.size(); j++)
+		{
+			const boltInfo_t &bolt = g.mBltlist[j];
+
+			if (bolt.boneNumber >= 0)
+			{
+				g.mBoneCache->MarkUsed(bolt.boneNumber);
+			}
+			else if (bolt.surfaceNumber >= 0 && bolt.surfaceType != G2SURFACEFLAG_GENERATED)
+			{
+				G2_MarkSurfaceBones(g.mBoneCache, (mdxmSurface_t *)G2_FindSurface((void *)g.currentModel, bolt.surfaceNumber, 0));
+			}
+		}
+	}
+}
+
+// true when the skeleton is held as built for exactly these arguments, any
+// other build of a held skeleton ends its hold
+static bool G2_SkeletonHeld(CGhoul2Info_v &ghoul2, const int frameNum, bool checkForNewOrigin, const vec3_t scale)
+{
+	int i;
+
+	for (i = 0; i < g2NumHeldSkeletons; i++)
+	{
+		if (g2HeldSkeletons[i].ghoul2 == &ghoul2)
+		{
+			if (checkForNewOrigin && scale && frameNum == g2HeldFrameNum && VectorCompare(g2HeldSkeletons[i].scale, scale))
+			{
+				return true;
+			}
+			g2HeldSkeletons[i] = g2HeldSkeletons[--g2NumHeldSkeletons];
+			return false;
+		}
+	}
+	return false;
+}
+
+void G2_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, const int frameNum, int numThreads)
+{
+	int		i, j, numCaches;
+
+	G2_ReleaseSkeletons();
+
+	numCaches = 0;
+	for (i = 0; i < count && g2NumHeldSkeletons < MAX_G2_HELD_SKELETONS; i++)
+	{
+		CGhoul2Info_v &g2 = *ghoul2[i];
+
+		if (!g2.IsValid() || !G2_SetupModelPointers(g2) || G2_SkeletonHeld(g2, frameNum, true, scales[i]))
+		{
+			continue;
+		}
+		if (numCaches + g2.size() > MAX_G2_PREPARED_CACHES)
+		{
+			break;
+		}
+
+		G2_ConstructGhoulSkeleton(g2, frameNum, true, scales[i]);
+		G2_MarkUsedBones(g2, lods[i]);
+
+		for (j = 0; j < g2.size(); j++)
+		{
+			if (g2[j].mValid && g2[j].mBoneCache)
+			{
+				g2PreparedCaches[numCaches++] = g2[j].mBoneCache;
+			}
+		}
+
+		g2HeldSkeletons[g2NumHeldSkeletons].ghoul2 = &g2;
+		VectorCopy(scales[i], g2HeldSkeletons[g2NumHeldSkeletons].scale);
+		g2HeldFrameNum = frameNum;
+		g2NumHeldSkeletons++;
+	}
+
+	G2_PrepareBoneCaches(g2PreparedCaches, numCaches, numThreads);
+}
+
+void G2_ReleaseSkeletons(void)
+{
+	g2NumHeldSkeletons = 0;
+}
+
 /*
 ==============
 G2_ConstructGhoulSkeleton - builds a complete skeleton for all ghoul models in a CGhoul2Info_v class	- using LOD 0
@@ -2886,6 +3108,11 @@ G2_ConstructGhoulSkeleton - builds a complete skeleton for all ghoul models in a
 */
 void G2_ConstructGhoulSkeleton( CGhoul2Info_v &ghoul2,const int frameNum,bool checkForNewOrigin,const vec3_t scale)
 {
+	if (g2NumHeldSkeletons && G2_SkeletonHeld(ghoul2,frameNum,checkForNewOrigin,scale))
+	{
+		// G2_ConstructSkeletons built it and nothing can have moved since
+		return;
+	}
 #ifdef G2_PERFORMANCE_ANALYSIS
 	G2PerformanceTimer_G2_ConstructGhoulSkeleton.Start();
 #endif
@@ -3383,6 +3610,7 @@ qboolean R_LoadMDXM( model_t *mod, void *buffer, const char *mod_name, qboolean
 
 	if (bAlreadyFound)
 	{
+		G2_RegisterHitIndex(mod, mod_name);
 		return qtrue;	// All done. Stop, go no further, do not LittleLong(), do not pass Go...
 	}
 
@@ -3519,6 +3747,7 @@ qboolean R_LoadMDXM( model_t *mod, void *buffer, const char *mod_name, qboolean
 		// find the next LOD
 		lod = (mdxmLOD_t *)( (byte *)lod + lod->ofsEnd );
 	}
+	G2_RegisterHitIndex(mod, mod_name);
 	return qtrue;
 }
 
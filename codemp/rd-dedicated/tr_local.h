@@ -869,6 +869,7 @@ Ghoul2 Insert Start
 */
 	mdxmHeader_t *mdxm;				// only if type == MOD_GL2M which is a GHOUL II Mesh file NOT a GHOUL II animation file
 	mdxaHeader_t *mdxa;				// only if type == MOD_GL2A which is a GHOUL II Animation file
+	const struct g2HitIndex_s *mdxmHits;	// cluster bounds for point traces against mdxm, see G2_RegisterHitIndex
 /*
 Ghoul2 Insert End
 */
@@ -1371,6 +1372,7 @@ int			RE_RegisterMedia_GetLevel(void);
 //
 qboolean	RE_RegisterModels_LevelLoadEnd(qboolean bDeleteEverythingNotUsedThisLevel = qfalse);
 void*		RE_RegisterModels_Malloc(int iSize, void *pvDiskBufferIfJustLoaded, const char *psModelFileName, qboolean *pqbAlreadyFound, memtag_t eTag);
+void*		RE_RegisterModels_Find(const char *psModelFileName);
 void		RE_RegisterModels_StoreShaderRequest(const char *psModelFileName, const char *psShaderName, int *piShaderIndexPoke);
 void		RE_RegisterModels_Info_f(void);
 //
@@ -1689,6 +1691,9 @@ CRenderableSurface():
 
 void R_AddGhoulSurfaces( trRefEntity_t *ent );
 void RB_SurfaceGhoul( CRenderableSurface *surface );
+void G2_RegisterHitIndex( model_t *mod, const char *mod_name );
+void G2_SkinCacheInit( void );
+void G2_SkinCacheShutdown( void );
 /*
 Ghoul2 Insert End
 */
@@ -238,6 +238,30 @@ void *RE_RegisterModels_Malloc(int iSize, void *pvDiskBufferIfJustLoaded, const
 	return ModelBin.pModelDiskImage;
 }
 
+// returns what RE_RegisterModels_Malloc cached under this name, or NULL without adding an entry,
+//	so something derived from a model can be looked up before going to the trouble of building it
+//
+void *RE_RegisterModels_Find(const char *psModelFileName)
+{
+	char sModelName[MAX_QPATH];
+
+	assert(CachedModels);
+
+	Q_strncpyz(sModelName,psModelFileName,sizeof(sModelName));
+	Q_strlwr  (sModelName);
+
+	CachedModels_t::iterator itModel = CachedModels->find(sModelName);
+
+	if (itModel == CachedModels->end() || (*itModel).second.pModelDiskImage == NULL)
+	{
+		return NULL;
+	}
+
+	(*itModel).second.iLastLevelUsedOn = RE_RegisterMedia_GetLevel();
+
+	return (*itModel).second.pModelDiskImage;
+}
+
 // Unfortunately the dedicated server also hates shader loading. So we need an alternate of this func.
 //
 void *RE_RegisterServerModels_Malloc(int iSize, void *pvDiskBufferIfJustLoaded, const char *psModelFileName, qboolean *pqbAlreadyFound, memtag_t eTag)
@@ -828,6 +852,7 @@ qboolean ServerLoadMDXM( model_t *mod, void *buffer, const char *mod_name, qbool
 
 	if (bAlreadyFound)
 	{
+		G2_RegisterHitIndex(mod, mod_name);
 		return qtrue;	// All done. Stop, go no further, do not LittleLong(), do not pass Go...
 	}
 
@@ -944,6 +969,7 @@ qboolean ServerLoadMDXM( model_t *mod, void *buffer, const char *mod_name, qbool
 		lod = (mdxmLOD_t *)( (byte *)lod + lod->ofsEnd );
 	}
 
+	G2_RegisterHitIndex(mod, mod_name);
 	return qtrue;
 }
 
@@ -1550,6 +1576,7 @@ static qboolean R_LoadMD3 (model_t *mod, int lod, void *buffer, const char *mod_
 void R_SVModelInit()
 {
 	R_ModelInit();
+	G2_SkinCacheInit();
 }
 
 /*
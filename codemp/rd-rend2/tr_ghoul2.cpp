@@ -1,6 +1,7 @@
 #include "client/client.h"	//FIXME!! EVIL - just include the definitions needed
 #include "tr_local.h"
 #include "qcommon/matcomp.h"
+#include "rd-common/mdx_simd.h"
 #include "qcommon/qcommon.h"
 #include "ghoul2/G2.h"
 #include "ghoul2/g2_local.h"
@@ -137,49 +138,7 @@ void Mat3x4_Multiply(mdxaBone_t *out, const mdxaBone_t *in2, const mdxaBone_t *i
 	assert(in != nullptr);
 
 	// Let's say we are doing R = N * M
-	const float n00 = in2->matrix[0][0];
-	const float n01 = in2->matrix[0][1];
-	const float n02 = in2->matrix[0][2];
-	const float n03 = in2->matrix[0][3];
-	const float n10 = in2->matrix[1][0];
-	const float n11 = in2->matrix[1][1];
-	const float n12 = in2->matrix[1][2];
-	const float n13 = in2->matrix[1][3];
-	const float n20 = in2->matrix[2][0];
-	const float n21 = in2->matrix[2][1];
-	const float n22 = in2->matrix[2][2];
-	const float n23 = in2->matrix[2][3];
-
-	const float m00 = in->matrix[0][0];
-	const float m01 = in->matrix[0][1];
-	const float m02 = in->matrix[0][2];
-	const float m03 = in->matrix[0][3];
-	const float m10 = in->matrix[1][0];
-	const float m11 = in->matrix[1][1];
-	const float m12 = in->matrix[1][2];
-	const float m13 = in->matrix[1][3];
-	const float m20 = in->matrix[2][0];
-	const float m21 = in->matrix[2][1];
-	const float m22 = in->matrix[2][2];
-	const float m23 = in->matrix[2][3];
-
-	// first row of out
-	out->matrix[0][0] = (n00 * m00) + (n01 * m10) + (n02 * m20);
-	out->matrix[0][1] = (n00 * m01) + (n01 * m11) + (n02 * m21);
-	out->matrix[0][2] = (n00 * m02) + (n01 * m12) + (n02 * m22);
-	out->matrix[0][3] = (n00 * m03) + (n01 * m13) + (n02 * m23) + n03;
-
-	// second row of outf out
-	out->matrix[1][0] = (n10 * m00) + (n11 * m10) + (n12 * m20);
-	out->matrix[1][1] = (n10 * m01) + (n11 * m11) + (n12 * m21);
-	out->matrix[1][2] = (n10 * m02) + (n11 * m12) + (n12 * m22);
-	out->matrix[1][3] = (n10 * m03) + (n11 * m13) + (n12 * m23) + n13;
-
-	// third row of out  out
-	out->matrix[2][0] = (n20 * m00) + (n21 * m10) + (n22 * m20);
-	out->matrix[2][1] = (n20 * m01) + (n21 * m11) + (n22 * m21);
-	out->matrix[2][2] = (n20 * m02) + (n21 * m12) + (n22 * m22);
-	out->matrix[2][3] = (n20 * m03) + (n21 * m13) + (n22 * m23) + n23;
+	Mdx_Multiply3x4(out, in2, in);
 }
 
 void Mat3x4_Scale( mdxaBone_t *result, const mdxaBone_t *lhs, const float scale )
@@ -199,13 +158,7 @@ void Mat3x4_Lerp(
 	const mdxaBone_t *rhs,
 	const float t )
 {
-	for ( int i = 0; i < 3; ++i )
-	{
-		for ( int j = 0; j < 4; ++j )
-		{
-			result->matrix[i][j] = lhs->matrix[i][j] * t + rhs->matrix[i][j] * (1.0f - t);
-		}
-	}
+	Mdx_LerpBone(result, lhs, t, rhs, 1.0f - t);
 }
 
 const mdxaBone_t operator +( const mdxaBone_t& lhs, const mdxaBone_t& rhs )
@@ -291,10 +244,14 @@ public:
 	int touchRender;
 	mdxaBone_t boneMatrix; //final matrix
 	int parent; // only set once
+	int prepared; // touch CBoneCache::Prepare already evaluated this bone for
+	int used; // touch this bone was last put on the prepare list for
 
 	CTransformBone()
 		: touch(0)
 		, touchRender(0)
+		, prepared(0)
+		, used(0)
 	{
 	}
 
@@ -322,6 +279,18 @@ class CBoneCache
 
 		if ( mFinalBones[index].touch != mCurrentTouch )
 		{
+			if ( mFinalBones[index].prepared == mCurrentTouch )
+			{
+				// already evaluated by Prepare, just mark it and its parents
+				// as used
+				if ( mFinalBones[index].parent >= 0 )
+				{
+					EvalLow(mFinalBones[index].parent);
+				}
+				mFinalBones[index].touch = mCurrentTouch;
+				return;
+			}
+
 			// need to evaluate the bone
 			assert((mFinalBones[index].parent >= 0
 						&& mFinalBones[index].parent < (int)mFinalBones.size()) ||
@@ -348,6 +317,36 @@ class CBoneCache
 		}
 	}
 
+	// same as EvalLow, but leaves touch alone so EvalRender still sees the
+	// bone as new this touch and keeps the ragdoll render marks right
+	void PrepareLow( int index )
+	{
+		assert(index >= 0 && index < (int)mBones.size());
+
+		if ( mFinalBones[index].touch != mCurrentTouch &&
+				mFinalBones[index].prepared != mCurrentTouch )
+		{
+			if ( mFinalBones[index].parent >= 0 )
+			{
+				PrepareLow(mFinalBones[index].parent);
+
+				const SBoneCalc &par = mBones[mFinalBones[index].parent];
+				SBoneCalc &bone = mBones[index];
+				bone.newFrame = par.newFrame;
+				bone.currentFrame = par.currentFrame;
+				bone.backlerp = par.backlerp;
+				bone.blendFrame = par.blendFrame;
+				bone.blendOldFrame = par.blendOldFrame;
+				bone.blendMode = par.blendMode;
+				bone.blendLerp = par.blendLerp;
+			}
+
+			G2_TransformBone(index, *this);
+
+			mFinalBones[index].prepared = mCurrentTouch;
+		}
+	}
+
 	void SmoothLow( int index )
 	{
 		if ( mSmoothBones[index].touch == mLastTouch )
@@ -404,6 +403,8 @@ public:
 	int incomingTime;
 
 	int mCurrentTouch;
+	std::vector<int> mPrepareBones; // bones MarkUsed asked Prepare for, this touch
+	int mPrepareTouch; // touch mPrepareBones was collected for
 	int mCurrentTouchRender;
 	int mLastTouch;
 	int mLastLastTouch;
@@ -425,6 +426,7 @@ public:
 		, mFinalBones(header->numBones)
 		, mSmoothBones(header->numBones)
 		, mCurrentTouch(3)
+		, mPrepareTouch(0)
 		, mLastTouch(2)
 		, mLastLastTouch(1)
 		, mSmoothingActive(false)
@@ -456,6 +458,38 @@ public:
 		return mBones[0];
 	}
 
+	// asks the next Prepare for a bone a surface or bolt of this touch uses
+	void MarkUsed( int index )
+	{
+		assert(index >= 0 && index < (int)mBones.size());
+		if ( mPrepareTouch != mCurrentTouch )
+		{
+			mPrepareBones.clear();
+			mPrepareTouch = mCurrentTouch;
+		}
+		if ( mFinalBones[index].used != mCurrentTouch )
+		{
+			mFinalBones[index].used = mCurrentTouch;
+			mPrepareBones.push_back(index);
+		}
+	}
+
+	// evaluates the bones marked for the current touch, and their parents,
+	// up front so the lazy Eval calls that follow only pick the results up.
+	// Anything else is still evaluated when it's asked for.  Touches nothing
+	// outside this cache, several caches can be prepared on job threads at once.
+	void Prepare()
+	{
+		if ( mPrepareTouch != mCurrentTouch )
+		{
+			return;
+		}
+		for ( size_t i = 0; i < mPrepareBones.size(); i++ )
+		{
+			PrepareLow(mPrepareBones[i]);
+		}
+	}
+
 	const mdxaBone_t &EvalUnsmooth( int index )
 	{
 		EvalLow(index);
@@ -1121,7 +1155,7 @@ static int G2_GetBonePoolIndex(	const mdxaHeader_t *pMDXAHeader, int iFrame, int
 {
 	mdxaCompQuatBone_t *pCompBonePool =
 		(mdxaCompQuatBone_t *)((byte *)pMDXAHeader + pMDXAHeader->ofsCompBonePool);
-	MC_UnCompressQuat(
+	Mdx_UnCompressQuat(
 		mat,
 		pCompBonePool[G2_GetBonePoolIndex(pMDXAHeader, iFrame, iBoneIndex)].Comp);
 }
@@ -3327,6 +3361,211 @@ bool G2_NeedsRecalc(CGhoul2Info *ghlInfo,int frameNum)
 	return false;
 }
 
+/*
+==============
+G2_ConstructSkeletons
+
+Skeletons built ahead of a run of queries that can't change them, for
+example the Ghoul2 traces of a server trace batch.  The skeletons are set up
+here and the bones used by their surfaces at each model's trace LOD and by
+their bolts are evaluated on the job threads, one bone cache per job.  Any
+other bone a query needs is evaluated when it's asked for.  Until
+G2_ReleaseSkeletons, G2_ConstructGhoulSkeleton leaves a held skeleton alone
+when it is asked for the same time and scale again.
+==============
+*/
+#define MAX_G2_HELD_SKELETONS 256
+#define MAX_G2_PREPARED_CACHES 1024
+
+struct g2HeldSkeleton_t
+{
+	CGhoul2Info_v *ghoul2;
+	vec3_t scale;
+};
+
+static g2HeldSkeleton_t g2HeldSkeletons[MAX_G2_HELD_SKELETONS];
+static int g2NumHeldSkeletons;
+static int g2HeldFrameNum;
+
+static CBoneCache *g2PreparedCaches[MAX_G2_PREPARED_CACHES];
+
+static void G2_PrepareBoneCacheJob( void *data, int index )
+{
+	((CBoneCache **)data)[index]->Prepare();
+}
+
+int G2_DecideTraceLod( CGhoul2Info &ghoul2, int useLod );
+
+// asks the next Prepare of the cache for the bones a surface is skinned with
+static void G2_MarkSurfaceBones(
+	CBoneCache *boneCache,
+	const mdxmSurface_t *surface)
+{
+	const int *piBoneReferences =
+		(const int *)((const byte *)surface + surface->ofsBoneReferences);
+
+	for ( int i = 0; i < surface->numBoneReferences; i++ )
+	{
+		boneCache->MarkUsed(piBoneReferences[i]);
+	}
+}
+
+// marks the bones of the surfaces of a LOD that aren't switched off, walking
+// the hierarchy the way G2_TransformSurfaces does.  Uses the quick override
+// lookup, so this has to stay on the main thread.
+static void G2_MarkSurfaceTreeBones(
+	CGhoul2Info &ghoul2,
+	int surfaceNum,
+	int lod)
+{
+	const mdxmSurface_t *surface = (mdxmSurface_t *)G2_FindSurface(
+		(void *)ghoul2.currentModel, surfaceNum, lod);
+	const mdxmHierarchyOffsets_t *surfIndexes = (mdxmHierarchyOffsets_t *)
+		((byte *)ghoul2.currentModel->data.glm->header + sizeof(mdxmHeader_t));
+	const mdxmSurfHierarchy_t *surfInfo = (mdxmSurfHierarchy_t *)
+		((byte *)surfIndexes + surfIndexes->offsets[surface->thisSurfaceIndex]);
+	const surfaceInfo_t *surfOverride =
+		G2_FindOverrideSurface(surfaceNum, ghoul2.mSlist);
+
+	int offFlags = surfInfo->flags;
+	if ( surfOverride )
+	{
+		offFlags = surfOverride->offFlags;
+	}
+
+	if ( !offFlags )
+	{
+		G2_MarkSurfaceBones(ghoul2.mBoneCache, surface);
+	}
+
+	if ( offFlags & G2SURFACEFLAG_NODESCENDANTS )
+	{
+		return;
+	}
+
+	for ( int i = 0; i < surfInfo->numChildren; i++ )
+	{
+		G2_MarkSurfaceTreeBones(ghoul2, surfInfo->childIndexes[i], lod);
+	}
+}
+
+// marks the bones a trace at useLod and the bolts of the models will use for
+// the next Prepare.  Bolts on generated surfaces are left to be evaluated
+// when they're asked for.
+static void G2_MarkUsedBones( CGhoul2Info_v &ghoul2, int useLod )
+{
+	for ( int i = 0; i < ghoul2.size(); i++ )
+	{
+		CGhoul2Info &g = ghoul2[i];
+		if ( !g.mValid || !g.mBoneCache )
+		{
+			continue;
+		}
+
+		G2_FindOverrideSurface(-1, g.mSlist); //reset the quick surface override lookup
+		G2_MarkSurfaceTreeBones(
+			g, g.mSurfaceRoot, G2_DecideTraceLod(g, useLod));
+
+		for ( const boltInfo_t& bolt : g.mBltlist )
+		{
+			if ( bolt.boneNumber >= 0 )
+			{
+				g.mBoneCache->MarkUsed(bolt.boneNumber);
+			}
+			else if ( bolt.surfaceNumber >= 0 &&
+					bolt.surfaceType != G2SURFACEFLAG_GENERATED )
+			{
+				G2_MarkSurfaceBones(
+					g.mBoneCache,
+					(mdxmSurface_t *)G2_FindSurface(
+						(void *)g.currentModel, bolt.surfaceNumber, 0));
+			}
+		}
+	}
+}
+
+// true when the skeleton is held as built for exactly these arguments, any
+// other build of a held skeleton ends its hold
+static bool G2_SkeletonHeld(
+	CGhoul2Info_v &ghoul2,
+	const int frameNum,
+	bool checkForNewOrigin,
+	const vec3_t scale)
+{
+	for ( int i = 0; i < g2NumHeldSkeletons; i++ )
+	{
+		g2HeldSkeleton_t& held = g2HeldSkeletons[i];
+		if ( held.ghoul2 != &ghoul2 )
+		{
+			continue;
+		}
+
+		if ( checkForNewOrigin && scale && frameNum == g2HeldFrameNum &&
+				VectorCompare(held.scale, scale) )
+		{
+			return true;
+		}
+
+		held = g2HeldSkeletons[--g2NumHeldSkeletons];
+		return false;
+	}
+
+	return false;
+}
+
+void G2_ConstructSkeletons(
+	CGhoul2Info_v **ghoul2,
+	float **scales,
+	int *lods,
+	int count,
+	const int frameNum,
+	int numThreads)
+{
+	int numCaches = 0;
+
+	G2_ReleaseSkeletons();
+
+	for ( int i = 0; i < count && g2NumHeldSkeletons < MAX_G2_HELD_SKELETONS; i++ )
+	{
+		CGhoul2Info_v &g2 = *ghoul2[i];
+
+		if ( !g2.IsValid() || !G2_SetupModelPointers(g2) ||
+				G2_SkeletonHeld(g2, frameNum, true, scales[i]) )
+		{
+			continue;
+		}
+
+		if ( numCaches + g2.size() > MAX_G2_PREPARED_CACHES )
+		{
+			break;
+		}
+
+		G2_ConstructGhoulSkeleton(g2, frameNum, true, scales[i]);
+		G2_MarkUsedBones(g2, lods[i]);
+
+		for ( int j = 0; j < g2.size(); j++ )
+		{
+			if ( g2[j].mValid && g2[j].mBoneCache )
+			{
+				g2PreparedCaches[numCaches++] = g2[j].mBoneCache;
+			}
+		}
+
+		g2HeldSkeleton_t& held = g2HeldSkeletons[g2NumHeldSkeletons++];
+		held.ghoul2 = &g2;
+		VectorCopy(scales[i], held.scale);
+		g2HeldFrameNum = frameNum;
+	}
+
+	ri.Sys_ParallelFor(
+		numThreads, numCaches, G2_PrepareBoneCacheJob, g2PreparedCaches);
+}
+
+void G2_ReleaseSkeletons( void )
+{
+	g2NumHeldSkeletons = 0;
+}
+
 /*
 ==============
 G2_ConstructGhoulSkeleton
@@ -3340,6 +3579,13 @@ void G2_ConstructGhoulSkeleton(
 	bool checkForNewOrigin,
 	const vec3_t scale)
 {
+	if ( g2NumHeldSkeletons &&
+			G2_SkeletonHeld(ghoul2, frameNum, checkForNewOrigin, scale) )
+	{
+		// G2_ConstructSkeletons built it and nothing can have moved since
+		return;
+	}
+
 #ifdef G2_PERFORMANCE_ANALYSIS
 	G2PerformanceTimer_G2_ConstructGhoulSkeleton.Start();
 #endif
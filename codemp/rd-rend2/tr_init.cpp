@@ -2284,6 +2284,7 @@ Q_EXPORT refexport_t* QDECL GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 	re.G2API_ClearAttachedInstance			= G2API_ClearAttachedInstance;
 	re.G2API_CollisionDetect				= G2API_CollisionDetect;
 	re.G2API_CollisionDetectCache			= G2API_CollisionDetectCache;
+	re.G2API_ConstructSkeletons				= G2API_ConstructSkeletons;
 	re.G2API_CopyGhoul2Instance				= G2API_CopyGhoul2Instance;
 	re.G2API_CopySpecificG2Model			= G2API_CopySpecificG2Model;
 	re.G2API_DetachG2Model					= G2API_DetachG2Model;
@@ -2326,6 +2327,7 @@ Q_EXPORT refexport_t* QDECL GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 	re.G2API_RagForceSolve					= G2API_RagForceSolve;
 	re.G2API_RagPCJConstraint				= G2API_RagPCJConstraint;
 	re.G2API_RagPCJGradientSpeed			= G2API_RagPCJGradientSpeed;
+	re.G2API_ReleaseSkeletons				= G2API_ReleaseSkeletons;
 	re.G2API_RemoveBolt						= G2API_RemoveBolt;
 	re.G2API_RemoveBone						= G2API_RemoveBone;
 	re.G2API_RemoveGhoul2Model				= G2API_RemoveGhoul2Model;
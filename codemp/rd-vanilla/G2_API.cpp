@@ -2379,6 +2379,19 @@ void G2API_CollisionDetect(CollisionRecord_t *collRecMap, CGhoul2Info_v &ghoul2,
 	}
 }
 
+// Builds the skeletons of several instances at once for a run of queries that
+// can't change them, see G2_ConstructSkeletons.  Release them before any bone
+// can move again.
+void G2API_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, int frameNumber, int numThreads)
+{
+	G2_ConstructSkeletons(ghoul2, scales, lods, count, frameNumber, numThreads);
+}
+
+void G2API_ReleaseSkeletons(void)
+{
+	G2_ReleaseSkeletons();
+}
+
 qboolean G2API_SetGhoul2ModelFlags(CGhoul2Info *ghlInfo, const int flags)
 {
 	if (G2_SetupModelPointers(ghlInfo))
@@ -23,6 +23,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "client/client.h"	//FIXME!! EVIL - just include the definitions needed
 #include "tr_local.h"
 #include "qcommon/matcomp.h"
+#include "rd-common/mdx_simd.h"
 #include "qcommon/qcommon.h"
 #include "ghoul2/G2.h"
 #include "ghoul2/g2_local.h"
@@ -176,6 +177,8 @@ public:
 	//rww - RAGDOLL_END
 	mdxaBone_t		boneMatrix; //final matrix
 	int				parent; // only set once
+	int				prepared; // touch CBoneCache::Prepare already evaluated this bone for
+	int				used; // touch this bone was last put on the prepare list for
 
 	CTransformBone()
 	{
@@ -183,6 +186,8 @@ public:
 	//rww - RAGDOLL_BEGIN
 		touchRender = 0;
 	//rww - RAGDOLL_END
+		prepared=0;
+		used=0;
 	}
 
 };
@@ -211,6 +216,16 @@ class CBoneCache
 		assert(index>=0&&index<(int)mBones.size());
 		if (mFinalBones[index].touch!=mCurrentTouch)
 		{
+			if (mFinalBones[index].prepared==mCurrentTouch)
+			{
+				// already evaluated by Prepare, just mark it and its parents as used
+				if (mFinalBones[index].parent>=0)
+				{
+					EvalLow(mFinalBones[index].parent);
+				}
+				mFinalBones[index].touch=mCurrentTouch;
+				return;
+			}
 			// need to evaluate the bone
 			assert((mFinalBones[index].parent>=0&&mFinalBones[index].parent<(int)mFinalBones.size())||(index==0&&mFinalBones[index].parent==-1));
 			if (mFinalBones[index].parent>=0)
@@ -229,6 +244,29 @@ class CBoneCache
 			mFinalBones[index].touch=mCurrentTouch;
 		}
 	}
+	// same as EvalLow, but leaves touch alone so EvalRender still sees the
+	// bone as new this touch and keeps the ragdoll render marks right
+	void PrepareLow(int index)
+	{
+		assert(index>=0&&index<(int)mBones.size());
+		if (mFinalBones[index].touch!=mCurrentTouch&&mFinalBones[index].prepared!=mCurrentTouch)
+		{
+			if (mFinalBones[index].parent>=0)
+			{
+				PrepareLow(mFinalBones[index].parent);
+				SBoneCalc &par=mBones[mFinalBones[index].parent];
+				mBones[index].newFrame=par.newFrame;
+				mBones[index].currentFrame=par.currentFrame;
+				mBones[index].backlerp=par.backlerp;
+				mBones[index].blendFrame=par.blendFrame;
+				mBones[index].blendOldFrame=par.blendOldFrame;
+				mBones[index].blendMode=par.blendMode;
+				mBones[index].blendLerp=par.blendLerp;
+			}
+			G2_TransformBone(index,*this);
+			mFinalBones[index].prepared=mCurrentTouch;
+		}
+	}
 //rww - RAGDOLL_BEGIN
 	void SmoothLow(int index)
 	{
@@ -329,6 +367,8 @@ public:
 	int				incomingTime;
 
 	int				mCurrentTouch;
+	std::vector<int> mPrepareBones; // bones MarkUsed asked Prepare for, this touch
+	int				mPrepareTouch; // touch mPrepareBones was collected for
 	//rww - RAGDOLL_BEGIN
 	int				mCurrentTouchRender;
 	int				mLastTouch;
@@ -340,6 +380,8 @@ public:
 	bool			mUnsquash;
 	float			mSmoothFactor;
 
+	int				mViewPass; // last R_PrepareGhoulSkeletons pass this cache was queued for
+
 	CBoneCache(const model_t *amod,const mdxaHeader_t *aheader) :
 		header(aheader),
 		mod(amod)
@@ -349,6 +391,7 @@ public:
 		mSmoothingActive=false;
 		mUnsquash=false;
 		mSmoothFactor=0.0f;
+		mViewPass=0;
 
 		int numBones=header->numBones;
 		mBones.resize(numBones);
@@ -369,6 +412,7 @@ public:
 			mFinalBones[i].parent=skel->parent;
 		}
 		mCurrentTouch=3;
+		mPrepareTouch=0;
 //rww - RAGDOLL_BEGIN
 		mLastTouch=2;
 		mLastLastTouch=1;
@@ -380,6 +424,36 @@ public:
 		assert(mBones.size());
 		return mBones[0];
 	}
+	// asks the next Prepare for a bone a surface or bolt of this touch uses
+	void MarkUsed(int index)
+	{
+		assert(index>=0&&index<(int)mBones.size());
+		if (mPrepareTouch!=mCurrentTouch)
+		{
+			mPrepareBones.clear();
+			mPrepareTouch=mCurrentTouch;
+		}
+		if (mFinalBones[index].used!=mCurrentTouch)
+		{
+			mFinalBones[index].used=mCurrentTouch;
+			mPrepareBones.push_back(index);
+		}
+	}
+	// evaluates the bones marked for the current touch, and their parents,
+	// up front so the lazy Eval calls that follow only pick the results up.
+	// Anything else is still evaluated when it's asked for.  Touches nothing
+	// outside this cache, several caches can be prepared on job threads at once.
+	void Prepare()
+	{
+		if (mPrepareTouch!=mCurrentTouch)
+		{
+			return;
+		}
+		for (size_t i=0;i<mPrepareBones.size();i++)
+		{
+			PrepareLow(mPrepareBones[i]);
+		}
+	}
 	const mdxaBone_t &EvalUnsmooth(int index)
 	{
 		EvalLow(index);
@@ -1049,21 +1123,7 @@ void G2_CreateMatrixFromQuaterion(mdxaBone_t *mat, vec4_t quat)
 // nasty little matrix multiply going on here..
 void Multiply_3x4Matrix(mdxaBone_t *out, mdxaBone_t *in2, mdxaBone_t *in)
 {
-	// first row of out
-	out->matrix[0][0] = (in2->matrix[0][0] * in->matrix[0][0]) + (in2->matrix[0][1] * in->matrix[1][0]) + (in2->matrix[0][2] * in->matrix[2][0]);
-	out->matrix[0][1] = (in2->matrix[0][0] * in->matrix[0][1]) + (in2->matrix[0][1] * in->matrix[1][1]) + (in2->matrix[0][2] * in->matrix[2][1]);
-	out->matrix[0][2] = (in2->matrix[0][0] * in->matrix[0][2]) + (in2->matrix[0][1] * in->matrix[1][2]) + (in2->matrix[0][2] * in->matrix[2][2]);
-	out->matrix[0][3] = (in2->matrix[0][0] * in->matrix[0][3]) + (in2->matrix[0][1] * in->matrix[1][3]) + (in2->matrix[0][2] * in->matrix[2][3]) + in2->matrix[0][3];
-	// second row of outf out
-	out->matrix[1][0] = (in2->matrix[1][0] * in->matrix[0][0]) + (in2->matrix[1][1] * in->matrix[1][0]) + (in2->matrix[1][2] * in->matrix[2][0]);
-	out->matrix[1][1] = (in2->matrix[1][0] * in->matrix[0][1]) + (in2->matrix[1][1] * in->matrix[1][1]) + (in2->matrix[1][2] * in->matrix[2][1]);
-	out->matrix[1][2] = (in2->matrix[1][0] * in->matrix[0][2]) + (in2->matrix[1][1] * in->matrix[1][2]) + (in2->matrix[1][2] * in->matrix[2][2]);
-	out->matrix[1][3] = (in2->matrix[1][0] * in->matrix[0][3]) + (in2->matrix[1][1] * in->matrix[1][3]) + (in2->matrix[1][2] * in->matrix[2][3]) + in2->matrix[1][3];
-	// third row of out  out
-	out->matrix[2][0] = (in2->matrix[2][0] * in->matrix[0][0]) + (in2->matrix[2][1] * in->matrix[1][0]) + (in2->matrix[2][2] * in->matrix[2][0]);
-	out->matrix[2][1] = (in2->matrix[2][0] * in->matrix[0][1]) + (in2->matrix[2][1] * in->matrix[1][1]) + (in2->matrix[2][2] * in->matrix[2][1]);
-	out->matrix[2][2] = (in2->matrix[2][0] * in->matrix[0][2]) + (in2->matrix[2][1] * in->matrix[1][2]) + (in2->matrix[2][2] * in->matrix[2][2]);
-	out->matrix[2][3] = (in2->matrix[2][0] * in->matrix[0][3]) + (in2->matrix[2][1] * in->matrix[1][3]) + (in2->matrix[2][2] * in->matrix[2][3]) + in2->matrix[2][3];
+	Mdx_Multiply3x4(out, in2, in);
 }
 
 
@@ -1079,7 +1139,7 @@ static int G2_GetBonePoolIndex(const mdxaHeader_t *pMDXAHeader, int iFrame, int
 /*static inline*/ void UnCompressBone(float mat[3][4], int iBoneIndex, const mdxaHeader_t *pMDXAHeader, int iFrame)
 {
 	mdxaCompQuatBone_t *pCompBonePool = (mdxaCompQuatBone_t *) ((byte *)pMDXAHeader + pMDXAHeader->ofsCompBonePool);
-	MC_UnCompressQuat(mat, pCompBonePool[ G2_GetBonePoolIndex( pMDXAHeader, iFrame, iBoneIndex ) ].Comp);
+	Mdx_UnCompressQuat(mat, pCompBonePool[ G2_GetBonePoolIndex( pMDXAHeader, iFrame, iBoneIndex ) ].Comp);
 }
 
 #define DEBUG_G2_TIMING (0)
@@ -1462,15 +1522,15 @@ void G2_RagGetAnimMatrix(CGhoul2Info &ghoul2, const int boneNum, mdxaBone_t &mat
 void G2_TransformBone (int child,CBoneCache &BC)
 {
 	SBoneCalc &TB=BC.mBones[child];
-	static mdxaBone_t		tbone[6];
+	mdxaBone_t		tbone[6];
 // 	mdxaFrame_t		*aFrame=0;
 //	mdxaFrame_t		*bFrame=0;
 //	mdxaFrame_t		*aoldFrame=0;
 //	mdxaFrame_t		*boldFrame=0;
-	static mdxaSkel_t		*skel;
-	static mdxaSkelOffsets_t *offsets;
+	mdxaSkel_t		*skel;
+	mdxaSkelOffsets_t *offsets;
 	boneInfo_v		&boneList = *BC.rootBoneList;
-	static int				j, boneListIndex;
+	int				boneListIndex;
 	int				angleOverride = 0;
 
 #if DEBUG_G2_TIMING
@@ -1628,11 +1688,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		UnCompressBone(tbone[3].matrix, child, BC.header, TB.blendFrame);
 		UnCompressBone(tbone[4].matrix, child, BC.header, TB.blendOldFrame);
 
-		for ( j = 0 ; j < 12 ; j++ )
-		{
-  			((float *)&tbone[5])[j] = (backlerp * ((float *)&tbone[3])[j])
-				+ (frontlerp * ((float *)&tbone[4])[j]);
-		}
+		Mdx_LerpBone(&tbone[5], &tbone[3], backlerp, &tbone[4], frontlerp);
 	}
 
   	//
@@ -1647,11 +1703,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		if (TB.blendMode)
 		{
 			float blendFrontlerp = 1.0 - TB.blendLerp;
-	  		for ( j = 0 ; j < 12 ; j++ )
-			{
-  				((float *)&tbone[2])[j] = (TB.blendLerp * ((float *)&tbone[2])[j])
-					+ (blendFrontlerp * ((float *)&tbone[5])[j]);
-			}
+			Mdx_LerpBone(&tbone[2], &tbone[2], TB.blendLerp, &tbone[5], blendFrontlerp);
 		}
 
   		if (!child)
@@ -1668,21 +1720,13 @@ void G2_TransformBone (int child,CBoneCache &BC)
 		UnCompressBone(tbone[0].matrix, child, BC.header, TB.newFrame);
 		UnCompressBone(tbone[1].matrix, child, BC.header, TB.currentFrame);
 
-		for ( j = 0 ; j < 12 ; j++ )
-		{
-  			((float *)&tbone[2])[j] = (TB.backlerp * ((float *)&tbone[0])[j])
-				+ (frontlerp * ((float *)&tbone[1])[j]);
-		}
+		Mdx_LerpBone(&tbone[2], &tbone[0], TB.backlerp, &tbone[1], frontlerp);
 
 		// blend in the other frame if we need to
 		if (TB.blendMode)
 		{
 			float blendFrontlerp = 1.0 - TB.blendLerp;
-	  		for ( j = 0 ; j < 12 ; j++ )
-			{
-  				((float *)&tbone[2])[j] = (TB.blendLerp * ((float *)&tbone[2])[j])
-					+ (blendFrontlerp * ((float *)&tbone[5])[j]);
-			}
+			Mdx_LerpBone(&tbone[2], &tbone[2], TB.blendLerp, &tbone[5], blendFrontlerp);
 		}
 
   		if (!child)
@@ -1718,7 +1762,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 			// this is crazy, we are gonna drive the animation to ID while we are doing post mults to compensate.
 			Multiply_3x4Matrix(&temp,&firstPass, &skel->BasePoseMat);
 			float	matrixScale = VectorLength((float*)&temp);
-			static mdxaBone_t		toMatrix =
+			mdxaBone_t		toMatrix =
 			{
 				{
 					{ 1.0f, 0.0f, 0.0f, 0.0f },
@@ -1751,11 +1795,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 //					mdxaBone_t lerp;
 					// now do the blend into the destination
 					float blendFrontlerp = 1.0 - blendLerp;
-	  				for ( j = 0 ; j < 12 ; j++ )
-					{
-  						((float *)&bone)[j] = (blendLerp * ((float *)&temp)[j])
-							+ (blendFrontlerp * ((float *)&tbone[2])[j]);
-					}
+					Mdx_LerpBone(&bone, &temp, blendLerp, &tbone[2], blendFrontlerp);
 //					Multiply_3x4Matrix(&bone, &BC.mFinalBones[parent].boneMatrix,&lerp);
 				}
 			}
@@ -1821,11 +1861,7 @@ void G2_TransformBone (int child,CBoneCache &BC)
 
 					// now do the blend into the destination
 					float blendFrontlerp = 1.0 - blendLerp;
-	  				for ( j = 0 ; j < 12 ; j++ )
-					{
-  						((float *)&bone)[j] = (blendLerp * ((float *)&temp)[j])
-							+ (blendFrontlerp * ((float *)&firstPass)[j]);
-					}
+					Mdx_LerpBone(&bone, &temp, blendLerp, &firstPass, blendFrontlerp);
 				}
 				else
 				{
@@ -2395,6 +2431,44 @@ void G2_ProcessGeneratedSurfaceBolts(CGhoul2Info &ghoul2, mdxaBone_v &bonePtr, m
 #endif
 }
 
+// r_ghoul2Threads, or a thread per core when it's 0
+static int G2_ViewThreads(void)
+{
+	static int	cpuCount;
+
+	if (r_ghoul2Threads->integer > 0)
+	{
+		return r_ghoul2Threads->integer;
+	}
+	if (!cpuCount)
+	{
+		cpuCount = ri.Sys_CPUCount();
+	}
+	return cpuCount;
+}
+
+// asks the next Prepare of the cache for the bones a surface is skinned with
+static void G2_MarkSurfaceBones(CBoneCache *boneCache, const mdxmSurface_t *surface)
+{
+	const int	*piBoneReferences = (const int *)((const byte *)surface + surface->ofsBoneReferences);
+	int			i;
+
+	for (i = 0; i < surface->numBoneReferences; i++)
+	{
+		boneCache->MarkUsed(piBoneReferences[i]);
+	}
+}
+
+// with r_ghoul2Threads only the bones of the surfaces that end up drawn are
+// evaluated up front by R_PrepareGhoulSkeletons
+static void G2_MarkDrawnSurfaceBones(const CRenderableSurface *newSurf)
+{
+	if (G2_ViewThreads() > 1)
+	{
+		G2_MarkSurfaceBones(newSurf->boneCache, newSurf->surfaceData);
+	}
+}
+
 void RenderSurfaces(CRenderSurface &RS) //also ended up just ripping right from SP.
 {
 #ifdef G2_PERFORMANCE_ANALYSIS
@@ -2478,6 +2552,7 @@ void RenderSurfaces(CRenderSurface &RS) //also ended up just ripping right from
 				newSurf->surfaceData = surface;
 			}
 			newSurf->boneCache = RS.boneCache;
+			G2_MarkDrawnSurfaceBones(newSurf);
 			R_AddDrawSurf( (surfaceType_t *)newSurf, tr.shadowShader, 0, qfalse );
 		}
 
@@ -2490,6 +2565,7 @@ void RenderSurfaces(CRenderSurface &RS) //also ended up just ripping right from
 			CRenderableSurface *newSurf = new CRenderableSurface;
 			newSurf->surfaceData = surface;
 			newSurf->boneCache = RS.boneCache;
+			G2_MarkDrawnSurfaceBones(newSurf);
 			R_AddDrawSurf( (surfaceType_t *)newSurf, tr.projectionShadowShader, 0, qfalse );
 		}
 
@@ -2499,6 +2575,7 @@ void RenderSurfaces(CRenderSurface &RS) //also ended up just ripping right from
 			CRenderableSurface *newSurf = new CRenderableSurface;
 			newSurf->surfaceData = surface;
 			newSurf->boneCache = RS.boneCache;
+			G2_MarkDrawnSurfaceBones(newSurf);
 			R_AddDrawSurf( (surfaceType_t *)newSurf, (shader_t *)shader, RS.fogNum, qfalse );
 
 #ifdef _G2_GORE
@@ -3207,6 +3284,62 @@ static inline bool bInShadowRange(vec3_t location)
 	return (dist < r_shadowRange->value);
 }
 
+static void G2_PrepareBoneCacheJob(void *data, int index)
+{
+	((CBoneCache **)data)[index]->Prepare();
+}
+
+// evaluates the marked bones of every cache, spread over numThreads threads
+static void G2_PrepareBoneCaches(CBoneCache **caches, int count, int numThreads)
+{
+	ri.Sys_ParallelFor(numThreads, count, G2_PrepareBoneCacheJob, caches);
+}
+
+/*
+==============
+R_PrepareGhoulSkeletons
+
+The bones of the models R_AddGhoulSurfaces sets up are only evaluated when
+something asks for them, mostly RB_SurfaceGhoul skinning in the back end.
+With r_ghoul2Threads the bone caches of a view are queued up instead and the
+bones RenderSurfaces marked for the surfaces it drew are evaluated here once
+the view's entities are in, one cache per job, so the back end only picks the
+matrices up.  Bones the front end already needed (bolts, new origins) are
+left as they are, and bones no drawn surface uses aren't evaluated at all.
+==============
+*/
+#define MAX_G2_VIEW_SKELETONS	1024
+
+static CBoneCache	*g2ViewSkeletons[MAX_G2_VIEW_SKELETONS];
+static int			g2NumViewSkeletons;
+static int			g2ViewPass = 1;
+
+static void G2_QueueViewSkeleton(CBoneCache *boneCache)
+{
+	if (G2_ViewThreads() <= 1 || !boneCache || boneCache->mViewPass == g2ViewPass)
+	{
+		return;
+	}
+	if (g2NumViewSkeletons == MAX_G2_VIEW_SKELETONS)
+	{
+		// the rest are evaluated as they're used
+		return;
+	}
+	boneCache->mViewPass = g2ViewPass;
+	g2ViewSkeletons[g2NumViewSkeletons++] = boneCache;
+}
+
+void R_PrepareGhoulSkeletons(void)
+{
+	// a single skeleton is cheaper to leave to the lazy evaluation
+	if (g2NumViewSkeletons > 1)
+	{
+		G2_PrepareBoneCaches(g2ViewSkeletons, g2NumViewSkeletons, G2_ViewThreads());
+	}
+	g2NumViewSkeletons = 0;
+	g2ViewPass++;
+}
+
 /*
 ==============
 R_AddGHOULSurfaces
@@ -3330,6 +3463,7 @@ void R_AddGhoulSurfaces( trRefEntity_t *ent ) {
 			{
 				G2_TransformGhoulBones(ghoul2[i].mBlist, rootMatrix, ghoul2[i],currentTime);
 			}
+			G2_QueueViewSkeleton(ghoul2[i].mBoneCache);
 			whichLod = G2_ComputeLOD( ent, ghoul2[i].currentModel, ghoul2[i].mLodBias );
 			G2_FindOverrideSurface(-1,ghoul2[i].mSlist); //reset the quick surface override lookup;
 
@@ -3387,6 +3521,166 @@ bool G2_NeedsRecalc(CGhoul2Info *ghlInfo,int frameNum)
 	return false;
 }
 
+/*
+==============
+G2_ConstructSkeletons
+
+Skeletons built ahead of a run of queries that can't change them, for
+example the Ghoul2 traces of a server trace batch.  The skeletons are set up
+here and the bones used by their surfaces at each model's trace LOD and by
+their bolts are evaluated on the job threads, one bone cache per job.  Any
+other bone a query needs is evaluated when it's asked for.  Until
+G2_ReleaseSkeletons, G2_ConstructGhoulSkeleton leaves a held skeleton alone
+when it is asked for the same time and scale again.
+==============
+*/
+#define MAX_G2_HELD_SKELETONS	256
+#define MAX_G2_PREPARED_CACHES	1024
+
+typedef struct g2HeldSkeleton_s {
+	CGhoul2Info_v	*ghoul2;
+	vec3_t			scale;
+} g2HeldSkeleton_t;
+
+static g2HeldSkeleton_t	g2HeldSkeletons[MAX_G2_HELD_SKELETONS];
+static int				g2NumHeldSkeletons;
+static int				g2HeldFrameNum;
+
+static CBoneCache		*g2PreparedCaches[MAX_G2_PREPARED_CACHES];
+
+int G2_DecideTraceLod(CGhoul2Info &ghoul2, int useLod);
+
+// marks the bones of the surfaces of a LOD that aren't switched off, walking
+// the hierarchy the way G2_TransformSurfaces does.  Uses the quick override
+// lookup, so this has to stay on the main thread.
+static void G2_MarkSurfaceTreeBones(CGhoul2Info &ghoul2, int surfaceNum, int lod)
+{
+	int	i;
+	const mdxmSurface_t			*surface = (mdxmSurface_t *)G2_FindSurface((void *)ghoul2.currentModel, surfaceNum, lod);
+	const mdxmHierarchyOffsets_t	*surfIndexes = (mdxmHierarchyOffsets_t *)((byte *)ghoul2.currentModel->mdxm + sizeof(mdxmHeader_t));
+	const mdxmSurfHierarchy_t		*surfInfo = (mdxmSurfHierarchy_t *)((byte *)surfIndexes + surfIndexes->offsets[surface->thisSurfaceIndex]);
+	const surfaceInfo_t			*surfOverride = G2_FindOverrideSurface(surfaceNum, ghoul2.mSlist);
+	int	offFlags = surfInfo->flags;
+
+	if (surfOverride)
+	{
+		offFlags = surfOverride->offFlags;
+	}
+	if (!offFlags)
+	{
+		G2_MarkSurfaceBones(ghoul2.mBoneCache, surface);
+	}
+	if (offFlags & G2SURFACEFLAG_NODESCENDANTS)
+	{
+		return;
+	}
+	for (i = 0; i < surfInfo->numChildren; i++)
+	{
+		G2_MarkSurfaceTreeBones(ghoul2, surfInfo->childIndexes[i], lod);
+	}
+}
+
+// marks the bones a trace at useLod and the bolts of the models will use for
+// the next Prepare.  Bolts on generated surfaces are left to be evaluated
+// when they're asked for.
+static void G2_MarkUsedBones(CGhoul2Info_v &ghoul2, int useLod)
+{
+	int	i, j;
+
+	for (i = 0; i < ghoul2.size(); i++)
+	{
+		CGhoul2Info &g = ghoul2[i];
+
+		if (!g.mValid || !g.mBoneCache)
+		{
+			continue;
+		}
+
+		G2_FindOverrideSurface(-1, g.mSlist); //reset the quick surface override lookup
+		G2_MarkSurfaceTreeBones(g, g.mSurfaceRoot, G2_DecideTraceLod(g, useLod));
+
+		for (j = 0; j < (int)g.mBltlist.size(); j++)
+		{
+			const boltInfo_t &bolt = g.mBltlist[j];
+
+			if (bolt.boneNumber >= 0)
+			{
+				g.mBoneCache->MarkUsed(bolt.boneNumber);
+			}
+			else if (bolt.surfaceNumber >= 0 && bolt.surfaceType != G2SURFACEFLAG_GENERATED)
+			{
+				G2_MarkSurfaceBones(g.mBoneCache, (mdxmSurface_t *)G2_FindSurface((void *)g.currentModel, bolt.surfaceNumber, 0));
+			}
+		}
+	}
+}
+
+// true when the skeleton is held as built for exactly these arguments, any
+// other build of a held skeleton ends its hold
+static bool G2_SkeletonHeld(CGhoul2Info_v &ghoul2, const int frameNum, bool checkForNewOrigin, const vec3_t scale)
+{
+	int i;
+
+	for (i = 0; i < g2NumHeldSkeletons; i++)
+	{
+		if (g2HeldSkeletons[i].ghoul2 == &ghoul2)
+		{
+			if (checkForNewOrigin && scale && frameNum == g2HeldFrameNum && VectorCompare(g2HeldSkeletons[i].scale, scale))
+			{
+				return true;
+			}
+			g2HeldSkeletons[i] = g2HeldSkeletons[--g2NumHeldSkeletons];
+			return false;
+		}
+	}
+	return false;
+}
+
+void G2_ConstructSkeletons(CGhoul2Info_v **ghoul2, float **scales, int *lods, int count, const int frameNum, int numThreads)
+{
+	int		i, j, numCaches;
+
+	G2_ReleaseSkeletons();
+
+	numCaches = 0;
+	for (i = 0; i < count && g2NumHeldSkeletons < MAX_G2_HELD_SKELETONS; i++)
+	{
+		CGhoul2Info_v &g2 = *ghoul2[i];
+
+		if (!g2.IsValid() || !G2_SetupModelPointers(g2) || G2_SkeletonHeld(g2, frameNum, true, scales[i]))
+		{
+			continue;
+		}
+		if (numCaches + g2.size() > MAX_G2_PREPARED_CACHES)
+		{
+			break;
+		}
+
+		G2_ConstructGhoulSkeleton(g2, frameNum, true, scales[i]);
+		G2_MarkUsedBones(g2, lods[i]);
+
+		for (j = 0; j < g2.size(); j++)
+		{
+			if (g2[j].mValid && g2[j].mBoneCache)
+			{
+				g2PreparedCaches[numCaches++] = g2[j].mBoneCache;
+			}
+		}
+
+		g2HeldSkeletons[g2NumHeldSkeletons].ghoul2 = &g2;
+		VectorCopy(scales[i], g2HeldSkeletons[g2NumHeldSkeletons].scale);
+		g2HeldFrameNum = frameNum;
+		g2NumHeldSkeletons++;
+	}
+
+	G2_PrepareBoneCaches(g2PreparedCaches, numCaches, numThreads);
+}
+
+void G2_ReleaseSkeletons(void)
+{
+	g2NumHeldSkeletons = 0;
+}
+
 /*
 ==============
 G2_ConstructGhoulSkeleton - builds a complete skeleton for all ghoul models in a CGhoul2Info_v class	- using LOD 0
@@ -3394,6 +3688,11 @@ G2_ConstructGhoulSkeleton - builds a complete skeleton for all ghoul models in a
 */
 void G2_ConstructGhoulSkeleton( CGhoul2Info_v &ghoul2,const int frameNum,bool checkForNewOrigin,const vec3_t scale)
 {
+	if (g2NumHeldSkeletons && G2_SkeletonHeld(ghoul2,frameNum,checkForNewOrigin,scale))
+	{
+		// G2_ConstructSkeletons built it and nothing can have moved since
+		return;
+	}
 #ifdef G2_PERFORMANCE_ANALYSIS
 	G2PerformanceTimer_G2_ConstructGhoulSkeleton.Start();
 #endif
@@ -3461,6 +3760,54 @@ static inline float G2_GetVertBoneWeightNotSlow( const mdxmVertex_t *pVert, cons
 	return fBoneWeight;
 }
 
+#ifdef MDX_SIMD_SSE
+static const mdxaBone_t &RB_EvalSkinBone( CBoneCache *bones, int index )
+{
+	return bones->EvalRender( index );
+}
+
+// The vertex loop of RB_SurfaceGhoul with each bone applied as one four lane
+// sum.  The palette evaluates the bones in the same order as before, and every
+// formula below is the scalar one with the same operations in the same order.
+static void RB_SkinGhoulVerts_SSE( const mdxmVertex_t *v, const mdxmVertexTexCoord_t *pTexCoords, int numVerts, const int *piBoneReferences, CBoneCache *bones, int baseVertex )
+{
+	mdxSkinPalette_t	palette;
+	int					j;
+
+	palette.loaded = 0;
+	for ( j = 0; j < numVerts; j++, baseVertex++, v++ )
+	{
+		const int iNumWeights = G2_GetVertWeights( v );
+		const mdxSkinBone_t *bone = Mdx_PaletteBone< CBoneCache, RB_EvalSkinBone >( &palette, G2_GetVertBoneIndex( v, 0 ), piBoneReferences, bones );
+		__m128 xyz;
+
+		Mdx_StoreVec3( tess.normal[baseVertex], Mdx_SkinNormal( bone, v->normal ) );
+
+		if ( iNumWeights == 1 )
+		{
+			xyz = Mdx_SkinPoint( bone, v->vertCoords );
+		}
+		else if ( iNumWeights == 2 )
+		{
+			const __m128 fBoneWeight = _mm_set1_ps( G2_GetVertBoneWeightNotSlow( v, 0 ) );
+			const __m128 t1 = Mdx_SkinPoint( bone, v->vertCoords );
+			const __m128 t2 = Mdx_SkinPoint( Mdx_PaletteBone< CBoneCache, RB_EvalSkinBone >( &palette, G2_GetVertBoneIndex( v, 1 ), piBoneReferences, bones ), v->vertCoords );
+
+			xyz = _mm_add_ps( _mm_mul_ps( fBoneWeight, _mm_sub_ps( t1, t2 ) ), t2 );
+		}
+		else
+		{
+			// the scalar loop sets the first term rather than adding it to zero
+			xyz = Mdx_SkinWeightedPoint< CBoneCache, RB_EvalSkinBone >( &palette, v, _mm_set1_ps( -0.0f ), piBoneReferences, bones );
+		}
+		Mdx_StoreVec3( tess.xyz[baseVertex], xyz );
+
+		tess.texCoords[baseVertex][0][0] = pTexCoords[j].texCoords[0];
+		tess.texCoords[baseVertex][0][1] = pTexCoords[j].texCoords[1];
+	}
+}
+#endif
+
 //This is a slightly mangled version of the same function from the sof2sp base.
 //It provides a pretty significant performance increase over the existing one.
 void RB_SurfaceGhoul( CRenderableSurface *surf )
@@ -3469,7 +3816,7 @@ void RB_SurfaceGhoul( CRenderableSurface *surf )
 	G2PerformanceTimer_RB_SurfaceGhoul.Start();
 #endif
 
-	static int				j, k;
+	static int				j;
 	static int				baseIndex, baseVertex;
 	static int				numVerts;
 	static mdxmVertex_t 	*v;
@@ -3681,6 +4028,10 @@ void RB_SurfaceGhoul( CRenderableSurface *surf )
 	else
 	{
 #endif
+#ifdef MDX_SIMD_SSE
+		RB_SkinGhoulVerts_SSE( v, pTexCoords, numVerts, piBoneReferences, bones, baseVertex );
+#else
+		int k;
 		float fTotalWeight;
 		float fBoneWeight;
 		float t1;
@@ -3756,6 +4107,7 @@ void RB_SurfaceGhoul( CRenderableSurface *surf )
 			tess.texCoords[baseVertex][0][0] = pTexCoords[j].texCoords[0];
 			tess.texCoords[baseVertex][0][1] = pTexCoords[j].texCoords[1];
 		}
+#endif
 #if 0
 	}
 #endif
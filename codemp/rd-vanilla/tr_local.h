@@ -1270,6 +1270,7 @@ extern	cvar_t	*r_noPrecacheGLA;
 #endif
 
 extern	cvar_t	*r_noServerGhoul2;
+extern	cvar_t	*r_ghoul2Threads;
 /*
 Ghoul2 Insert End
 */
@@ -1710,6 +1711,7 @@ CRenderableSurface():
 };
 
 void R_AddGhoulSurfaces( trRefEntity_t *ent );
+void R_PrepareGhoulSkeletons( void );
 void RB_SurfaceGhoul( CRenderableSurface *surface );
 /*
 Ghoul2 Insert End
@@ -1303,6 +1303,7 @@ Ghoul2 Insert End
 		}
 	}
 
+	R_PrepareGhoulSkeletons();
 }
 
 
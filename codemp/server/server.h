@@ -39,13 +39,15 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	struct worldGridCell_s *gridCell;		// set instead of worldSector when sv_worldGrid is on
+	struct svEntity_s *prevEntityInGridCell;
+	struct svEntity_s *nextEntityInGridCell;
 
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -60,7 +62,6 @@ typedef struct server_s {
 	int				serverId;			// changes each server start
 	int				restartedServerId;	// serverId before a map_restart
 	int				checksumFeed;		//
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -195,6 +196,8 @@ typedef struct client_s {
 //=============================================================================
 
 
+#define	CLIENT_HASH_SIZE	64		// buckets for looking clients up by address and qport
+
 // this structure will be cleared only when the game dll changes
 typedef struct serverStatic_s {
 	qboolean	initialized;				// sv_init has completed
@@ -214,6 +217,12 @@ typedef struct serverStatic_s {
 	netadr_t	authorizeAddress;			// for rcon return messages
 
 	qboolean	gameStarted;				// gvm is loaded
+
+	// clients by netchan address and qport, see SV_LinkClientAddress.  The
+	// links are client numbers + 1 so a cleared svs has empty buckets
+	int			clientHash[CLIENT_HASH_SIZE];	// first client in each bucket
+	int			clientHashNext[MAX_CLIENTS];	// next client in the same bucket
+	int			clientHashBucket[MAX_CLIENTS];	// bucket + 1 a client is linked into, 0 if none
 } serverStatic_t;
 
 #define SERVER_MAXBANS	1024
@@ -276,6 +285,12 @@ extern	cvar_t	*sv_banFile;
 extern	cvar_t	*sv_maxOOBRate;
 extern	cvar_t	*sv_maxOOBRateIP;
 extern	cvar_t	*sv_autoWhitelist;
+extern	cvar_t	*sv_snapshotThreads;
+extern	cvar_t	*sv_traceThreads;
+extern	cvar_t	*sv_snapshotVerify;
+extern	cvar_t	*sv_snapshotVisCache;
+extern	cvar_t	*sv_snapshotDeltaCache;
+extern	cvar_t	*sv_worldGrid;
 
 extern	serverBan_t serverBans[SERVER_MAXBANS];
 extern	int serverBansCount;
@@ -308,6 +323,8 @@ void SV_RemoveOperatorCommands (void);
 void SV_MasterHeartbeat (void);
 void SV_MasterShutdown (void);
 
+void SV_PacketBench_f( void );
+
 
 
 
@@ -316,6 +333,7 @@ void SV_MasterShutdown (void);
 //
 void SV_SetConfigstring( int index, const char *val );
 void SV_GetConfigstring( int index, char *buffer, int bufferSize );
+void SV_PrecacheBench_f( void );
 void SV_UpdateConfigstrings( client_t *client );
 
 void SV_SetUserinfo( int index, const char *val );
@@ -341,6 +359,11 @@ void SV_GetChallenge( const netadr_t *from );
 
 void SV_DirectConnect( const netadr_t *from );
 
+void SV_LinkClientAddress( client_t *cl );
+void SV_UnlinkClientAddress( client_t *cl );
+void SV_RelinkClientAddresses( void );
+client_t *SV_ClientForAddress( const netadr_t *from, int qport );
+
 void SV_SendClientMapChange( client_t *client );
 void SV_ExecuteClientMessage( client_t *cl, msg_t *msg );
 void SV_UserinfoChanged( client_t *cl );
@@ -372,6 +395,9 @@ void SV_WriteFrameToClient (client_t *client, msg_t *msg);
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
 void SV_SendClientSnapshot( client_t *client );
+void SV_FreeSnapshotJobs( void );
+void SV_FreeDeltaCache( void );
+void SV_SnapshotStats_f( void );
 
 //
 // sv_game.c
@@ -395,6 +421,7 @@ void		SV_BotFreeClient( int clientNum );
 void		SV_BotInitCvars(void);
 int			SV_BotGetSnapshotEntity( int client, int ent );
 int			SV_BotGetConsoleMessage( int client, char *buf, int size );
+void		SV_BotPathBench_f( void );
 
 void *Bot_GetMemoryGame(int size);
 void Bot_FreeMemoryGame(void *ptr);
@@ -426,6 +453,9 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_TraceBench_f( void );
+void SV_G2TraceBench_f( void );
+void SV_G2CrowdBench_f( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -442,6 +472,7 @@ int SV_PointContents( const vec3_t p, int passEntityNum );
 
 
 void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule, int traceFlags, int useLod );
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int count );
 // mins and maxs are relative
 
 // if the entire move stays in a solid volume, trace.allsolid will be set,
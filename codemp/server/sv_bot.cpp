@@ -89,33 +89,216 @@ void SV_BotWaypointReception(int wpnum, wpobject_t **wps)
 	}
 }
 
+/*
+==================
+Waypoint cells
+
+Waypoints only ever link to waypoints closer than MAX_NEIGHBOR_LINK_DISTANCE
+at the same integer height, so they're sorted into square cells that size
+on each height.  Everything a waypoint can link to is then in its own cell
+or one of the eight around it.
+==================
+*/
+typedef struct wpCellEntry_s
+{
+	int z;
+	int x;
+	int y;
+	int index;
+} wpCellEntry_t;
+
+static wpCellEntry_t svWPCells[MAX_WPARRAY_SIZE];
+static int svNumWPCells;
+
+static int SV_WaypointCellCoord(float v)
+{
+	return (int)floorf(v / MAX_NEIGHBOR_LINK_DISTANCE);
+}
+
+static int QDECL SV_CompareWaypointCells(const void *a, const void *b)
+{
+	const wpCellEntry_t *ca = (const wpCellEntry_t *)a;
+	const wpCellEntry_t *cb = (const wpCellEntry_t *)b;
+
+	if (ca->z != cb->z)
+	{
+		return ca->z < cb->z ? -1 : 1;
+	}
+	if (ca->x != cb->x)
+	{
+		return ca->x < cb->x ? -1 : 1;
+	}
+	if (ca->y != cb->y)
+	{
+		return ca->y < cb->y ? -1 : 1;
+	}
+	return ca->index - cb->index;
+}
+
+static int QDECL SV_CompareInts(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+static void SV_BuildWaypointCells(void)
+{
+	int i;
+
+	svNumWPCells = 0;
+
+	for (i = 0; i < gWPNum; i++)
+	{
+		if (gWPArray[i] && gWPArray[i]->inuse)
+		{
+			wpCellEntry_t *cell = &svWPCells[svNumWPCells++];
+
+			cell->z = (int)gWPArray[i]->origin[2];
+			cell->x = SV_WaypointCellCoord(gWPArray[i]->origin[0]);
+			cell->y = SV_WaypointCellCoord(gWPArray[i]->origin[1]);
+			cell->index = i;
+		}
+	}
+
+	qsort(svWPCells, svNumWPCells, sizeof(svWPCells[0]), SV_CompareWaypointCells);
+}
+
+// first entry at or after the start of the given cell
+static int SV_FindWaypointCell(int z, int x, int y)
+{
+	wpCellEntry_t key;
+	int lo = 0, hi = svNumWPCells;
+
+	key.z = z;
+	key.x = x;
+	key.y = y;
+	key.index = -1;
+
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+
+		if (SV_CompareWaypointCells(&svWPCells[mid], &key) < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/*
+==================
+SV_BotLinkWaypoint
+
+Fills in the neighbors of one waypoint.  Candidates from the surrounding
+cells are tested in index order and linking stops at MAX_NEIGHBOR_SIZE, the
+same as walking the whole waypoint array did.  Only reads the cells and the
+collision model and only writes waypoint i, so it's safe on a job thread.
+==================
+*/
+static void SV_BotLinkWaypoint(int i)
+{
+	vec3_t mins = { -15, -15, -15 };
+	vec3_t maxs = { 15, 15, 15 };
+	int candidates[MAX_WPARRAY_SIZE];
+	int numCandidates = 0;
+	wpobject_t *wp = gWPArray[i];
+	vec3_t a;
+	int x, y, c, n;
+
+	const int z = (int)wp->origin[2];
+	const int cx = SV_WaypointCellCoord(wp->origin[0]);
+	const int cy = SV_WaypointCellCoord(wp->origin[1]);
+
+	for (x = cx - 1; x <= cx + 1; x++)
+	{
+		for (y = cy - 1; y <= cy + 1; y++)
+		{
+			for (n = SV_FindWaypointCell(z, x, y); n < svNumWPCells; n++)
+			{
+				const wpCellEntry_t *cell = &svWPCells[n];
+
+				if (cell->z != z || cell->x != x || cell->y != y)
+				{
+					break;
+				}
+
+				c = cell->index;
+				if (c == i || !NotWithinRange(i, c))
+				{
+					continue;
+				}
+
+				VectorSubtract(wp->origin, gWPArray[c]->origin, a);
+				if (VectorLength(a) < MAX_NEIGHBOR_LINK_DISTANCE)
+				{
+					candidates[numCandidates++] = c;
+				}
+			}
+		}
+	}
+
+	qsort(candidates, numCandidates, sizeof(candidates[0]), SV_CompareInts);
+
+	for (n = 0; n < numCandidates && wp->neighbornum < MAX_NEIGHBOR_SIZE; n++)
+	{
+		c = candidates[n];
+
+		if (SV_OrgVisibleBox(wp->origin, mins, maxs, gWPArray[c]->origin, ENTITYNUM_NONE))
+		{
+			wp->neighbors[wp->neighbornum].num = c;
+			wp->neighbors[wp->neighbornum].forceJumpTo = 0;
+			wp->neighbornum++;
+		}
+	}
+}
+
+static void SV_BotLinkWaypointJob(void *data, int index)
+{
+	SV_BotLinkWaypoint(((const int *)data)[index]);
+}
+
+static void SV_BotLinkWaypoints(int numThreads)
+{
+	int waypoints[MAX_WPARRAY_SIZE];
+	int i;
+
+	SV_BuildWaypointCells();
+
+	// the cells hold exactly the waypoints in use
+	for (i = 0; i < svNumWPCells; i++)
+	{
+		waypoints[i] = svWPCells[i].index;
+	}
+
+	if (numThreads > 1)
+	{
+		CM_SetupThreads(numThreads);
+	}
+	Sys_ParallelFor(numThreads, svNumWPCells, SV_BotLinkWaypointJob, waypoints);
+}
+
 /*
 ==================
 SV_BotCalculatePaths
+
+Links every waypoint to the visible waypoints near it.  The line of sight
+traces are spread over sv_traceThreads job threads.
 ==================
 */
 void SV_BotCalculatePaths( int /*rmg*/ )
 {
 	int i;
-	int c;
-	int forceJumpable;
-	int maxNeighborDist = MAX_NEIGHBOR_LINK_DISTANCE;
-	float nLDist;
-	vec3_t a;
-	vec3_t mins, maxs;
 
 	if (!gWPNum)
 	{
 		return;
 	}
 
-	mins[0] = -15;
-	mins[1] = -15;
-	mins[2] = -15; //-1
-	maxs[0] = 15;
-	maxs[1] = 15;
-	maxs[2] = 15; //1
-
 	//now clear out all the neighbor data before we recalculate
 	i = 0;
 
@@ -135,52 +318,190 @@ void SV_BotCalculatePaths( int /*rmg*/ )
 		i++;
 	}
 
-	i = 0;
+	SV_BotLinkWaypoints(sv_traceThreads->integer);
+}
 
-	while (i < gWPNum)
+/*
+==================
+Bot path benchmark
+==================
+*/
+#define BOTPATHBENCH_WAYPOINTS	4000
+#define BOTPATHBENCH_TRAIL		64		// waypoints laid along each trail
+
+// the plain all pairs loop SV_BotCalculatePaths used to run, for reference
+static void SV_BotCalculatePathsAllPairs(void)
+{
+	vec3_t mins = { -15, -15, -15 };
+	vec3_t maxs = { 15, 15, 15 };
+	vec3_t a;
+	int i, c;
+
+	for (i = 0; i < gWPNum; i++)
 	{
-		if (gWPArray[i] && gWPArray[i]->inuse)
+		if (!gWPArray[i] || !gWPArray[i]->inuse)
 		{
-			c = 0;
+			continue;
+		}
 
-			while (c < gWPNum)
+		for (c = 0; c < gWPNum; c++)
+		{
+			if (gWPArray[c] && gWPArray[c]->inuse && i != c && NotWithinRange(i, c))
 			{
-				if (gWPArray[c] && gWPArray[c]->inuse && i != c &&
-					NotWithinRange(i, c))
+				VectorSubtract(gWPArray[i]->origin, gWPArray[c]->origin, a);
+
+				if (VectorLength(a) < MAX_NEIGHBOR_LINK_DISTANCE &&
+					(int)gWPArray[i]->origin[2] == (int)gWPArray[c]->origin[2] &&
+					SV_OrgVisibleBox(gWPArray[i]->origin, mins, maxs, gWPArray[c]->origin, ENTITYNUM_NONE))
+				{
+					gWPArray[i]->neighbors[gWPArray[i]->neighbornum].num = c;
+					gWPArray[i]->neighbors[gWPArray[i]->neighbornum].forceJumpTo = 0;
+					gWPArray[i]->neighbornum++;
+				}
+
+				if (gWPArray[i]->neighbornum >= MAX_NEIGHBOR_SIZE)
 				{
-					VectorSubtract(gWPArray[i]->origin, gWPArray[c]->origin, a);
-
-					nLDist = VectorLength(a);
-					forceJumpable = qfalse;//CanForceJumpTo(i, c, nLDist);
-
-					if ((nLDist < maxNeighborDist || forceJumpable) &&
-						((int)gWPArray[i]->origin[2] == (int)gWPArray[c]->origin[2] || forceJumpable) &&
-						(SV_OrgVisibleBox(gWPArray[i]->origin, mins, maxs, gWPArray[c]->origin, ENTITYNUM_NONE) || forceJumpable))
-					{
-						gWPArray[i]->neighbors[gWPArray[i]->neighbornum].num = c;
-						if (forceJumpable && ((int)gWPArray[i]->origin[2] != (int)gWPArray[c]->origin[2] || nLDist < maxNeighborDist))
-						{
-							gWPArray[i]->neighbors[gWPArray[i]->neighbornum].forceJumpTo = 999;//forceJumpable; //FJSR
-						}
-						else
-						{
-							gWPArray[i]->neighbors[gWPArray[i]->neighbornum].forceJumpTo = 0;
-						}
-						gWPArray[i]->neighbornum++;
-					}
-
-					if (gWPArray[i]->neighbornum >= MAX_NEIGHBOR_SIZE)
-					{
-						break;
-					}
+					break;
 				}
-				c++;
 			}
 		}
-		i++;
 	}
 }
 
+static int SV_BotPathBenchDiffer(const wpobject_t *a, const wpobject_t *b, int count)
+{
+	int differ = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (a[i].neighbornum != b[i].neighbornum ||
+			memcmp(a[i].neighbors, b[i].neighbors, a[i].neighbornum * sizeof(a[i].neighbors[0])))
+		{
+			differ++;
+		}
+	}
+
+	return differ;
+}
+
+static int SV_BotPathBenchRun(wpobject_t *wps, int count, int threads, qboolean allPairs)
+{
+	for (int i = 0; i < count; i++)
+	{
+		wps[i].neighbornum = 0;
+	}
+
+	const int start = Sys_Milliseconds();
+	if (allPairs)
+	{
+		SV_BotCalculatePathsAllPairs();
+	}
+	else
+	{
+		SV_BotLinkWaypoints(threads);
+	}
+	return Sys_Milliseconds() - start;
+}
+
+/*
+==================
+SV_BotPathBench_f
+
+Lays a large made up waypoint set through the current level as trails of
+waypoints, links it with the old all pairs loop and with the waypoint cells
+(serially and on the job threads) and checks the neighbor lists match
+==================
+*/
+void SV_BotPathBench_f(void)
+{
+	wpobject_t *savedWPArray[MAX_WPARRAY_SIZE];
+	const int savedWPNum = gWPNum;
+	vec3_t worldMins, worldMaxs, pos;
+	int count = BOTPATHBENCH_WAYPOINTS;
+	int threads = Sys_CPUCount();
+	int seed = 0x5eed;
+	int i, j;
+
+	if (sv.state != SS_GAME)
+	{
+		Com_Printf("Server is not running.\n");
+		return;
+	}
+
+	if (Cmd_Argc() > 1)
+	{
+		count = Com_Clampi(1, MAX_WPARRAY_SIZE, atoi(Cmd_Argv(1)));
+	}
+	if (Cmd_Argc() > 2)
+	{
+		threads = Com_Clampi(1, MAX_JOB_THREADS, atoi(Cmd_Argv(2)));
+	}
+
+	CM_ModelBounds(CM_InlineModel(0), worldMins, worldMaxs);
+
+	wpobject_t *reference = (wpobject_t *)Z_Malloc(count * sizeof(wpobject_t), TAG_TEMP_WORKSPACE, qtrue);
+	wpobject_t *wps = (wpobject_t *)Z_Malloc(count * sizeof(wpobject_t), TAG_TEMP_WORKSPACE, qtrue);
+
+	// trails wander in steps of 40 to 80 units at one height, like routes
+	// laid down by walking through the level
+	VectorClear(pos);
+	for (i = 0; i < count; i++)
+	{
+		if (!(i % BOTPATHBENCH_TRAIL))
+		{
+			for (j = 0; j < 3; j++)
+			{
+				pos[j] = worldMins[j] + Q_random(&seed) * (worldMaxs[j] - worldMins[j]);
+			}
+		}
+		else
+		{
+			const float angle = Q_random(&seed) * 2.0f * M_PI;
+			const float step = 40.0f + Q_random(&seed) * 40.0f;
+
+			pos[0] = Com_Clamp(worldMins[0], worldMaxs[0], pos[0] + cosf(angle) * step);
+			pos[1] = Com_Clamp(worldMins[1], worldMaxs[1], pos[1] + sinf(angle) * step);
+		}
+
+		VectorCopy(pos, wps[i].origin);
+		wps[i].inuse = 1;
+		wps[i].index = i;
+	}
+
+	memcpy(savedWPArray, gWPArray, sizeof(savedWPArray));
+	for (i = 0; i < count; i++)
+	{
+		gWPArray[i] = &wps[i];
+	}
+	gWPNum = count;
+
+	const int allPairsMsec = SV_BotPathBenchRun(wps, count, 0, qtrue);
+	memcpy(reference, wps, count * sizeof(wpobject_t));
+
+	const int cellMsec = SV_BotPathBenchRun(wps, count, 0, qfalse);
+	const int cellDiffer = SV_BotPathBenchDiffer(reference, wps, count);
+
+	const int threadMsec = SV_BotPathBenchRun(wps, count, threads, qfalse);
+	const int threadDiffer = SV_BotPathBenchDiffer(reference, wps, count);
+
+	int links = 0;
+	for (i = 0; i < count; i++)
+	{
+		links += reference[i].neighbornum;
+	}
+
+	memcpy(gWPArray, savedWPArray, sizeof(savedWPArray));
+	gWPNum = savedWPNum;
+
+	Z_Free(wps);
+	Z_Free(reference);
+
+	Com_Printf("%i waypoints, %i links\n", count, links);
+	Com_Printf("all pairs            %6i msec\n", allPairsMsec);
+	Com_Printf("cells                %6i msec, %i waypoints differ\n", cellMsec, cellDiffer);
+	Com_Printf("cells on %2i threads  %6i msec, %i waypoints differ\n", threads, threadMsec, threadDiffer);
+}
+
 /*
 ==================
 SV_BotAllocateClient
@@ -1966,6 +1966,13 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f, "Prints the userinfo for a given userid" );
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f, "Restart the current map" );
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("tracebench", SV_TraceBench_f, "Measures entity traces per second with the sector tree and the world grid" );
+	Cmd_AddCommand ("g2tracebench", SV_G2TraceBench_f, "Measures Ghoul2 hit traces per second with and without the hit index" );
+	Cmd_AddCommand ("g2crowdbench", SV_G2CrowdBench_f, "Measures Ghoul2 hit traces on a crowd with the skeletons built per trace and up front on the job threads" );
+	Cmd_AddCommand ("snapshotstats", SV_SnapshotStats_f, "Shows snapshot visibility and delta cache statistics" );
+	Cmd_AddCommand ("packetbench", SV_PacketBench_f, "Measures the cost of finding the client a sequenced packet belongs to" );
+	Cmd_AddCommand ("precachebench", SV_PrecacheBench_f, "Measures reading the level's precache list with and without background prefetching" );
+	Cmd_AddCommand ("botpathbench", SV_BotPathBench_f, "Measures linking a large made up waypoint set with and without the waypoint cells" );
 	Cmd_AddCommand ("map", SV_Map_f, "Load a new map with cheats disabled" );
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 	Cmd_AddCommand ("devmap", SV_Map_f, "Load a new map with cheats enabled" );
@@ -2010,6 +2017,13 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("tracebench");
+	Cmd_RemoveCommand ("g2tracebench");
+	Cmd_RemoveCommand ("g2crowdbench");
+	Cmd_RemoveCommand ("snapshotstats");
+	Cmd_RemoveCommand ("packetbench");
+	Cmd_RemoveCommand ("precachebench");
+	Cmd_RemoveCommand ("botpathbench");
 	Cmd_RemoveCommand ("svsay");
 #endif
 }
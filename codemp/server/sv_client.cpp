@@ -121,6 +121,126 @@ static qboolean SV_IsBanned( const netadr_t *from, qboolean isexception )
 	return qfalse;
 }
 
+/*
+==================
+SV_ClientAddressHash
+
+Only the base address and the qport go into the hash, the IP port can
+change under an address translating router (see SV_PacketEvent)
+==================
+*/
+static int SV_ClientAddressHash( const netadr_t *adr, int qport ) {
+	unsigned int	hash;
+
+	hash = (unsigned int)adr->type * 0x9e3779b1U ^ (unsigned int)( qport & 0xffff );
+	if ( adr->type == NA_IP ) {
+		hash ^= ( adr->ip[0] | ( adr->ip[1] << 8 ) | ( adr->ip[2] << 16 ) | ( (unsigned int)adr->ip[3] << 24 ) ) * 0x85ebca6bU;
+	}
+	hash ^= hash >> 16;
+
+	return (int)( hash & ( CLIENT_HASH_SIZE - 1 ) );
+}
+
+/*
+==================
+SV_UnlinkClientAddress
+==================
+*/
+void SV_UnlinkClientAddress( client_t *cl ) {
+	const int	clientNum = cl - svs.clients;
+	int			*link;
+
+	if ( !svs.clientHashBucket[clientNum] ) {
+		return;
+	}
+
+	for ( link = &svs.clientHash[svs.clientHashBucket[clientNum] - 1] ; *link ; link = &svs.clientHashNext[*link - 1] ) {
+		if ( *link == clientNum + 1 ) {
+			*link = svs.clientHashNext[clientNum];
+			break;
+		}
+	}
+
+	svs.clientHashNext[clientNum] = 0;
+	svs.clientHashBucket[clientNum] = 0;
+}
+
+/*
+==================
+SV_LinkClientAddress
+
+Files a client under its current netchan address and qport so
+SV_ClientForAddress can find it, call whenever either of them changes
+==================
+*/
+void SV_LinkClientAddress( client_t *cl ) {
+	const int	clientNum = cl - svs.clients;
+	const int	bucket = SV_ClientAddressHash( &cl->netchan.remoteAddress, cl->netchan.qport );
+
+	SV_UnlinkClientAddress( cl );
+
+	if ( cl->netchan.remoteAddress.type == NA_BOT ) {
+		return;		// bots never send packets
+	}
+
+	svs.clientHashNext[clientNum] = svs.clientHash[bucket];
+	svs.clientHash[bucket] = clientNum + 1;
+	svs.clientHashBucket[clientNum] = bucket + 1;
+}
+
+/*
+==================
+SV_RelinkClientAddresses
+
+Rebuilds the address hash from scratch after svs.clients was reallocated
+==================
+*/
+void SV_RelinkClientAddresses( void ) {
+	int			i;
+	client_t	*cl;
+
+	Com_Memset( svs.clientHash, 0, sizeof( svs.clientHash ) );
+	Com_Memset( svs.clientHashNext, 0, sizeof( svs.clientHashNext ) );
+	Com_Memset( svs.clientHashBucket, 0, sizeof( svs.clientHashBucket ) );
+
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state != CS_FREE ) {
+			SV_LinkClientAddress( cl );
+		}
+	}
+}
+
+/*
+==================
+SV_ClientForAddress
+
+Returns the client that sequenced packets from this address and qport
+belong to, or NULL
+==================
+*/
+client_t *SV_ClientForAddress( const netadr_t *from, int qport ) {
+	int			link;
+	client_t	*cl;
+
+	for ( link = svs.clientHash[SV_ClientAddressHash( from, qport )] ; link ; link = svs.clientHashNext[link - 1] ) {
+		if ( link > sv_maxclients->integer ) {
+			continue;
+		}
+		cl = &svs.clients[link - 1];
+		if ( cl->state == CS_FREE ) {
+			continue;
+		}
+		// it is possible to have multiple clients from a single IP
+		// address, so they are differentiated by the qport variable
+		if ( cl->netchan.qport != qport || !NET_CompareBaseAdr( from, &cl->netchan.remoteAddress ) ) {
+			continue;
+		}
+		return cl;
+	}
+
+	return NULL;
+}
+
 /*
 ==================
 SV_DirectConnect
@@ -311,6 +431,7 @@ gotnewcl:
 
 	// save the address
 	Netchan_Setup (NS_SERVER, &newcl->netchan , from, qport);
+	SV_LinkClientAddress( newcl );
 
 	// save the userinfo
 	Q_strncpyz( newcl->userinfo, userinfo, sizeof(newcl->userinfo) );
@@ -320,6 +441,7 @@ gotnewcl:
 	if ( denied ) {
 		NET_OutOfBandPrint( NS_SERVER, from, "print\n%s\n", denied );
 		Com_DPrintf ("Game rejected a connection: %s.\n", denied);
+		SV_UnlinkClientAddress( newcl );
 		return;
 	}
 
@@ -397,7 +519,9 @@ void SV_DropClient( client_t *drop, const char *reason ) {
 	if ( isBot ) {
 		// bots shouldn't go zombie, as there's no real net connection.
 		drop->state = CS_FREE;
+		SV_UnlinkClientAddress( drop );
 	} else {
+		// zombies stay linked, they still need SV_Netchan_Process
 		Com_DPrintf( "Going to CS_ZOMBIE for %s\n", drop->name );
 		drop->state = CS_ZOMBIE;		// become free in a few seconds
 	}
@@ -3119,8 +3119,15 @@ void SV_BindGame( void ) {
 		gi.G2API_OverrideServer					= SV_G2API_OverrideServer;
 		gi.G2API_GetSurfaceName					= SV_G2API_GetSurfaceName;
 
+		gi.TraceBatch							= SV_TraceBatch;
+
 		GetGameAPI = (GetGameAPI_t)gvm->GetModuleAPI;
 		ret = GetGameAPI( GAME_API_VERSION, &gi );
+		if ( !ret ) {
+			// modules from before TraceBatch only take version 1, the table
+			// they know is laid out the same
+			ret = GetGameAPI( 1, &gi );
+		}
 		if ( !ret ) {
 			//free VM?
 			svs.gameStarted = qfalse;
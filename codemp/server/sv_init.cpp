@@ -361,6 +361,9 @@ void SV_ChangeMaxClients( void ) {
 	// free the old clients on the hunk
 	Hunk_FreeTempMemory( oldClients );
 
+	// slots past the new sv_maxclients are gone
+	SV_RelinkClientAddresses();
+
 	// allocate new snapshot entities
 	if ( com_dedicated->integer ) {
 		svs.numSnapshotEntities = sv_maxclients->integer * PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
@@ -540,6 +543,9 @@ Ghoul2 Insert Start
 	// clear pak references
 	FS_ClearPakReferences(0);
 
+	// look for loose files added since the last map again
+	FS_FlushDirMisses();
+
 /*
 Ghoul2 Insert Start
 */
@@ -909,6 +915,9 @@ static void SV_InitRef( void ) {
 	ri.GetG2VertSpaceServer = GetG2VertSpaceServer;
 	G2VertSpaceServer = &IHeapAllocator_singleton;
 
+	ri.Sys_ParallelFor = Sys_ParallelFor;
+	ri.Sys_CPUCount = Sys_CPUCount;
+
 	ret = GetRefAPI( REF_API_VERSION, &ri );
 
 //	Com_Printf( "-------------------------------\n");
@@ -1014,6 +1023,15 @@ void SV_Init (void) {
 	sv_maxOOBRateIP = Cvar_Get("sv_maxOOBRateIP", "1", CVAR_ARCHIVE, "Maximum rate of handling incoming server commands per IP address" );
 	sv_autoWhitelist = Cvar_Get("sv_autoWhitelist", "1", CVAR_ARCHIVE, "Save player IPs to allow them using server during DOS attack" );
 
+	sv_snapshotThreads = Cvar_Get( "sv_snapshotThreads", "0", CVAR_ARCHIVE_ND, "Number of threads used to build client snapshots, 0 builds them serially" );
+	Cvar_CheckRange( sv_snapshotThreads, 0, MAX_JOB_THREADS, qtrue );
+	sv_traceThreads = Cvar_Get( "sv_traceThreads", "0", CVAR_ARCHIVE_ND, "Number of threads used for large trace batches from the game, 0 runs them serially" );
+	Cvar_CheckRange( sv_traceThreads, 0, MAX_JOB_THREADS, qtrue );
+	sv_snapshotVerify = Cvar_Get( "sv_snapshotVerify", "0", 0, "Compare threaded client snapshots against a serial encode" );
+	sv_snapshotVisCache = Cvar_Get( "sv_snapshotVisCache", "1", CVAR_ARCHIVE_ND, "Share PVS entity visibility between clients in the same cluster and area" );
+	sv_snapshotDeltaCache = Cvar_Get( "sv_snapshotDeltaCache", "1", CVAR_ARCHIVE_ND, "Encode each entity delta once per frame and share it between clients" );
+	sv_worldGrid = Cvar_Get( "sv_worldGrid", "1", CVAR_ARCHIVE_ND, "Link entities into a loose grid instead of the world sector tree, takes effect on the next map" );
+
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
 
@@ -1083,6 +1101,9 @@ void SV_Shutdown( char *finalmsg )
 
 //	Com_Printf( "----- Server Shutdown -----\n" );
 
+	// a fatal error doesn't unwind, so a send batch it hit may still be open
+	NET_FlushSendBatch();
+
 	if ( svs.clients && !com_errorEntered ) {
 		SV_FinalMessage( finalmsg );
 	}
@@ -1106,6 +1127,9 @@ Ghoul2 Insert Start
 	SV_ClearServer();
 	CM_ClearMap();//jfm: add a clear here since it's commented out in clearServer.  This prevents crashing cmShaderTable on exit.
 
+	SV_FreeSnapshotJobs();
+	SV_FreeDeltaCache();
+
 	// free server static data
 	if ( svs.clients ) {
 		Z_Free( svs.clients );
@@ -1121,3 +1145,167 @@ Ghoul2 Insert Start
 	if( sv_killserver->integer != 2 )
 		CL_Disconnect( qfalse );
 }
+
+/*
+==============================================================================
+
+PRECACHE BENCHMARK
+
+==============================================================================
+*/
+
+#define	PRECACHEBENCH_MAX_FILES		4096
+
+typedef char precacheName_t[MAX_QPATH];
+
+/*
+===============
+SV_PrecacheBenchList
+
+What a client loading the current level reads first: the map, the models and
+both kinds of sound file for every sound
+===============
+*/
+static int SV_PrecacheBenchList( precacheName_t *names ) {
+	const char	*s;
+	char		sound[MAX_QPATH];
+	int			i, count;
+
+	count = 0;
+	Com_sprintf( names[count++], sizeof( precacheName_t ), "maps/%s.bsp", sv_mapname->string );
+	for ( i = 1 ; i < MAX_MODELS ; i++ ) {
+		s = sv.configstrings[CS_MODELS + i];
+		// inline brush models are in the map
+		if ( s && s[0] && s[0] != '*' ) {
+			Q_strncpyz( names[count++], s, sizeof( precacheName_t ) );
+		}
+	}
+	for ( i = 1 ; i < MAX_SOUNDS ; i++ ) {
+		s = sv.configstrings[CS_SOUNDS + i];
+		// '*' sounds depend on the player model
+		if ( s && s[0] && s[0] != '*' ) {
+			COM_StripExtension( s, sound, sizeof( sound ) );
+			Com_sprintf( names[count++], sizeof( precacheName_t ), "%s.wav", sound );
+			Com_sprintf( names[count++], sizeof( precacheName_t ), "%s.mp3", sound );
+		}
+	}
+
+	return count;
+}
+
+/*
+===============
+SV_PrecacheBenchPass
+
+Reads every file once, returns the number found
+===============
+*/
+static int SV_PrecacheBenchPass( precacheName_t *names, int count, int *checksums, int *bytes ) {
+	void	*buffer;
+	long	len;
+	int		i, found;
+
+	found = 0;
+	*bytes = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		len = FS_ReadFile( names[i], &buffer );
+		if ( len < 0 ) {
+			checksums[i] = 0;
+			continue;
+		}
+		checksums[i] = Com_BlockChecksum( buffer, len );
+		*bytes += len;
+		found++;
+		FS_FreeFile( buffer );
+	}
+
+	return found;
+}
+
+/*
+===============
+SV_PrecacheBench_f
+
+Reads the precache list of the current level, or the files listed in the
+given text file, once the way a level load does and once with the list handed
+to FS_PrefetchFiles first.  An untimed pass before them puts both on an equal
+footing with the OS file cache
+===============
+*/
+void SV_PrecacheBench_f( void ) {
+	precacheName_t	*names;
+	const char		*list, *token;
+	const char		**qpaths;
+	void			*text;
+	int				*checksums, *prefetchedChecksums;
+	int				count, found, bytes, differ, i, start, readMsec, prefetchMsec;
+
+	names = (precacheName_t *)Z_Malloc( sizeof( precacheName_t ) * PRECACHEBENCH_MAX_FILES, TAG_TEMP_WORKSPACE, qtrue );
+
+	count = 0;
+	if ( Cmd_Argc() > 1 ) {
+		if ( FS_ReadFile( Cmd_Argv( 1 ), &text ) < 0 ) {
+			Com_Printf( "Couldn't read %s.\n", Cmd_Argv( 1 ) );
+			Z_Free( names );
+			return;
+		}
+		list = (const char *)text;
+		while ( count < PRECACHEBENCH_MAX_FILES ) {
+			token = COM_ParseExt( &list, qtrue );
+			if ( !token[0] ) {
+				break;
+			}
+			Q_strncpyz( names[count++], token, sizeof( precacheName_t ) );
+		}
+		FS_FreeFile( text );
+	} else if ( sv.state == SS_GAME ) {
+		count = SV_PrecacheBenchList( names );
+	} else {
+		Com_Printf( "usage: precachebench [list file], without one a level has to be running\n" );
+		Z_Free( names );
+		return;
+	}
+
+	if ( !count ) {
+		Com_Printf( "Nothing to read.\n" );
+		Z_Free( names );
+		return;
+	}
+
+	checksums = (int *)Z_Malloc( sizeof( int ) * count * 2, TAG_TEMP_WORKSPACE, qtrue );
+	prefetchedChecksums = checksums + count;
+	qpaths = (const char **)Z_Malloc( sizeof( *qpaths ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	for ( i = 0 ; i < count ; i++ ) {
+		qpaths[i] = names[i];
+	}
+
+	found = SV_PrecacheBenchPass( names, count, checksums, &bytes );
+
+	start = Sys_Milliseconds();
+	SV_PrecacheBenchPass( names, count, checksums, &bytes );
+	readMsec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	FS_PrefetchFiles( qpaths, count );
+	SV_PrecacheBenchPass( names, count, prefetchedChecksums, &bytes );
+	prefetchMsec = Sys_Milliseconds() - start;
+	FS_CancelPrefetch();
+
+	differ = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( checksums[i] != prefetchedChecksums[i] ) {
+			differ++;
+		}
+	}
+
+	Com_Printf( "%i of %i files found, %i KB\n", found, count, bytes >> 10 );
+	Com_Printf( "read       %6i msec\n", readMsec );
+	Com_Printf( "prefetched %6i msec\n", prefetchMsec );
+	if ( differ ) {
+		Com_Printf( S_COLOR_RED "%i files read differently with prefetching\n", differ );
+	}
+
+	Z_Free( qpaths );
+	Z_Free( checksums );
+	Z_Free( names );
+}
@@ -72,6 +72,12 @@ cvar_t	*sv_banFile;
 cvar_t	*sv_maxOOBRate;
 cvar_t	*sv_maxOOBRateIP;
 cvar_t	*sv_autoWhitelist;
+cvar_t	*sv_snapshotThreads;	// build and encode client snapshots on the job threads
+cvar_t	*sv_traceThreads;		// run large game trace batches on the job threads
+cvar_t	*sv_snapshotVerify;		// compare parallel snapshots against a serial encode
+cvar_t	*sv_snapshotVisCache;	// share PVS visibility between clients in the same cluster
+cvar_t	*sv_snapshotDeltaCache;	// encode each entity delta once per frame
+cvar_t	*sv_worldGrid;			// link entities into the loose grid instead of the sector tree
 
 serverBan_t serverBans[SERVER_MAXBANS];
 int serverBansCount = 0;
@@ -784,7 +790,6 @@ SV_ReadPackets
 =================
 */
 void SV_PacketEvent( const netadr_t *from, msg_t *msg ) {
-	int			i;
 	client_t	*cl;
 	int			qport;
 
@@ -801,25 +806,15 @@ void SV_PacketEvent( const netadr_t *from, msg_t *msg ) {
 	qport = MSG_ReadShort( msg ) & 0xffff;
 
 	// find which client the message is from
-	for (i=0, cl=svs.clients ; i < sv_maxclients->integer ; i++,cl++) {
-		if (cl->state == CS_FREE) {
-			continue;
-		}
-		if ( !NET_CompareBaseAdr( from, &cl->netchan.remoteAddress ) ) {
-			continue;
-		}
-		// it is possible to have multiple clients from a single IP
-		// address, so they are differentiated by the qport variable
-		if (cl->netchan.qport != qport) {
-			continue;
-		}
-
+	cl = SV_ClientForAddress( from, qport );
+	if ( cl ) {
 		// the IP port can't be used to differentiate them, because
 		// some address translating routers periodically change UDP
 		// port assignments
 		if (cl->netchan.remoteAddress.port != from->port) {
 			Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
 			cl->netchan.remoteAddress.port = from->port;
+			// the port isn't part of the address hash, the client stays linked
 		}
 
 		// make sure it is a valid, in sequence packet
@@ -840,6 +835,155 @@ void SV_PacketEvent( const netadr_t *from, msg_t *msg ) {
 	NET_OutOfBandPrint( NS_SERVER, from, "disconnect" );
 }
 
+/*
+============================================================================
+
+PACKET DISPATCH BENCHMARK
+
+============================================================================
+*/
+
+#define	PACKETBENCH_PACKETS		1000000
+
+typedef struct packetBench_s {
+	netadr_t	from;
+	int			qport;
+} packetBench_t;
+
+/*
+===============
+SV_ScanClientsForAddress
+
+The linear search SV_PacketEvent used before the address hash, kept for the
+benchmark to compare against
+===============
+*/
+static client_t *SV_ScanClientsForAddress( const netadr_t *from, int qport ) {
+	int			i;
+	client_t	*cl;
+
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state == CS_FREE ) {
+			continue;
+		}
+		if ( !NET_CompareBaseAdr( from, &cl->netchan.remoteAddress ) ) {
+			continue;
+		}
+		if ( cl->netchan.qport != qport ) {
+			continue;
+		}
+		return cl;
+	}
+
+	return NULL;
+}
+
+/*
+===============
+SV_PacketBench_f
+
+Fills a scratch client array with sv_maxclients fake connections, some of
+them sharing an address behind a router, and floods both client lookups
+with sequenced packets from them and from unknown senders.  The real
+clients and their hash links are put back afterwards
+===============
+*/
+void SV_PacketBench_f( void ) {
+	client_t		*realClients, *fakeClients, *cl;
+	packetBench_t	*packets, *p;
+	int				realHash[CLIENT_HASH_SIZE], realHashNext[MAX_CLIENTS], realHashBucket[MAX_CLIENTS];
+	int				count, seed, i, j, start, scanMsec, hashMsec, found, differ;
+	uintptr_t		check;
+
+	if ( !svs.clients || sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	count = PACKETBENCH_PACKETS;
+	if ( Cmd_Argc() > 1 ) {
+		count = Com_Clampi( 1, 100000000, atoi( Cmd_Argv( 1 ) ) );
+	}
+
+	realClients = svs.clients;
+	Com_Memcpy( realHash, svs.clientHash, sizeof( realHash ) );
+	Com_Memcpy( realHashNext, svs.clientHashNext, sizeof( realHashNext ) );
+	Com_Memcpy( realHashBucket, svs.clientHashBucket, sizeof( realHashBucket ) );
+
+	fakeClients = (client_t *)Z_Malloc( sizeof( client_t ) * sv_maxclients->integer, TAG_TEMP_WORKSPACE, qtrue );
+	svs.clients = fakeClients;
+	Com_Memset( svs.clientHash, 0, sizeof( svs.clientHash ) );
+	Com_Memset( svs.clientHashNext, 0, sizeof( svs.clientHashNext ) );
+	Com_Memset( svs.clientHashBucket, 0, sizeof( svs.clientHashBucket ) );
+
+	// same connections and packets every run so the numbers can be compared between builds
+	seed = 0x5eed;
+	for ( i = 0, cl = fakeClients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		cl->state = CS_ACTIVE;
+		cl->netchan.remoteAddress.type = NA_IP;
+		if ( i & 3 ) {
+			for ( j = 0 ; j < 4 ; j++ ) {
+				cl->netchan.remoteAddress.ip[j] = (byte)Q_rand( &seed );
+			}
+		} else {
+			// every fourth client shares the address of the one before it
+			cl->netchan.remoteAddress = fakeClients[Q_max( i - 1, 0 )].netchan.remoteAddress;
+		}
+		cl->netchan.remoteAddress.port = (unsigned short)Q_rand( &seed );
+		cl->netchan.qport = Q_rand( &seed ) & 0xffff;
+		SV_LinkClientAddress( cl );
+	}
+
+	// three out of four packets come from a connected client
+	packets = (packetBench_t *)Z_Malloc( sizeof( packetBench_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	for ( i = 0, p = packets ; i < count ; i++, p++ ) {
+		cl = &fakeClients[( Q_rand( &seed ) & 0x7fffffff ) % sv_maxclients->integer];
+		p->from = cl->netchan.remoteAddress;
+		p->qport = cl->netchan.qport;
+		if ( !( i & 3 ) ) {
+			p->from.ip[3] ^= 0x80;
+		}
+	}
+
+	found = 0;
+	check = 0;
+	start = Sys_Milliseconds();
+	for ( i = 0, p = packets ; i < count ; i++, p++ ) {
+		cl = SV_ScanClientsForAddress( &p->from, p->qport );
+		check += (uintptr_t)cl;
+		found += cl ? 1 : 0;
+	}
+	scanMsec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( i = 0, p = packets ; i < count ; i++, p++ ) {
+		check -= (uintptr_t)SV_ClientForAddress( &p->from, p->qport );
+	}
+	hashMsec = Sys_Milliseconds() - start;
+
+	differ = 0;
+	for ( i = 0, p = packets ; i < count ; i++, p++ ) {
+		if ( SV_ScanClientsForAddress( &p->from, p->qport ) != SV_ClientForAddress( &p->from, p->qport ) ) {
+			differ++;
+		}
+	}
+
+	Com_Printf( "%i packets for %i clients, %i from connected clients\n", count, sv_maxclients->integer, found );
+	Com_Printf( "linear scan  %6i msec (%7.1f nsec/packet)\n", scanMsec, 1000000.0f * scanMsec / count );
+	Com_Printf( "address hash %6i msec (%7.1f nsec/packet)\n", hashMsec, 1000000.0f * hashMsec / count );
+	if ( differ || check ) {
+		Com_Printf( S_COLOR_RED "%i packets found a different client\n", differ );
+	}
+
+	Z_Free( packets );
+	Z_Free( fakeClients );
+
+	svs.clients = realClients;
+	Com_Memcpy( svs.clientHash, realHash, sizeof( realHash ) );
+	Com_Memcpy( svs.clientHashNext, realHashNext, sizeof( realHashNext ) );
+	Com_Memcpy( svs.clientHashBucket, realHashBucket, sizeof( realHashBucket ) );
+}
+
 
 /*
 ===================
@@ -927,6 +1071,7 @@ void SV_CheckTimeouts( void ) {
 		&& cl->lastPacketTime < zombiepoint) {
 			Com_DPrintf( "Going from CS_ZOMBIE to CS_FREE for %s\n", cl->name );
 			cl->state = CS_FREE;	// can now be reused
+			SV_UnlinkClientAddress( cl );
 			continue;
 		}
 		if ( cl->state >= CS_CONNECTED && cl->lastPacketTime < droppoint) {
@@ -935,6 +1080,7 @@ void SV_CheckTimeouts( void ) {
 			if ( ++cl->timeoutCount > 5 ) {
 				SV_DropClient (cl, "timed out");
 				cl->state = CS_FREE;	// don't bother with zombie state
+				SV_UnlinkClientAddress( cl );
 			}
 		} else {
 			cl->timeoutCount = 0;
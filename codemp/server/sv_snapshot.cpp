@@ -24,6 +24,8 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include "server.h"
 #include "qcommon/cm_public.h"
 
+#include <atomic>
+
 /*
 =============================================================================
 
@@ -46,6 +48,208 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Delta encoding cache
+
+An entity that changed between the same two states is encoded the same way
+for every client that sees it, so while SV_SendClientMessages runs each
+(from, to) delta is encoded once and the bits are spliced into the other
+messages with MSG_WriteBitString.  Job threads share the cache, entries are
+never changed after they have been published on their entity's list.
+Statistics are kept per thread and summed up by snapshotstats.
+
+=============================================================================
+*/
+
+#define MAX_DELTA_CACHE_ENTRIES		2048
+#define MAX_DELTA_CACHE_BYTES		(256*1024)
+#define MAX_DELTA_BYTES				2048		// scratch for encoding one delta
+
+typedef struct deltaCacheEntry_s {
+	struct deltaCacheEntry_s	*next;
+	entityState_t				from;
+	entityState_t				to;
+	qboolean					force;
+	int							numBits;
+	const byte					*bits;
+} deltaCacheEntry_t;
+
+typedef struct deltaCacheStats_s {
+	int			lookups;
+	int			encodes;
+	int			hits;
+	int			full;		// deltas that didn't fit in the cache
+	byte		pad[64 - 4 * sizeof( int )];	// keep the threads off each other's cache lines
+} deltaCacheStats_t;
+
+typedef struct deltaCache_s {
+	qboolean							active;
+	deltaCacheEntry_t					*entries;
+	byte								*bits;
+	std::atomic<int>					numEntries;
+	std::atomic<int>					numBytes;
+	std::atomic<deltaCacheEntry_t *>	heads[MAX_GENTITIES];
+	deltaCacheStats_t					stats[MAX_JOB_THREADS];
+} deltaCache_t;
+
+static deltaCache_t		svDeltaCache;
+
+/*
+===============
+SV_BeginDeltaCache
+===============
+*/
+static void SV_BeginDeltaCache( void ) {
+	int		i;
+
+	svDeltaCache.active = (sv_snapshotDeltaCache->integer && sv.state) ? qtrue : qfalse;
+	if ( !svDeltaCache.active ) {
+		return;
+	}
+
+	if ( !svDeltaCache.entries ) {
+		svDeltaCache.entries = (deltaCacheEntry_t *)Z_Malloc( sizeof( deltaCacheEntry_t ) * MAX_DELTA_CACHE_ENTRIES, TAG_CLIENTS, qfalse );
+		svDeltaCache.bits = (byte *)Z_Malloc( MAX_DELTA_CACHE_BYTES, TAG_CLIENTS, qfalse );
+	}
+
+	svDeltaCache.numEntries = 0;
+	svDeltaCache.numBytes = 0;
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		svDeltaCache.heads[i].store( NULL, std::memory_order_relaxed );
+	}
+}
+
+/*
+===============
+SV_EndDeltaCache
+===============
+*/
+static void SV_EndDeltaCache( void ) {
+	svDeltaCache.active = qfalse;
+}
+
+/*
+===============
+SV_FreeDeltaCache
+===============
+*/
+void SV_FreeDeltaCache( void ) {
+	svDeltaCache.active = qfalse;
+	if ( svDeltaCache.entries ) {
+		Z_Free( svDeltaCache.entries );
+		Z_Free( svDeltaCache.bits );
+		svDeltaCache.entries = NULL;
+		svDeltaCache.bits = NULL;
+	}
+}
+
+/*
+===============
+SV_FindDeltaCacheEntry
+===============
+*/
+static const deltaCacheEntry_t *SV_FindDeltaCacheEntry( const entityState_t *from, const entityState_t *to, qboolean force ) {
+	const deltaCacheEntry_t	*entry;
+
+	entry = svDeltaCache.heads[to->number].load( std::memory_order_acquire );
+	for ( ; entry ; entry = entry->next ) {
+		if ( entry->force == force
+			&& !memcmp( &entry->from, from, sizeof( *from ) )
+			&& !memcmp( &entry->to, to, sizeof( *to ) ) ) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*
+===============
+SV_AddDeltaCacheEntry
+
+Returns NULL if the cache is full for this frame.  Two threads may race to
+add the same delta, the loser's entry is just never found.
+===============
+*/
+static const deltaCacheEntry_t *SV_AddDeltaCacheEntry( const entityState_t *from, const entityState_t *to,
+													qboolean force, const byte *bits, int numBits ) {
+	deltaCacheEntry_t	*entry;
+	int					index, offset, numBytes;
+
+	index = svDeltaCache.numEntries.fetch_add( 1, std::memory_order_relaxed );
+	if ( index >= MAX_DELTA_CACHE_ENTRIES ) {
+		return NULL;
+	}
+	numBytes = (numBits + 7) >> 3;
+	offset = svDeltaCache.numBytes.fetch_add( numBytes, std::memory_order_relaxed );
+	if ( offset + numBytes > MAX_DELTA_CACHE_BYTES ) {
+		return NULL;
+	}
+
+	entry = &svDeltaCache.entries[index];
+	entry->from = *from;
+	entry->to = *to;
+	entry->force = force;
+	entry->numBits = numBits;
+	entry->bits = svDeltaCache.bits + offset;
+	Com_Memcpy( svDeltaCache.bits + offset, bits, numBytes );
+
+	std::atomic<deltaCacheEntry_t *> &head = svDeltaCache.heads[to->number];
+	entry->next = head.load( std::memory_order_relaxed );
+	while ( !head.compare_exchange_weak( entry->next, entry, std::memory_order_release, std::memory_order_relaxed ) ) {
+	}
+
+	return entry;
+}
+
+/*
+===============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the delta cache.
+===============
+*/
+static void SV_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, qboolean force ) {
+	const deltaCacheEntry_t	*entry;
+	deltaCacheStats_t		*stats;
+	msg_t					delta;
+	byte					deltaBuf[MAX_DELTA_BYTES];
+
+	// removes are just a few bits, nothing to gain
+	if ( !svDeltaCache.active || !to || msg->overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	stats = &svDeltaCache.stats[Sys_JobThreadIndex()];
+	stats->lookups++;
+
+	entry = SV_FindDeltaCacheEntry( from, to, force );
+	if ( entry ) {
+		stats->hits++;
+		if ( MSG_WriteBitString( msg, entry->bits, entry->numBits ) ) {
+			return;
+		}
+	} else {
+		MSG_Init( &delta, deltaBuf, sizeof( deltaBuf ) );
+		MSG_WriteDeltaEntity( &delta, from, to, force );
+		stats->encodes++;
+
+		if ( !delta.overflowed ) {
+			if ( !SV_AddDeltaCacheEntry( from, to, force, delta.data, delta.bit ) ) {
+				stats->full++;
+			}
+			if ( MSG_WriteBitString( msg, delta.data, delta.bit ) ) {
+				return;
+			}
+		}
+	}
+
+	// close to the end of the message, let it overflow the usual way
+	MSG_WriteDeltaEntity( msg, from, to, force );
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -89,7 +293,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteDeltaEntity( msg, oldent, newent, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -97,14 +301,14 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteDeltaEntity( msg, &sv.svEntities[newnum].baseline, newent, qtrue );
 			newindex++;
 			continue;
 		}
 
 		if ( newnum > oldnum ) {
 			// the old entity isn't present in the new message
-			MSG_WriteDeltaEntity (msg, oldent, NULL, qtrue );
+			SV_WriteDeltaEntity( msg, oldent, NULL, qtrue );
 			oldindex++;
 			continue;
 		}
@@ -117,19 +321,18 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SelectDeltaFrame
+
+Picks the previous frame the snapshot for the client's current outgoing
+sequence will be delta compressed against, NULL for a full snapshot.
+Must be called right after the current frame's entities were allocated,
+the ring check depends on svs.nextSnapshotEntities.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
-	int					lastframe;
-	int					i;
-	int					snapFlags;
+static clientSnapshot_t *SV_SelectDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t	*oldframe;
 	int					deltaMessage;
 
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
-
 	// bots never acknowledge, but it doesn't matter since the only use case is for serverside demos
 	// in which case we can delta against the very last message every time
 	deltaMessage = client->deltaMessage;
@@ -141,33 +344,33 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 	if ( deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->netchan.outgoingSequence - deltaMessage
 		>= (PACKET_BACKUP - 3) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf ("%s: Delta request from out of date packet.\n", client->name);
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->demo.demorecording && client->demo.demowaiting ) {
 		// demo is waiting for a non-delta-compressed frame for this client, so don't delta compress
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->demo.minDeltaFrame > deltaMessage ) {
 		// we saved a non-delta frame to the demo and sent it to the client, but the client didn't ack it
 		// we can't delta against an old frame that's not in the demo without breaking the demo.  so send
 		// non-delta frames until the client acks.
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else {
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[ deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
 		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
 			Com_DPrintf ("%s: Delta request from out of date entities.\n", client->name);
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
@@ -179,6 +382,24 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 		client->demo.demowaiting = qfalse;
 	}
 
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+
+Only reads shared server state, so this may run on a job thread.
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -309,6 +530,7 @@ Build a client snapshot structure
 typedef struct snapshotEntityNumbers_s {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+	byte	added[MAX_GENTITIES/8];	// prevents double adding from portal views
 } snapshotEntityNumbers_t;
 
 /*
@@ -339,12 +561,14 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		e = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[e >> 3] |= 1 << (e & 7);
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -355,6 +579,236 @@ static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapsh
 	eNums->numSnapshotEntities++;
 }
 
+/*
+===============
+SV_EntityInClusterPVS
+
+Area and cluster checks for an entity seen from a point in clientarea,
+these only depend on where the viewer is and not on who it is.
+===============
+*/
+static qboolean SV_EntityInClusterPVS( svEntity_t *svEnt, int clientarea, const byte *clientpvs ) {
+	int		i, l;
+
+	// ignore if not touching a PV leaf
+	// check area
+	if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+		// doors can legally straddle two areas, so
+		// we may need to check another one
+		if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+			return qfalse;		// blocked by a door
+		}
+	}
+
+	// check individual leafs
+	if ( !svEnt->numClusters ) {
+		return qfalse;
+	}
+	l = 0;
+	for ( i=0 ; i < svEnt->numClusters ; i++ ) {
+		l = svEnt->clusternums[i];
+		if ( clientpvs[l >> 3] & (1 << (l&7) ) ) {
+			break;
+		}
+	}
+
+	// if we haven't found it to be visible,
+	// check overflow clusters that coudln't be stored
+	if ( i == svEnt->numClusters ) {
+		if ( svEnt->lastCluster ) {
+			for ( ; l <= svEnt->lastCluster ; l++ ) {
+				if ( clientpvs[l >> 3] & (1 << (l&7) ) ) {
+					break;
+				}
+			}
+			if ( l == svEnt->lastCluster ) {
+				return qfalse;	// not visible
+			}
+		} else {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+=============================================================================
+
+Per-frame visibility cache
+
+Clients standing in the same cluster and area see the same entities through
+the PVS, so while SV_SendClientMessages runs the client independent part of
+SV_AddEntitiesVisibleFromPoint is done once per (cluster, area) and the
+resulting candidate list is shared.  Single client flags, broadcastClients,
+the cull distance and portal cameras are still handled per client.
+
+=============================================================================
+*/
+
+#define MAX_VIS_CACHE_ENTRIES	MAX_CLIENTS
+
+typedef struct visCacheEntry_s {
+	int			cluster;
+	int			area;
+	int			numEntities;
+	int			entityNums[MAX_GENTITIES];	// candidates in ascending order
+	byte		inPVS[MAX_GENTITIES/8];		// candidates that passed SV_EntityInClusterPVS
+} visCacheEntry_t;
+
+typedef struct visCache_s {
+	qboolean		active;
+	qboolean		jobsRunning;	// entries are read only while job threads are running
+	int				numEntries;
+	visCacheEntry_t	entries[MAX_VIS_CACHE_ENTRIES];
+
+	// cumulative, reported by snapshotstats
+	int				lookups;
+	int				hits;
+} visCache_t;
+
+static visCache_t	svVisCache;
+
+/*
+===============
+SV_BuildVisCacheEntry
+===============
+*/
+static void SV_BuildVisCacheEntry( visCacheEntry_t *entry ) {
+	int				e;
+	sharedEntity_t	*ent;
+	svEntity_t		*svEnt;
+	const byte		*clientpvs;
+	qboolean		inPVS;
+
+	clientpvs = CM_ClusterPVS( entry->cluster );
+
+	entry->numEntities = 0;
+	Com_Memset( entry->inPVS, 0, sizeof( entry->inPVS ) );
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum(e);
+
+		// never send entities that aren't linked in
+		if ( !ent->r.linked ) {
+			continue;
+		}
+
+		if (ent->s.eFlags & EF_PERMANENT)
+		{	// he's permanent, so don't send him down!
+			continue;
+		}
+
+		if (ent->s.number != e) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+
+		// entities can be flagged to explicitly not be sent to the client
+		if ( ent->r.svFlags & SVF_NOCLIENT ) {
+			continue;
+		}
+
+		svEnt = SV_SvEntityForGentity( ent );
+		inPVS = SV_EntityInClusterPVS( svEnt, entry->area, clientpvs );
+
+		// anything that can be sent regardless of the PVS stays a candidate
+		if ( !inPVS && !(ent->r.svFlags & SVF_BROADCAST) && !ent->s.isPortalEnt
+			&& !ent->r.broadcastClients[0] && !ent->r.broadcastClients[1] ) {
+			continue;
+		}
+
+		if ( inPVS ) {
+			entry->inPVS[e >> 3] |= 1 << (e & 7);
+		}
+		entry->entityNums[entry->numEntities++] = e;
+	}
+}
+
+/*
+===============
+SV_FindVisCacheEntry
+
+Only the main thread may create entries, job threads just look them up.
+===============
+*/
+static visCacheEntry_t *SV_FindVisCacheEntry( int cluster, int area, qboolean create ) {
+	visCacheEntry_t	*entry;
+	int				i;
+
+	if ( !svVisCache.active ) {
+		return NULL;
+	}
+
+	for ( i = 0, entry = svVisCache.entries ; i < svVisCache.numEntries ; i++, entry++ ) {
+		if ( entry->cluster == cluster && entry->area == area ) {
+			if ( create ) {
+				svVisCache.lookups++;
+				svVisCache.hits++;
+			}
+			return entry;
+		}
+	}
+
+	if ( !create || svVisCache.numEntries == MAX_VIS_CACHE_ENTRIES ) {
+		return NULL;
+	}
+
+	svVisCache.lookups++;
+	entry = &svVisCache.entries[svVisCache.numEntries++];
+	entry->cluster = cluster;
+	entry->area = area;
+	SV_BuildVisCacheEntry( entry );
+
+	return entry;
+}
+
+/*
+===============
+SV_BeginVisCache
+===============
+*/
+static void SV_BeginVisCache( void ) {
+	svVisCache.active = (sv_snapshotVisCache->integer && sv.state) ? qtrue : qfalse;
+	svVisCache.numEntries = 0;
+}
+
+/*
+===============
+SV_PrecacheClientVis
+
+Creates the cache entry for the client's eye ahead of time so the job
+threads only have to look it up.
+===============
+*/
+static void SV_PrecacheClientVis( client_t *client ) {
+	playerState_t	*ps;
+	vec3_t			org;
+	int				leafnum;
+
+	if ( !svVisCache.active || !client->gentity || client->state == CS_ZOMBIE ) {
+		return;
+	}
+
+	ps = SV_GameClientNum( client - svs.clients );
+	VectorCopy( ps->origin, org );
+	org[2] += ps->viewheight;
+
+	leafnum = CM_PointLeafnum( org );
+	SV_FindVisCacheEntry( CM_LeafCluster( leafnum ), CM_LeafArea( leafnum ), qtrue );
+}
+
+/*
+===============
+SV_EndVisCache
+===============
+*/
+static void SV_EndVisCache( void ) {
+	svVisCache.active = qfalse;
+	svVisCache.jobsRunning = qfalse;
+	svVisCache.numEntries = 0;
+}
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
@@ -363,16 +817,16 @@ SV_AddEntitiesVisibleFromPoint
 float g_svCullDist = -1.0f;
 static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
 									snapshotEntityNumbers_t *eNums, qboolean portal ) {
-	int		e, i;
+	int		c, e;
+	int		numCandidates;
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
-	int		l;
 	int		clientarea, clientcluster;
 	int		leafnum;
 	byte	*clientpvs;
-	byte	*bitvector;
 	vec3_t	difference;
 	float	length, radius;
+	visCacheEntry_t	*cache;
 
 	// during an error shutdown message we may need to transmit
 	// the shutdown message after the server has shutdown, so
@@ -390,27 +844,37 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 	clientpvs = CM_ClusterPVS (clientcluster);
 
-	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+	// portal cameras are rare enough to not be worth caching
+	cache = NULL;
+	if ( !portal ) {
+		cache = SV_FindVisCacheEntry( clientcluster, clientarea, (qboolean)(Sys_JobThreadIndex() == 0 && !svVisCache.jobsRunning) );
+	}
+	numCandidates = cache ? cache->numEntities : sv.num_entities;
+
+	for ( c = 0 ; c < numCandidates ; c++ ) {
+		e = cache ? cache->entityNums[c] : c;
 		ent = SV_GentityNum(e);
 
-		// never send entities that aren't linked in
-		if ( !ent->r.linked ) {
-			continue;
-		}
+		if ( !cache ) {
+			// never send entities that aren't linked in
+			if ( !ent->r.linked ) {
+				continue;
+			}
 
-		if (ent->s.eFlags & EF_PERMANENT)
-		{	// he's permanent, so don't send him down!
-			continue;
-		}
+			if (ent->s.eFlags & EF_PERMANENT)
+			{	// he's permanent, so don't send him down!
+				continue;
+			}
 
-		if (ent->s.number != e) {
-			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
+			if (ent->s.number != e) {
+				Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+				ent->s.number = e;
+			}
 
-		// entities can be flagged to explicitly not be sent to the client
-		if ( ent->r.svFlags & SVF_NOCLIENT ) {
-			continue;
+			// entities can be flagged to explicitly not be sent to the client
+			if ( ent->r.svFlags & SVF_NOCLIENT ) {
+				continue;
+			}
 		}
 
 		// entities can be flagged to be sent to only one client
@@ -429,7 +893,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		svEnt = SV_SvEntityForGentity( ent );
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
 			continue;
 		}
 
@@ -443,55 +907,22 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		if ( (ent->r.svFlags & SVF_BROADCAST) || e == frame->ps.clientNum
 			|| (ent->r.broadcastClients[frame->ps.clientNum/32] & (1 << (frame->ps.clientNum % 32))) )
 		{
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
 		if (ent->s.isPortalEnt)
 		{ //rww - portal entities are always sent as well
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
-		// ignore if not touching a PV leaf
-		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
-			// doors can legally straddle two areas, so
-			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
-				continue;		// blocked by a door
-			}
-		}
-
-		bitvector = clientpvs;
-
-		// check individual leafs
-		if ( !svEnt->numClusters ) {
-			continue;
-		}
-		l = 0;
-		for ( i=0 ; i < svEnt->numClusters ; i++ ) {
-			l = svEnt->clusternums[i];
-			if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-				break;
-			}
-		}
-
-		// if we haven't found it to be visible,
-		// check overflow clusters that coudln't be stored
-		if ( i == svEnt->numClusters ) {
-			if ( svEnt->lastCluster ) {
-				for ( ; l <= svEnt->lastCluster ; l++ ) {
-					if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-						break;
-					}
-				}
-				if ( l == svEnt->lastCluster ) {
-					continue;	// not visible
-				}
-			} else {
+		if ( cache ) {
+			if ( !(cache->inPVS[e >> 3] & (1 << (e & 7))) ) {
 				continue;
 			}
+		} else if ( !SV_EntityInClusterPVS( svEnt, clientarea, clientpvs ) ) {
+			continue;
 		}
 
 		if (g_svCullDist != -1.0f)
@@ -511,7 +942,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 
 		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		SV_AddEntToSnapshot( ent, eNums );
 
 		// if its a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL ) {
@@ -529,7 +960,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 /*
 =============
-SV_BuildClientSnapshot
+SV_GatherClientSnapshot
 
 Decides which entities are going to be visible to the client, and
 copies off the playerstate and areabits.
@@ -538,34 +969,31 @@ This properly handles multiple recursive portals, but the render
 currently doesn't.
 
 For viewing through other player's eyes, client can be something other than client->gentity
+
+Only reads shared server state, so this may run on a job thread.
+Returns qfalse if the client has no entity to build a snapshot for.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static qboolean SV_GatherClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
 	frame->num_entities = 0;
 
 	clent = client->gentity;
 	if ( !clent || client->state == CS_ZOMBIE ) {
-		return;
+		return qfalse;
 	}
 
 	// grab the current playerState_t
@@ -599,8 +1027,7 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
 		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[clientNum >> 3] |= 1 << (clientNum & 7);
 
 
 	// find the client's viewpoint
@@ -609,14 +1036,14 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
 	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities,
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities,
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
@@ -624,22 +1051,64 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
 
-	// copy the entity states out
-	frame->num_entities = 0;
+	return qtrue;
+}
+
+/*
+=============
+SV_AllocClientSnapshotEntities
+
+Reserves the client's range of svs.snapshotEntities, has to run in
+client order on the main thread so the ring layout is deterministic.
+=============
+*/
+static void SV_AllocClientSnapshotEntities( client_t *client, const snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t	*frame;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+	frame->num_entities = entityNumbers->numSnapshotEntities;
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
-		}
-		frame->num_entities++;
+	svs.nextSnapshotEntities += entityNumbers->numSnapshotEntities;
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
+		Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
 	}
 }
 
+/*
+=============
+SV_CopyClientSnapshotEntities
+
+Copies the entity states out into the client's reserved range.
+=============
+*/
+static void SV_CopyClientSnapshotEntities( client_t *client, const snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t	*frame;
+	sharedEntity_t		*ent;
+	int					i;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+	for ( i = 0 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
+		svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities] = ent->s;
+	}
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	snapshotEntityNumbers_t		entityNumbers;
+
+	if ( !SV_GatherClientSnapshot( client, &entityNumbers ) ) {
+		return;
+	}
+	SV_AllocClientSnapshotEntities( client, &entityNumbers );
+	SV_CopyClientSnapshotEntities( client, &entityNumbers );
+}
+
 
 /*
 ====================
@@ -762,98 +1231,327 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
 
 /*
 =======================
-SV_SendClientSnapshot
-
-Also called by SV_FinalMessage
+SV_SendClientGamedir
 
+rww - if the client hasn't been told the game dir yet, make sure there is
+an svc_setgame sent before the next snapshot
 =======================
 */
-extern cvar_t	*fs_gamedirvar;
-void SV_SendClientSnapshot( client_t *client ) {
+static void SV_SendClientGamedir( client_t *client ) {
 	byte		msg_buf[MAX_MSGLEN];
 	msg_t		msg;
+	int			i = 0;
 
-	if (!client->sentGamedir)
-	{ //rww - if this is the case then make sure there is an svc_setgame sent before this snap
-		int i = 0;
+	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 
-		MSG_Init (&msg, msg_buf, sizeof(msg_buf));
+	//have to include this for each message.
+	MSG_WriteLong( &msg, client->lastClientCommand );
 
-		//have to include this for each message.
-		MSG_WriteLong( &msg, client->lastClientCommand );
+	MSG_WriteByte (&msg, svc_setgame);
 
-		MSG_WriteByte (&msg, svc_setgame);
+	const char *gamedir = FS_GetCurrentGameDir(true);
 
-		const char *gamedir = FS_GetCurrentGameDir(true);
+	while (gamedir[i])
+	{
+		MSG_WriteByte(&msg, gamedir[i]);
+		i++;
+	}
+	MSG_WriteByte(&msg, 0);
 
-		while (gamedir[i])
-		{
-			MSG_WriteByte(&msg, gamedir[i]);
-			i++;
-		}
-		MSG_WriteByte(&msg, 0);
+	// MW - my attempt to fix illegible server message errors caused by
+	// packet fragmentation of initial snapshot.
+	//rww - reusing this code here
+	while(client->state&&client->netchan.unsentFragments)
+	{
+		// send additional message fragments if the last message
+		// was too large to send at once
+		Com_Printf ("[ISM]SV_SendClientGameState() [1] for %s, writing out old fragments\n", client->name);
+		SV_Netchan_TransmitNextFragment(&client->netchan);
+	}
 
-		// MW - my attempt to fix illegible server message errors caused by
-		// packet fragmentation of initial snapshot.
-		//rww - reusing this code here
-		while(client->state&&client->netchan.unsentFragments)
-		{
-			// send additional message fragments if the last message
-			// was too large to send at once
-			Com_Printf ("[ISM]SV_SendClientGameState() [1] for %s, writing out old fragments\n", client->name);
-			SV_Netchan_TransmitNextFragment(&client->netchan);
-		}
+	// record information about the message
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg.cursize;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.time;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
+
+	// send the datagram
+	SV_Netchan_Transmit( client, &msg );	//msg->cursize, msg->data );
+
+	client->sentGamedir = qtrue;
+}
+
+/*
+=======================
+SV_WriteClientMessage
 
-		// record information about the message
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg.cursize;
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.time;
-		client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
+Writes everything that goes into the client's snapshot message up to the
+download data.  Only touches the client itself and reads shared server
+state, so this may run on a job thread.
+=======================
+*/
+static void SV_WriteClientMessage( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( msg, client->lastClientCommand );
 
-		// send the datagram
-		SV_Netchan_Transmit( client, &msg );	//msg->cursize, msg->data );
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, msg );
 
-		client->sentGamedir = qtrue;
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotToClient( client, msg, oldframe, lastframe );
+}
+
+/*
+=======================
+SV_FinishClientMessage
+
+Adds the download data and sends the message, main thread only.
+=======================
+*/
+static void SV_FinishClientMessage( client_t *client, msg_t *msg ) {
+	// Add any download data if the client is downloading
+	SV_WriteDownloadToClient( client, msg );
+
+	// check for overflow
+	if ( msg->overflowed ) {
+		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
+		MSG_Clear (msg);
 	}
 
-	// build the snapshot
-	SV_BuildClientSnapshot( client );
+	SV_SendMessageToClient( msg, client );
+}
+
+/*
+=======================
+SV_ClientWantsSnapshotMessage
 
+bots need to have their snapshots built, but
+they query them directly without needing to be sent
+=======================
+*/
+static qboolean SV_ClientWantsSnapshotMessage( client_t *client ) {
 	if ( sv_autoDemo->integer && !client->demo.demorecording ) {
 		if ( client->netchan.remoteAddress.type != NA_BOT || sv_autoDemoBots->integer ) {
 			SV_BeginAutoRecordDemos();
 		}
 	}
 
-	// bots need to have their snapshots built, but
-	// they query them directly without needing to be sent
 	if ( client->netchan.remoteAddress.type == NA_BOT && !client->demo.demorecording ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+=======================
+SV_SendClientSnapshot
+
+Also called by SV_FinalMessage
+
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client ) {
+	byte				msg_buf[MAX_MSGLEN];
+	msg_t				msg;
+	clientSnapshot_t	*oldframe;
+	int					lastframe;
+
+	if (!client->sentGamedir)
+	{
+		SV_SendClientGamedir( client );
+	}
+
+	// build the snapshot
+	SV_BuildClientSnapshot( client );
+
+	if ( !SV_ClientWantsSnapshotMessage( client ) ) {
 		return;
 	}
 
 	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 	msg.allowoverflow = qtrue;
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
+	oldframe = SV_SelectDeltaFrame( client, &lastframe );
+	SV_WriteClientMessage( client, &msg, oldframe, lastframe );
+	SV_FinishClientMessage( client, &msg );
+}
 
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
+/*
+=============================================================================
 
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+Parallel snapshot construction
 
-	// Add any download data if the client is downloading
-	SV_WriteDownloadToClient( client, &msg );
+With sv_snapshotThreads > 0 the clients due for a snapshot this frame are
+built and delta encoded on the job threads.  The world is frozen while the
+jobs run, everything with side effects outside of the client itself
+(snapshot entity ring allocation, delta frame selection, demos, downloads
+and the actual sends) stays on the main thread in client order, so the
+packets are byte identical to the ones SV_SendClientSnapshot produces.
+sv_snapshotVerify re-encodes every message on the main thread and
+compares them.
 
-	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		MSG_Clear (&msg);
+=============================================================================
+*/
+
+typedef struct snapshotJob_s {
+	client_t				*client;
+	snapshotEntityNumbers_t	entityNumbers;
+	qboolean				built;		// has entities to copy out
+	qboolean				transmit;	// bots only need the snapshot built
+	qboolean				written;	// already encoded on the main thread
+	clientSnapshot_t		*oldframe;
+	int						lastframe;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t	*svSnapshotJobs;
+static int				svNumSnapshotJobs;
+
+/*
+=======================
+SV_GatherSnapshotJob
+=======================
+*/
+static void SV_GatherSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = &((snapshotJob_t *)data)[index];
+
+	job->built = SV_GatherClientSnapshot( job->client, &job->entityNumbers );
+}
+
+/*
+=======================
+SV_EncodeSnapshotJob
+=======================
+*/
+static void SV_EncodeSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = &((snapshotJob_t *)data)[index];
+
+	if ( job->written ) {
+		return;
+	}
+	if ( job->built ) {
+		SV_CopyClientSnapshotEntities( job->client, &job->entityNumbers );
 	}
+	if ( job->transmit ) {
+		SV_WriteClientMessage( job->client, &job->msg, job->oldframe, job->lastframe );
+	}
+}
 
-	SV_SendMessageToClient( &msg, client );
+/*
+=======================
+SV_VerifySnapshotJob
+=======================
+*/
+static void SV_VerifySnapshotJob( snapshotJob_t *job ) {
+	byte		msg_buf[MAX_MSGLEN];
+	msg_t		msg;
+	qboolean	deltaCache;
+
+	// encode every delta from scratch so the cache gets checked as well
+	deltaCache = svDeltaCache.active;
+	svDeltaCache.active = qfalse;
+
+	MSG_Init( &msg, msg_buf, sizeof( msg_buf ) );
+	msg.allowoverflow = qtrue;
+	SV_WriteClientMessage( job->client, &msg, job->oldframe, job->lastframe );
+
+	svDeltaCache.active = deltaCache;
+
+	if ( msg.cursize != job->msg.cursize || msg.bit != job->msg.bit
+		|| memcmp( msg.data, job->msg.data, msg.cursize ) ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: parallel snapshot for %s differs from serial encoding (%i/%i bits)\n",
+			job->client->name, job->msg.bit, msg.bit );
+	}
+}
+
+/*
+=======================
+SV_FreeSnapshotJobs
+=======================
+*/
+void SV_FreeSnapshotJobs( void ) {
+	if ( svSnapshotJobs ) {
+		Z_Free( svSnapshotJobs );
+		svSnapshotJobs = NULL;
+	}
+	svNumSnapshotJobs = 0;
+}
+
+/*
+=======================
+SV_SendClientSnapshotsParallel
+=======================
+*/
+static void SV_SendClientSnapshotsParallel( client_t **clients, int numClients ) {
+	snapshotJob_t	*job;
+	int				i, numThreads;
+	int				batchEnd;
+
+	if ( numClients > svNumSnapshotJobs ) {
+		SV_FreeSnapshotJobs();
+		svSnapshotJobs = (snapshotJob_t *)Z_Malloc( sizeof( snapshotJob_t ) * sv_maxclients->integer, TAG_CLIENTS, qfalse );
+		svNumSnapshotJobs = sv_maxclients->integer;
+	}
+
+	numThreads = sv_snapshotThreads->integer;
+
+	for ( i = 0, job = svSnapshotJobs ; i < numClients ; i++, job++ ) {
+		job->client = clients[i];
+		job->written = qfalse;
+		if ( !job->client->sentGamedir ) {
+			SV_SendClientGamedir( job->client );
+		}
+	}
+
+	// decide which entities everyone gets to see
+	for ( i = 0, job = svSnapshotJobs ; i < numClients ; i++, job++ ) {
+		SV_PrecacheClientVis( job->client );
+	}
+	svVisCache.jobsRunning = qtrue;
+	Sys_ParallelFor( numThreads, numClients, SV_GatherSnapshotJob, svSnapshotJobs );
+	svVisCache.jobsRunning = qfalse;
+
+	// lay the snapshots out in the entity ring and pick delta frames in the
+	// same order as the serial path
+	for ( i = 0, job = svSnapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( job->built ) {
+			SV_AllocClientSnapshotEntities( job->client, &job->entityNumbers );
+		}
+		job->transmit = SV_ClientWantsSnapshotMessage( job->client );
+		if ( job->transmit ) {
+			MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+			job->msg.allowoverflow = qtrue;
+			job->oldframe = SV_SelectDeltaFrame( job->client, &job->lastframe );
+		}
+	}
+
+	// a delta frame that is about to be overwritten by the entity copies of a
+	// later client in this batch has to be encoded before those copies happen
+	batchEnd = svs.nextSnapshotEntities;
+	for ( i = 0, job = svSnapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( job->transmit && job->oldframe
+			&& job->oldframe->first_entity < batchEnd - svs.numSnapshotEntities ) {
+			SV_EncodeSnapshotJob( svSnapshotJobs, i );
+			job->written = qtrue;
+		}
+	}
+
+	// copy the entities out and delta encode everything else
+	Sys_ParallelFor( numThreads, numClients, SV_EncodeSnapshotJob, svSnapshotJobs );
+
+	for ( i = 0, job = svSnapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( !job->transmit ) {
+			continue;
+		}
+		// jobs written ahead of the copies were encoded on this thread, and
+		// their delta frame may since have been overwritten
+		if ( sv_snapshotVerify->integer && !job->written ) {
+			SV_VerifySnapshotJob( job );
+		}
+		SV_FinishClientMessage( job->client, &job->msg );
+	}
 }
 
 
@@ -865,6 +1563,13 @@ SV_SendClientMessages
 void SV_SendClientMessages( void ) {
 	int			i;
 	client_t	*c;
+	client_t	*snapshotClients[MAX_CLIENTS];
+	int			numSnapshotClients = 0;
+
+	NetSendBatch	sendBatch;
+
+	SV_BeginVisCache();
+	SV_BeginDeltaCache();
 
 	// send a message to each connected client
 	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
@@ -886,7 +1591,48 @@ void SV_SendClientMessages( void ) {
 		}
 
 		// generate and send a new message
-		SV_SendClientSnapshot( c );
+		if ( sv_snapshotThreads->integer > 0 ) {
+			snapshotClients[numSnapshotClients++] = c;
+		} else {
+			SV_SendClientSnapshot( c );
+		}
 	}
+
+	if ( numSnapshotClients ) {
+		SV_SendClientSnapshotsParallel( snapshotClients, numSnapshotClients );
+	}
+
+	SV_EndDeltaCache();
+	SV_EndVisCache();
 }
 
+/*
+=======================
+SV_SnapshotStats_f
+=======================
+*/
+void SV_SnapshotStats_f( void ) {
+	deltaCacheStats_t	total;
+	int					i;
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		svVisCache.lookups = svVisCache.hits = 0;
+		Com_Memset( svDeltaCache.stats, 0, sizeof( svDeltaCache.stats ) );
+		return;
+	}
+
+	Com_Printf( "visibility cache: %s\n", sv_snapshotVisCache->integer ? "enabled" : "disabled" );
+	Com_Printf( "  %i lookups, %i hits (%.1f%%)\n", svVisCache.lookups, svVisCache.hits,
+		svVisCache.lookups ? 100.0f * svVisCache.hits / svVisCache.lookups : 0.0f );
+
+	Com_Memset( &total, 0, sizeof( total ) );
+	for ( i = 0 ; i < MAX_JOB_THREADS ; i++ ) {
+		total.lookups += svDeltaCache.stats[i].lookups;
+		total.encodes += svDeltaCache.stats[i].encodes;
+		total.hits += svDeltaCache.stats[i].hits;
+		total.full += svDeltaCache.stats[i].full;
+	}
+	Com_Printf( "delta cache: %s\n", sv_snapshotDeltaCache->integer ? "enabled" : "disabled" );
+	Com_Printf( "  %i deltas, %i encoded, %i encodes saved (%.1f%%), %i didn't fit\n", total.lookups, total.encodes,
+		total.hits, total.lookups ? 100.0f * total.hits / total.lookups : 0.0f, total.full );
+}
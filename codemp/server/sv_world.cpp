@@ -25,6 +25,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 #include "server.h"
 #include "ghoul2/ghoul2_shared.h"
+#include "ghoul2/G2.h"
 #include "qcommon/cm_public.h"
 
 /*
@@ -62,6 +63,14 @@ the world is carved up with an evenly spaced, axially aligned bsp tree.  Entitie
 are kept in chains either at the final leafs, or at the first node that splits
 them, which prevents having to deal with multiple fragments of a single entity.
 
+With sv_worldGrid on, entities are instead kept in a loose grid.  Each entity
+goes into the single cell of the finest level that holds its center and whose
+cell size is at least the entity's horizontal size, so a cell's contents never
+reach more than half a cell past its edges.  Queries widen their bounds by that
+half cell, and entities too big for the coarsest level go on an oversize list
+that every query checks.  Unlike the tree, a small entity never ends up on a
+long list just because it straddles a split plane in the middle of the map.
+
 ===============================================================================
 */
 
@@ -78,6 +87,40 @@ typedef struct worldSector_s {
 worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
+typedef struct worldGridCell_s {
+	svEntity_t	*entities;
+	int			numEntities;
+	struct worldGridLevel_s	*level;	// NULL for the oversize list
+	int			x, y;
+} worldGridCell_t;
+
+#define	WORLD_GRID_LEVELS		3
+#define	WORLD_GRID_LEVEL_SCALE	4		// each level's cells are this many times wider than the last
+#define	WORLD_GRID_DIM			64		// finest level cells along the longer side of the world, at most 64 for the row bits
+#define	WORLD_GRID_MIN_CELL		128		// don't bother with cells smaller than a couple of players
+#define	WORLD_GRID_CELLS		(64*64 + 16*16 + 4*4)
+#define	WORLD_GRID_ROWS			(64 + 16 + 4)
+
+typedef struct worldGridLevel_s {
+	float			cellSize;
+	float			invCellSize;
+	int				dims[2];
+	int				numEntities;
+	worldGridCell_t	*cells;
+	uint64_t		*rows;		// a bit for each occupied cell, so long queries skip empty ones
+} worldGridLevel_t;
+
+typedef struct worldGrid_s {
+	qboolean			active;			// sampled from sv_worldGrid in SV_ClearWorld
+	vec3_t				mins, maxs;
+	worldGridLevel_t	levels[WORLD_GRID_LEVELS];
+	worldGridCell_t		oversize;
+	worldGridCell_t		cells[WORLD_GRID_CELLS];
+	uint64_t			rows[WORLD_GRID_ROWS];
+} worldGrid_t;
+
+static worldGrid_t	svWorldGrid;
+
 
 /*
 ===============
@@ -89,6 +132,33 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( svWorldGrid.active ) {
+		int					j, total, occupied, most;
+		worldGridLevel_t	*level;
+
+		Com_Printf( "world grid: (%.0f %.0f) to (%.0f %.0f)\n", svWorldGrid.mins[0], svWorldGrid.mins[1],
+			svWorldGrid.maxs[0], svWorldGrid.maxs[1] );
+		for ( i = 0 ; i < WORLD_GRID_LEVELS ; i++ ) {
+			level = &svWorldGrid.levels[i];
+
+			total = occupied = most = 0;
+			for ( j = 0 ; j < level->dims[0] * level->dims[1] ; j++ ) {
+				c = level->cells[j].numEntities;
+				if ( c ) {
+					occupied++;
+					total += c;
+					if ( c > most ) {
+						most = c;
+					}
+				}
+			}
+			Com_Printf( "level %i: %ix%i cells of %.0f units, %i entities in %i cells, at most %i per cell\n",
+				i, level->dims[0], level->dims[1], level->cellSize, total, occupied, most );
+		}
+		Com_Printf( "oversize: %i entities\n", svWorldGrid.oversize.numEntities );
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -142,6 +212,55 @@ worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
 	return anode;
 }
 
+/*
+===============
+SV_CreateWorldGrid
+
+Sizes the grid levels for the given world size
+===============
+*/
+static void SV_CreateWorldGrid( const vec3_t mins, const vec3_t maxs ) {
+	worldGridLevel_t	*level;
+	worldGridCell_t		*cells;
+	uint64_t			*rows;
+	float				size, cellSize;
+	int					i, j;
+
+	Com_Memset( &svWorldGrid, 0, sizeof( svWorldGrid ) );
+	VectorCopy( mins, svWorldGrid.mins );
+	VectorCopy( maxs, svWorldGrid.maxs );
+
+	size = maxs[0] - mins[0];
+	if ( maxs[1] - mins[1] > size ) {
+		size = maxs[1] - mins[1];
+	}
+	cellSize = size / WORLD_GRID_DIM;
+	if ( !(cellSize >= WORLD_GRID_MIN_CELL) ) {
+		cellSize = WORLD_GRID_MIN_CELL;
+	}
+
+	cells = svWorldGrid.cells;
+	rows = svWorldGrid.rows;
+	for ( i = 0 ; i < WORLD_GRID_LEVELS ; i++, cellSize *= WORLD_GRID_LEVEL_SCALE ) {
+		level = &svWorldGrid.levels[i];
+		level->cellSize = cellSize;
+		level->invCellSize = 1.0f / cellSize;
+		for ( j = 0 ; j < 2 ; j++ ) {
+			level->dims[j] = (int)ceilf( ( maxs[j] - mins[j] ) * level->invCellSize );
+			level->dims[j] = Com_Clampi( 1, WORLD_GRID_DIM >> ( 2 * i ), level->dims[j] );
+		}
+		level->cells = cells;
+		level->rows = rows;
+		for ( j = 0 ; j < level->dims[0] * level->dims[1] ; j++ ) {
+			cells[j].level = level;
+			cells[j].x = j % level->dims[0];
+			cells[j].y = j / level->dims[0];
+		}
+		cells += level->dims[0] * level->dims[1];
+		rows += level->dims[1];
+	}
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -159,6 +278,128 @@ void SV_ClearWorld( void ) {
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	SV_CreateWorldGrid( mins, maxs );
+	svWorldGrid.active = (qboolean)( sv_worldGrid->integer != 0 );
+}
+
+/*
+===============
+SV_GridCoord
+
+Cell index along axis for a point, points outside the world use the edge cells
+===============
+*/
+static QINLINE int SV_GridCoord( const worldGridLevel_t *level, int axis, float v ) {
+	const float f = ( v - svWorldGrid.mins[axis] ) * level->invCellSize;
+
+	if ( !(f >= 0.0f) ) {
+		return 0;
+	}
+	if ( f >= level->dims[axis] ) {
+		return level->dims[axis] - 1;
+	}
+	return (int)f;
+}
+
+/*
+===============
+SV_LinkEntityToGrid
+
+===============
+*/
+static void SV_LinkEntityToGrid( svEntity_t *ent, const sharedEntity_t *gEnt ) {
+	const worldGridLevel_t	*level;
+	worldGridCell_t			*cell;
+	float					size;
+	int						i;
+
+	size = gEnt->r.absmax[0] - gEnt->r.absmin[0];
+	if ( gEnt->r.absmax[1] - gEnt->r.absmin[1] > size ) {
+		size = gEnt->r.absmax[1] - gEnt->r.absmin[1];
+	}
+
+	cell = &svWorldGrid.oversize;
+	for ( i = 0 ; i < WORLD_GRID_LEVELS ; i++ ) {
+		level = &svWorldGrid.levels[i];
+		if ( size <= level->cellSize ) {
+			cell = &level->cells[
+				SV_GridCoord( level, 1, 0.5f * ( gEnt->r.absmin[1] + gEnt->r.absmax[1] ) ) * level->dims[0] +
+				SV_GridCoord( level, 0, 0.5f * ( gEnt->r.absmin[0] + gEnt->r.absmax[0] ) ) ];
+			break;
+		}
+	}
+
+	ent->gridCell = cell;
+	ent->prevEntityInGridCell = NULL;
+	ent->nextEntityInGridCell = cell->entities;
+	if ( cell->entities ) {
+		cell->entities->prevEntityInGridCell = ent;
+	}
+	cell->entities = ent;
+	cell->numEntities++;
+	if ( cell->level ) {
+		cell->level->rows[cell->y] |= (uint64_t)1 << cell->x;
+		cell->level->numEntities++;
+	}
+}
+
+/*
+===============
+SV_UnlinkEntityFromGrid
+
+===============
+*/
+static void SV_UnlinkEntityFromGrid( svEntity_t *ent ) {
+	worldGridCell_t	*cell = ent->gridCell;
+
+	if ( ent->prevEntityInGridCell ) {
+		ent->prevEntityInGridCell->nextEntityInGridCell = ent->nextEntityInGridCell;
+	} else {
+		cell->entities = ent->nextEntityInGridCell;
+	}
+	if ( ent->nextEntityInGridCell ) {
+		ent->nextEntityInGridCell->prevEntityInGridCell = ent->prevEntityInGridCell;
+	}
+	cell->numEntities--;
+	if ( cell->level ) {
+		if ( !cell->numEntities ) {
+			cell->level->rows[cell->y] &= ~( (uint64_t)1 << cell->x );
+		}
+		cell->level->numEntities--;
+	}
+
+	ent->gridCell = NULL;
+	ent->prevEntityInGridCell = ent->nextEntityInGridCell = NULL;
+}
+
+/*
+===============
+SV_LinkEntityToSector
+
+===============
+*/
+static void SV_LinkEntityToSector( svEntity_t *ent, const sharedEntity_t *gEnt ) {
+	worldSector_t	*node;
+
+	// find the first world sector node that the ent's box crosses
+	node = sv_worldSectors;
+	while (1)
+	{
+		if (node->axis == -1)
+			break;
+		if ( gEnt->r.absmin[node->axis] > node->dist)
+			node = node->children[0];
+		else if ( gEnt->r.absmax[node->axis] < node->dist)
+			node = node->children[1];
+		else
+			break;		// crosses the node
+	}
+
+	// link it in
+	ent->worldSector = node;
+	ent->nextEntityInWorldSector = node->entities;
+	node->entities = ent;
 }
 
 
@@ -177,6 +418,11 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linked = qfalse;
 
+	if ( ent->gridCell ) {
+		SV_UnlinkEntityFromGrid( ent );
+		return;
+	}
+
 	ws = ent->worldSector;
 	if ( !ws ) {
 		return;		// not linked in anywhere
@@ -207,7 +453,6 @@ SV_LinkEntity
 */
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEntity( sharedEntity_t *gEnt ) {
-	worldSector_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			cluster;
 	int			num_leafs;
@@ -219,7 +464,7 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
+	if ( ent->worldSector || ent->gridCell ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -343,25 +588,12 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+	if ( svWorldGrid.active ) {
+		SV_LinkEntityToGrid( ent, gEnt );
+	} else {
+		SV_LinkEntityToSector( ent, gEnt );
 	}
 
-	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
-
 	gEnt->r.linked = qtrue;
 }
 
@@ -429,6 +661,90 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesInGridCell
+
+Returns qfalse once the list is full
+====================
+*/
+static qboolean SV_AreaEntitiesInGridCell( const worldGridCell_t *cell, areaParms_t *ap ) {
+	svEntity_t	*check;
+	sharedEntity_t *gcheck;
+
+	for ( check = cell->entities ; check ; check = check->nextEntityInGridCell ) {
+		gcheck = SV_GEntityForSvEntity( check );
+
+		if ( gcheck->r.absmin[0] > ap->maxs[0]
+		|| gcheck->r.absmin[1] > ap->maxs[1]
+		|| gcheck->r.absmin[2] > ap->maxs[2]
+		|| gcheck->r.absmax[0] < ap->mins[0]
+		|| gcheck->r.absmax[1] < ap->mins[1]
+		|| gcheck->r.absmax[2] < ap->mins[2]) {
+			continue;
+		}
+
+		if ( ap->count == ap->maxcount ) {
+			Com_DPrintf ("SV_AreaEntities: MAXCOUNT\n");
+			return qfalse;
+		}
+
+		ap->list[ap->count] = check - sv.svEntities;
+		ap->count++;
+	}
+
+	return qtrue;
+}
+
+/*
+====================
+SV_AreaEntitiesInGrid
+
+Coarse levels go first, like the big straddling entities near the top of the tree
+====================
+*/
+static void SV_AreaEntitiesInGrid( areaParms_t *ap ) {
+	const worldGridLevel_t	*level;
+	float					loose;
+	uint64_t				row;
+	int						i, x, y;
+	int						x0, x1, y0, y1;
+
+	if ( !SV_AreaEntitiesInGridCell( &svWorldGrid.oversize, ap ) ) {
+		return;
+	}
+
+	for ( i = WORLD_GRID_LEVELS - 1 ; i >= 0 ; i-- ) {
+		level = &svWorldGrid.levels[i];
+		if ( !level->numEntities ) {
+			continue;
+		}
+
+		// entities reach up to half a cell out of the cell they are linked in
+		loose = 0.5f * level->cellSize;
+		x0 = SV_GridCoord( level, 0, ap->mins[0] - loose );
+		x1 = SV_GridCoord( level, 0, ap->maxs[0] + loose );
+		y0 = SV_GridCoord( level, 1, ap->mins[1] - loose );
+		y1 = SV_GridCoord( level, 1, ap->maxs[1] + loose );
+
+		for ( y = y0 ; y <= y1 ; y++ ) {
+			// only visit the occupied cells between x0 and x1
+			row = level->rows[y] >> x0;
+			if ( x1 - x0 < 63 ) {
+				row &= ( (uint64_t)2 << ( x1 - x0 ) ) - 1;
+			}
+			for ( x = x0 ; row ; x++, row >>= 1 ) {
+				if ( !( row & 1 ) ) {
+					continue;
+				}
+				if ( !SV_AreaEntitiesInGridCell( &level->cells[y * level->dims[0] + x], ap ) ) {
+					return;
+				}
+			}
+		}
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -443,7 +759,11 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( svWorldGrid.active ) {
+		SV_AreaEntitiesInGrid( &ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
 
 	return ap.count;
 }
@@ -536,7 +856,7 @@ static float VectorDistance(vec3_t p1, vec3_t p2)
 #endif
 
 static void SV_ClipMoveToEntities( moveclip_t *clip ) {
-	static int	touchlist[MAX_GENTITIES];
+	int			touchlist[MAX_GENTITIES];
 	int			i, num;
 	sharedEntity_t *touch;
 	int			passOwnerNum;
@@ -876,6 +1196,154 @@ Ghoul2 Insert End
 	*results = clip.trace;
 }
 
+typedef struct traceBatchJob_s {
+	trace_t					*results;
+	const traceRequest_t	*requests;
+} traceBatchJob_t;
+
+#define	TRACEBATCH_JOB_TRACES	8	// don't wake a thread for fewer traces than this
+
+static void SV_TraceBatchRequest( trace_t *result, const traceRequest_t *req ) {
+	SV_Trace( result, req->start, req->mins, req->maxs, req->end,
+		req->passEntityNum, req->contentmask, req->capsule, req->traceFlags, req->useLod );
+}
+
+static void SV_TraceBatchJob( void *data, int index ) {
+	const traceBatchJob_t	*job = (const traceBatchJob_t *)data;
+
+	// Ghoul2 collision isn't safe off the main thread
+	if ( job->requests[index].traceFlags & G2TRFLAG_DOGHOULTRACE ) {
+		return;
+	}
+	SV_TraceBatchRequest( &job->results[index], &job->requests[index] );
+}
+
+/*
+==================
+SV_TraceBatchSkeletons
+
+Ghoul2 collision has to stay on the main thread, the skeletons it tests
+against don't.  Has the renderer build the skeletons of every Ghoul2 entity
+the batch's Ghoul2 traces can reach on the job threads and hold them, so the
+serial traces only skin and test them.  Only the bones the surfaces of an
+entity use at the LOD of the first trace reaching it are built up front.
+Returns qtrue when skeletons are held and have to be released after the
+traces.
+==================
+*/
+static qboolean SV_TraceBatchSkeletons( const traceRequest_t *requests, int count, int numThreads ) {
+	static CGhoul2Info_v	*ghoul2[MAX_GENTITIES];
+	static float			*scales[MAX_GENTITIES];
+	static int				lods[MAX_GENTITIES];
+	static byte				added[MAX_GENTITIES];
+	int						touchlist[MAX_GENTITIES];
+	vec3_t					boxmins, boxmaxs;
+	int						i, j, k, num, numGhoul2;
+
+	Com_Memset( added, 0, sizeof( added ) );
+	numGhoul2 = 0;
+
+	for ( i=0 ; i<count ; i++ ) {
+		const traceRequest_t	*req = &requests[i];
+
+		if ( !( req->traceFlags & G2TRFLAG_DOGHOULTRACE ) ) {
+			continue;
+		}
+
+		// same move bounds as SV_Trace
+		for ( k=0 ; k<3 ; k++ ) {
+			boxmins[k] = Q_min( req->start[k], req->end[k] ) + req->mins[k] - 1;
+			boxmaxs[k] = Q_max( req->start[k], req->end[k] ) + req->maxs[k] + 1;
+		}
+
+		num = SV_AreaEntities( boxmins, boxmaxs, touchlist, MAX_GENTITIES );
+		for ( j=0 ; j<num ; j++ ) {
+			sharedEntity_t	*touch = SV_GentityNum( touchlist[j] );
+
+			if ( added[touchlist[j]] || touchlist[j] == req->passEntityNum || !touch->ghoul2 ) {
+				continue;
+			}
+			if ( !( req->contentmask & touch->r.contents ) ) {
+				continue;
+			}
+			if ( !( req->traceFlags & G2TRFLAG_HITCORPSES ) && ( touch->s.eFlags & EF_DEAD ) ) {
+				continue;
+			}
+
+			added[touchlist[j]] = 1;
+			ghoul2[numGhoul2] = (CGhoul2Info_v *)touch->ghoul2;
+			scales[numGhoul2] = touch->modelScale;
+			lods[numGhoul2] = req->useLod;
+			numGhoul2++;
+		}
+	}
+
+	// a single skeleton is cheaper to leave to the trace
+	if ( numGhoul2 < 2 ) {
+		return qfalse;
+	}
+
+	re->G2API_ConstructSkeletons( ghoul2, scales, lods, numGhoul2, sv.time, numThreads );
+	return qtrue;
+}
+
+// releases the skeletons SV_TraceBatchSkeletons held on the way out, even when
+// a Ghoul2 trace throws, so none are left keyed to models the drop frees
+class TraceBatchSkeletons {
+public:
+	TraceBatchSkeletons() : held( qfalse ) {};
+	~TraceBatchSkeletons() {
+		if ( held ) {
+			// the game gets control back and may move bones again
+			re->G2API_ReleaseSkeletons();
+		}
+	};
+
+	qboolean held;
+};
+
+/*
+==================
+SV_TraceBatch
+
+Runs a batch of independent traces for the game module in one call, so bot
+and NPC code that checks many lines of sight at once doesn't pay for a
+syscall per trace.  Results come back in request order and match SV_Trace.
+
+With sv_traceThreads the batch is spread over the job threads.  Only the
+collision model and the entity links are read while the jobs run, the game
+is blocked in this call so neither can change underneath them.  The Ghoul2
+traces run afterwards on this thread, against skeletons the job threads
+built for them.
+==================
+*/
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int count ) {
+	traceBatchJob_t		job;
+	TraceBatchSkeletons	skeletons;
+	int					i, numThreads;
+
+	numThreads = Q_min( sv_traceThreads->integer, count / TRACEBATCH_JOB_TRACES );
+	if ( numThreads <= 1 ) {
+		for ( i=0 ; i<count ; i++ ) {
+			SV_TraceBatchRequest( &results[i], &requests[i] );
+		}
+		return;
+	}
+
+	CM_SetupThreads( numThreads );
+
+	job.results = results;
+	job.requests = requests;
+	Sys_ParallelFor( numThreads, count, SV_TraceBatchJob, &job );
+
+	skeletons.held = SV_TraceBatchSkeletons( requests, count, numThreads );
+	for ( i=0 ; i<count ; i++ ) {
+		if ( requests[i].traceFlags & G2TRFLAG_DOGHOULTRACE ) {
+			SV_TraceBatchRequest( &results[i], &requests[i] );
+		}
+	}
+}
+
 
 
 /*
@@ -913,3 +1381,540 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 }
 
 
+
+/*
+============================================================================
+
+TRACE BENCHMARK
+
+============================================================================
+*/
+
+typedef struct traceBench_s {
+	vec3_t	start, end;
+	int		passEntityNum;
+	int		entityNum[2];
+	float	fraction[2];
+} traceBench_t;
+
+#define	TRACEBENCH_TRACES	100000
+#define	TRACEBENCH_BATCH	16
+
+/*
+===============
+SV_RebuildWorldIndex
+
+Relinks every linked entity into the sector tree or the grid without touching
+anything the game can see
+===============
+*/
+static void SV_RebuildWorldIndex( qboolean grid ) {
+	sharedEntity_t	*gEnt;
+	svEntity_t		*ent;
+	vec3_t			mins, maxs;
+	int				i;
+
+	VectorCopy( svWorldGrid.mins, mins );
+	VectorCopy( svWorldGrid.maxs, maxs );
+
+	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
+	sv_numworldSectors = 0;
+	SV_CreateworldSector( 0, mins, maxs );
+	SV_CreateWorldGrid( mins, maxs );
+	svWorldGrid.active = grid;
+
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		ent = &sv.svEntities[i];
+		ent->worldSector = NULL;
+		ent->nextEntityInWorldSector = NULL;
+		ent->gridCell = NULL;
+		ent->prevEntityInGridCell = ent->nextEntityInGridCell = NULL;
+
+		gEnt = SV_GentityNum( i );
+		if ( !gEnt->r.linked ) {
+			continue;
+		}
+		if ( grid ) {
+			SV_LinkEntityToGrid( ent, gEnt );
+		} else {
+			SV_LinkEntityToSector( ent, gEnt );
+		}
+	}
+}
+
+/*
+===============
+SV_TraceBench_f
+
+Runs the same random traces around the linked entities through both indexes,
+then fans them out from a shared start in batches like a bot looking around
+and checks SV_TraceBatch against single traces
+===============
+*/
+void SV_TraceBench_f( void ) {
+	static const vec3_t	playerMins = { -15, -15, DEFAULT_MINS_2 };
+	static const vec3_t	playerMaxs = { 15, 15, DEFAULT_MAXS_2 };
+	static const char	*names[2] = { "sector tree", "world grid" };
+	int				anchors[MAX_GENTITIES];
+	int				touch[MAX_GENTITIES];
+	traceBench_t	*traces, *t;
+	traceRequest_t	*requests, *req;
+	trace_t			tr, *batched;
+	vec3_t			boxmins, boxmaxs, dir;
+	const float		*mins, *maxs;
+	qboolean		wasActive;
+	int				numAnchors, count, seed;
+	int				i, j, mode, start, traceMsec, areaMsec, batchMsec, touched, differ;
+	sharedEntity_t	*gEnt;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	count = TRACEBENCH_TRACES;
+	if ( Cmd_Argc() > 1 ) {
+		count = Com_Clampi( 1, 10000000, atoi( Cmd_Argv( 1 ) ) );
+	}
+
+	numAnchors = 0;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		if ( SV_GentityNum( i )->r.linked ) {
+			anchors[numAnchors++] = i;
+		}
+	}
+
+	// same traces every run so the numbers can be compared between builds
+	traces = (traceBench_t *)Z_Malloc( sizeof( traceBench_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	seed = 0x5eed;
+	for ( i = 0 ; i < count ; i++ ) {
+		t = &traces[i];
+		t->passEntityNum = ENTITYNUM_NONE;
+		if ( numAnchors ) {
+			j = anchors[( Q_rand( &seed ) & 0x7fffffff ) % numAnchors];
+			gEnt = SV_GentityNum( j );
+			VectorAdd( gEnt->r.absmin, gEnt->r.absmax, t->start );
+			VectorScale( t->start, 0.5f, t->start );
+			if ( i & 2 ) {
+				t->passEntityNum = j;
+			}
+		} else {
+			for ( j = 0 ; j < 3 ; j++ ) {
+				t->start[j] = svWorldGrid.mins[j] + Q_random( &seed ) * ( svWorldGrid.maxs[j] - svWorldGrid.mins[j] );
+			}
+		}
+		t->start[0] += Q_crandom( &seed ) * 512.0f;
+		t->start[1] += Q_crandom( &seed ) * 512.0f;
+		t->start[2] += Q_crandom( &seed ) * 128.0f;
+
+		dir[0] = Q_crandom( &seed );
+		dir[1] = Q_crandom( &seed );
+		dir[2] = Q_crandom( &seed ) * 0.25f;
+		VectorNormalize( dir );
+		VectorMA( t->start, 64.0f + Q_random( &seed ) * 1984.0f, dir, t->end );
+	}
+
+	wasActive = svWorldGrid.active;
+	Com_Printf( "%i traces around %i linked entities\n", count, numAnchors );
+
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		SV_RebuildWorldIndex( (qboolean)mode );
+
+		// odd traces are player sized boxes, even ones are shots
+		start = Sys_Milliseconds();
+		for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+			if ( i & 1 ) {
+				SV_Trace( &tr, t->start, playerMins, playerMaxs, t->end, t->passEntityNum, MASK_PLAYERSOLID, 0, 0, 0 );
+			} else {
+				SV_Trace( &tr, t->start, NULL, NULL, t->end, t->passEntityNum, MASK_SHOT, 0, 0, 0 );
+			}
+			t->fraction[mode] = tr.fraction;
+			t->entityNum[mode] = tr.entityNum;
+		}
+		traceMsec = Sys_Milliseconds() - start;
+
+		// the entity gathering on its own, without the world and entity clipping
+		touched = 0;
+		start = Sys_Milliseconds();
+		for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+			mins = ( i & 1 ) ? playerMins : vec3_origin;
+			maxs = ( i & 1 ) ? playerMaxs : vec3_origin;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				boxmins[j] = Q_min( t->start[j], t->end[j] ) + mins[j] - 1;
+				boxmaxs[j] = Q_max( t->start[j], t->end[j] ) + maxs[j] + 1;
+			}
+			touched += SV_AreaEntities( boxmins, boxmaxs, touch, MAX_GENTITIES );
+		}
+		areaMsec = Sys_Milliseconds() - start;
+
+		Com_Printf( "%-12s traces %6i msec (%8.0f/sec), area queries %6i msec (%8.0f/sec), %.1f entities per query\n",
+			names[mode], traceMsec, 1000.0f * count / Q_max( traceMsec, 1 ), areaMsec, 1000.0f * count / Q_max( areaMsec, 1 ),
+			(float)touched / count );
+	}
+
+	differ = 0;
+	for ( i = 0, t = traces ; i < count ; i++, t++ ) {
+		if ( t->fraction[0] != t->fraction[1] || t->entityNum[0] != t->entityNum[1] ) {
+			differ++;
+		}
+	}
+	if ( differ ) {
+		// entities touched at exactly the same fraction may be reported in either order
+		Com_Printf( "%i traces ended differently\n", differ );
+	}
+
+	// every batch looks out from the start of its first trace
+	requests = (traceRequest_t *)Z_Malloc( sizeof( traceRequest_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	batched = (trace_t *)Z_Malloc( sizeof( trace_t ) * count, TAG_TEMP_WORKSPACE, qfalse );
+	for ( i = 0, t = traces, req = requests ; i < count ; i++, t++, req++ ) {
+		const traceBench_t *first = &traces[i - i % TRACEBENCH_BATCH];
+
+		VectorCopy( first->start, req->start );
+		VectorSubtract( t->end, t->start, dir );
+		VectorAdd( req->start, dir, req->end );
+		req->passEntityNum = first->passEntityNum;
+		req->contentmask = MASK_SHOT;
+	}
+
+	start = Sys_Milliseconds();
+	for ( i = 0, req = requests ; i < count ; i++, req++ ) {
+		SV_Trace( &tr, req->start, NULL, NULL, req->end, req->passEntityNum, req->contentmask, 0, 0, 0 );
+		traces[i].fraction[0] = tr.fraction;
+		traces[i].entityNum[0] = tr.entityNum;
+	}
+	traceMsec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < count ; i += TRACEBENCH_BATCH ) {
+		SV_TraceBatch( &batched[i], &requests[i], Q_min( TRACEBENCH_BATCH, count - i ) );
+	}
+	batchMsec = Sys_Milliseconds() - start;
+
+	differ = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( batched[i].fraction != traces[i].fraction[0] || batched[i].entityNum != traces[i].entityNum[0] ) {
+			differ++;
+		}
+	}
+	Com_Printf( "%-12s single %6i msec (%8.0f/sec), batches of %i %6i msec (%8.0f/sec)\n",
+		"fanned out", traceMsec, 1000.0f * count / Q_max( traceMsec, 1 ), TRACEBENCH_BATCH,
+		batchMsec, 1000.0f * count / Q_max( batchMsec, 1 ) );
+	if ( differ ) {
+		Com_Printf( S_COLOR_RED "%i batched traces differ from single traces\n", differ );
+	}
+
+	SV_RebuildWorldIndex( wasActive );
+
+	Z_Free( batched );
+	Z_Free( requests );
+	Z_Free( traces );
+}
+
+/*
+============================================================================
+
+GHOUL2 HIT TRACE BENCHMARK
+
+============================================================================
+*/
+
+typedef struct g2TraceBench_s {
+	vec3_t	start, end;
+	vec3_t	angles;
+	vec3_t	scale;
+	int		time;
+	int		traceFlags;
+	int		useLod;
+	float	radius;
+} g2TraceBench_t;
+
+#define	G2TRACEBENCH_SHOTS		20000
+#define	G2TRACEBENCH_PER_FRAME	8
+
+/*
+===============
+SV_G2TraceBench_f
+
+Fires the same shots at an animating Ghoul2 model with r_ghoul2HitIndex and
+r_ghoul2SkinCache off and on, a few shots per frame with every fourth one a
+radius trace, and checks that every mode reports exactly the same collision
+records as plain skinning
+===============
+*/
+void SV_G2TraceBench_f( void ) {
+	static const char	*names[4] = { "full skin", "hit index", "skin cache", "both" };
+	static const vec3_t	origin = { 0, 0, 0 };
+	CGhoul2Info_v		*ghoul2 = NULL;
+	CollisionRecord_t	*records[2], *rec;
+	g2TraceBench_t		*shots, *s;
+	vec3_t				dir;
+	const char			*modelName, *cacheSize;
+	char				oldIndex[MAX_CVAR_VALUE_STRING], oldCache[MAX_CVAR_VALUE_STRING];
+	int					count, perFrame, seed, frame;
+	int					i, j, mode, start, msec, hits, differ;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	modelName = "models/players/kyle/model.glm";
+	if ( Cmd_Argc() > 1 ) {
+		modelName = Cmd_Argv( 1 );
+	}
+	count = G2TRACEBENCH_SHOTS;
+	if ( Cmd_Argc() > 2 ) {
+		count = Com_Clampi( 1, 1000000, atoi( Cmd_Argv( 2 ) ) );
+	}
+	perFrame = G2TRACEBENCH_PER_FRAME;
+	if ( Cmd_Argc() > 3 ) {
+		perFrame = Com_Clampi( 1, 1000, atoi( Cmd_Argv( 3 ) ) );
+	}
+
+	if ( re->G2API_InitGhoul2Model( &ghoul2, modelName, 0, 0, 0, 0, 0 ) < 0 || !ghoul2 ) {
+		Com_Printf( "Couldn't load %s\n", modelName );
+		return;
+	}
+	// whatever the skeleton has, run through it so the bones actually move
+	re->G2API_SetBoneAnim( *ghoul2, 0, "model_root", 0, 16, BONE_ANIM_OVERRIDE_LOOP, 1.0f, sv.time, -1, -1 );
+
+	seed = 0x5eed;
+	shots = (g2TraceBench_t *)Z_Malloc( sizeof( g2TraceBench_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	for ( i = 0, s = shots ; i < count ; i++, s++ ) {
+		const float range = 256 + Q_random( &seed ) * 768;
+
+		dir[0] = Q_crandom( &seed );
+		dir[1] = Q_crandom( &seed );
+		dir[2] = Q_crandom( &seed ) * 0.5f;
+		if ( VectorNormalize( dir ) == 0 ) {
+			dir[0] = 1;
+		}
+		s->end[0] = Q_crandom( &seed ) * 32;
+		s->end[1] = Q_crandom( &seed ) * 32;
+		s->end[2] = Q_crandom( &seed ) * 48;
+		VectorMA( s->end, range, dir, s->start );
+		// run the shot straight through the model
+		VectorMA( s->end, -64, dir, s->end );
+
+		// the model holds still within a frame, the shooters don't
+		frame = i / perFrame;
+		s->angles[YAW] = ( frame * 37 ) % 360;
+		if ( frame & 1 ) {
+			VectorSet( s->scale, 1.25f, 1.25f, 1.1f );
+		}
+		s->time = sv.time + frame * 50;
+		s->traceFlags = ( i & 2 ) ? G2_RETURNONHIT : 0;
+		s->useLod = ( frame & 7 ) == 7;
+		s->radius = ( i % 4 == 3 ) ? 4.0f : 0.0f;
+	}
+
+	records[0] = (CollisionRecord_t *)Z_Malloc( sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count, TAG_TEMP_WORKSPACE, qfalse );
+	records[1] = (CollisionRecord_t *)Z_Malloc( sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count, TAG_TEMP_WORKSPACE, qfalse );
+
+	Q_strncpyz( oldIndex, Cvar_VariableString( "r_ghoul2HitIndex" ), sizeof( oldIndex ) );
+	Q_strncpyz( oldCache, Cvar_VariableString( "r_ghoul2SkinCache" ), sizeof( oldCache ) );
+	cacheSize = atoi( oldCache ) > 0 ? oldCache : "2048";
+
+	for ( mode = 0 ; mode < 4 ; mode++ ) {
+		rec = records[mode ? 1 : 0];
+
+		Com_Memset( rec, 0, sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count );
+		for ( i = 0 ; i < MAX_G2_COLLISIONS * count ; i++ ) {
+			rec[i].mEntityNum = -1;
+		}
+		Cvar_Set( "r_ghoul2HitIndex", ( mode & 1 ) ? "1" : "0" );
+		Cvar_Set( "r_ghoul2SkinCache", ( mode & 2 ) ? cacheSize : "0" );
+		Cmd_ExecuteString( "g2skincacheinfo reset" );
+
+		hits = 0;
+		start = Sys_Milliseconds();
+		for ( i = 0, s = shots ; i < count ; i++, s++, rec += MAX_G2_COLLISIONS ) {
+			re->G2API_CollisionDetect( rec, *ghoul2, s->angles, origin, s->time, 0, s->start, s->end, s->scale,
+				G2VertSpaceServer, s->traceFlags, s->useLod, s->radius );
+			if ( rec[0].mEntityNum != -1 ) {
+				hits++;
+			}
+		}
+		msec = Sys_Milliseconds() - start;
+
+		differ = 0;
+		if ( mode ) {
+			for ( i = 0 ; i < count ; i++ ) {
+				const CollisionRecord_t *a = &records[0][i * MAX_G2_COLLISIONS];
+				const CollisionRecord_t *b = &records[1][i * MAX_G2_COLLISIONS];
+
+				for ( j = 0 ; j < MAX_G2_COLLISIONS ; j++ ) {
+					if ( memcmp( &a[j], &b[j], sizeof( CollisionRecord_t ) ) ) {
+						differ++;
+						break;
+					}
+				}
+			}
+		}
+
+		Com_Printf( "%-12s %7i shots %7i hits %6i msec (%8.0f/sec)\n",
+			names[mode], count, hits, msec, 1000.0f * count / Q_max( msec, 1 ) );
+		if ( mode & 2 ) {
+			Cmd_ExecuteString( "g2skincacheinfo" );
+		}
+		if ( differ ) {
+			Com_Printf( S_COLOR_RED "%i shots hit differently than with full skinning\n", differ );
+		}
+	}
+
+	// both are registered on first use, so they may not have existed before
+	Cvar_Set( "r_ghoul2HitIndex", oldIndex[0] ? oldIndex : "1" );
+	Cvar_Set( "r_ghoul2SkinCache", oldCache[0] ? oldCache : "2048" );
+
+	Z_Free( records[1] );
+	Z_Free( records[0] );
+	Z_Free( shots );
+	re->G2API_CleanGhoul2Models( &ghoul2 );
+}
+
+#define	G2CROWDBENCH_MODELS		32
+#define	G2CROWDBENCH_FRAMES		200
+
+/*
+===============
+SV_G2CrowdBench_f
+
+Shoots once a frame at each model of a crowd, each animating out of step
+with the others, first with every trace building its own skeleton and then
+with the crowd's skeletons built up front on the job threads the way
+SV_TraceBatch does, and checks both report the same collision records.
+Then times building the crowd's skeletons up front on their own, which is
+the part the job threads take over
+===============
+*/
+void SV_G2CrowdBench_f( void ) {
+	static const vec3_t	origin = { 0, 0, 0 };
+	static const vec3_t	angles = { 0, 0, 0 };
+	CGhoul2Info_v		*crowd[G2CROWDBENCH_MODELS];
+	float				*scales[G2CROWDBENCH_MODELS];
+	vec3_t				scale[G2CROWDBENCH_MODELS];
+	int					lods[G2CROWDBENCH_MODELS];
+	CollisionRecord_t	*records[2], *rec;
+	g2TraceBench_t		*shots, *s;
+	vec3_t				dir;
+	const char			*modelName;
+	int					numModels, frames, numThreads, seed, count;
+	int					i, k, pass, frame, start, msec[3], hits[2], differ;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	modelName = "models/players/kyle/model.glm";
+	if ( Cmd_Argc() > 1 ) {
+		modelName = Cmd_Argv( 1 );
+	}
+	numModels = G2CROWDBENCH_MODELS;
+	if ( Cmd_Argc() > 2 ) {
+		numModels = Com_Clampi( 2, G2CROWDBENCH_MODELS, atoi( Cmd_Argv( 2 ) ) );
+	}
+	frames = G2CROWDBENCH_FRAMES;
+	if ( Cmd_Argc() > 3 ) {
+		frames = Com_Clampi( 1, 100000, atoi( Cmd_Argv( 3 ) ) );
+	}
+	numThreads = sv_traceThreads->integer > 1 ? sv_traceThreads->integer : Q_min( Sys_CPUCount(), MAX_JOB_THREADS );
+
+	Com_Memset( crowd, 0, sizeof( crowd ) );
+	for ( k = 0 ; k < numModels ; k++ ) {
+		if ( re->G2API_InitGhoul2Model( &crowd[k], modelName, 0, 0, 0, 0, 0 ) < 0 || !crowd[k] ) {
+			Com_Printf( "Couldn't load %s\n", modelName );
+			for ( k = 0 ; k < numModels ; k++ ) {
+				if ( crowd[k] ) {
+					re->G2API_CleanGhoul2Models( &crowd[k] );
+				}
+			}
+			return;
+		}
+		// the same animation, started at a different time for everyone
+		re->G2API_SetBoneAnim( *crowd[k], 0, "model_root", 0, 16, BONE_ANIM_OVERRIDE_LOOP, 1.0f, sv.time - k * 73, -1, -1 );
+		VectorSet( scale[k], 1.0f + ( k & 3 ) * 0.05f, 1.0f + ( k & 3 ) * 0.05f, 1.0f );
+		scales[k] = scale[k];
+		lods[k] = 0;
+	}
+
+	count = numModels * frames;
+	seed = 0x5eed;
+	shots = (g2TraceBench_t *)Z_Malloc( sizeof( g2TraceBench_t ) * count, TAG_TEMP_WORKSPACE, qtrue );
+	for ( i = 0, s = shots ; i < count ; i++, s++ ) {
+		dir[0] = Q_crandom( &seed );
+		dir[1] = Q_crandom( &seed );
+		dir[2] = Q_crandom( &seed ) * 0.5f;
+		if ( VectorNormalize( dir ) == 0 ) {
+			dir[0] = 1;
+		}
+		s->end[0] = Q_crandom( &seed ) * 32;
+		s->end[1] = Q_crandom( &seed ) * 32;
+		s->end[2] = Q_crandom( &seed ) * 48;
+		VectorMA( s->end, 512, dir, s->start );
+		VectorMA( s->end, -64, dir, s->end );
+	}
+
+	records[0] = (CollisionRecord_t *)Z_Malloc( sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count, TAG_TEMP_WORKSPACE, qfalse );
+	records[1] = (CollisionRecord_t *)Z_Malloc( sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count, TAG_TEMP_WORKSPACE, qfalse );
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		rec = records[pass];
+		Com_Memset( rec, 0, sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS * count );
+		for ( i = 0 ; i < MAX_G2_COLLISIONS * count ; i++ ) {
+			rec[i].mEntityNum = -1;
+		}
+
+		hits[pass] = 0;
+		s = shots;
+		start = Sys_Milliseconds();
+		for ( frame = 0 ; frame < frames ; frame++ ) {
+			const int time = sv.time + frame * 50;
+
+			if ( pass ) {
+				re->G2API_ConstructSkeletons( crowd, scales, lods, numModels, time, numThreads );
+			}
+			for ( k = 0 ; k < numModels ; k++, s++, rec += MAX_G2_COLLISIONS ) {
+				re->G2API_CollisionDetect( rec, *crowd[k], angles, origin, time, k, s->start, s->end, scales[k],
+					G2VertSpaceServer, 0, 0, 0.0f );
+				if ( rec[0].mEntityNum != -1 ) {
+					hits[pass]++;
+				}
+			}
+			if ( pass ) {
+				re->G2API_ReleaseSkeletons();
+			}
+		}
+		msec[pass] = Sys_Milliseconds() - start;
+	}
+
+	// new times, so no skeleton is left over from the passes above
+	start = Sys_Milliseconds();
+	for ( frame = 0 ; frame < frames ; frame++ ) {
+		re->G2API_ConstructSkeletons( crowd, scales, lods, numModels, sv.time + ( frames + frame ) * 50, numThreads );
+		re->G2API_ReleaseSkeletons();
+	}
+	msec[2] = Sys_Milliseconds() - start;
+
+	differ = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( memcmp( &records[0][i * MAX_G2_COLLISIONS], &records[1][i * MAX_G2_COLLISIONS], sizeof( CollisionRecord_t ) * MAX_G2_COLLISIONS ) ) {
+			differ++;
+		}
+	}
+
+	Com_Printf( "%i models, %i frames, %i hits\n", numModels, frames, hits[0] );
+	Com_Printf( "%-12s %6i msec (%8.0f/sec)\n", "per trace", msec[0], 1000.0f * count / Q_max( msec[0], 1 ) );
+	Com_Printf( "%-12s %6i msec (%8.0f/sec) on %i threads\n", "up front", msec[1], 1000.0f * count / Q_max( msec[1], 1 ), numThreads );
+	Com_Printf( "%-12s %6i msec (%8.0f/sec) on %i threads\n", "skeletons", msec[2], 1000.0f * count / Q_max( msec[2], 1 ), numThreads );
+	if ( differ ) {
+		Com_Printf( S_COLOR_RED "%i shots hit differently with the skeletons built up front\n", differ );
+	}
+
+	Z_Free( records[1] );
+	Z_Free( records[0] );
+	Z_Free( shots );
+	for ( k = 0 ; k < numModels ; k++ ) {
+		re->G2API_CleanGhoul2Models( &crowd[k] );
+	}
+}
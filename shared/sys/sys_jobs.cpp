@@ -0,0 +1,232 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+#include "sys/sys_jobs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	thread_local int jobThreadIndex = 0;
+	thread_local bool insideJob = false;
+
+	class JobPool
+	{
+	public:
+		~JobPool()
+		{
+			Shutdown();
+		}
+
+		void Run( int numThreads, int count, jobFunc_t func, void *data )
+		{
+			// only one batch at a time, other callers queue up here
+			std::lock_guard< std::mutex > batchLock( batchMutex );
+
+			Grow( numThreads - 1 );
+
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				batchFunc = func;
+				batchData = data;
+				batchCount = count;
+				batchNext = 0;
+				batchWorkers = numThreads - 1;
+				pendingWorkers = batchWorkers;
+				batchError = nullptr;
+				generation++;
+			}
+			wake.notify_all();
+
+			Work();
+
+			std::exception_ptr error;
+			{
+				std::unique_lock< std::mutex > lock( mutex );
+				done.wait( lock, [this] { return pendingWorkers == 0; } );
+				error = batchError;
+				batchError = nullptr;
+			}
+
+			if ( error )
+			{
+				std::rethrow_exception( error );
+			}
+		}
+
+		void Shutdown()
+		{
+			std::lock_guard< std::mutex > batchLock( batchMutex );
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				quit = true;
+			}
+			wake.notify_all();
+			for ( std::thread& thread : threads )
+			{
+				thread.join();
+			}
+			threads.clear();
+			quit = false;
+		}
+
+	private:
+		void Grow( int numWorkers )
+		{
+			while ( (int)threads.size() < numWorkers )
+			{
+				const int index = (int)threads.size() + 1;
+				threads.emplace_back( [this, index] { WorkerLoop( index ); } );
+			}
+		}
+
+		void Work()
+		{
+			insideJob = true;
+			try
+			{
+				for ( ;; )
+				{
+					const int index = batchNext.fetch_add( 1 );
+					if ( index >= batchCount )
+					{
+						break;
+					}
+					batchFunc( batchData, index );
+				}
+			}
+			catch ( ... )
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				if ( !batchError )
+				{
+					batchError = std::current_exception();
+				}
+				// let the other threads run out of work
+				batchNext = batchCount;
+			}
+			insideJob = false;
+		}
+
+		void WorkerLoop( int index )
+		{
+			jobThreadIndex = index;
+
+			unsigned int seenGeneration = 0;
+			for ( ;; )
+			{
+				{
+					std::unique_lock< std::mutex > lock( mutex );
+					wake.wait( lock, [&] { return quit || generation != seenGeneration; } );
+					if ( quit )
+					{
+						return;
+					}
+					seenGeneration = generation;
+					if ( index > batchWorkers )
+					{
+						// not needed for this batch
+						continue;
+					}
+				}
+
+				Work();
+
+				bool last;
+				{
+					std::lock_guard< std::mutex > lock( mutex );
+					last = --pendingWorkers == 0;
+				}
+				if ( last )
+				{
+					done.notify_one();
+				}
+			}
+		}
+
+	private:
+		std::vector< std::thread > threads;
+		std::mutex batchMutex;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		unsigned int generation = 0;
+		bool quit = false;
+
+		jobFunc_t batchFunc = nullptr;
+		void *batchData = nullptr;
+		int batchCount = 0;
+		std::atomic< int > batchNext{ 0 };
+		int batchWorkers = 0;
+		int pendingWorkers = 0;
+		std::exception_ptr batchError;
+	};
+
+	JobPool jobPool;
+}
+
+int Sys_CPUCount( void )
+{
+	const unsigned int count = std::thread::hardware_concurrency();
+	return count ? (int)count : 1;
+}
+
+void Sys_ParallelFor( int numThreads, int count, jobFunc_t func, void *data )
+{
+	if ( count <= 0 )
+	{
+		return;
+	}
+
+	if ( numThreads > MAX_JOB_THREADS )
+	{
+		numThreads = MAX_JOB_THREADS;
+	}
+	if ( numThreads > count )
+	{
+		numThreads = count;
+	}
+
+	if ( numThreads <= 1 || insideJob )
+	{
+		for ( int i = 0; i < count; i++ )
+		{
+			func( data, i );
+		}
+		return;
+	}
+
+	jobPool.Run( numThreads, count, func, data );
+}
+
+int Sys_JobThreadIndex( void )
+{
+	return jobThreadIndex;
+}
+
+void Sys_ShutdownJobs( void )
+{
+	jobPool.Shutdown();
+}
@@ -0,0 +1,55 @@
+/*
+===========================================================================
+Copyright (C) 2013 - 2015, OpenJK contributors
+
+This file is part of the OpenJK source code.
+
+OpenJK is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, see <http://www.gnu.org/licenses/>.
+===========================================================================
+*/
+
+#pragma once
+
+/*
+==============================================================
+
+WORKER THREAD POOL
+
+Data-parallel jobs for engine systems that can split their work into
+independent items (per-client snapshots, batched traces, ...).  Jobs must
+not touch the zone allocator, cvars, the console or any other engine state
+that isn't explicitly documented as safe to use from a worker.
+
+==============================================================
+*/
+
+#define MAX_JOB_THREADS		32
+
+typedef void (*jobFunc_t)( void *data, int index );
+
+// number of hardware threads, at least 1
+int		Sys_CPUCount( void );
+
+// Runs func( data, index ) for every index in [0, count) spread over up to
+// numThreads threads, the calling thread included, and returns once every
+// index has completed.  numThreads <= 1 (or a call made from inside a job)
+// runs everything on the calling thread.  An exception thrown by a job is
+// rethrown on the calling thread after the batch has drained.
+void	Sys_ParallelFor( int numThreads, int count, jobFunc_t func, void *data );
+
+// 0 on any thread that isn't a pool worker, 1..MAX_JOB_THREADS-1 on workers.
+// Use it to index per-thread scratch memory from inside a job.
+int		Sys_JobThreadIndex( void );
+
+// joins all worker threads, the pool is recreated on the next Sys_ParallelFor
+void	Sys_ShutdownJobs( void );
@@ -299,6 +299,25 @@ time_t Sys_FileTime( const char *path )
 	return buf.st_mtime;
 }
 
+/*
+============
+Sys_FileInfo
+
+size and modification time in one stat, qfalse if not present
+============
+*/
+qboolean Sys_FileInfo( const char *path, long long *size, time_t *mtime )
+{
+	struct stat buf;
+
+	if ( stat( path, &buf ) == -1 )
+		return qfalse;
+
+	*size = (long long)buf.st_size;
+	*mtime = buf.st_mtime;
+	return qtrue;
+}
+
 /*
 =================
 Sys_UnloadDll
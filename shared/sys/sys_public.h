@@ -22,6 +22,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include "qcommon/q_shared.h"
+#include "sys/sys_jobs.h"
 
 #define MAXPRINTMSG 4096
 
@@ -151,6 +152,19 @@ void	Sys_FreeFileList( char **fileList );
 //rwwRMG - changed to fileList to not conflict with list type
 
 time_t Sys_FileTime( const char *path );
+qboolean Sys_FileInfo( const char *path, long long *size, time_t *mtime );
+
+// a read-only view of part of a file, see Sys_MapFile
+typedef struct sysFileMapping_s {
+	void		*base;		// start of the view, aligned down to the mapping granularity
+	size_t		size;
+} sysFileMapping_t;
+
+// Maps length bytes of f starting at offset read-only into memory and returns
+// a pointer to the byte at offset, or NULL if the file can't be mapped.  The
+// view stays valid after f is closed, until Sys_UnmapFile.
+const void *Sys_MapFile( FILE *f, long offset, long length, sysFileMapping_t *mapping );
+void	Sys_UnmapFile( sysFileMapping_t *mapping );
 
 qboolean Sys_LowPhysicalMemory();
 
@@ -28,6 +28,7 @@ along with this program; if not, see <http://www.gnu.org/licenses/>.
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <sched.h>
@@ -184,6 +185,48 @@ qboolean Sys_LowPhysicalMemory( void )
 	return qfalse;
 }
 
+/*
+==================
+Sys_MapFile
+==================
+*/
+const void *Sys_MapFile( FILE *f, long offset, long length, sysFileMapping_t *mapping )
+{
+	const long	pageSize = sysconf( _SC_PAGESIZE );
+	const long	start = offset - offset % pageSize;
+	void		*base;
+
+	mapping->base = NULL;
+	mapping->size = 0;
+
+	if ( offset < 0 || length <= 0 ) {
+		return NULL;
+	}
+
+	base = mmap( NULL, (size_t)( offset - start + length ), PROT_READ, MAP_PRIVATE, fileno( f ), (off_t)start );
+	if ( base == MAP_FAILED ) {
+		return NULL;
+	}
+
+	mapping->base = base;
+	mapping->size = (size_t)( offset - start + length );
+	return (const byte *)base + ( offset - start );
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( sysFileMapping_t *mapping )
+{
+	if ( mapping->base ) {
+		munmap( mapping->base, mapping->size );
+	}
+	mapping->base = NULL;
+	mapping->size = 0;
+}
+
 /*
 ==================
 Sys_Basename
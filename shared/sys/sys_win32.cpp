@@ -244,6 +244,62 @@ qboolean Sys_LowPhysicalMemory(void) {
 	return (stat.ullTotalPhys <= MEM_THRESHOLD) ? qtrue : qfalse;
 }
 
+/*
+==================
+Sys_MapFile
+==================
+*/
+const void *Sys_MapFile( FILE *f, long offset, long length, sysFileMapping_t *mapping ) {
+	SYSTEM_INFO	info;
+	HANDLE		file, fileMapping;
+	long		start;
+	void		*base;
+
+	mapping->base = NULL;
+	mapping->size = 0;
+
+	if ( offset < 0 || length <= 0 ) {
+		return NULL;
+	}
+
+	file = (HANDLE)_get_osfhandle( _fileno( f ) );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+
+	fileMapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( !fileMapping ) {
+		return NULL;
+	}
+
+	GetSystemInfo( &info );
+	start = offset - offset % (long)info.dwAllocationGranularity;
+
+	// the view keeps the mapping object alive on its own
+	base = MapViewOfFile( fileMapping, FILE_MAP_READ, 0, (DWORD)start, (SIZE_T)( offset - start + length ) );
+	CloseHandle( fileMapping );
+	if ( !base ) {
+		return NULL;
+	}
+
+	mapping->base = base;
+	mapping->size = (size_t)( offset - start + length );
+	return (const byte *)base + ( offset - start );
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( sysFileMapping_t *mapping ) {
+	if ( mapping->base ) {
+		UnmapViewOfFile( mapping->base );
+	}
+	mapping->base = NULL;
+	mapping->size = 0;
+}
+
 /*
 ==============
 Sys_Mkdir
@@ -0,0 +1,350 @@
+#include "qcommon/cm_local.h"
+#include "sys/sys_jobs.h"
+
+#include "stubs.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+	// A made up map: a few dozen boxes, some with a corner cut off by a
+	// slanted side, in a kd-tree whose leafs share most of the brushes, so
+	// the multi-check marks and the box hull both get a workout.
+	const int NUM_BRUSHES = 48;
+	const int TREE_DEPTH = 5;
+	const float MAP_EXTENT = 1024.0f;
+	const char *const MAP_NAME = "maps/cm_trace_test.bsp";
+
+	struct mapBuilder_t
+	{
+		std::vector< dplane_t > planes;
+		std::vector< dbrushside_t > sides;
+		std::vector< dbrush_t > brushes;
+		std::vector< std::vector< float > > bounds;	// mins and maxs of each brush
+		std::vector< dnode_t > nodes;
+		std::vector< dleaf_t > leafs;
+		std::vector< int > leafBrushes;
+
+		// adds the plane and its opposite, returns the first
+		int AddPlane( const vec3_t normal, float dist )
+		{
+			dplane_t plane;
+			VectorCopy( normal, plane.normal );
+			plane.dist = dist;
+			planes.push_back( plane );
+			VectorScale( normal, -1, plane.normal );
+			plane.dist = -dist;
+			planes.push_back( plane );
+			return (int)planes.size() - 2;
+		}
+
+		void AddSide( int planeNum )
+		{
+			dbrushside_t side;
+			side.planeNum = planeNum;
+			side.shaderNum = 0;
+			side.drawSurfNum = -1;
+			sides.push_back( side );
+		}
+
+		void AddBrush( const vec3_t mins, const vec3_t maxs, const vec3_t cutNormal )
+		{
+			dbrush_t brush;
+			brush.firstSide = (int)sides.size();
+			brush.shaderNum = 0;
+
+			// -x, +x, -y, +y, -z, +z, the order CM_BoundBrush expects
+			for ( int axis = 0; axis < 3; axis++ )
+			{
+				vec3_t normal = { 0, 0, 0 };
+				normal[axis] = -1;
+				AddSide( AddPlane( normal, -mins[axis] ) );
+				normal[axis] = 1;
+				AddSide( AddPlane( normal, maxs[axis] ) );
+			}
+
+			if ( VectorLengthSquared( cutNormal ) > 0 )
+			{
+				// take a corner off, halfway between the centre and the corner
+				vec3_t centre, corner;
+				for ( int axis = 0; axis < 3; axis++ )
+				{
+					centre[axis] = ( mins[axis] + maxs[axis] ) * 0.5f;
+					corner[axis] = cutNormal[axis] > 0 ? maxs[axis] : mins[axis];
+				}
+				AddSide( AddPlane( cutNormal, ( DotProduct( cutNormal, centre ) + DotProduct( cutNormal, corner ) ) * 0.5f ) );
+			}
+
+			brush.numSides = (int)sides.size() - brush.firstSide;
+			brushes.push_back( brush );
+
+			bounds.push_back( { mins[0], mins[1], mins[2], maxs[0], maxs[1], maxs[2] } );
+		}
+
+		// returns the child number for the node or leaf covering mins..maxs
+		int AddTree( const vec3_t mins, const vec3_t maxs, int depth )
+		{
+			if ( depth == TREE_DEPTH )
+			{
+				dleaf_t leaf;
+				memset( &leaf, 0, sizeof( leaf ) );
+				leaf.firstLeafBrush = (int)leafBrushes.size();
+				for ( int i = 0; i < (int)brushes.size(); i++ )
+				{
+					vec3pair_t leafBounds, brushBounds;
+					VectorCopy( mins, leafBounds[0] );
+					VectorCopy( maxs, leafBounds[1] );
+					VectorCopy( &bounds[i][0], brushBounds[0] );
+					VectorCopy( &bounds[i][3], brushBounds[1] );
+					if ( CM_GenericBoxCollide( brushBounds, leafBounds ) )
+					{
+						leafBrushes.push_back( i );
+					}
+				}
+				leaf.numLeafBrushes = (int)leafBrushes.size() - leaf.firstLeafBrush;
+				for ( int axis = 0; axis < 3; axis++ )
+				{
+					leaf.mins[axis] = (int)mins[axis];
+					leaf.maxs[axis] = (int)maxs[axis];
+				}
+				leafs.push_back( leaf );
+				return -(int)leafs.size();
+			}
+
+			const int axis = depth % 3;
+			const float split = ( mins[axis] + maxs[axis] ) * 0.5f;
+			vec3_t normal = { 0, 0, 0 };
+			normal[axis] = 1;
+
+			const int nodeNum = (int)nodes.size();
+			nodes.push_back( dnode_t() );
+			nodes[nodeNum].planeNum = AddPlane( normal, split );
+
+			vec3_t frontMins, backMaxs;
+			VectorCopy( mins, frontMins );
+			VectorCopy( maxs, backMaxs );
+			frontMins[axis] = split;
+			backMaxs[axis] = split;
+
+			const int front = AddTree( frontMins, maxs, depth + 1 );
+			const int back = AddTree( mins, backMaxs, depth + 1 );
+			nodes[nodeNum].children[0] = front;
+			nodes[nodeNum].children[1] = back;
+			for ( int j = 0; j < 3; j++ )
+			{
+				nodes[nodeNum].mins[j] = (int)mins[j];
+				nodes[nodeNum].maxs[j] = (int)maxs[j];
+			}
+			return nodeNum;
+		}
+	};
+
+	template< typename T >
+	void AddLump( std::vector< byte > &file, int lump, const T *data, size_t count )
+	{
+		dheader_t *header = (dheader_t *)file.data();
+		header->lumps[lump].fileofs = (int)file.size();
+		header->lumps[lump].filelen = (int)( count * sizeof( T ) );
+		file.insert( file.end(), (const byte *)data, (const byte *)( data + count ) );
+		while ( file.size() & 3 )
+		{
+			file.push_back( 0 );
+		}
+	}
+
+	void LoadTestMap()
+	{
+		static bool loaded = false;
+		if ( loaded )
+		{
+			return;
+		}
+		loaded = true;
+
+		mapBuilder_t map;
+		int seed = 0xb5b;
+
+		for ( int i = 0; i < NUM_BRUSHES; i++ )
+		{
+			vec3_t mins, maxs, cut = { 0, 0, 0 };
+			for ( int axis = 0; axis < 3; axis++ )
+			{
+				const float centre = ( Q_random( &seed ) * 2 - 1 ) * ( MAP_EXTENT - 128 );
+				const float size = 16 + Q_random( &seed ) * 112;
+				mins[axis] = floorf( centre - size );
+				maxs[axis] = floorf( centre + size );
+			}
+			if ( i % 3 == 0 )
+			{
+				VectorSet( cut, Q_crandom( &seed ), Q_crandom( &seed ), Q_crandom( &seed ) );
+				VectorNormalize( cut );
+			}
+			map.AddBrush( mins, maxs, cut );
+		}
+
+		const vec3_t worldMins = { -MAP_EXTENT, -MAP_EXTENT, -MAP_EXTENT };
+		const vec3_t worldMaxs = { MAP_EXTENT, MAP_EXTENT, MAP_EXTENT };
+		map.AddTree( worldMins, worldMaxs, 0 );
+
+		dshader_t shader;
+		memset( &shader, 0, sizeof( shader ) );
+		Q_strncpyz( shader.shader, "textures/test/solid", sizeof( shader.shader ) );
+		shader.contentFlags = CONTENTS_SOLID;
+
+		dmodel_t world;
+		memset( &world, 0, sizeof( world ) );
+		VectorCopy( worldMins, world.mins );
+		VectorCopy( worldMaxs, world.maxs );
+		world.numBrushes = NUM_BRUSHES;
+
+		const char entities[] = "{\n\"classname\" \"worldspawn\"\n}\n";
+
+		std::vector< byte > file( sizeof( dheader_t ), 0 );
+		AddLump( file, LUMP_ENTITIES, entities, sizeof( entities ) );
+		AddLump( file, LUMP_SHADERS, &shader, 1 );
+		AddLump( file, LUMP_PLANES, map.planes.data(), map.planes.size() );
+		AddLump( file, LUMP_NODES, map.nodes.data(), map.nodes.size() );
+		AddLump( file, LUMP_LEAFS, map.leafs.data(), map.leafs.size() );
+		AddLump( file, LUMP_LEAFBRUSHES, map.leafBrushes.data(), map.leafBrushes.size() );
+		AddLump( file, LUMP_MODELS, &world, 1 );
+		AddLump( file, LUMP_BRUSHES, map.brushes.data(), map.brushes.size() );
+		AddLump( file, LUMP_BRUSHSIDES, map.sides.data(), map.sides.size() );
+
+		dheader_t *header = (dheader_t *)file.data();
+		header->ident = BSP_IDENT;
+		header->version = BSP_VERSION;
+
+		Test_AddFile( MAP_NAME, file.data(), (int)file.size() );
+
+		int checksum;
+		CM_LoadMap( MAP_NAME, qfalse, &checksum );
+	}
+
+	struct testTrace_t
+	{
+		vec3_t start, end, mins, maxs;
+		vec3_t origin;		// of the temp box, which is only used when set
+		qboolean tempBox;
+		int capsule;
+		trace_t result[2];	// serial, threaded
+	};
+
+	std::vector< testTrace_t > MakeTraces( int count, int seed )
+	{
+		std::vector< testTrace_t > traces( count );
+		for ( testTrace_t &t : traces )
+		{
+			memset( &t, 0, sizeof( t ) );
+			for ( int axis = 0; axis < 3; axis++ )
+			{
+				t.start[axis] = Q_crandom( &seed ) * MAP_EXTENT;
+				t.end[axis] = Q_crandom( &seed ) * MAP_EXTENT;
+			}
+			// half of them are point traces
+			if ( Q_rand( &seed ) & 1 )
+			{
+				const float size = Q_random( &seed ) * 32;
+				VectorSet( t.mins, -size, -size, -size * 1.5f );
+				VectorSet( t.maxs, size, size, size * 1.5f );
+			}
+			t.capsule = ( Q_rand( &seed ) % 8 ) == 0;
+			t.tempBox = (qboolean)( ( Q_rand( &seed ) % 4 ) == 0 );
+			if ( t.tempBox )
+			{
+				// a box on the way from start to end
+				const float frac = Q_random( &seed );
+				for ( int axis = 0; axis < 3; axis++ )
+				{
+					t.origin[axis] = t.start[axis] + frac * ( t.end[axis] - t.start[axis] );
+				}
+			}
+		}
+		return traces;
+	}
+
+	struct traceJob_t
+	{
+		std::vector< testTrace_t > *traces;
+		int pass;
+	};
+
+	void RunTrace( testTrace_t &t, trace_t *result )
+	{
+		if ( t.tempBox )
+		{
+			const vec3_t boxMins = { -24, -24, -40 };
+			const vec3_t boxMaxs = { 24, 24, 40 };
+			const clipHandle_t box = CM_TempBoxModel( boxMins, boxMaxs, t.capsule );
+			CM_TransformedBoxTrace( result, t.start, t.end, t.mins, t.maxs, box, CONTENTS_SOLID, t.origin, vec3_origin, t.capsule );
+		}
+		else
+		{
+			CM_BoxTrace( result, t.start, t.end, t.mins, t.maxs, 0, CONTENTS_SOLID, t.capsule );
+		}
+	}
+
+	void TraceJob( void *data, int index )
+	{
+		traceJob_t *job = static_cast< traceJob_t* >( data );
+		testTrace_t &t = ( *job->traces )[index];
+		RunTrace( t, &t.result[job->pass] );
+	}
+
+	bool SameTrace( const trace_t &a, const trace_t &b )
+	{
+		return a.allsolid == b.allsolid && a.startsolid == b.startsolid
+			&& a.fraction == b.fraction && VectorCompare( a.endpos, b.endpos )
+			&& VectorCompare( a.plane.normal, b.plane.normal ) && a.plane.dist == b.plane.dist
+			&& a.surfaceFlags == b.surfaceFlags && a.contents == b.contents;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE( qcommon )
+
+BOOST_AUTO_TEST_SUITE( cm_trace )
+
+BOOST_AUTO_TEST_CASE( threaded_traces_match_serial )
+{
+	const int numTraces = 20000;
+	const int numThreads = 8;
+
+	LoadTestMap();
+	CM_SetupThreads( numThreads );
+
+	std::vector< testTrace_t > traces = MakeTraces( numTraces, 0x57e5 );
+	traceJob_t job = { &traces, 0 };
+	int hits = 0;
+
+	for ( testTrace_t &t : traces )
+	{
+		RunTrace( t, &t.result[0] );
+		hits += t.result[0].fraction < 1.0f || t.result[0].startsolid;
+	}
+	// make sure the map gets in the way of a fair share of them
+	BOOST_CHECK_GT( hits, numTraces / 10 );
+	BOOST_CHECK_LT( hits, numTraces );
+
+	job.pass = 1;
+	for ( int round = 0; round < 4; round++ )
+	{
+		int threadTraces, brushTraces, patchTraces, pointContents;
+
+		CM_TraceStats( &threadTraces, &brushTraces, &patchTraces, &pointContents );
+		Sys_ParallelFor( numThreads, numTraces, TraceJob, &job );
+		CM_TraceStats( &threadTraces, &brushTraces, &patchTraces, &pointContents );
+		BOOST_CHECK_EQUAL( threadTraces, numTraces );
+
+		int differ = 0;
+		for ( testTrace_t &t : traces )
+		{
+			differ += !SameTrace( t.result[0], t.result[1] );
+		}
+		BOOST_CHECK_EQUAL( differ, 0 );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
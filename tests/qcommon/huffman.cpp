@@ -0,0 +1,192 @@
+#include "qcommon/qcommon.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+extern int msg_hData[256];
+
+namespace
+{
+	// Trees fed a frequency table the way MSG_initHuffman feeds msg_hData,
+	// and the tables flattened from them.
+	struct huffTrees_t
+	{
+		huffman_t huff;
+		huffTable_t encode;
+		huffTable_t decode;
+		bool tables;
+	};
+
+	std::vector< int > MessageCounts()
+	{
+		return std::vector< int >( msg_hData, msg_hData + 256 );
+	}
+
+	// Fibonacci weights give every symbol a code one bit longer than the
+	// last, well past HUFF_LOOKUP_BITS but inside HUFF_MAX_CODE_BITS.
+	std::vector< int > SkewedCounts()
+	{
+		std::vector< int > counts( 22 );
+		counts[0] = counts[1] = 1;
+		for ( size_t i = 2; i < counts.size(); i++ )
+		{
+			counts[i] = counts[i - 1] + counts[i - 2];
+		}
+		return counts;
+	}
+
+	std::unique_ptr< huffTrees_t > BuildTrees( const std::vector< int > &counts )
+	{
+		std::unique_ptr< huffTrees_t > trees( new huffTrees_t );
+
+		Huff_Init( &trees->huff );
+		for ( size_t i = 0; i < counts.size(); i++ )
+		{
+			for ( int j = 0; j < counts[i]; j++ )
+			{
+				Huff_addRef( &trees->huff.compressor, (byte)i );
+				Huff_addRef( &trees->huff.decompressor, (byte)i );
+			}
+		}
+		trees->tables = Huff_BuildTable( &trees->huff.compressor, &trees->encode )
+			&& Huff_BuildTable( &trees->huff.decompressor, &trees->decode );
+		return trees;
+	}
+
+	// Every symbol a few times over, then a run that follows the counts, so
+	// the rare long codes get as much use as the short ones.
+	std::vector< int > MakeSymbols( const std::vector< int > &counts )
+	{
+		std::vector< int > symbols;
+		unsigned int seed = 0x1234567;
+		int total = 0;
+
+		for ( int count : counts )
+		{
+			total += count;
+		}
+		for ( size_t i = 0; i < counts.size() * 8; i++ )
+		{
+			seed = seed * 1664525 + 1013904223;
+			symbols.push_back( ( seed >> 8 ) % counts.size() );
+		}
+		for ( int i = 0; i < 1 << 14; i++ )
+		{
+			int pick, ch;
+
+			seed = seed * 1664525 + 1013904223;
+			pick = (int)( ( (uint64_t)( seed >> 8 ) * total ) >> 24 );
+			for ( ch = 0; pick >= counts[ch]; ch++ )
+			{
+				pick -= counts[ch];
+			}
+			symbols.push_back( ch );
+		}
+		return symbols;
+	}
+
+	void CheckEncode( const std::vector< int > &counts )
+	{
+		std::unique_ptr< huffTrees_t > trees = BuildTrees( counts );
+		const std::vector< int > symbols = MakeSymbols( counts );
+		const int maxOffset = (int)symbols.size() * HUFF_MAX_CODE_BITS;
+		std::vector< byte > treeBits( maxOffset / 8 ), tableBits( maxOffset / 8 );
+		int treeOffset = 0, tableOffset = 0;
+
+		BOOST_REQUIRE( trees->tables );
+		for ( int ch : symbols )
+		{
+			Huff_offsetTransmit( &trees->huff.compressor, ch, treeBits.data(), &treeOffset, maxOffset );
+			Huff_tableTransmit( &trees->encode, ch, tableBits.data(), &tableOffset, maxOffset );
+			BOOST_REQUIRE_EQUAL( treeOffset, tableOffset );
+		}
+		BOOST_CHECK( memcmp( treeBits.data(), tableBits.data(), ( treeOffset + 7 ) >> 3 ) == 0 );
+	}
+
+	void CheckDecode( const std::vector< int > &counts )
+	{
+		std::unique_ptr< huffTrees_t > trees = BuildTrees( counts );
+		const std::vector< int > symbols = MakeSymbols( counts );
+		const int maxOffset = (int)symbols.size() * HUFF_MAX_CODE_BITS;
+		std::vector< byte > bits( maxOffset / 8 );
+		int offset = 0, treeOffset = 0, tableOffset = 0;
+
+		BOOST_REQUIRE( trees->tables );
+		for ( int ch : symbols )
+		{
+			Huff_offsetTransmit( &trees->huff.compressor, ch, bits.data(), &offset, maxOffset );
+		}
+
+		// the last few symbols sit too close to the end for the lookup
+		for ( size_t i = 0; i < symbols.size(); i++ )
+		{
+			int treeCh = -1, tableCh = -1;
+
+			Huff_offsetReceive( trees->huff.decompressor.tree, &treeCh, bits.data(), &treeOffset, offset );
+			Huff_tableReceive( &trees->decode, &tableCh, bits.data(), &tableOffset, offset );
+			BOOST_REQUIRE_EQUAL( treeCh, symbols[i] );
+			BOOST_REQUIRE_EQUAL( tableCh, symbols[i] );
+			BOOST_REQUIRE_EQUAL( treeOffset, tableOffset );
+		}
+		BOOST_CHECK_EQUAL( tableOffset, offset );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE( qcommon )
+
+BOOST_AUTO_TEST_SUITE( huffman )
+
+BOOST_AUTO_TEST_CASE( message_tables_match_tree )
+{
+	CheckEncode( MessageCounts() );
+	CheckDecode( MessageCounts() );
+}
+
+BOOST_AUTO_TEST_CASE( long_codes_match_tree )
+{
+	std::unique_ptr< huffTrees_t > trees = BuildTrees( SkewedCounts() );
+	int longest = 0;
+
+	BOOST_REQUIRE( trees->tables );
+	for ( int ch = 0; ch < 256; ch++ )
+	{
+		BOOST_CHECK_EQUAL( trees->encode.length[ch], trees->decode.length[ch] );
+		longest = std::max( longest, (int)trees->encode.length[ch] );
+	}
+
+	// the codes past the lookup decode by walking the tree
+	BOOST_REQUIRE( longest > HUFF_LOOKUP_BITS );
+	CheckEncode( SkewedCounts() );
+	CheckDecode( SkewedCounts() );
+}
+
+BOOST_AUTO_TEST_CASE( table_overflow_matches_tree )
+{
+	std::unique_ptr< huffTrees_t > trees = BuildTrees( MessageCounts() );
+	const std::vector< int > symbols = MakeSymbols( MessageCounts() );
+
+	BOOST_REQUIRE( trees->tables );
+
+	// run out of room at every bit of the first few codes
+	for ( int maxOffset = 0; maxOffset < 256; maxOffset++ )
+	{
+		byte treeBits[64] = {}, tableBits[64] = {};
+		int treeOffset = 0, tableOffset = 0;
+
+		for ( int i = 0; i < 64; i++ )
+		{
+			Huff_offsetTransmit( &trees->huff.compressor, symbols[i], treeBits, &treeOffset, maxOffset );
+			Huff_tableTransmit( &trees->encode, symbols[i], tableBits, &tableOffset, maxOffset );
+			BOOST_REQUIRE_EQUAL( treeOffset, tableOffset );
+		}
+		BOOST_CHECK_EQUAL( treeOffset, maxOffset + 1 );
+		BOOST_CHECK( memcmp( treeBits, tableBits, sizeof( treeBits ) ) == 0 );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
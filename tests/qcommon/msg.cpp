@@ -0,0 +1,523 @@
+#include "qcommon/qcommon.h"
+#include "game/bg_public.h"
+#include "sys/sys_jobs.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+	// Frames from a made up game: entities drifting about a level, players
+	// running between them, and a handful of entities coming and going.
+	const int NUM_FRAMES = 48;
+	const int NUM_ENTITIES = 256;
+	const int NUM_CLIENTS = 24;
+	const int VIEW_RANGE = 1200;
+
+	struct clientFrame_t
+	{
+		playerState_t ps;
+		std::vector< int > entities;	// visible entity numbers, ascending
+	};
+
+	struct recording_t
+	{
+		std::vector< std::vector< entityState_t > > world;		// [frame][entity]
+		std::vector< std::vector< clientFrame_t > > clients;	// [frame][client]
+	};
+
+	float RandomRange( int *seed, float min, float max )
+	{
+		return min + ( max - min ) * Q_random( seed );
+	}
+
+	int RandomInt( int *seed, int min, int max )
+	{
+		return min + Q_rand( seed ) % ( max - min + 1 );
+	}
+
+	void Record( recording_t &rec )
+	{
+		int seed = 0x51a95;
+		std::vector< entityState_t > ents( NUM_ENTITIES );
+		std::vector< playerState_t > players( NUM_CLIENTS );
+
+		memset( ents.data(), 0, sizeof( entityState_t ) * ents.size() );
+		for ( int e = 0; e < NUM_ENTITIES; e++ )
+		{
+			entityState_t &es = ents[e];
+			es.number = e;
+			es.eType = e % 6;
+			es.modelindex = e % 40;
+			es.pos.trType = ( e & 1 ) ? TR_LINEAR : TR_STATIONARY;
+			for ( int j = 0; j < 3; j++ )
+			{
+				es.pos.trBase[j] = (int)RandomRange( &seed, -2048, 2048 );
+				es.pos.trDelta[j] = (int)RandomRange( &seed, -200, 200 );
+			}
+			es.apos.trBase[YAW] = (int)RandomRange( &seed, 0, 360 );
+		}
+
+		memset( players.data(), 0, sizeof( playerState_t ) * players.size() );
+		for ( int c = 0; c < NUM_CLIENTS; c++ )
+		{
+			playerState_t &ps = players[c];
+			ps.clientNum = c;
+			ps.stats[STAT_HEALTH] = 100;
+			ps.weapon = 1 + c % 8;
+			for ( int j = 0; j < 3; j++ )
+			{
+				ps.origin[j] = RandomRange( &seed, -2048, 2048 );
+			}
+		}
+
+		for ( int f = 0; f < NUM_FRAMES; f++ )
+		{
+			const int time = 1000 + f * 50;
+
+			for ( entityState_t &es : ents )
+			{
+				if ( es.pos.trType == TR_LINEAR )
+				{
+					es.pos.trTime = time;
+					for ( int j = 0; j < 3; j++ )
+					{
+						es.pos.trBase[j] += (int)( es.pos.trDelta[j] * 0.05f );
+					}
+				}
+				if ( RandomInt( &seed, 0, 9 ) == 0 )
+				{
+					es.apos.trBase[YAW] = AngleNormalize360( es.apos.trBase[YAW] + RandomRange( &seed, -45, 45 ) );
+					es.frame = ( es.frame + 1 ) % 64;
+				}
+				if ( RandomInt( &seed, 0, 31 ) == 0 )
+				{
+					es.event = ( es.event + 1 ) & 255;
+				}
+			}
+
+			std::vector< clientFrame_t > clients( NUM_CLIENTS );
+			for ( int c = 0; c < NUM_CLIENTS; c++ )
+			{
+				playerState_t &ps = players[c];
+
+				ps.commandTime = time;
+				for ( int j = 0; j < 3; j++ )
+				{
+					ps.velocity[j] = RandomRange( &seed, -320, 320 );
+					ps.origin[j] += ps.velocity[j] * 0.05f;
+				}
+				ps.viewangles[YAW] = AngleNormalize360( ps.viewangles[YAW] + RandomRange( &seed, -20, 20 ) );
+				ps.viewangles[PITCH] = RandomRange( &seed, -60, 60 );
+				if ( RandomInt( &seed, 0, 15 ) == 0 )
+				{
+					ps.stats[STAT_HEALTH] -= RandomInt( &seed, 1, 20 );
+					ps.ammo[ps.weapon] = RandomInt( &seed, 0, 200 );
+				}
+
+				clients[c].ps = ps;
+				for ( int e = 0; e < NUM_ENTITIES; e++ )
+				{
+					vec3_t delta;
+					VectorSubtract( ents[e].pos.trBase, ps.origin, delta );
+					if ( VectorLength( delta ) < VIEW_RANGE )
+					{
+						clients[c].entities.push_back( e );
+					}
+				}
+			}
+
+			rec.world.push_back( ents );
+			rec.clients.push_back( clients );
+		}
+	}
+
+	// The message SV_WriteSnapshotToClient writes for one client: playerstate
+	// and packet entities delta compressed against an older frame.
+	struct snapshotJob_t
+	{
+		const recording_t *rec;
+		int frame;
+		int client;
+		int deltaFrame;		// -1 for a full snapshot
+		msg_t msg;
+		byte msgBuf[MAX_MSGLEN];
+	};
+
+	void WriteSnapshot( snapshotJob_t &job )
+	{
+		static entityState_t baseline;	// all zero
+		const clientFrame_t &to = job.rec->clients[job.frame][job.client];
+		const std::vector< entityState_t > &toWorld = job.rec->world[job.frame];
+		const clientFrame_t *from = nullptr;
+		const std::vector< entityState_t > *fromWorld = nullptr;
+		static const std::vector< int > noEntities;
+
+		if ( job.deltaFrame >= 0 )
+		{
+			from = &job.rec->clients[job.deltaFrame][job.client];
+			fromWorld = &job.rec->world[job.deltaFrame];
+		}
+
+		MSG_Init( &job.msg, job.msgBuf, sizeof( job.msgBuf ) );
+		MSG_WriteLong( &job.msg, job.frame );
+		MSG_WriteByte( &job.msg, svc_snapshot );
+		MSG_WriteLong( &job.msg, 1000 + job.frame * 50 );
+		MSG_WriteByte( &job.msg, from ? job.frame - job.deltaFrame : 0 );
+
+		playerState_t fromPs, toPs = to.ps;
+		if ( from )
+		{
+			fromPs = from->ps;
+			MSG_WriteDeltaPlayerstate( &job.msg, &fromPs, &toPs );
+		}
+		else
+		{
+			MSG_WriteDeltaPlayerstate( &job.msg, nullptr, &toPs );
+		}
+
+		const std::vector< int > &oldList = from ? from->entities : noEntities;
+		const std::vector< int > &newList = to.entities;
+		size_t oldIndex = 0, newIndex = 0;
+
+		while ( oldIndex < oldList.size() || newIndex < newList.size() )
+		{
+			const int newnum = newIndex < newList.size() ? newList[newIndex] : 9999;
+			const int oldnum = oldIndex < oldList.size() ? oldList[oldIndex] : 9999;
+			entityState_t newEnt, oldEnt;
+
+			if ( newnum == oldnum )
+			{
+				oldEnt = (*fromWorld)[oldnum];
+				newEnt = toWorld[newnum];
+				MSG_WriteDeltaEntity( &job.msg, &oldEnt, &newEnt, qfalse );
+				oldIndex++;
+				newIndex++;
+			}
+			else if ( newnum < oldnum )
+			{
+				oldEnt = baseline;
+				newEnt = toWorld[newnum];
+				MSG_WriteDeltaEntity( &job.msg, &oldEnt, &newEnt, qtrue );
+				newIndex++;
+			}
+			else
+			{
+				oldEnt = (*fromWorld)[oldnum];
+				MSG_WriteDeltaEntity( &job.msg, &oldEnt, nullptr, qtrue );
+				oldIndex++;
+			}
+		}
+		MSG_WriteBits( &job.msg, MAX_GENTITIES - 1, GENTITYNUM_BITS );
+	}
+
+	void WriteSnapshotJob( void *data, int index )
+	{
+		WriteSnapshot( static_cast< snapshotJob_t* >( data )[index] );
+	}
+
+	std::vector< snapshotJob_t > MakeJobs( const recording_t &rec, int frame )
+	{
+		std::vector< snapshotJob_t > jobs( NUM_CLIENTS );
+		for ( int c = 0; c < NUM_CLIENTS; c++ )
+		{
+			// a mix of clients that are up to date, lagging and in need of a full snapshot
+			const int lag = 1 + c % 4;
+			jobs[c].rec = &rec;
+			jobs[c].frame = frame;
+			jobs[c].client = c;
+			jobs[c].deltaFrame = ( c % 7 == 0 || frame < lag ) ? -1 : frame - lag;
+		}
+		return jobs;
+	}
+
+	// the bit by bit bitstream for as long as it's in scope
+	struct slowBits_t
+	{
+		slowBits_t() { MSG_SetFastBits( qfalse ); }
+		~slowBits_t() { MSG_SetFastBits( qtrue ); }
+	};
+
+	// Reads back what WriteSnapshot wrote the way CL_ParseSnapshot would.
+	void ReadSnapshot( snapshotJob_t &job )
+	{
+		const clientFrame_t &to = job.rec->clients[job.frame][job.client];
+		const std::vector< entityState_t > &toWorld = job.rec->world[job.frame];
+		const clientFrame_t *from = job.deltaFrame >= 0 ? &job.rec->clients[job.deltaFrame][job.client] : nullptr;
+		msg_t &msg = job.msg;
+		entityState_t baseline, oldEnt, decoded;
+		playerState_t fromPs, ps;
+
+		memset( &baseline, 0, sizeof( baseline ) );
+		memset( &ps, 0, sizeof( ps ) );
+
+		MSG_BeginReading( &msg );
+		BOOST_CHECK_EQUAL( MSG_ReadLong( &msg ), job.frame );
+		BOOST_CHECK_EQUAL( MSG_ReadByte( &msg ), svc_snapshot );
+		BOOST_CHECK_EQUAL( MSG_ReadLong( &msg ), 1000 + job.frame * 50 );
+		BOOST_CHECK_EQUAL( MSG_ReadByte( &msg ), from ? job.frame - job.deltaFrame : 0 );
+		if ( from )
+		{
+			fromPs = from->ps;
+			MSG_ReadDeltaPlayerstate( &msg, &fromPs, &ps );
+		}
+		else
+		{
+			MSG_ReadDeltaPlayerstate( &msg, nullptr, &ps );
+		}
+		BOOST_CHECK_EQUAL( ps.commandTime, to.ps.commandTime );
+		BOOST_CHECK( memcmp( ps.origin, to.ps.origin, sizeof( ps.origin ) ) == 0 );
+		BOOST_CHECK( memcmp( ps.velocity, to.ps.velocity, sizeof( ps.velocity ) ) == 0 );
+
+		for ( ;; )
+		{
+			const int number = MSG_ReadBits( &msg, GENTITYNUM_BITS );
+			if ( number == MAX_GENTITIES - 1 )
+			{
+				break;
+			}
+			BOOST_REQUIRE( number >= 0 && number < NUM_ENTITIES );
+
+			const bool inOld = from && std::binary_search( from->entities.begin(), from->entities.end(), number );
+			const bool inNew = std::binary_search( to.entities.begin(), to.entities.end(), number );
+
+			oldEnt = inOld ? job.rec->world[job.deltaFrame][number] : baseline;
+			MSG_ReadDeltaEntity( &msg, &oldEnt, &decoded, number );
+			if ( inNew )
+			{
+				BOOST_CHECK( memcmp( &decoded, &toWorld[number], sizeof( decoded ) ) == 0 );
+			}
+			else
+			{
+				BOOST_CHECK( inOld );
+				BOOST_CHECK_EQUAL( decoded.number, MAX_GENTITIES - 1 );
+			}
+		}
+		BOOST_CHECK( msg.readcount <= msg.cursize );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE( qcommon )
+
+BOOST_AUTO_TEST_SUITE( msg )
+
+BOOST_AUTO_TEST_CASE( parallel_snapshots_match_serial )
+{
+	recording_t rec;
+	Record( rec );
+
+	for ( int threads = 2; threads <= 8; threads *= 2 )
+	{
+		for ( int f = 0; f < NUM_FRAMES; f++ )
+		{
+			std::vector< snapshotJob_t > serial = MakeJobs( rec, f );
+			std::vector< snapshotJob_t > parallel = MakeJobs( rec, f );
+
+			Sys_ParallelFor( 1, NUM_CLIENTS, WriteSnapshotJob, serial.data() );
+			Sys_ParallelFor( threads, NUM_CLIENTS, WriteSnapshotJob, parallel.data() );
+
+			for ( int c = 0; c < NUM_CLIENTS; c++ )
+			{
+				const msg_t &a = serial[c].msg;
+				const msg_t &b = parallel[c].msg;
+
+				BOOST_REQUIRE( !a.overflowed );
+				BOOST_CHECK_EQUAL( a.bit, b.bit );
+				BOOST_REQUIRE_EQUAL( a.cursize, b.cursize );
+				BOOST_CHECK( memcmp( a.data, b.data, a.cursize ) == 0 );
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_entities_decode )
+{
+	recording_t rec;
+	Record( rec );
+
+	const int f = NUM_FRAMES - 1;
+	std::vector< snapshotJob_t > jobs = MakeJobs( rec, f );
+	Sys_ParallelFor( 4, NUM_CLIENTS, WriteSnapshotJob, jobs.data() );
+
+	// full snapshots only need the baseline to read back
+	for ( int c = 0; c < NUM_CLIENTS; c += 7 )
+	{
+		msg_t &msg = jobs[c].msg;
+		entityState_t baseline, decoded;
+		playerState_t ps;
+
+		memset( &baseline, 0, sizeof( baseline ) );
+		memset( &ps, 0, sizeof( ps ) );
+
+		MSG_BeginReading( &msg );
+		BOOST_CHECK_EQUAL( MSG_ReadLong( &msg ), f );
+		BOOST_CHECK_EQUAL( MSG_ReadByte( &msg ), svc_snapshot );
+		MSG_ReadLong( &msg );
+		BOOST_CHECK_EQUAL( MSG_ReadByte( &msg ), 0 );
+		MSG_ReadDeltaPlayerstate( &msg, nullptr, &ps );
+		BOOST_CHECK_EQUAL( ps.commandTime, rec.clients[f][c].ps.commandTime );
+
+		for ( int number : rec.clients[f][c].entities )
+		{
+			BOOST_REQUIRE_EQUAL( MSG_ReadBits( &msg, GENTITYNUM_BITS ), number );
+			MSG_ReadDeltaEntity( &msg, &baseline, &decoded, number );
+			BOOST_CHECK( memcmp( &decoded, &rec.world[f][number], sizeof( decoded ) ) == 0 );
+		}
+		BOOST_CHECK_EQUAL( MSG_ReadBits( &msg, GENTITYNUM_BITS ), MAX_GENTITIES - 1 );
+	}
+}
+
+// the word at a time writer has to put out exactly the bits the bit by bit one does
+BOOST_AUTO_TEST_CASE( fast_bits_write_matches_bit_by_bit )
+{
+	recording_t rec;
+	Record( rec );
+
+	for ( int f = 0; f < NUM_FRAMES; f++ )
+	{
+		std::vector< snapshotJob_t > slow = MakeJobs( rec, f );
+		std::vector< snapshotJob_t > fast = MakeJobs( rec, f );
+
+		{
+			slowBits_t slowBits;
+			Sys_ParallelFor( 1, NUM_CLIENTS, WriteSnapshotJob, slow.data() );
+		}
+		Sys_ParallelFor( 1, NUM_CLIENTS, WriteSnapshotJob, fast.data() );
+
+		for ( int c = 0; c < NUM_CLIENTS; c++ )
+		{
+			const msg_t &a = slow[c].msg;
+			const msg_t &b = fast[c].msg;
+
+			BOOST_REQUIRE( !a.overflowed );
+			BOOST_CHECK_EQUAL( a.bit, b.bit );
+			BOOST_REQUIRE_EQUAL( a.cursize, b.cursize );
+			BOOST_CHECK( memcmp( a.data, b.data, a.cursize ) == 0 );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( snapshots_round_trip_both_ways )
+{
+	recording_t rec;
+	Record( rec );
+
+	for ( int f = 0; f < NUM_FRAMES; f += 5 )
+	{
+		std::vector< snapshotJob_t > jobs = MakeJobs( rec, f );
+		Sys_ParallelFor( 1, NUM_CLIENTS, WriteSnapshotJob, jobs.data() );
+
+		for ( int c = 0; c < NUM_CLIENTS; c++ )
+		{
+			ReadSnapshot( jobs[c] );
+			{
+				slowBits_t slowBits;
+				ReadSnapshot( jobs[c] );
+			}
+		}
+	}
+}
+
+// running out of room has to stop both writers at the same bit
+BOOST_AUTO_TEST_CASE( fast_bits_overflow_matches_bit_by_bit )
+{
+	recording_t rec;
+	Record( rec );
+
+	for ( int size = 64; size <= 512; size += 37 )
+	{
+		std::vector< byte > buffers[2];
+		msg_t msgs[2];
+
+		for ( int mode = 0; mode < 2; mode++ )
+		{
+			msg_t &msg = msgs[mode];
+			std::unique_ptr< slowBits_t > slowBits( mode ? nullptr : new slowBits_t );
+
+			buffers[mode].assign( size, 0 );
+			MSG_Init( &msg, buffers[mode].data(), size );
+			msg.allowoverflow = qtrue;
+			for ( int e = 0; e < NUM_ENTITIES && !msg.overflowed; e++ )
+			{
+				entityState_t from = rec.world[0][e], to = rec.world[NUM_FRAMES - 1][e];
+				MSG_WriteDeltaEntity( &msg, &from, &to, qtrue );
+			}
+		}
+
+		BOOST_CHECK( msgs[0].overflowed );
+		BOOST_CHECK_EQUAL( msgs[0].overflowed, msgs[1].overflowed );
+		BOOST_CHECK_EQUAL( msgs[0].bit, msgs[1].bit );
+		BOOST_CHECK_EQUAL( msgs[0].cursize, msgs[1].cursize );
+		BOOST_CHECK( buffers[0] == buffers[1] );
+	}
+}
+
+// plain MSG_WriteBits and MSG_ReadBits of every width, signed and not
+BOOST_AUTO_TEST_CASE( bits_round_trip_both_ways )
+{
+	const int count = 4096;
+	std::vector< byte > buffer( count * 5 );
+	std::vector< int > widths( count ), values( count );
+	unsigned int seed = 0x7e57;
+	msg_t msg;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		seed = seed * 1664525 + 1013904223;
+		const int bits = 1 + ( seed >> 8 ) % 32;
+		const bool sgn = bits < 32 && ( seed & 0x80000000 );
+		seed = seed * 1664525 + 1013904223;
+		int value = (int)seed;
+
+		if ( bits < 32 )
+		{
+			value &= ( 1 << bits ) - 1;
+			if ( sgn && ( value & ( 1 << ( bits - 1 ) ) ) )
+			{
+				value |= ~( ( 1 << bits ) - 1 );
+			}
+		}
+		widths[i] = sgn ? -bits : bits;
+		values[i] = value;
+	}
+
+	MSG_Init( &msg, buffer.data(), (int)buffer.size() );
+	for ( int i = 0; i < count; i++ )
+	{
+		MSG_WriteBits( &msg, values[i], widths[i] );
+	}
+	BOOST_REQUIRE( !msg.overflowed );
+
+	// Signed reads only sign extend from the whole bytes of the width, so a
+	// negative value in a width that isn't a multiple of 8 comes back with
+	// its top bits clear.  Both readers have to agree on that too.
+	std::vector< int > slowValues( count );
+	{
+		slowBits_t slowBits;
+
+		MSG_BeginReading( &msg );
+		for ( int i = 0; i < count; i++ )
+		{
+			slowValues[i] = MSG_ReadBits( &msg, widths[i] );
+			if ( widths[i] > 0 || !( widths[i] & 7 ) )
+			{
+				BOOST_REQUIRE_EQUAL( slowValues[i], values[i] );
+			}
+		}
+		BOOST_CHECK_EQUAL( msg.readcount, msg.cursize );
+	}
+
+	MSG_BeginReading( &msg );
+	for ( int i = 0; i < count; i++ )
+	{
+		BOOST_REQUIRE_EQUAL( MSG_ReadBits( &msg, widths[i] ), slowValues[i] );
+	}
+	BOOST_CHECK_EQUAL( msg.readcount, msg.cursize );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,143 @@
+#include "qcommon/qcommon.h"
+#include "server/server.h"
+#include "sys/sys_public.h"
+
+#include "stubs.h"
+
+#include <cstdarg>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The engine functions the qcommon code under test calls, just enough for
+// writing messages and loading and tracing a clip map outside of the engine.
+
+cvar_t		*cl_shownet = nullptr;
+static cvar_t	dedicated;
+cvar_t		*com_dedicated = &dedicated;
+server_t	sv;
+
+void Com_Error( int, const char *fmt, ... )
+{
+	char text[1024];
+	va_list argptr;
+	va_start( argptr, fmt );
+	Q_vsnprintf( text, sizeof( text ), fmt, argptr );
+	va_end( argptr );
+	throw std::runtime_error( text );
+}
+
+void Com_Printf( const char *, ... )
+{
+}
+
+void Com_DPrintf( const char *, ... )
+{
+}
+
+uint32_t Com_BlockChecksum( const void *, int length )
+{
+	return length;
+}
+
+int Cmd_Argc( void ) { return 0; }
+char *Cmd_Argv( int ) { return const_cast< char* >( "" ); }
+int Sys_Milliseconds( bool ) { return 0; }
+qboolean Sys_LowPhysicalMemory() { return qfalse; }
+void Sys_UnmapFile( sysFileMapping_t * ) {}
+sharedEntity_t *SV_GentityNum( int ) { return nullptr; }
+void BotDrawDebugPolygons( void (*)( int, int, float * ), int ) {}
+
+cvar_t *Cvar_Get( const char *name, const char *value, uint32_t flags, const char * )
+{
+	static std::map< std::string, cvar_t > cvars;
+	cvar_t &var = cvars[name];
+	if ( !var.name )
+	{
+		var.name = strdup( name );
+		var.string = strdup( value );
+		var.flags = flags;
+		var.value = atof( value );
+		var.integer = atoi( value );
+	}
+	return &var;
+}
+
+void *Z_Malloc( int size, memtag_t, qboolean init, int )
+{
+	return init ? calloc( 1, size ) : malloc( size );
+}
+void Z_Free( void *ptr ) { free( ptr ); }
+
+void *Hunk_Alloc( int size, ha_pref )
+{
+	// lives until the test exits, like the hunk lives until the next map
+	return calloc( 1, size ? size : 1 );
+}
+
+//
+// files the tests hand to FS_FOpenFileRead
+//
+namespace
+{
+	struct testFile_t
+	{
+		std::vector< byte > data;
+		size_t pos;
+	};
+	std::map< std::string, testFile_t > testFiles;
+	std::vector< testFile_t* > openFiles( 1, nullptr );	// handle 0 is no file
+}
+
+void Test_AddFile( const char *name, const void *data, int length )
+{
+	testFile_t &file = testFiles[name];
+	file.data.assign( (const byte *)data, (const byte *)data + length );
+	file.pos = 0;
+}
+
+long FS_FOpenFileRead( const char *name, fileHandle_t *handle, qboolean )
+{
+	auto it = testFiles.find( name );
+	if ( it == testFiles.end() )
+	{
+		*handle = 0;
+		return -1;
+	}
+	it->second.pos = 0;
+	openFiles.push_back( &it->second );
+	*handle = (fileHandle_t)openFiles.size() - 1;
+	return (long)it->second.data.size();
+}
+
+void FS_FCloseFile( fileHandle_t handle )
+{
+	openFiles[handle] = nullptr;
+}
+
+int FS_Read( void *buffer, int length, fileHandle_t handle )
+{
+	testFile_t *file = openFiles[handle];
+	length = Q_min( length, (int)( file->data.size() - file->pos ) );
+	memcpy( buffer, file->data.data() + file->pos, length );
+	file->pos += length;
+	return length;
+}
+
+const void *FS_MapFile( fileHandle_t, sysFileMapping_t * )
+{
+	return nullptr;
+}
+
+long FS_ReadFile( const char *, void **buffer )
+{
+	if ( buffer )
+	{
+		*buffer = nullptr;
+	}
+	return -1;
+}
+
+void FS_FreeFile( void * ) {}
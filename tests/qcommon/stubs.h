@@ -0,0 +1,4 @@
+#pragma once
+
+// makes name readable through FS_FOpenFileRead for the rest of the test run
+void Test_AddFile( const char *name, const void *data, int length );
@@ -0,0 +1,113 @@
+#include "sys/sys_jobs.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+	void MarkIndex( void *data, int index )
+	{
+		std::vector< std::atomic< int > >& hits = *static_cast< std::vector< std::atomic< int > >* >( data );
+		hits[ index ]++;
+	}
+
+	void RecordThread( void *data, int index )
+	{
+		static_cast< int* >( data )[ index ] = Sys_JobThreadIndex();
+	}
+
+	void ThrowOnSeven( void *, int index )
+	{
+		if ( index == 7 )
+		{
+			throw std::runtime_error( "job failed" );
+		}
+	}
+
+	void NestedParallelFor( void *data, int index )
+	{
+		std::vector< std::atomic< int > >& hits = *static_cast< std::vector< std::atomic< int > >* >( data );
+		// nested batches run inline on the calling thread
+		Sys_ParallelFor( 4, 1, MarkIndex, &hits );
+		hits[ index + 1 ]++;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE( sys )
+
+BOOST_AUTO_TEST_SUITE( jobs )
+
+BOOST_AUTO_TEST_CASE( every_index_runs_once )
+{
+	for ( int threads = 0; threads <= 8; threads++ )
+	{
+		std::vector< std::atomic< int > > hits( 1000 );
+		Sys_ParallelFor( threads, (int)hits.size(), MarkIndex, &hits );
+		for ( const std::atomic< int >& hit : hits )
+		{
+			BOOST_CHECK_EQUAL( hit.load(), 1 );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( serial_runs_on_caller )
+{
+	int threadIndices[ 16 ];
+	Sys_ParallelFor( 1, 16, RecordThread, threadIndices );
+	for ( int index : threadIndices )
+	{
+		BOOST_CHECK_EQUAL( index, 0 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( thread_indices_in_range )
+{
+	int threadIndices[ 256 ];
+	Sys_ParallelFor( 4, 256, RecordThread, threadIndices );
+	for ( int index : threadIndices )
+	{
+		BOOST_CHECK( index >= 0 && index < 4 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( exception_reaches_caller )
+{
+	BOOST_CHECK_THROW( Sys_ParallelFor( 4, 64, ThrowOnSeven, nullptr ), std::runtime_error );
+
+	// the pool is still usable afterwards
+	std::vector< std::atomic< int > > hits( 64 );
+	Sys_ParallelFor( 4, (int)hits.size(), MarkIndex, &hits );
+	for ( const std::atomic< int >& hit : hits )
+	{
+		BOOST_CHECK_EQUAL( hit.load(), 1 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( nested )
+{
+	std::vector< std::atomic< int > > hits( 33 );
+	Sys_ParallelFor( 4, 32, NestedParallelFor, &hits );
+	BOOST_CHECK_EQUAL( hits[ 0 ].load(), 32 );
+	for ( int i = 1; i <= 32; i++ )
+	{
+		BOOST_CHECK_EQUAL( hits[ i ].load(), 1 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( shutdown_and_restart )
+{
+	Sys_ShutdownJobs();
+	std::vector< std::atomic< int > > hits( 100 );
+	Sys_ParallelFor( 3, (int)hits.size(), MarkIndex, &hits );
+	for ( const std::atomic< int >& hit : hits )
+	{
+		BOOST_CHECK_EQUAL( hit.load(), 1 );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()